@@ -0,0 +1,30 @@
+#version 460 core
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+
+// Depth only pass. ALPHA_MASK adds the albedo alpha test, OVERDRAW outputs 1 per shaded fragment
+// so an additively blended target counts overdraw.
+#ifdef ALPHA_MASK
+in vec2 vUV;
+#include "draw_data.glsl"
+#ifdef MATERIAL_TABLE
+flat in uint vMaterial;
+#endif
+#endif
+
+#ifdef OVERDRAW
+out vec4 FragColor;
+#endif
+
+void main() {
+#ifdef ALPHA_MASK
+#ifdef MATERIAL_TABLE
+	loadMaterial(vMaterial);
+#endif
+	if (material.hasAlbedoMap != 0 && materialMap(MAP_ALBEDO, vUV).a < material.alphaCutoff) discard;
+#endif
+#ifdef OVERDRAW
+	FragColor = vec4(1.0);
+#endif
+}
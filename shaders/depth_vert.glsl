@@ -0,0 +1,34 @@
+#version 460 core
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+
+// Depth pre-pass / overdraw vertex shader. Opaque meshes feed it their position only stream.
+layout(location = 0) in vec3 aPos;
+#ifdef ALPHA_MASK
+layout(location = 3) in vec2 aUV;
+out vec2 vUV;
+#ifdef MATERIAL_TABLE
+flat out uint vMaterial;
+#endif
+#endif
+
+#include "frame_data.glsl"
+#include "draw_data.glsl"
+
+// Must match vert.glsl bit for bit so the shading pass can use GL_EQUAL
+invariant gl_Position;
+
+void main() {
+#ifdef MATERIAL_TABLE
+	loadDraw(uint(gl_BaseInstance));
+#endif
+	vec4 worldPos = model * vec4(aPos, 1.0);
+#ifdef ALPHA_MASK
+	vUV = aUV;
+#ifdef MATERIAL_TABLE
+	vMaterial = materialIndex;
+#endif
+#endif
+	gl_Position = projection * view * worldPos;
+}
@@ -0,0 +1,119 @@
+// Per draw transform and material constants, one ring buffer range per draw (Render::DrawData).
+// MATERIAL_TABLE variants read both from storage buffers instead (Render::MaterialTable): batched draws
+// find their DrawInstance at gl_BaseInstance and it names the material.
+
+struct MaterialData {
+	vec3 Albedo;
+	float Metallic;
+	vec3 Emissive;
+	float Roughness;
+	float AO;
+	float alphaCutoff;
+	// Texture toggles, the constants above are used where they are 0. With a map Metallic and Roughness
+	// scale its channel and AO is the occlusion strength, as the glTF factors.
+	int hasAlbedoMap;
+	int hasMetallicMap;
+	int hasRoughnessMap;
+	int hasAOMap;
+	int hasEmissiveMap;
+	int hasNormalMap;
+	int doubleSided;
+	// Channels of the ORM texture the maps above read
+	int metallicChannel;
+	int roughnessChannel;
+	int aoChannel;
+};
+
+// Render::MaterialMap
+#define MAP_ALBEDO 0
+#define MAP_ORM 1
+#define MAP_NORMAL 2
+#define MAP_EMISSIVE 3
+
+#ifdef MATERIAL_TABLE
+
+struct MaterialRecord {
+	MaterialData constants;
+	uvec2 maps[4]; // bindless handle, or (array, layer)
+};
+
+layout(std430, binding = 5) readonly buffer MaterialTable {
+	MaterialRecord materials[];
+};
+
+struct DrawInstance {
+	mat4 model;
+	vec4 normalMatrix[3];
+	uint material;
+	uint pad0, pad1, pad2;
+};
+
+layout(std430, binding = 6) readonly buffer DrawInstances {
+	DrawInstance instances[];
+};
+
+// Filled from the storage buffers at the start of main
+mat4 model;
+mat3 normalMatrix;
+MaterialData material;
+uint materialIndex;
+
+void loadDraw(uint instance) {
+	model = instances[instance].model;
+	normalMatrix = mat3(instances[instance].normalMatrix[0].xyz, instances[instance].normalMatrix[1].xyz, instances[instance].normalMatrix[2].xyz);
+	materialIndex = instances[instance].material;
+}
+
+void loadMaterial(uint index) {
+	materialIndex = index;
+	material = materials[index].constants;
+}
+
+#ifdef BINDLESS
+vec4 materialMap(int map, vec2 uv) {
+	return texture(sampler2D(materials[materialIndex].maps[map]), uv);
+}
+#else
+// Render::kMaterialArrayUnit onwards. Indexed with constants only, draws of one batch may differ.
+layout(binding = 8) uniform sampler2DArray u_MaterialArrays[8];
+
+vec4 materialMap(int map, vec2 uv) {
+	uvec2 ref = materials[materialIndex].maps[map];
+	vec3 coord = vec3(uv, float(ref.y));
+	switch (ref.x) {
+	case 0u: return texture(u_MaterialArrays[0], coord);
+	case 1u: return texture(u_MaterialArrays[1], coord);
+	case 2u: return texture(u_MaterialArrays[2], coord);
+	case 3u: return texture(u_MaterialArrays[3], coord);
+	case 4u: return texture(u_MaterialArrays[4], coord);
+	case 5u: return texture(u_MaterialArrays[5], coord);
+	case 6u: return texture(u_MaterialArrays[6], coord);
+	default: return texture(u_MaterialArrays[7], coord);
+	}
+}
+#endif
+
+#else
+
+layout(std140, binding = 1) uniform DrawData {
+	mat4 model;
+	mat3 normalMatrix; // inverse transpose of model's upper 3x3, computed once per draw on the CPU
+	MaterialData material;
+};
+
+// Material textures stay on fixed units (Model::bindMaterial)
+layout(binding = 1) uniform sampler2D u_AlbedoMap;
+layout(binding = 2) uniform sampler2D u_OrmMap;
+layout(binding = 4) uniform sampler2D u_NormalMap;
+layout(binding = 6) uniform sampler2D u_EmissiveMap;
+
+vec4 materialMap(int map, vec2 uv) {
+	switch (map) {
+	case MAP_ALBEDO: return texture(u_AlbedoMap, uv);
+	case MAP_ORM: return texture(u_OrmMap, uv);
+	case MAP_NORMAL: return texture(u_NormalMap, uv);
+	default: return texture(u_EmissiveMap, uv);
+	}
+}
+
+#endif
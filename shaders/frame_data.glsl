@@ -0,0 +1,20 @@
+// Per frame constants, streamed through the ring buffer (Render::FrameData on the C++ side).
+
+struct Light {
+	vec3 position;
+	vec3 color;
+	float intensity;
+};
+
+layout(std140, binding = 0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	Light light;
+	vec3 viewPos;
+	float envMaxMips;       // number of mip levels in the environment map
+	float iblIntensity;     // scales IBL contribution
+	float horizonFadePower; // controls horizon fade exponent
+	int debugMode;          // 0=off, 1=NdotL, 2=NdotV, 3=DirectOnly, 4=IBLOnly
+	int enableIBL;          // 1=on, 0=off
+	int enableDirect;       // 1=on, 0=off
+};
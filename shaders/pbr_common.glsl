@@ -0,0 +1,116 @@
+// Shared PBR shading code. Included by the forward fragment shader and the visibility buffer resolve.
+
+#include "frame_data.glsl"
+#include "draw_data.glsl"
+
+layout(binding = 0) uniform samplerCube environmentMap;
+
+const float PI = 3.14159265359;
+
+vec3 fresnelSchlick(float cosTheta, vec3 F0) {
+    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
+    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+vec2 envBRDFApprox(float NdotV, float roughness) {
+    const vec4 c0 = vec4(-1.0, -0.0275, -0.572, 0.022);
+    const vec4 c1 = vec4( 1.0,  0.0425,  1.04, -0.04);
+    vec4 r = roughness * c0 + c1;
+    float a004 = min(r.x * r.x, exp2(-9.28 * NdotV)) * r.x + r.y;
+    return vec2(-1.04, 1.04) * a004 + r.zw;
+}
+
+float specularAO(float NdotV, float ao, float roughness) {
+    float exponent = exp2(-16.0 * roughness - 1.0);
+    return clamp(pow(NdotV + ao, exponent) - 1.0 + ao, 0.0, 1.0);
+}
+
+float distributionGGX(vec3 N, vec3 H, float roughness) {
+    float a  = max(roughness * roughness, 1e-4);
+    float a2 = a * a;
+    float NdotH  = max(dot(N, H), 0.0);
+    float NdotH2 = NdotH * NdotH;
+    float denom  = (NdotH2 * (a2 - 1.0) + 1.0);
+    return a2 / (PI * denom * denom);
+}
+
+float geometrySchlickGGX(float NdotX, float roughness) {
+    float a = max(roughness, 1e-4);
+    float k = (a + 1.0);
+    k = (k * k) / 8.0;
+    return NdotX / (NdotX * (1.0 - k) + k);
+}
+
+float geometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
+    float NdotV = max(dot(N, V), 0.0);
+    float NdotL = max(dot(N, L), 0.0);
+    float ggxV = geometrySchlickGGX(NdotV, roughness);
+    float ggxL = geometrySchlickGGX(NdotL, roughness);
+    return ggxV * ggxL;
+}
+
+// Direct + image based lighting for a resolved surface point. Returns linear HDR radiance.
+vec3 shadeSurface(vec3 P, vec3 N, vec3 V, vec3 baseColor, float metallic, float roughness, float aoVal, vec3 emissive) {
+    vec3 L = normalize(light.position - P);
+    float NdotL = max(dot(N, L), 0.0);
+    float NdotV = max(dot(N, V), 0.0);
+
+    if (debugMode == 1) return vec3(NdotL);
+    if (debugMode == 2) return vec3(NdotV);
+
+    float distance   = length(light.position - P);
+    float attenuation = 1.0 / max(distance * distance, 1e-4);
+    vec3 radiance    = light.color * light.intensity * attenuation;
+
+    vec3 F0 = vec3(0.04);
+    F0 = mix(F0, baseColor, metallic);
+
+    vec3 Lo = vec3(0.0);
+    if (NdotL > 0.0) {
+        vec3 H = normalize(V + L);
+        float NDF = distributionGGX(N, H, roughness);
+        float G   = geometrySmith(N, V, L, roughness);
+        vec3  F   = fresnelSchlick(max(dot(H, V), 0.0), F0);
+
+        vec3 numerator    = NDF * G * F;
+        float denominator = max(4.0 * NdotV * NdotL, 1e-4);
+        vec3 specular     = numerator / denominator;
+
+        vec3 kS = F;
+        vec3 kD = (vec3(1.0) - kS) * (1.0 - metallic);
+        vec3 diffuse = kD * baseColor / PI;
+        Lo = (diffuse + specular) * radiance * NdotL;
+    }
+
+    float maxMips = (envMaxMips > 0.5) ? envMaxMips : 8.0;
+    float maxMip = max(maxMips - 1.0, 0.0);
+    vec3 irradiance = textureLod(environmentMap, N, maxMip).rgb;
+    vec3 diffuseIBL = irradiance * baseColor / PI;
+
+    vec3 R = reflect(-V, N);
+    float mip = roughness * maxMip;
+    vec3 prefiltered = textureLod(environmentMap, R, mip).rgb;
+
+    float NoV = max(dot(N, V), 0.0);
+    vec2 AB = envBRDFApprox(NoV, roughness);
+    vec3 specularIBL = prefiltered * (F0 * AB.x + AB.y);
+    float horizon = clamp(1.0 + dot(R, N), 0.0, 1.0);
+    specularIBL *= pow(horizon, max(horizonFadePower, 0.0));
+    specularIBL *= geometrySchlickGGX(NoV, roughness);
+    float specAOv = specularAO(NoV, aoVal, roughness);
+    specularIBL *= specAOv;
+
+    vec3 kS_ibl = fresnelSchlickRoughness(NoV, F0, roughness);
+    vec3 kD_ibl = (vec3(1.0) - kS_ibl) * (1.0 - metallic);
+    vec3 ambientCombined = ((diffuseIBL * aoVal) * kD_ibl + specularIBL) * iblIntensity;
+
+    vec3 color = emissive; // emissive adds directly
+    if (enableDirect != 0) color += Lo;
+    if (enableIBL != 0)    color += ambientCombined;
+    if (debugMode == 3) color = Lo;
+    if (debugMode == 4) color = ambientCombined;
+    return color;
+}
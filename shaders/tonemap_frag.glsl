@@ -1,8 +1,29 @@
 #version 460 core
 in vec2 vUV;
 out vec4 FragColor;
+#ifdef MSAA_RESOLVE
+// Fused resolve: every sample is tonemapped before averaging, so bright HDR samples on an edge no
+// longer swamp the darker ones and no intermediate resolve texture is needed
+uniform sampler2DMS uColor;
+uniform int uSamples;
+#else
 uniform sampler2D uColor;
+#endif
 uniform float uExposure;
+uniform int uOverdraw; // 1 = uColor.r holds a fragment count, show it as a heat map
+uniform vec2 uUVScale;     // render size / allocated size of uColor
+uniform ivec2 uRenderSize; // rendered region of uColor in texels
+uniform ivec2 uOutputSize; // size of the target
+uniform int uUpscale;      // 1 = rendered below output resolution, use the edge preserving filter
+
+vec3 overdrawHeat(float count) {
+    // 0 = black, 1 = blue, 2 = green, 3 = yellow, 4 = red, 6+ = white
+    const vec3 ramp[7] = vec3[7](vec3(0.0), vec3(0.0, 0.2, 1.0), vec3(0.0, 0.9, 0.2), vec3(1.0, 0.9, 0.0),
+                                 vec3(1.0, 0.1, 0.0), vec3(1.0, 0.0, 0.6), vec3(1.0));
+    float c = clamp(count, 0.0, 6.0);
+    int i = min(int(c), 5);
+    return mix(ramp[i], ramp[i + 1], c - float(i));
+}
 
 vec3 tonemapACES(vec3 x) {
     const float a = 2.51;
@@ -13,9 +34,97 @@ vec3 tonemapACES(vec3 x) {
     return clamp((x*(a*x + b)) / (x*(c*x + d) + e), 0.0, 1.0);
 }
 
+vec3 exposeAndMap(vec3 hdr) {
+    return tonemapACES(hdr * max(uExposure, 0.0));
+}
+
+#ifdef MSAA_RESOLVE
+// Tonemapped (linear LDR) average of the texel's samples
+vec3 fetchRendered(ivec2 p) {
+    p = clamp(p, ivec2(0), uRenderSize - 1);
+    vec3 sum = vec3(0.0);
+    for (int s = 0; s < uSamples; ++s) sum += exposeAndMap(texelFetch(uColor, p, s).rgb);
+    return sum / float(uSamples);
+}
+
+float fetchOverdraw(vec2 uv) {
+    ivec2 p = clamp(ivec2(uv * vec2(uRenderSize)), ivec2(0), uRenderSize - 1);
+    float sum = 0.0;
+    for (int s = 0; s < uSamples; ++s) sum += texelFetch(uColor, p, s).r;
+    return sum / float(uSamples);
+}
+
+// There is no filtering for multisample textures, blend the four nearest resolved texels by hand
+vec3 sampleBilinear(vec2 uv) {
+    vec2 pos = uv * vec2(uRenderSize) - 0.5;
+    ivec2 base = ivec2(floor(pos));
+    vec2 f = pos - vec2(base);
+    vec3 top = mix(fetchRendered(base), fetchRendered(base + ivec2(1, 0)), f.x);
+    vec3 bottom = mix(fetchRendered(base + ivec2(0, 1)), fetchRendered(base + ivec2(1, 1)), f.x);
+    return mix(top, bottom, f.y);
+}
+#else
+vec3 fetchRendered(ivec2 p) {
+    return texelFetch(uColor, clamp(p, ivec2(0), uRenderSize - 1), 0).rgb;
+}
+#endif
+
+vec4 catmullRomWeights(float t) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return vec4(-0.5 * t3 + t2 - 0.5 * t,
+                 1.5 * t3 - 2.5 * t2 + 1.0,
+                -1.5 * t3 + 2.0 * t2 + 0.5 * t,
+                 0.5 * t3 - 0.5 * t2);
+}
+
+// Catmull-Rom reconstruction clamped to the 2x2 texels around the sample point. The bicubic keeps
+// edges sharp where bilinear would smear them, the clamp removes its ringing/halos across strong edges.
+vec3 sampleUpscaled(vec2 uv) {
+    vec2 pos = uv * vec2(uRenderSize) - 0.5;
+    ivec2 base = ivec2(floor(pos));
+    vec2 f = pos - vec2(base);
+    vec4 wx = catmullRomWeights(f.x);
+    vec4 wy = catmullRomWeights(f.y);
+
+    vec3 sum = vec3(0.0);
+    vec3 lo = vec3(1e30);
+    vec3 hi = vec3(-1e30);
+    for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 4; ++i) {
+            vec3 c = fetchRendered(base + ivec2(i - 1, j - 1));
+            sum += c * (wx[i] * wy[j]);
+            if (i >= 1 && i <= 2 && j >= 1 && j <= 2) {
+                lo = min(lo, c);
+                hi = max(hi, c);
+            }
+        }
+    }
+    return clamp(sum, lo, hi);
+}
+
 void main(){
-    vec3 hdr = texture(uColor, vUV).rgb;
-    vec3 mapped = tonemapACES(hdr * max(uExposure, 0.0));
+#ifdef MSAA_RESOLVE
+    if (uOverdraw != 0) {
+        FragColor = vec4(overdrawHeat(fetchOverdraw(vUV)), 1.0);
+        return;
+    }
+    // Samples are already tonemapped, the upscale filter runs on the mapped values. At native size every
+    // bilinear weight is 0 or 1, so only the one texel's samples are mapped instead of four texels' worth.
+    vec3 mapped;
+    if (uRenderSize == uOutputSize) {
+        mapped = fetchRendered(ivec2(gl_FragCoord.xy));
+    } else {
+        mapped = (uUpscale != 0) ? sampleUpscaled(vUV) : sampleBilinear(vUV);
+    }
+#else
+    if (uOverdraw != 0) {
+        FragColor = vec4(overdrawHeat(texture(uColor, vUV * uUVScale).r), 1.0);
+        return;
+    }
+    vec3 hdr = (uUpscale != 0) ? sampleUpscaled(vUV) : texture(uColor, vUV * uUVScale).rgb;
+    vec3 mapped = exposeAndMap(hdr);
+#endif
     vec3 ldr = pow(mapped, vec3(1.0/2.2));
     FragColor = vec4(ldr, 1.0);
 }
@@ -1,29 +1,43 @@
 #version 460 core
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
 
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec4 aTangent; // xyz tangent, w = handedness
 layout(location = 3) in vec2 aUV;
 
-// basic transformation matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "frame_data.glsl"
+#include "draw_data.glsl"
+
+// Recompute the normal matrix per vertex instead, only to measure what that costs
+uniform bool uShaderNormalMatrix = false;
 
 out vec3 vWorldPos;   // world position
 out vec3 vWorldN;     // world normal
 out vec3 vWorldT;     // world tangent
 out vec3 vWorldB;     // world bitangent
 out vec2 vUV;
+#ifdef MATERIAL_TABLE
+flat out uint vMaterial;
+#endif
+
+// Must match depth_vert.glsl bit for bit so the GL_EQUAL pass after a depth pre-pass works
+invariant gl_Position;
 
 void main() {
+#ifdef MATERIAL_TABLE
+	loadDraw(uint(gl_BaseInstance));
+	vMaterial = materialIndex;
+#endif
 	vec4 worldPos = model * vec4(aPos, 1.0);
 	vWorldPos = worldPos.xyz;
 
-	mat3 normalMatrix = transpose(inverse(mat3(model)));
-	vec3 N = normalize(normalMatrix * aNormal);
+	mat3 N3 = uShaderNormalMatrix ? transpose(inverse(mat3(model))) : normalMatrix;
+	vec3 N = normalize(N3 * aNormal);
 	// Build tangent basis, falling back if tangents are missing/zero
-	vec3 T = normalMatrix * aTangent.xyz;
+	vec3 T = N3 * aTangent.xyz;
 	float tLen = length(T);
 	if (tLen < 1e-5) {
 		// Construct arbitrary T orthogonal to N
@@ -0,0 +1,33 @@
+#version 460 core
+
+// Bins the visibility buffer by screen tile: sets the tile's bit in the mask of every draw with a sample in
+// it, so each draw's resolve only covers the tiles it shows up in. One work group per 32x32 pixel tile
+// (Render::VisibilityRenderer's kResolveTileSize), each invocation a 2x2 pixel block.
+layout(local_size_x = 16, local_size_y = 16) in;
+
+uniform usampler2DMS uVisibility;
+uniform int uSamples;
+uniform ivec2 uViewport; // render size, the buffer may be larger
+uniform int uTileWords;  // mask words per draw
+
+// Cleared to zero before the dispatch, draw (key - 1) owns words [draw * uTileWords, (draw + 1) * uTileWords)
+layout(std430, binding = 7) buffer TileMasks { uint tileMasks[]; };
+
+void main() {
+	uint tile = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+	uint word = tile >> 5u;
+	uint bit = 1u << (tile & 31u);
+	uint lastKey = 0u;
+	for (int p = 0; p < 4; ++p) {
+		ivec2 px = ivec2(gl_GlobalInvocationID.xy) * 2 + ivec2(p & 1, p >> 1);
+		if (any(greaterThanEqual(px, uViewport))) continue;
+		for (int s = 0; s < uSamples; ++s) {
+			uint key = texelFetch(uVisibility, px, s).x;
+			if (key == 0u || key == lastKey) continue; // empty, or this invocation already set it
+			lastKey = key;
+			uint slot = (key - 1u) * uint(uTileWords) + word;
+			// Most samples of a tile belong to draws whose bit is set by then, the read skips their atomics
+			if ((tileMasks[slot] & bit) == 0u) atomicOr(tileMasks[slot], bit);
+		}
+	}
+}
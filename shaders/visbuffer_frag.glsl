@@ -0,0 +1,17 @@
+#version 460 core
+
+// Thin visibility buffer: draw id (offset by one, 0 = empty) and triangle id per sample.
+in vec2 vUV;
+layout(location = 0) out uvec2 VisID;
+
+uniform int uDrawID;
+// Only the albedo alpha of the material is used, for the alpha test
+#include "draw_data.glsl"
+
+void main() {
+#ifdef ALPHA_MASK
+	// Alpha test has to happen here so the resolve never sees cut-out triangles
+	if (material.hasAlbedoMap != 0 && texture(u_AlbedoMap, vUV).a < material.alphaCutoff) discard;
+#endif
+	VisID = uvec2(uint(uDrawID) + 1u, uint(gl_PrimitiveID));
+}
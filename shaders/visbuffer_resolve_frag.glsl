@@ -0,0 +1,208 @@
+#version 460 core
+
+// Visibility buffer resolve. Drawn once per draw record over the screen tiles the binning pass found the
+// draw in (visbuffer_tile_vert.glsl) with additive blending. Each pass shades the pixels whose samples
+// belong to its draw once. Into a single-sample target the shade is weighted by how many of the MSAA samples it
+// covers, so edge pixels come out as the coverage weighted average of every draw touching them; into a
+// multisample target (uSampleMask) it is written unweighted to just the covered samples.
+
+in vec2 vUV;
+out vec4 FragColor;
+
+#include "pbr_common.glsl"
+
+uniform usampler2DMS uVisibility;
+uniform int uSamples;
+uniform int uSampleMask;
+uniform int uDrawID;
+uniform vec2 uViewport;
+
+// model, normalMatrix and the material come from the draw's DrawData range, view and projection from FrameData
+uniform int uHasNormals;
+uniform int uHasTangents;
+uniform int uHasUVs;
+
+// Vertex streams of the draw's mesh, bound straight from its vertex buffers as raw words since they may be
+// interleaved or quantized. uStreamFormat describes each like its VAO attribute does: x = GL component
+// type, y = component count, z = normalized, w = stride in bytes. Interleaved streams share a buffer,
+// uStreamOffset is the byte offset of each stream's first element in it.
+layout(std430, binding = 0) readonly buffer Positions { uint positionWords[]; };
+layout(std430, binding = 1) readonly buffer Normals { uint normalWords[]; };
+layout(std430, binding = 2) readonly buffer Tangents { uint tangentWords[]; };
+layout(std430, binding = 3) readonly buffer UVs { uint uvWords[]; };
+layout(std430, binding = 4) readonly buffer Indices { uint indices[]; };
+uniform ivec4 uStreamFormat[4];
+uniform int uStreamOffset[4];
+
+const int GL_BYTE_TYPE = 0x1400;
+const int GL_UNSIGNED_BYTE_TYPE = 0x1401;
+const int GL_SHORT_TYPE = 0x1402;
+const int GL_UNSIGNED_SHORT_TYPE = 0x1403;
+const int GL_FLOAT_TYPE = 0x1406;
+
+uint loadWord(int stream, uint word) {
+	if (stream == 0) return positionWords[word];
+	if (stream == 1) return normalWords[word];
+	if (stream == 2) return tangentWords[word];
+	return uvWords[word];
+}
+
+// glTF normalized integer decoding, same as the fixed function vertex fetch
+float fetchComponent(int stream, uint byteOffset, ivec4 format) {
+	uint word = loadWord(stream, byteOffset >> 2);
+	int bit = int(byteOffset & 3u) * 8;
+	bool normalized = format.z != 0;
+	switch (format.x) {
+	case GL_UNSIGNED_BYTE_TYPE: {
+		float v = float(bitfieldExtract(word, bit, 8));
+		return normalized ? v / 255.0 : v;
+	}
+	case GL_BYTE_TYPE: {
+		float v = float(bitfieldExtract(int(word), bit, 8));
+		return normalized ? max(v / 127.0, -1.0) : v;
+	}
+	case GL_UNSIGNED_SHORT_TYPE: {
+		float v = float(bitfieldExtract(word, bit, 16));
+		return normalized ? v / 65535.0 : v;
+	}
+	case GL_SHORT_TYPE: {
+		float v = float(bitfieldExtract(int(word), bit, 16));
+		return normalized ? max(v / 32767.0, -1.0) : v;
+	}
+	default: return uintBitsToFloat(word);
+	}
+}
+
+vec4 fetchAttribute(int stream, uint i) {
+	ivec4 format = uStreamFormat[stream];
+	uint size = format.x == GL_FLOAT_TYPE ? 4u : (format.x == GL_SHORT_TYPE || format.x == GL_UNSIGNED_SHORT_TYPE) ? 2u : 1u;
+	uint base = uint(uStreamOffset[stream]) + i * uint(format.w);
+	vec4 v = vec4(0.0);
+	for (int c = 0; c < format.y; ++c) v[c] = fetchComponent(stream, base + uint(c) * size, format);
+	return v;
+}
+
+// Perspective correct barycentrics and their screen space derivatives from clip space vertices.
+void computeBarycentrics(vec4 c0, vec4 c1, vec4 c2, vec2 ndc, out vec3 lambda, out vec3 lambdaDx, out vec3 lambdaDy) {
+	vec3 invW = 1.0 / vec3(c0.w, c1.w, c2.w);
+	vec2 p0 = c0.xy * invW.x;
+	vec2 p1 = c1.xy * invW.y;
+	vec2 p2 = c2.xy * invW.z;
+
+	float invDet = 1.0 / determinant(mat2(p2 - p1, p0 - p1));
+	vec3 ddx = vec3(p1.y - p2.y, p2.y - p0.y, p0.y - p1.y) * invDet * invW;
+	vec3 ddy = vec3(p2.x - p1.x, p0.x - p2.x, p1.x - p0.x) * invDet * invW;
+	float ddxSum = dot(ddx, vec3(1.0));
+	float ddySum = dot(ddy, vec3(1.0));
+
+	vec2 delta = ndc - p0;
+	float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+	float interpW = 1.0 / interpInvW;
+	lambda.x = interpW * (invW.x + delta.x * ddx.x + delta.y * ddy.x);
+	lambda.y = interpW * (delta.x * ddx.y + delta.y * ddy.y);
+	lambda.z = interpW * (delta.x * ddx.z + delta.y * ddy.z);
+
+	// One pixel step in NDC
+	ddx *= 2.0 / uViewport.x;
+	ddy *= 2.0 / uViewport.y;
+	ddxSum *= 2.0 / uViewport.x;
+	ddySum *= 2.0 / uViewport.y;
+	float interpWdx = 1.0 / (interpInvW + ddxSum);
+	float interpWdy = 1.0 / (interpInvW + ddySum);
+	lambdaDx = interpWdx * (lambda * interpInvW + ddx) - lambda;
+	lambdaDy = interpWdy * (lambda * interpInvW + ddy) - lambda;
+}
+
+void main() {
+	ivec2 px = ivec2(gl_FragCoord.xy);
+	uint drawKey = uint(uDrawID) + 1u;
+
+	// Count the samples that belong to this draw, remember the first one's triangle
+	int covered = 0;
+	uint mask = 0u;
+	uint triangle = 0u;
+	for (int s = 0; s < uSamples; ++s) {
+		uvec2 id = texelFetch(uVisibility, px, s).xy;
+		if (id.x == drawKey) {
+			if (covered == 0) triangle = id.y;
+			++covered;
+			mask |= 1u << uint(s);
+		}
+	}
+	if (covered == 0) discard;
+
+	uint i0 = indices[3u * triangle + 0u];
+	uint i1 = indices[3u * triangle + 1u];
+	uint i2 = indices[3u * triangle + 2u];
+
+	vec3 w0 = (model * vec4(fetchAttribute(0, i0).xyz, 1.0)).xyz;
+	vec3 w1 = (model * vec4(fetchAttribute(0, i1).xyz, 1.0)).xyz;
+	vec3 w2 = (model * vec4(fetchAttribute(0, i2).xyz, 1.0)).xyz;
+	mat4 viewProj = projection * view;
+
+	vec3 l, ldx, ldy;
+	vec2 ndc = (gl_FragCoord.xy / uViewport) * 2.0 - 1.0;
+	computeBarycentrics(viewProj * vec4(w0, 1.0), viewProj * vec4(w1, 1.0), viewProj * vec4(w2, 1.0), ndc, l, ldx, ldy);
+
+	vec3 worldPos = l.x * w0 + l.y * w1 + l.z * w2;
+	vec2 uv = vec2(0.0), uvDx = vec2(0.0), uvDy = vec2(0.0);
+	if (uHasUVs != 0) {
+		vec2 t0 = fetchAttribute(3, i0).xy, t1 = fetchAttribute(3, i1).xy, t2 = fetchAttribute(3, i2).xy;
+		uv = l.x * t0 + l.y * t1 + l.z * t2;
+		uvDx = ldx.x * t0 + ldx.y * t1 + ldx.z * t2;
+		uvDy = ldy.x * t0 + ldy.y * t1 + ldy.z * t2;
+	}
+
+	vec3 Ngeom = normalize(cross(w1 - w0, w2 - w0));
+	if (uHasNormals != 0) {
+		vec3 n = l.x * fetchAttribute(1, i0).xyz + l.y * fetchAttribute(1, i1).xyz + l.z * fetchAttribute(1, i2).xyz;
+		Ngeom = normalize(normalMatrix * n);
+	}
+
+	vec3 N = Ngeom;
+	if (material.hasNormalMap != 0) {
+		// Same tangent frame construction as vert.glsl
+		vec4 tangent = vec4(0.0);
+		if (uHasTangents != 0) tangent = l.x * fetchAttribute(2, i0) + l.y * fetchAttribute(2, i1) + l.z * fetchAttribute(2, i2);
+		vec3 T = normalMatrix * tangent.xyz;
+		if (length(T) < 1e-5) {
+			vec3 up = (abs(Ngeom.z) < 0.999) ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+			T = normalize(cross(up, Ngeom));
+		} else {
+			T = normalize(T);
+		}
+		vec3 B = normalize(cross(Ngeom, T)) * (tangent.w < 0.0 ? -1.0 : 1.0);
+		vec3 nTex = textureGrad(u_NormalMap, uv, uvDx, uvDy).xyz * 2.0 - 1.0;
+		N = normalize(mat3(T, B, Ngeom) * nTex);
+	}
+	vec3 V = normalize(viewPos - worldPos);
+	if (material.doubleSided != 0 && dot(N, V) < 0.0) N = -N;
+
+	// Material parameter resolution (texture overrides constants), explicit gradients since there are no quads
+	vec3 baseColor = material.Albedo;
+	if (material.hasAlbedoMap != 0) {
+		vec3 srgb = textureGrad(u_AlbedoMap, uv, uvDx, uvDy).rgb;
+		baseColor = pow(max(srgb, vec3(0.0)), vec3(2.2));
+	}
+	vec4 orm = vec4(1.0);
+	if (material.hasMetallicMap + material.hasRoughnessMap + material.hasAOMap != 0) orm = textureGrad(u_OrmMap, uv, uvDx, uvDy);
+	float metallic = material.hasMetallicMap != 0 ? orm[material.metallicChannel] * material.Metallic : material.Metallic;
+	float roughness = material.hasRoughnessMap != 0 ? orm[material.roughnessChannel] * material.Roughness : material.Roughness;
+	metallic = clamp(metallic, 0.0, 1.0);
+	roughness = clamp(roughness, 0.04, 1.0);
+	float aoVal = material.hasAOMap != 0 ? mix(1.0, orm[material.aoChannel], material.AO) : material.AO;
+	vec3 emissive = material.Emissive;
+	if (material.hasEmissiveMap != 0) {
+		vec3 srgbE = textureGrad(u_EmissiveMap, uv, uvDx, uvDy).rgb;
+		emissive = pow(max(srgbE, vec3(0.0)), vec3(2.2));
+	}
+
+	vec3 color = shadeSurface(worldPos, N, V, baseColor, metallic, roughness, aoVal, emissive);
+	if (uSampleMask != 0) {
+		gl_SampleMask[0] = int(mask);
+		FragColor = vec4(color, 1.0);
+	} else {
+		gl_SampleMask[0] = -1;
+		FragColor = vec4(color * (float(covered) / float(uSamples)), 1.0);
+	}
+}
@@ -0,0 +1,27 @@
+#version 460 core
+
+// Instanced quad per screen tile of a draw's bounds for the visibility resolve. Tiles the binning pass
+// (visbuffer_bin.comp) found none of the draw's samples in collapse to a point and are never rasterized.
+
+layout(std430, binding = 7) readonly buffer TileMasks { uint tileMasks[]; };
+uniform int uDrawID;
+uniform ivec4 uTileRect; // first tile x and y, width of the rectangle in tiles, tiles per screen row
+uniform int uTileWords;  // mask words per draw
+uniform int uTileSize;
+uniform vec2 uViewport;
+
+const vec2 corners[6] = vec2[6](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+out vec2 vUV;
+
+void main() {
+	ivec2 tile = uTileRect.xy + ivec2(gl_InstanceID % uTileRect.z, gl_InstanceID / uTileRect.z);
+	uint index = uint(tile.y * uTileRect.w + tile.x);
+	uint bits = tileMasks[uint(uDrawID) * uint(uTileWords) + (index >> 5u)];
+	if ((bits & (1u << (index & 31u))) == 0u) {
+		vUV = vec2(0.0);
+		gl_Position = vec4(-2.0, -2.0, 0.0, 1.0);
+		return;
+	}
+	vUV = (vec2(tile) + corners[gl_VertexID]) * float(uTileSize) / uViewport;
+	gl_Position = vec4(vUV * 2.0 - 1.0, 0.0, 1.0);
+}
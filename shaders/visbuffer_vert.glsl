@@ -0,0 +1,14 @@
+#version 460 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 3) in vec2 aUV;
+
+#include "frame_data.glsl"
+#include "draw_data.glsl"
+
+out vec2 vUV;
+
+void main() {
+	vUV = aUV;
+	gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
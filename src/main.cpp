@@ -1,21 +1,694 @@
 #include <pbre/base.hpp>
+#include <pbre/core/hdr_decode.hpp>
+#include <pbre/core/job_system.hpp>
+#include <pbre/core/image_write.hpp>
+#include <pbre/core/memory_stats.hpp>
 #include <pbre/render/camera.hpp>
+#include <pbre/render/dynamic_resolution.hpp>
+#include <pbre/render/frame_capture.hpp>
+#include <pbre/render/forward.hpp>
+#include <pbre/render/frame_pacer.hpp>
 #include <pbre/render/material.hpp>
+#include <pbre/render/material_table.hpp>
+#include <pbre/render/occlusion.hpp>
+#include <pbre/render/path_tracer.hpp>
+#include <pbre/render/render_graph.hpp>
+#include <pbre/render/scene.hpp>
+#include <pbre/render/scene_bvh.hpp>
+#include <pbre/render/stress_scene.hpp>
+#include <pbre/render/texture_pool.hpp>
+#include <pbre/render/visibility.hpp>
 #include <pbre/wrapper/buffers.hpp>
 #include <pbre/wrapper/framebuffer.hpp>
+#include <pbre/wrapper/gl_state.hpp>
+#include <pbre/wrapper/gpu_memory.hpp>
 #include <pbre/wrapper/model.hpp>
+#include <pbre/wrapper/query.hpp>
+#include <pbre/wrapper/ring_buffer.hpp>
 #include <pbre/wrapper/shader.hpp>
 #include <pbre/wrapper/texture.hpp>
 #include <pbre/wrapper/window.hpp>
 
 #include <imgui.h>
+#include <stb_image.h>
 
 #include "data.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 static inline PBRE::Render::Camera* camera = nullptr;
-int run() {
+
+enum class RenderPath {
+    Forward,    // full PBR shading per MSAA sample
+    Visibility, // visibility buffer + per pixel material resolve
+};
+static const char* kRenderPathNames[] = {"Forward (MSAA)", "Visibility buffer"};
+// PBRE::Wrapper::CubemapFormat
+static const char* kCubemapFormatNames[] = {"RGB16F", "BC6H", "RGB9E5"};
+// PBRE::Render::PacingMode
+static const char* kPacingModeNames[] = {"Uncapped", "Vsync", "Frame limiter", "Late latch"};
+
+// Steps through every render path at a few resolution scales and averages the scene GPU time of each
+struct PathComparison {
+    static constexpr std::array<float, 3> kScales = {0.5f, 1.0f, 1.5f};
+    static constexpr int kWarmupFrames = 10;
+    static constexpr int kMeasureFrames = 60;
+
+    struct Result {
+        RenderPath path;
+        float scale;
+        int width, height;
+        double gpuMs;
+    };
+
+    bool running = false;
+    size_t step = 0;
+    int frame = 0;
+    double accumMs = 0.0;
+    std::vector<Result> results;
+
+    static size_t stepCount() { return kScales.size() * 2; }
+    RenderPath path() const { return static_cast<RenderPath>(step % 2); }
+    float scale() const { return kScales[step / 2]; }
+
+    void start() {
+        running = true;
+        step = 0;
+        frame = 0;
+        accumMs = 0.0;
+        results.clear();
+    }
+    // Feed the last GPU time each frame, returns true while still running
+    bool advance(double gpuMs, int width, int height) {
+        if (!running) return false;
+        if (frame >= kWarmupFrames) accumMs += gpuMs;
+        if (++frame == kWarmupFrames + kMeasureFrames) {
+            results.push_back({path(), scale(), width, height, accumMs / kMeasureFrames});
+            frame = 0;
+            accumMs = 0.0;
+            if (++step == stepCount()) running = false;
+        }
+        return running;
+    }
+};
+
+// CPU side cost of one frame, from the start of the previous frame's loop iteration to this one's
+struct FrameTimings {
+    double frameMs = 0.0;
+    double updateMs = 0.0; // Scene::update and the picker's refit
+    double cullMs = 0.0;
+    double submitMs = 0.0; // building and issuing the scene's draws
+    double gpuMs = 0.0;    // Scene pass
+};
+
+// Doubles the stress scene's instance count up to a maximum and averages the frame timings at each step.
+// Started with --bench-stress, prints the table and writes stress_sweep.csv when done.
+struct StressSweep {
+    static constexpr size_t kFirstInstances = 250;
+    static constexpr int kWarmupFrames = 10;
+    static constexpr int kMeasureFrames = 60;
+
+    struct Result {
+        size_t instances;
+        size_t renderables;
+        FrameTimings timings;
+    };
+
+    bool running = false;
+    size_t instances = 0;
+    size_t maxInstances = 0;
+    int frame = 0;
+    FrameTimings accum;
+    std::vector<Result> results;
+
+    void start(size_t max) {
+        running = true;
+        maxInstances = max;
+        instances = std::min(kFirstInstances, max);
+        frame = 0;
+        accum = {};
+        results.clear();
+    }
+    // Feed each frame's timings, returns true when the next step needs a scene with the new instance count
+    bool advance(const FrameTimings& timings, size_t renderables) {
+        if (!running) return false;
+        if (frame >= kWarmupFrames) {
+            accum.frameMs += timings.frameMs;
+            accum.updateMs += timings.updateMs;
+            accum.cullMs += timings.cullMs;
+            accum.submitMs += timings.submitMs;
+            accum.gpuMs += timings.gpuMs;
+        }
+        if (++frame < kWarmupFrames + kMeasureFrames) return false;
+        for (double* v : {&accum.frameMs, &accum.updateMs, &accum.cullMs, &accum.submitMs, &accum.gpuMs}) *v /= kMeasureFrames;
+        results.push_back({instances, renderables, accum});
+        frame = 0;
+        accum = {};
+        if (instances >= maxInstances) {
+            running = false;
+            return false;
+        }
+        instances = std::min(instances * 2, maxInstances);
+        return true;
+    }
+    void write(std::ostream& out, char separator) const {
+        out << "instances" << separator << "renderables" << separator << "frame_ms" << separator << "update_ms" << separator << "cull_ms"
+            << separator << "submit_ms" << separator << "gpu_ms\n";
+        for (const auto& r : results) {
+            const auto& t = r.timings;
+            out << r.instances << separator << r.renderables << separator << t.frameMs << separator << t.updateMs << separator << t.cullMs
+                << separator << t.submitMs << separator << t.gpuMs << "\n";
+        }
+    }
+};
+
+// Command line setup of the viewer: a stress scene on top of the bundled one, and optionally the sweep
+struct StressOptions {
+    size_t instances = 0; // 0 for the bundled scene alone
+    uint32_t seed = 1;
+    size_t sweepMax = 0; // runs the sweep up to this many instances and exits
+};
+
+// Times the job system at 1..N threads against the single thread run: a compute bound parallelFor, spawning
+// empty tasks, and a layered task graph where every task depends on the whole previous layer. CPU only, run
+// with --bench-jobs [max threads].
+static int runJobBenchmark(int maxThreads) {
+    constexpr size_t kItems = 1 << 22;
+    constexpr size_t kSpawns = 100000;
+    constexpr int kLayers = 64, kLayerWidth = 64;
+    constexpr int kIterations = 5;
+
+    std::vector<float> data(kItems);
+    auto timeMs = [](auto&& fn) {
+        double best = 0.0;
+        for (int it = 0; it < kIterations; ++it) {
+            auto start = std::chrono::high_resolution_clock::now();
+            fn();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            best = it == 0 ? ms : std::min(best, ms);
+        }
+        return best;
+    };
+
+    double baseline[3] = {};
+    for (int threads = 1; threads <= maxThreads; ++threads) {
+        PBRE::Core::JobSystem jobs(threads - 1);
+        double parallelMs = timeMs([&] {
+            jobs.parallelFor(kItems, 1024, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    float x = static_cast<float>(i);
+                    for (int k = 0; k < 32; ++k) x = std::sqrt(x * 1.0001f + 1.0f);
+                    data[i] = x;
+                }
+            });
+        });
+        double spawnMs = timeMs([&] {
+            std::atomic<size_t> ran{0};
+            auto root = jobs.schedule([&] {
+                std::vector<PBRE::Core::TaskHandle> tasks;
+                tasks.reserve(kSpawns);
+                for (size_t i = 0; i < kSpawns; ++i) tasks.push_back(jobs.schedule([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }));
+                for (const auto& task : tasks) jobs.wait(task);
+            });
+            jobs.wait(root);
+        });
+        double graphMs = timeMs([&] {
+            std::vector<PBRE::Core::TaskHandle> layer;
+            for (int l = 0; l < kLayers; ++l) {
+                std::vector<PBRE::Core::TaskHandle> next;
+                next.reserve(kLayerWidth);
+                for (int t = 0; t < kLayerWidth; ++t) {
+                    size_t slot = static_cast<size_t>(l * kLayerWidth + t);
+                    next.push_back(jobs.schedule([&data, slot] {
+                        float x = data[slot];
+                        for (int k = 0; k < 2000; ++k) x = std::sqrt(x * 1.0001f + 1.0f);
+                        data[slot] = x;
+                    }, layer));
+                }
+                layer = std::move(next);
+            }
+            for (const auto& task : layer) jobs.wait(task);
+        });
+        double results[3] = {parallelMs, spawnMs, graphMs};
+        if (threads == 1) std::copy(results, results + 3, baseline);
+        std::cout << threads << " thread" << (threads > 1 ? "s" : " ") << ": parallelFor " << parallelMs << " ms (x" << baseline[0] / parallelMs
+                  << "), " << kSpawns << " tasks " << spawnMs << " ms (" << kSpawns / (spawnMs * 1000.0) << " M/s), graph " << kLayers << "x"
+                  << kLayerWidth << " " << graphMs << " ms (x" << baseline[2] / graphMs << ")\n";
+    }
+    return 0;
+}
+
+// Times Scene::update on a random hierarchy. CPU only, run with --bench-scene [node count].
+static int runSceneBenchmark(size_t nodeCount) {
+    constexpr size_t kRoots = 16;
+    constexpr int kIterations = 20;
+
+    PBRE::Render::Scene scene;
+    scene.reserve(nodeCount);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<PBRE::Render::NodeId> ids;
+    ids.reserve(nodeCount);
+    for (size_t i = 0; i < nodeCount; ++i) {
+        PBRE::Transform local;
+        local.position = PBRE::vec3(unit(rng), unit(rng), unit(rng)) * 10.0f;
+        local.rotation = glm::normalize(PBRE::quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+        local.scale = PBRE::vec3(1.0f + 0.1f * unit(rng));
+        // Parents are picked among earlier nodes, giving roughly logarithmic depth
+        PBRE::Render::NodeId parent = i < kRoots ? PBRE::Render::kNoNode : ids[rng() % i];
+        ids.push_back(scene.addNode(parent, local));
+    }
+
+    auto layoutStart = std::chrono::high_resolution_clock::now();
+    scene.update();
+    double layoutMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - layoutStart).count();
+    std::cout << "Scene benchmark: " << scene.size() << " nodes, " << scene.depthCount() << " levels, first update (sort + compose) "
+              << layoutMs << " ms\n";
+
+    // all = every root moved, so the whole tree recomposes; partial = 1% of nodes moved; clean = nothing moved
+    enum class Change { All, Partial, Clean };
+    const char* changeNames[] = {"all dirty", "1% dirty", "clean"};
+    for (bool simd : {false, true}) {
+        scene.useSimd = simd;
+        for (Change change : {Change::All, Change::Partial, Change::Clean}) {
+            double totalMs = 0.0;
+            size_t composed = 0;
+            for (int it = 0; it < kIterations; ++it) {
+                if (change == Change::All) {
+                    for (size_t r = 0; r < kRoots; ++r) scene.setPosition(ids[r], PBRE::vec3(unit(rng), 0.0f, 0.0f));
+                } else if (change == Change::Partial) {
+                    for (size_t n = 0; n < nodeCount / 100; ++n) scene.setPosition(ids[rng() % nodeCount], PBRE::vec3(unit(rng), 0.0f, 0.0f));
+                }
+                auto start = std::chrono::high_resolution_clock::now();
+                composed += scene.update();
+                totalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            }
+            double ms = totalMs / kIterations;
+            double nodesPerSec = ms > 0.0 ? (composed / static_cast<double>(kIterations)) / (ms / 1000.0) : 0.0;
+            std::cout << (simd ? "  simd   " : "  scalar ") << changeNames[static_cast<int>(change)] << ": " << ms << " ms/update, "
+                      << composed / kIterations << " recomposed, " << nodesPerSec / 1.0e6 << " M nodes/s\n";
+        }
+    }
+    return 0;
+}
+
+// Times SceneBvh build, refit and queries over random boxes at 10k, 100k and 1M objects: refits after 1% of
+// the objects moved a little and after every object drifted, closest hit rays and box overlap queries. CPU
+// only, run with --bench-bvh [max objects].
+static int runBvhBenchmark(size_t maxObjects) {
+    constexpr int kIterations = 10;
+    constexpr int kRays = 100000;
+    constexpr int kOverlaps = 10000;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (size_t count : {size_t(10000), size_t(100000), size_t(1000000)}) {
+        if (count > maxObjects) break;
+        // Unit sized objects at a constant density
+        float extent = std::cbrt(static_cast<float>(count)) * 2.0f;
+        std::vector<PBRE::Render::Aabb> bounds(count);
+        std::vector<PBRE::vec3> velocity(count);
+        for (size_t i = 0; i < count; ++i) {
+            PBRE::vec3 center = PBRE::vec3(unit(rng), unit(rng), unit(rng)) * extent;
+            PBRE::vec3 half = PBRE::vec3(unit(rng), unit(rng), unit(rng)) * 0.25f + 0.5f;
+            bounds[i] = {center - half, center + half};
+            velocity[i] = PBRE::vec3(unit(rng), unit(rng), unit(rng)) * 0.5f;
+        }
+        PBRE::Render::SceneBvh bvh;
+        bvh.build(bounds);
+        std::cout << "Scene BVH, " << count << " objects: build " << bvh.buildMs() << " ms, " << bvh.nodeCount() << " nodes\n";
+
+        auto move = [&](size_t i, float scale) {
+            PBRE::vec3 offset = velocity[i] * scale;
+            bounds[i] = {bounds[i].min + offset, bounds[i].max + offset};
+            bvh.update(static_cast<uint32_t>(i), bounds[i]);
+        };
+        double partialMs = 0.0;
+        for (int it = 0; it < kIterations; ++it) {
+            for (size_t n = 0; n < count / 100; ++n) move(rng() % count, 0.1f);
+            bvh.refit();
+            partialMs += bvh.refitMs();
+        }
+        std::cout << "  refit 1% moved: " << partialMs / kIterations << " ms, cost x" << bvh.costRatio() << "\n";
+        // Everything drifts, so the tree degrades until refit() rebuilds it
+        double driftMs = 0.0, worstMs = 0.0;
+        int rebuildsBefore = bvh.rebuilds();
+        for (int it = 0; it < kIterations; ++it) {
+            for (size_t i = 0; i < count; ++i) move(i, 1.0f);
+            bvh.refit();
+            driftMs += bvh.refitMs();
+            worstMs = std::max(worstMs, bvh.refitMs());
+        }
+        std::cout << "  refit all drifting: " << driftMs / kIterations << " ms (worst " << worstMs << " ms), " << bvh.rebuilds() - rebuildsBefore
+                  << " rebuilds, cost x" << bvh.costRatio() << "\n";
+
+        std::vector<PBRE::Render::Ray> rays(kRays);
+        for (auto& ray : rays) {
+            ray.origin = PBRE::vec3(unit(rng), unit(rng), unit(rng)) * extent;
+            ray.direction = glm::normalize(PBRE::vec3(unit(rng), unit(rng), unit(rng)) + PBRE::vec3(1e-3f));
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t hits = 0;
+        for (const auto& ray : rays) {
+            PBRE::Render::SceneBvh::Hit hit;
+            hits += bvh.intersect(ray, hit);
+        }
+        double rayMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<uint32_t> found;
+        for (int q = 0; q < kOverlaps; ++q) {
+            PBRE::vec3 center = PBRE::vec3(unit(rng), unit(rng), unit(rng)) * extent;
+            bvh.overlap({center - PBRE::vec3(2.0f), center + PBRE::vec3(2.0f)}, found);
+        }
+        double overlapMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "  " << kRays << " rays: " << rayMs << " ms (" << kRays / (rayMs * 1000.0) << " Mrays/s, " << hits << " hits), " << kOverlaps
+                  << " overlap queries: " << overlapMs << " ms (" << static_cast<double>(found.size()) / kOverlaps << " objects each)\n";
+    }
+    return 0;
+}
+
+static constexpr const char* kEnvironmentPath = "resources/kloppenheim_06_puresky_4k.hdr";
+static constexpr const char* kModelPaths[] = {"resources/lion_head/lion_head_4k.gltf", "resources/table/round_wooden_table_02_4k.gltf",
+                                              "resources/vintage_camera/vintage_video_camera_4k.gltf"};
+
+// Loads the bundled models concurrently: each decodes (parse, images, tangents) on a worker and uploads on
+// this thread once decoded. Main thread only.
+static bool loadBundledModels(std::span<PBRE::Wrapper::Model, 3> models, PBRE::Wrapper::GeometryRetention retention) {
+    auto& jobs = PBRE::Core::JobSystem::instance();
+    bool ok[3] = {false, false, false};
+    std::vector<PBRE::Core::TaskHandle> uploads;
+    for (int i = 0; i < 3; ++i) {
+        models[i].retainGeometry = retention;
+        auto decode = jobs.schedule([&models, &ok, i] { ok[i] = models[i].decode(kModelPaths[i]); });
+        uploads.push_back(jobs.scheduleOnMain([&models, &ok, i] { ok[i] = ok[i] && models[i].upload(); }, {decode}));
+    }
+    for (const auto& upload : uploads) jobs.wait(upload);
+    for (int i = 0; i < 3; ++i) {
+        if (!ok[i]) std::cerr << "Failed to load model " << kModelPaths[i] << "\n";
+    }
+    return ok[0] && ok[1] && ok[2];
+}
+
+// The bundled models for the path tracer: every stream and texture pixel on the CPU, nothing uploaded, so
+// no GL context is needed and no GPU memory is taken
+static bool decodeBundledModels(std::span<PBRE::Wrapper::Model, 3> models) {
+    auto& jobs = PBRE::Core::JobSystem::instance();
+    bool ok[3] = {false, false, false};
+    std::vector<PBRE::Core::TaskHandle> decodes;
+    for (int i = 0; i < 3; ++i) {
+        models[i].retainGeometry = PBRE::Wrapper::GeometryRetention::All;
+        decodes.push_back(jobs.schedule([&models, &ok, i] { ok[i] = models[i].decode(kModelPaths[i]) && models[i].keepDecoded(); }));
+    }
+    for (const auto& decode : decodes) jobs.wait(decode);
+    for (int i = 0; i < 3; ++i) {
+        if (!ok[i]) std::cerr << "Failed to load model " << kModelPaths[i] << "\n";
+    }
+    return ok[0] && ok[1] && ok[2];
+}
+
+// Loads the bundled models with both loader paths and each CPU geometry policy. Reports load time, the peak
+// RSS each load adds and the RSS it leaves behind while the model is alive, plus the load arena's peak and
+// the CPU geometry kept. Needs a GL context for the uploads, run with --bench-load.
+static int runLoadBenchmark() {
+    using PBRE::Wrapper::GeometryRetention;
+    using PBRE::Wrapper::LoadMode;
+    struct Config {
+        LoadMode mode;
+        GeometryRetention retention;
+        const char* name;
+    };
+    const Config configs[] = {{LoadMode::Copy, GeometryRetention::All, "copy   keep all      "},
+                              {LoadMode::Mapped, GeometryRetention::All, "mapped keep all      "},
+                              {LoadMode::Mapped, GeometryRetention::Positions, "mapped keep positions"},
+                              {LoadMode::Mapped, GeometryRetention::None, "mapped keep none     "}};
+    constexpr double kMiB = 1024.0 * 1024.0;
+
+    PBRE::Wrapper::Window window(320, 240, "PBRE Load Benchmark");
+    if (!PBRE::Core::resetPeakRss()) std::cout << "Peak RSS can't be reset on this platform, peaks are cumulative\n";
+    for (const auto& config : configs) {
+        for (const char* path : kModelPaths) {
+            PBRE::Core::resetPeakRss();
+            size_t before = PBRE::Core::currentRssBytes();
+            PBRE::Wrapper::Model model;
+            model.retainGeometry = config.retention;
+            if (!model.loadFromFile(path, config.mode)) return -1;
+            size_t peak = PBRE::Core::peakRssBytes();
+            size_t after = PBRE::Core::currentRssBytes();
+            const auto& stats = model.loadStats;
+            std::cout << config.name << " " << std::filesystem::path(path).filename().string() << ": " << stats.loadMs << " ms, RSS peak +"
+                      << (peak > before ? peak - before : 0) / kMiB << " MiB, steady +" << (after > before ? after - before : 0) / kMiB
+                      << " MiB, scratch " << stats.scratchBytes / kMiB << " MiB, kept " << stats.retainedBytes / kMiB << " MiB, textures "
+                      << stats.textureBytes / kMiB << " MiB (" << stats.unpackedTextureBytes / kMiB << " unpacked)\n";
+        }
+    }
+    return 0;
+}
+
+// Writes the bundled environment bilinearly upscaled to width x width / 2, two source rows in memory at a time
+static bool writeUpscaledEnvironment(const std::string& path, int width) {
+    PBRE::Core::HdrDecoder source;
+    if (!source.open(kEnvironmentPath)) {
+        std::cerr << "Failed to open " << kEnvironmentPath << ": " << source.error() << "\n";
+        return false;
+    }
+    int sw = source.width(), sh = source.height(), height = width / 2;
+    std::vector<float> rows(static_cast<size_t>(sw) * 3 * 2), out(static_cast<size_t>(width) * 3);
+    int cached = -1;
+    PBRE::Core::HdrWriter writer;
+    if (!writer.open(path, width, height)) return false;
+    for (int y = 0; y < height; ++y) {
+        float fy = static_cast<float>(y) * (sh - 1) / std::max(height - 1, 1);
+        int y0 = std::min(static_cast<int>(fy), sh - 2);
+        float ty = fy - y0;
+        if (y0 != cached) {
+            source.decodeRows(y0, 2, rows.data());
+            cached = y0;
+        }
+        for (int x = 0; x < width; ++x) {
+            float fx = static_cast<float>(x) * (sw - 1) / (width - 1);
+            int x0 = std::min(static_cast<int>(fx), sw - 2);
+            float tx = fx - x0;
+            for (int c = 0; c < 3; ++c) {
+                const float* r0 = rows.data() + static_cast<size_t>(x0) * 3 + c;
+                const float* r1 = r0 + static_cast<size_t>(sw) * 3;
+                float top = r0[0] * (1.0f - tx) + r0[3] * tx;
+                float bottom = r1[0] * (1.0f - tx) + r1[3] * tx;
+                out[static_cast<size_t>(x) * 3 + c] = top * (1.0f - ty) + bottom * ty;
+            }
+        }
+        if (!writer.writeRow(out.data())) return false;
+    }
+    return writer.close();
+}
+
+// Equirect HDR to cubemap faces at 4k, 8k and 16k: stb decoding the whole image to floats against the mapped
+// decoder streaming bands of rows. Reports decode throughput, decode + resample time and the peak RSS each
+// adds. CPU only, inputs are generated once from the bundled environment into the temp directory. Run with
+// --bench-hdr [face size].
+static int runHdrBenchmark(int faceSize) {
+    constexpr double kMiB = 1024.0 * 1024.0;
+    auto elapsedMs = [](auto start) { return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count(); };
+    if (!PBRE::Core::resetPeakRss()) std::cout << "Peak RSS can't be reset on this platform, peaks are cumulative\n";
+    for (int width : {4096, 8192, 16384}) {
+        auto path = (std::filesystem::temp_directory_path() / ("pbre_env_" + std::to_string(width) + ".hdr")).string();
+        if (!std::filesystem::exists(path)) {
+            std::cout << "Writing " << path << "\n";
+            if (!writeUpscaledEnvironment(path, width)) {
+                std::cerr << "Failed to write " << path << "\n";
+                std::filesystem::remove(path);
+                return -1;
+            }
+        }
+        double pixels = static_cast<double>(width) * (width / 2);
+        std::cout << width << "x" << width / 2 << " (" << std::filesystem::file_size(path) / kMiB << " MiB file), " << faceSize << " faces\n";
+
+        // stb: the whole image as floats, then resampled
+        {
+            PBRE::Core::resetPeakRss();
+            size_t before = PBRE::Core::currentRssBytes();
+            auto start = std::chrono::high_resolution_clock::now();
+            stbi_set_flip_vertically_on_load(false);
+            int w, h, channels;
+            float* data = stbi_loadf(path.c_str(), &w, &h, &channels, 3);
+            if (!data) return -1;
+            double decodeMs = elapsedMs(start);
+            std::vector<float> faces = PBRE::Core::equirectToCubeFaces(data, w, h, faceSize);
+            stbi_image_free(data);
+            double totalMs = elapsedMs(start);
+            size_t peak = PBRE::Core::peakRssBytes();
+            std::cout << "  stb       decode " << decodeMs << " ms (" << pixels / (decodeMs * 1000.0) << " MPix/s), to faces " << totalMs
+                      << " ms, RSS peak +" << (peak > before ? peak - before : 0) / kMiB << " MiB\n";
+        }
+        // Streaming: decode alone through a band buffer, then decode + resample
+        {
+            PBRE::Core::HdrDecoder decoder;
+            auto start = std::chrono::high_resolution_clock::now();
+            if (!decoder.open(path)) {
+                std::cerr << "Failed to open " << path << ": " << decoder.error() << "\n";
+                return -1;
+            }
+            constexpr int kBand = 64;
+            std::vector<float> band(static_cast<size_t>(kBand) * decoder.width() * 3);
+            for (int first = 0; first < decoder.height(); first += kBand) {
+                int count = std::min(kBand, decoder.height() - first);
+                decoder.decodeRows(first, count, band.data());
+                decoder.releaseRows(first, count);
+            }
+            double decodeMs = elapsedMs(start);
+            decoder.close();
+            std::vector<float>().swap(band);
+
+            PBRE::Core::resetPeakRss();
+            size_t before = PBRE::Core::currentRssBytes();
+            start = std::chrono::high_resolution_clock::now();
+            if (!decoder.open(path)) return -1;
+            std::vector<float> faces = PBRE::Core::equirectToCubeFaces(decoder, faceSize, kBand);
+            double totalMs = elapsedMs(start);
+            size_t peak = PBRE::Core::peakRssBytes();
+            std::cout << "  streaming decode " << decodeMs << " ms (" << pixels / (decodeMs * 1000.0) << " MPix/s), to faces " << totalMs
+                      << " ms, RSS peak +" << (peak > before ? peak - before : 0) / kMiB << " MiB\n";
+        }
+    }
+    return 0;
+}
+
+// Places the bundled models (lion head, table, camera) in the scene, returns the camera model's root node
+static PBRE::Render::NodeId addBundledModels(PBRE::Render::Scene& scene, const PBRE::Wrapper::Model& model, const PBRE::Wrapper::Model& tableModel,
+                                             const PBRE::Wrapper::Model& cameraModel, PBRE::Transform& cameraTransform) {
+    scene.addModel(model, PBRE::Render::kNoNode);
+    PBRE::Transform tableTransform;
+    tableTransform.position = PBRE::vec3(0.0f, -0.75f, 0.0f);
+    scene.addModel(tableModel, PBRE::Render::kNoNode, tableTransform);
+    cameraTransform.position = PBRE::vec3(0.2f, 0.0f, 0.0f);
+    cameraTransform.rotation = glm::angleAxis(glm::radians(12.0f), PBRE::vec3(0.0f, 1.0f, 0.0f));
+    return scene.addModel(cameraModel, PBRE::Render::kNoNode, cameraTransform);
+}
+
+// The data.h cube as a model with a mesh per random material, for the stress scene. Keeps every stream so
+// the path traced reference can use it as is.
+static bool createPrimitiveModel(PBRE::Wrapper::Model& primitive, uint32_t seed) {
+    constexpr size_t kVariants = 16;
+    std::vector<PBRE::vec3> positions, normals;
+    for (size_t v = 0; v < cubeVertices.size(); v += 6) {
+        positions.emplace_back(cubeVertices[v], cubeVertices[v + 1], cubeVertices[v + 2]);
+        normals.emplace_back(cubeVertices[v + 3], cubeVertices[v + 4], cubeVertices[v + 5]);
+    }
+    std::vector<uint32_t> indices(cubeIndices.begin(), cubeIndices.end());
+    primitive.retainGeometry = PBRE::Wrapper::GeometryRetention::All;
+    return primitive.create("cube", positions, normals, indices, PBRE::Render::randomMaterials(kVariants, seed));
+}
+
+// Path traces the bundled scene from the viewer's start camera, reporting rays/s and the noise estimate
+// as samples double, then writes the result (.exr or .hdr). Runs without a GPU, with --path-trace [samples]
+// [output].
+static int runPathTrace(int samples, const std::string& output) {
+    constexpr int kWidth = 640, kHeight = 360;
+    PBRE::Wrapper::Model models[3];
+    if (!decodeBundledModels(models)) return -1;
+    PBRE::Render::Scene scene;
+    PBRE::Transform cameraTransform;
+    addBundledModels(scene, models[0], models[1], models[2], cameraTransform);
+    scene.update();
+
+    PBRE::Render::Camera camera;
+    camera.setPosition({10.0f, 10.0f, 3.0f});
+    camera.lookAt({0.0f, 0.0f, 0.0f});
+    camera.setAspectRatio(static_cast<float>(kWidth) / kHeight);
+
+    PBRE::Render::PathTracer tracer;
+    if (!tracer.loadEnvironment(kEnvironmentPath)) std::cout << "No environment, tracing with the point light only\n";
+    for (const auto& r : scene.renderables()) tracer.submit(*r.model, r.model->meshes[r.mesh], scene.world(r.node));
+    tracer.build();
+    std::cout << "BVH: " << tracer.bvh().triangleCount() << " triangles, " << tracer.bvh().nodeCount() << " nodes, built in "
+              << tracer.bvh().buildMs() << " ms\n";
+    tracer.resize(kWidth, kHeight);
+    tracer.setCamera(camera.getViewMatrix(), camera.getProjectionMatrix());
+
+    // Each pass doubles the sample count, so a converging image shows the noise falling by about 1/sqrt(2)
+    PBRE::Render::PathTracerSettings settings;
+    double lastNoise = 0.0;
+    for (int pass = 1; tracer.sampleCount() < samples; pass *= 2) {
+        int count = std::min(std::max(tracer.sampleCount(), 1), samples - tracer.sampleCount());
+        auto stats = tracer.render(settings, count);
+        double noise = tracer.noiseEstimate();
+        std::cout << tracer.sampleCount() << " spp: " << stats.ms << " ms, " << stats.raysPerSecond() / 1.0e6 << " Mrays/s, noise " << noise;
+        if (lastNoise > 0.0) std::cout << " (x" << noise / lastNoise << ")";
+        std::cout << "\n";
+        lastNoise = noise;
+    }
+    auto rgb = tracer.image();
+    if (!PBRE::Core::writeImage(output, kWidth, kHeight, rgb.data())) {
+        std::cerr << "Failed to write " << output << std::endl;
+        return -1;
+    }
+    std::cout << "Wrote " << output << "\n";
+    return 0;
+}
+
+// Captures a noisy offscreen frame as fast as the loop runs at 1080p and 4k in both formats and reports the
+// sustained encode rate, drops and the render thread's cost per capture. Run with --bench-capture [frames].
+static int runCaptureBenchmark(int frames) {
+    PBRE::Wrapper::Window window(320, 240, "PBRE Capture Benchmark");
+    auto& glState = PBRE::Wrapper::GlState::instance();
+    auto directory = std::filesystem::temp_directory_path() / "pbre_capture_bench";
+    std::mt19937 rng(1234);
+    for (auto [width, height] : {std::pair{1920, 1080}, std::pair{3840, 2160}}) {
+        PBRE::Wrapper::Framebuffer target(width, height);
+        // Noise so PNG compression does real work, a small moving square changes it every frame
+        std::vector<unsigned char> noise(static_cast<size_t>(width) * height * 4);
+        for (auto& b : noise) b = static_cast<unsigned char>(rng());
+        glState.bindTextureForUpdate(GL_TEXTURE_2D, target.colorTex());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, noise.data());
+
+        for (auto format : {PBRE::Render::CaptureFormat::Png, PBRE::Render::CaptureFormat::Hdr}) {
+            PBRE::Render::FrameCapture capture;
+            std::filesystem::remove_all(directory);
+            if (!capture.start(directory.string(), format)) {
+                std::cerr << "Can't create " << directory << std::endl;
+                return -1;
+            }
+            double captureMs = 0.0, worstMs = 0.0;
+            for (int i = 0; i < frames; ++i) {
+                glState.bindFramebuffer(GL_FRAMEBUFFER, target.fbo());
+                glState.setEnabled(GL_SCISSOR_TEST, true);
+                glScissor((i * 16) % (width - 64), height / 2, 64, 64);
+                glClearColor(static_cast<float>(i % 2), 0.5f, 0.0f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+                glState.setEnabled(GL_SCISSOR_TEST, false);
+                auto start = std::chrono::high_resolution_clock::now();
+                capture.capture(target.fbo(), width, height);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+                captureMs += ms;
+                worstMs = std::max(worstMs, ms);
+            }
+            capture.stop();
+            capture.flush();
+            auto stats = capture.stats();
+            std::cout << width << "x" << height << (format == PBRE::Render::CaptureFormat::Png ? " png: " : " hdr: ") << stats.encoded
+                      << "/" << stats.requested << " frames (" << stats.dropped << " dropped), " << stats.framesPerSecond() << " fps, "
+                      << stats.readbackMegabytesPerSecond() << " MB/s read back, " << (stats.encoded ? stats.encodeMs / stats.encoded : 0.0)
+                      << " ms encode/frame, render thread " << captureMs / frames << " ms/capture (worst " << worstMs << ")\n";
+        }
+    }
+    glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+    std::filesystem::remove_all(directory);
+    return 0;
+}
+
+int run(const StressOptions& options) {
     PBRE::Wrapper::Window window(800, 600, "PBRE Example - Transform");
 
     glfwSetFramebufferSizeCallback(window.getGLFWwindow(), [](GLFWwindow* window, int width, int height) {
@@ -33,99 +706,180 @@ int run() {
     buffers.setAttribute(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);                   // position
     buffers.setAttribute(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float))); // normal
 
-    PBRE::Wrapper::Shader shader;
-    shader.loadFromFiles("shaders/vert.glsl", "shaders/frag.glsl");
-    shader.use();
+    // Forward path: opaque / alpha tested PBR variants plus the depth pre-pass and overdraw programs
+    PBRE::Render::ForwardRenderer forward;
+    // Alternative visibility buffer path
+    PBRE::Render::VisibilityRenderer visibility;
+    // Per frame constants and per draw data for both paths are streamed through here
+    PBRE::Wrapper::RingBuffer ring;
 
-    // Tonemapping post-process shader
-    PBRE::Wrapper::Shader tonemap;
-    tonemap.loadFromFiles("shaders/tonemap_vert.glsl", "shaders/tonemap_frag.glsl");
-    tonemap.use();
-    tonemap.set("uColor", 0);
-    tonemap.set("uExposure", 1.0f);
-
-    // Fullscreen triangle needs a VAO in core profile
-    GLuint screenVAO = 0;
-    glGenVertexArrays(1, &screenVAO);
+    // Tonemapping post-process shader: [0] samples the resolved texture, [1] resolves the MSAA texture itself
+    PBRE::Wrapper::Shader tonemap[2];
+    tonemap[0].loadFromFiles("shaders/tonemap_vert.glsl", "shaders/tonemap_frag.glsl");
+    tonemap[1].loadFromFiles("shaders/tonemap_vert.glsl", "shaders/tonemap_frag.glsl", {"MSAA_RESOLVE"});
+    for (auto& shader : tonemap) {
+        shader.use();
+        shader.set("uColor", 0);
+        shader.set("uExposure", 1.0f);
+    }
 
     // shader for the light indicator (simple unlit/emissive)
     PBRE::Wrapper::Shader lightShader;
     lightShader.loadFromFiles("shaders/light_vert.glsl", "shaders/light_frag.glsl");
 
     PBRE::Wrapper::Texture envIBL;
-    // Convert the equirect HDR into a cubemap (face size 512 by default)
-    envIBL.loadHDRAsCubemap("resources/kloppenheim_06_puresky_4k.hdr", 512);
-    shader.set("environmentMap", 0);
-    glActiveTexture(GL_TEXTURE0);
-    envIBL.bind(0);
-    // Inform shader of environment map mip count for roughness-based LOD
-    shader.set("envMaxMips", envIBL.getMaxMips());
-    shader.set("iblIntensity", 1.0f);
-    // AO fallback value if material has no AO map
-    shader.set("material.AO", 1.0f);
-    shader.set("horizonFadePower", 2.0f);
-    shader.set("debugMode", 0);
-    shader.set("enableIBL", 1);
-    shader.set("enableDirect", 1);
-
-    // HDR framebuffer (RGBA16F)
-    PBRE::Wrapper::Framebuffer hdrFbo(window.getWidth(), window.getHeight(), 4);
+    PBRE::Wrapper::CubemapLoadStats envStats;
+    int envFormat = static_cast<int>(PBRE::Wrapper::CubemapFormat::BC6H);
+    auto loadEnvironment = [&] {
+        // Convert the equirect HDR into a cubemap (face size 512 by default)
+        envIBL.loadHDRAsCubemap(kEnvironmentPath, 512, static_cast<PBRE::Wrapper::CubemapFormat>(envFormat), &envStats);
+        constexpr double kMiB = 1024.0 * 1024.0;
+        std::cout << "Environment " << kCubemapFormatNames[static_cast<int>(envStats.format)] << " " << envStats.bytes / kMiB << " MiB (RGB16F "
+                  << envStats.rgb16fBytes / kMiB << " MiB) in " << envStats.loadMs << " ms";
+        if (envStats.format != PBRE::Wrapper::CubemapFormat::RGB16F) {
+            std::cout << ", error mean " << envStats.meanStops << " max " << envStats.maxStops << " stops, "
+                      << (envStats.cached ? "cached, encoded in " : "encoded in ") << envStats.encodeMs << " ms";
+        }
+        std::cout << std::endl;
+        // Unit 0 is the environmentMap sampler's binding in pbr_common.glsl
+        envIBL.bind(0);
+    };
+    loadEnvironment();
+
+    // HDR scene targets are transients of the frame graph, 4x MSAA (RGBA16F + DEPTH24_STENCIL8 with a blit resolve by default)
+    using RenderGraph = PBRE::Render::RenderGraph;
+    constexpr int kSceneSamples = 4;
+    PBRE::Wrapper::FramebufferFormat hdrFormat;
+    bool shaderResolve = false; // tonemap each MSAA sample in the tonemap pass instead of blitting a resolve first
+    PBRE::Render::TexturePool targetPool;
+    RenderGraph graph(targetPool);
     float exposure = 1.0f;
 
+    RenderPath renderPath = RenderPath::Forward;
+    PBRE::Render::ForwardOptions forwardOptions;
+    float renderScale = 1.0f;
+    // Dynamic resolution: the controller picks the scale, the scene targets stay at window size
+    bool dynamicResolution = false;
+    PBRE::Render::DynamicResolution dynres;
+    // Rendered region and allocated size of the scene targets, from the last frame for the UI
+    int renderWidth = window.getWidth(), renderHeight = window.getHeight();
+    int targetWidth = renderWidth, targetHeight = renderHeight;
+    PathComparison comparison;
+    // Frame capture: the tonemapped frame (PNG) or the resolved HDR scene color (Radiance .hdr)
+    PBRE::Render::FrameCapture capture;
+    int captureFormat = 0;
+    int captureSession = 0;
+    // GPU memory budget, 0 = none
+    int gpuBudgetMiB = 0;
+    bool gpuBudgetRefuse = false;
+
     // Light
     PBRE::vec3 lightPosition = PBRE::vec3(5.0f, 5.0f, 5.0f);
     PBRE::vec3 lightColor = PBRE::vec3(1.0f, 1.0f, 1.0f);
     float lightIntensity = 1.0f;
 
-    shader.set("light.position", lightPosition);
-    shader.set("light.color", lightColor);
-    shader.set("light.intensity", lightIntensity);
+    // Test model, table and camera
+    PBRE::Wrapper::Model models[3];
+    if (!loadBundledModels(models, PBRE::Wrapper::GeometryRetention::Positions)) return -1;
+    PBRE::Wrapper::Model& model = models[0];
+    PBRE::Wrapper::Model& tableModel = models[1];
+    PBRE::Wrapper::Model& cameraModel = models[2];
 
-    // Base material (used for single-sphere mode and as base albedo for grid)
-    PBRE::Render::Material material{
-        .albedo = PBRE::vec3(0.8f, 0.0f, 0.0f),
-        .metallic = 0.0f,
-        .roughness = 0.5f};
+    // Scene hierarchy: each model's glTF nodes under a root placing it in the world
+    PBRE::Render::Scene scene;
+    PBRE::Transform cameraTransform;
+    PBRE::Render::NodeId cameraNode = addBundledModels(scene, model, tableModel, cameraModel, cameraTransform);
+    // CPU occlusion culling of the renderables, both paths draw only what it leaves visible
+    PBRE::Render::OcclusionCuller occlusion;
+    bool occlusionCulling = true;
+    // Mouse picking: clicks select a renderable, or place the camera model on the surface under the cursor
+    PBRE::Render::ScenePicker picker;
+    PBRE::Render::ScenePicker::Hit selection;
+    bool placeOnClick = false;
 
-    // Test model
-    PBRE::Wrapper::Model model;
-    if (!model.loadFromFile("resources/lion_head/lion_head_4k.gltf")) {
-        std::cerr << "Failed to load model\n";
-        return -1;
-    }
-    PBRE::Wrapper::Model tableModel;
-    if (!tableModel.loadFromFile("resources/table/round_wooden_table_02_4k.gltf")) {
-        std::cerr << "Failed to load table model\n";
-        return -1;
-    }
-    PBRE::Wrapper::Model cameraModel;
-    if (!cameraModel.loadFromFile("resources/vintage_camera/vintage_video_camera_4k.gltf")) {
-        std::cerr << "Failed to load camera model\n";
-        return -1;
+    // Stress scene: instances of the bundled models and the data.h cube scattered around the bundled scene
+    PBRE::Wrapper::Model cubeModel;
+    if (!createPrimitiveModel(cubeModel, options.seed)) return -1;
+    const PBRE::Wrapper::Model* stressModels[] = {&model, &tableModel, &cameraModel};
+    const PBRE::Wrapper::Model* stressPrimitives[] = {&cubeModel};
+    // Every material of the viewer's models, for the forward path's batched draws
+    PBRE::Render::MaterialTable materialTable;
+    const PBRE::Wrapper::Model* tableModels[] = {&model, &tableModel, &cameraModel, &cubeModel};
+    materialTable.build(tableModels);
+    PBRE::Render::StressSceneSettings stressSettings;
+    PBRE::Render::StressScene stress;
+    int stressInstances = static_cast<int>(options.instances);
+    int stressSeed = static_cast<int>(options.seed);
+    // Replaces the whole scene, the selection indexes renderables of the old one
+    auto regenerate = [&](size_t instances) {
+        scene.clear();
+        occlusion.clearOccluderCache();
+        cameraNode = addBundledModels(scene, model, tableModel, cameraModel, cameraTransform);
+        selection = {};
+        stress = {};
+        if (instances == 0) return;
+        stressSettings.seed = static_cast<uint32_t>(stressSeed);
+        stressSettings.instances = instances;
+        cubeModel.materials = PBRE::Render::randomMaterials(cubeModel.materials.size(), stressSettings.seed);
+        materialTable.update();
+        stress = PBRE::Render::generateStressScene(scene, stressModels, stressPrimitives, stressSettings);
+        lightPosition = stress.light.position;
+        lightColor = stress.light.color;
+        lightIntensity = stress.light.intensity;
+        // Overlooking the whole floor
+        float e = std::max(stress.halfExtent, 8.0f);
+        camera.setPosition({e, e * 0.6f, e});
+        camera.lookAt({0.0f, 0.0f, 0.0f});
+    };
+    FrameTimings timings;
+    auto lastFrameStart = std::chrono::steady_clock::now();
+    PBRE::Render::FramePacer pacer;
+    pacer.refreshMs = 1000.0 / window.refreshRate();
+    pacer.targetFps = static_cast<float>(window.refreshRate());
+    window.setSwapInterval(pacer.swapInterval());
+    PBRE::Render::PacingMode pacingBeforeSweep = pacer.mode;
+    StressSweep sweep;
+    bool exitAfterSweep = options.sweepMax > 0;
+    // Vsync or a limiter would cap the frame times the sweep measures
+    auto startSweep = [&](size_t maxInstances) {
+        sweep.start(maxInstances);
+        pacingBeforeSweep = pacer.mode;
+        pacer.mode = PBRE::Render::PacingMode::Uncapped;
+        window.setSwapInterval(pacer.swapInterval());
+        regenerate(sweep.instances);
+    };
+    if (exitAfterSweep) {
+        startSweep(options.sweepMax);
+    } else if (options.instances > 0) {
+        regenerate(options.instances);
     }
 
-    BIND_MATERIAL_PARAM(material, albedo, Albedo, 1, shader, PBRE::vec3);
-    BIND_MATERIAL_PARAM(material, metallic, Metallic, 2, shader, float);
-    BIND_MATERIAL_PARAM(material, roughness, Roughness, 3, shader, float);
-
-    if (auto tex = material.normal; tex) {
-        shader.set("u_HasNormalMap", 1);
-        shader.set("u_NormalMap", 4);
-        glActiveTexture(GL_TEXTURE0 + 4);
-        tex->bind(4);
-    } else {
-        shader.set("u_HasNormalMap", 0);
-    }
+    // CPU reference of the current view, traced on demand from the UI
+    PBRE::Render::PathTracer tracer;
+    bool tracerHasEnvironment = false, tracerLoaded = false;
+    // The viewer's models only keep positions, the tracer gets copies with every stream on its first trace
+    std::unique_ptr<std::array<PBRE::Wrapper::Model, 3>> referenceModels;
+    int referenceSamples = 16;
+    PBRE::Render::PathTracerStats referenceStats;
+    double referenceNoise = 0.0;
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS); // or GL_LEQUAL
+    // Every bind and state change below goes through the cache
+    auto& glState = PBRE::Wrapper::GlState::instance();
+    glState.setEnabled(GL_DEPTH_TEST, true);
+    glState.depthFunc(GL_LESS); // or GL_LEQUAL
     // Reduce seams between cubemap faces
-    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    glState.setEnabled(GL_TEXTURE_CUBE_MAP_SEAMLESS, true);
 
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
+    glState.setEnabled(GL_CULL_FACE, true);
+    glState.cullFace(GL_BACK);
     glFrontFace(GL_CCW);
 
+    // Lighting debug settings, applied to every shading path each frame
+    int debugMode = 0;
+    bool ibl = true, direct = true;
+    float iblIntensity = 1.0f;
+    float horizonFadePower = 2.0f;
+
     // Grid controls
     bool mouseLocked = false;
     static int gridRows = 6;
@@ -134,12 +888,387 @@ int run() {
 
     while (!window.shouldClose()) {
         window.beginFrame();
+        auto frameStart = std::chrono::steady_clock::now();
+        timings.frameMs = std::chrono::duration<double, std::milli>(frameStart - lastFrameStart).count();
+        lastFrameStart = frameStart;
 
         auto fps = ImGui::GetIO().Framerate;
         ImGui::Begin("FPS");
         ImGui::Text("FPS: %.1f", fps);
         ImGui::End();
 
+        ImGui::Begin("Renderer");
+        if (comparison.running) {
+            ImGui::Text("Comparing: %s at %.0f%% (%zu/%zu)", kRenderPathNames[static_cast<int>(comparison.path())],
+                        comparison.scale() * 100.0f, comparison.step + 1, PathComparison::stepCount());
+        } else {
+            int pathIndex = static_cast<int>(renderPath);
+            if (ImGui::Combo("Path", &pathIndex, kRenderPathNames, IM_ARRAYSIZE(kRenderPathNames))) {
+                renderPath = static_cast<RenderPath>(pathIndex);
+            }
+            if (ImGui::Checkbox("Dynamic Resolution", &dynamicResolution)) dynres.reset();
+            if (dynamicResolution) {
+                ImGui::SliderFloat("Target GPU ms", &dynres.targetMs, 2.0f, 50.0f);
+                ImGui::SliderFloat("Min Scale", &dynres.minScale, 0.25f, 1.0f);
+                char overlay[32];
+                snprintf(overlay, sizeof(overlay), "scale %.2f", dynres.scale());
+                ImGui::PlotLines("Scale", dynres.scaleHistory().data(), PBRE::Render::DynamicResolution::kHistorySize,
+                                 dynres.historyOffset(), overlay, 0.0f, 1.0f, ImVec2(0.0f, 60.0f));
+                snprintf(overlay, sizeof(overlay), "target %.1f ms", dynres.targetMs);
+                ImGui::PlotLines("GPU ms", dynres.gpuMsHistory().data(), PBRE::Render::DynamicResolution::kHistorySize,
+                                 dynres.historyOffset(), overlay, 0.0f, dynres.targetMs * 2.0f, ImVec2(0.0f, 60.0f));
+            } else {
+                ImGui::SliderFloat("Resolution Scale", &renderScale, 0.25f, 2.0f);
+            }
+            if (renderPath == RenderPath::Forward) {
+                ImGui::Checkbox("Depth Pre-pass", &forwardOptions.depthPrepass);
+                ImGui::SameLine();
+                ImGui::Checkbox("Overdraw Heat Map", &forwardOptions.overdraw);
+                // A/B the per vertex inverse against the per draw uniform with the Scene GPU time below
+                ImGui::Checkbox("Normal Matrix in Shader", &forwardOptions.shaderNormalMatrix);
+                ImGui::Checkbox("Material Table (batched draws)", &forwardOptions.materialTable);
+                const auto& forwardStats = forward.stats();
+                ImGui::Text("%d draws in %d calls, %d texture binds", forwardStats.draws, forwardStats.drawCalls, forwardStats.textureBinds);
+                const auto& tableStats = materialTable.stats();
+                if (tableStats.bindless) {
+                    ImGui::Text("Table: %zu materials, %zu bindless textures", tableStats.materials, tableStats.textures);
+                } else {
+                    ImGui::Text("Table: %zu materials, %zu textures in %d arrays (%.1f MiB)", tableStats.materials, tableStats.textures,
+                                tableStats.arrays, tableStats.arrayBytes / (1024.0 * 1024.0));
+                }
+            }
+            if (ImGui::Button("Compare Paths")) comparison.start();
+        }
+        ImGui::Text("CPU: frame %.2f ms, update %.3f ms, cull %.3f ms, submit %.3f ms", timings.frameMs, timings.updateMs, timings.cullMs,
+                    timings.submitMs);
+        if (ImGui::CollapsingHeader("GL State")) {
+            ImGui::Checkbox("Skip Redundant Calls", &glState.enabled);
+            const auto& calls = glState.lastFrame();
+            ImGui::Text("%d calls issued, %d elided last frame", calls.totalIssued(), calls.totalElided());
+            if (ImGui::BeginTable("GL State Calls", 3)) {
+                ImGui::TableSetupColumn("Kind");
+                ImGui::TableSetupColumn("Issued");
+                ImGui::TableSetupColumn("Elided");
+                ImGui::TableHeadersRow();
+                for (size_t i = 0; i < static_cast<size_t>(PBRE::Wrapper::GlStateCategory::Count); ++i) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(PBRE::Wrapper::GlState::name(static_cast<PBRE::Wrapper::GlStateCategory>(i)));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%d", calls.issued[i]);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%d", calls.elided[i]);
+                }
+                ImGui::EndTable();
+            }
+        }
+        if (ImGui::CollapsingHeader("Frame Pacing")) {
+            if (sweep.running) {
+                ImGui::Text("Uncapped while sweeping");
+            } else {
+                int pacingIndex = static_cast<int>(pacer.mode);
+                if (ImGui::Combo("Mode", &pacingIndex, kPacingModeNames, IM_ARRAYSIZE(kPacingModeNames))) {
+                    pacer.mode = static_cast<PBRE::Render::PacingMode>(pacingIndex);
+                    window.setSwapInterval(pacer.swapInterval());
+                }
+            }
+            if (pacer.mode == PBRE::Render::PacingMode::Limiter) {
+                ImGui::SliderFloat("Target FPS", &pacer.targetFps, 10.0f, 500.0f);
+                ImGui::SliderFloat("Spin ms", &pacer.spinMs, 0.0f, 4.0f);
+            } else if (pacer.mode == PBRE::Render::PacingMode::LateLatch) {
+                ImGui::SliderFloat("Latch Margin ms", &pacer.latchMarginMs, 0.0f, 8.0f);
+            }
+            const auto& pacing = pacer.stats();
+            ImGui::Text("Frame %.2f ms, jitter %.3f ms, max %.2f ms, %d missed of %d", pacing.frameMs, pacing.jitterMs, pacing.maxFrameMs,
+                        pacing.missed, PBRE::Render::FramePacer::kHistorySize);
+            ImGui::Text("Input latency ~%.1f ms (refresh %.1f Hz), waited %.2f ms, predicted work %.2f ms", pacing.latencyMs,
+                        1000.0 / pacer.refreshMs, pacing.waitMs, pacing.predictedWorkMs);
+            ImGui::PlotLines("Frame ms", pacer.frameMsHistory().data(), PBRE::Render::FramePacer::kHistorySize, pacer.historyOffset(), nullptr,
+                             0.0f, static_cast<float>(pacing.maxFrameMs) * 1.2f, ImVec2(0.0f, 60.0f));
+            ImGui::PlotLines("Latency ms", pacer.latencyMsHistory().data(), PBRE::Render::FramePacer::kHistorySize, pacer.historyOffset(),
+                             nullptr, 0.0f, static_cast<float>(pacing.latencyMs) * 2.0f, ImVec2(0.0f, 60.0f));
+        }
+        ImGui::Text("Scene GPU: %.3f ms (%dx%d)", graph.gpuMs("Scene"), renderWidth, renderHeight);
+        ImGui::Text("Resolve + Tonemap GPU: %.3f ms", graph.gpuMs("Resolve") + graph.gpuMs("Tonemap"));
+        const auto& ringStats = ring.stats();
+        ImGui::Text("Streamed: %.1f KiB/frame (peak %.1f of %.0f), %d stalls (%.2f ms) in %d frames", ringStats.frameBytes / 1024.0,
+                    ringStats.peakFrameBytes / 1024.0, ring.regionBytes() / 1024.0, ringStats.stalls, ringStats.stallMs, ringStats.frames);
+        ImGui::Checkbox("Occlusion Culling", &occlusionCulling);
+        if (occlusionCulling) {
+            const auto& occlusionStats = occlusion.stats();
+            ImGui::SliderFloat("Occluder Screen Area", &occlusion.occluderArea, 0.0f, 0.25f);
+            ImGui::Text("Culled: %d frustum, %d occluded of %d", occlusionStats.frustumCulled, occlusionStats.occlusionCulled, occlusionStats.tested);
+            ImGui::Text("Occluders: %d (%zu triangles), raster %.3f ms, test %.3f ms", occlusionStats.occluders, occlusionStats.occluderTriangles,
+                        occlusionStats.rasterMs, occlusionStats.testMs);
+        }
+
+        if (ImGui::CollapsingHeader("Stress Scene")) {
+            if (sweep.running) {
+                ImGui::Text("Sweeping: %zu instances of %zu", sweep.instances, sweep.maxInstances);
+            } else {
+                ImGui::InputInt("Instances", &stressInstances, 100, 1000);
+                ImGui::InputInt("Seed", &stressSeed);
+                stressInstances = std::max(stressInstances, 0);
+                if (ImGui::Button("Generate")) regenerate(static_cast<size_t>(stressInstances));
+                ImGui::SameLine();
+                if (ImGui::Button("Sweep to Instances") && stressInstances > 0) startSweep(static_cast<size_t>(stressInstances));
+            }
+            ImGui::Text("%zu models, %zu primitives on %.0f x %.0f, generated in %.1f ms", stress.modelInstances, stress.primitiveInstances,
+                        stress.halfExtent * 2.0f, stress.halfExtent * 2.0f, stress.generateMs);
+            ImGui::Text("%zu nodes, %zu renderables", scene.size(), scene.renderables().size());
+            if (!sweep.results.empty() && ImGui::BeginTable("Sweep", 6)) {
+                for (const char* column : {"Instances", "Frame ms", "Update ms", "Cull ms", "Submit ms", "GPU ms"}) ImGui::TableSetupColumn(column);
+                ImGui::TableHeadersRow();
+                for (const auto& r : sweep.results) {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%zu", r.instances);
+                    for (double ms : {r.timings.frameMs, r.timings.updateMs, r.timings.cullMs, r.timings.submitMs, r.timings.gpuMs}) {
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3f", ms);
+                    }
+                }
+                ImGui::EndTable();
+            }
+        }
+
+        if (ImGui::CollapsingHeader("HDR Target")) {
+            static const char* kColorFormats[] = {"RGBA16F", "R11F_G11F_B10F"};
+            static const char* kDepthFormats[] = {"DEPTH24_STENCIL8", "DEPTH24", "DEPTH32F"};
+            int colorIndex = static_cast<int>(hdrFormat.color);
+            int depthIndex = static_cast<int>(hdrFormat.depth);
+            bool changed = ImGui::Combo("Color", &colorIndex, kColorFormats, IM_ARRAYSIZE(kColorFormats));
+            changed |= ImGui::Combo("Depth", &depthIndex, kDepthFormats, IM_ARRAYSIZE(kDepthFormats));
+            changed |= ImGui::Checkbox("Fused Resolve + Tonemap", &shaderResolve);
+            if (changed) {
+                hdrFormat.color = static_cast<PBRE::Wrapper::ColorFormat>(colorIndex);
+                hdrFormat.depth = static_cast<PBRE::Wrapper::DepthFormat>(depthIndex);
+            }
+            ImGui::Text("Memory: %.2f MiB, resolve traffic: %.2f MiB/frame",
+                        PBRE::Wrapper::Framebuffer::memoryBytes(hdrFormat, targetWidth, targetHeight, kSceneSamples, shaderResolve) / (1024.0 * 1024.0),
+                        PBRE::Wrapper::Framebuffer::resolveTrafficBytes(hdrFormat, renderWidth, renderHeight, kSceneSamples, shaderResolve, window.getWidth(), window.getHeight()) / (1024.0 * 1024.0));
+
+            // Estimates for every configuration at the current size, to compare against the live one
+            if (ImGui::BeginTable("Formats", 4)) {
+                ImGui::TableSetupColumn("Color");
+                ImGui::TableSetupColumn("Resolve");
+                ImGui::TableSetupColumn("Memory MiB");
+                ImGui::TableSetupColumn("Traffic MiB");
+                ImGui::TableHeadersRow();
+                for (int c = 0; c < IM_ARRAYSIZE(kColorFormats); ++c) {
+                    for (int fused = 0; fused < 2; ++fused) {
+                        PBRE::Wrapper::FramebufferFormat f{static_cast<PBRE::Wrapper::ColorFormat>(c), hdrFormat.depth};
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(kColorFormats[c]);
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(fused ? "fused" : "blit");
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.2f", PBRE::Wrapper::Framebuffer::memoryBytes(f, targetWidth, targetHeight, kSceneSamples, fused != 0) / (1024.0 * 1024.0));
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.2f", PBRE::Wrapper::Framebuffer::resolveTrafficBytes(f, renderWidth, renderHeight, kSceneSamples, fused != 0, window.getWidth(), window.getHeight()) / (1024.0 * 1024.0));
+                    }
+                }
+                ImGui::EndTable();
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Render Graph")) {
+            if (ImGui::BeginTable("Passes", 3)) {
+                ImGui::TableSetupColumn("Pass");
+                ImGui::TableSetupColumn("State");
+                ImGui::TableSetupColumn("GPU ms");
+                ImGui::TableHeadersRow();
+                for (const auto& pass : graph.passInfo()) {
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(pass.name.c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(pass.culled ? "culled" : "run");
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", pass.culled ? 0.0 : pass.gpuMs);
+                }
+                ImGui::EndTable();
+            }
+            const auto& poolStats = targetPool.stats();
+            ImGui::Text("Pooled targets: %d (%.2f MiB), peak live %.2f MiB", poolStats.textureCount,
+                        poolStats.pooledBytes / (1024.0 * 1024.0), poolStats.peakLiveBytes / (1024.0 * 1024.0));
+            ImGui::Text("This frame: %d acquires, %d allocations (%.2f MiB), %d frees", poolStats.acquires,
+                        poolStats.allocations, poolStats.allocatedBytes / (1024.0 * 1024.0), poolStats.frees);
+        }
+        if (ImGui::CollapsingHeader("Models")) {
+            if (ImGui::BeginTable("Loads", 7)) {
+                ImGui::TableSetupColumn("Model");
+                ImGui::TableSetupColumn("Load ms");
+                ImGui::TableSetupColumn("Vertex MiB");
+                ImGui::TableSetupColumn("Texture MiB");
+                ImGui::TableSetupColumn("Scratch / kept MiB");
+                ImGui::TableSetupColumn("Meshopt MB/s");
+                ImGui::TableSetupColumn("Tangent ms");
+                ImGui::TableHeadersRow();
+                for (const auto* m : {&model, &tableModel, &cameraModel}) {
+                    const auto& stats = m->loadStats;
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(std::filesystem::path(m->path).filename().string().c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.1f", stats.loadMs);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f / %.2f", stats.vertexBytes / (1024.0 * 1024.0), stats.floatVertexBytes / (1024.0 * 1024.0));
+                    ImGui::TableNextColumn();
+                    // Packed against unpacked
+                    ImGui::Text("%.2f / %.2f", stats.textureBytes / (1024.0 * 1024.0), stats.unpackedTextureBytes / (1024.0 * 1024.0));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f / %.2f", stats.scratchBytes / (1024.0 * 1024.0), stats.retainedBytes / (1024.0 * 1024.0));
+                    ImGui::TableNextColumn();
+                    if (stats.meshopt.views > 0) {
+                        ImGui::Text("%.0f", stats.meshopt.megabytesPerSecond());
+                    } else {
+                        ImGui::TextUnformatted("-");
+                    }
+                    ImGui::TableNextColumn();
+                    if (stats.tangentsGenerated + stats.tangentsCached > 0) {
+                        ImGui::Text("%.1f (%d cached)", stats.tangentMs, stats.tangentsCached);
+                    } else {
+                        ImGui::TextUnformatted("-");
+                    }
+                }
+                ImGui::EndTable();
+            }
+        }
+        if (ImGui::CollapsingHeader("Environment")) {
+            if (ImGui::Combo("Cubemap format", &envFormat, kCubemapFormatNames, IM_ARRAYSIZE(kCubemapFormatNames))) loadEnvironment();
+            constexpr double kMiB = 1024.0 * 1024.0;
+            ImGui::Text("%s: %.2f MiB, %.2f MiB saved against RGB16F", kCubemapFormatNames[static_cast<int>(envStats.format)],
+                        envStats.bytes / kMiB, (static_cast<double>(envStats.rgb16fBytes) - static_cast<double>(envStats.bytes)) / kMiB);
+            if (envStats.format != PBRE::Wrapper::CubemapFormat::RGB16F) {
+                ImGui::Text("Error: mean %.4f, max %.3f stops", envStats.meanStops, envStats.maxStops);
+                ImGui::Text("Encode %.1f ms%s, load %.1f ms", envStats.encodeMs, envStats.cached ? " (cached)" : "", envStats.loadMs);
+            } else {
+                ImGui::Text("Load %.1f ms", envStats.loadMs);
+            }
+        }
+        if (ImGui::CollapsingHeader("GPU Memory")) {
+            constexpr double kMiB = 1024.0 * 1024.0;
+            auto& gpuMemory = PBRE::Wrapper::GpuMemory::instance();
+            auto memoryStats = gpuMemory.stats();
+            ImGui::Text("%.2f MiB in %zu allocations, peak %.2f MiB", memoryStats.totalBytes / kMiB, memoryStats.allocations, memoryStats.peakBytes / kMiB);
+            for (size_t c = 0; c < memoryStats.categoryBytes.size(); ++c) {
+                ImGui::Text("  %s: %.2f MiB", PBRE::Wrapper::GpuMemory::name(static_cast<PBRE::Wrapper::GpuCategory>(c)), memoryStats.categoryBytes[c] / kMiB);
+            }
+            bool budgetChanged = ImGui::InputInt("Budget MiB", &gpuBudgetMiB, 64, 256);
+            budgetChanged |= ImGui::Checkbox("Refuse allocations over budget", &gpuBudgetRefuse);
+            if (budgetChanged) {
+                gpuBudgetMiB = std::max(gpuBudgetMiB, 0);
+                gpuMemory.setBudget(static_cast<size_t>(gpuBudgetMiB) << 20, gpuBudgetRefuse ? PBRE::Wrapper::GpuBudgetPolicy::Refuse : PBRE::Wrapper::GpuBudgetPolicy::Warn);
+            }
+            if (memoryStats.refused + memoryStats.overBudget > 0) {
+                ImGui::Text("%d refused, %d over budget", memoryStats.refused, memoryStats.overBudget);
+            }
+            if (ImGui::BeginTable("Owners", 2)) {
+                ImGui::TableSetupColumn("Owner");
+                ImGui::TableSetupColumn("MiB");
+                ImGui::TableHeadersRow();
+                for (const auto& [owner, bytes] : gpuMemory.ownerBytes()) {
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(std::filesystem::path(owner).filename().string().c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", bytes / kMiB);
+                }
+                ImGui::EndTable();
+            }
+            // The largest allocations with where they were made
+            constexpr size_t kListed = 12;
+            if (ImGui::BeginTable("Allocations", 4)) {
+                ImGui::TableSetupColumn("Category");
+                ImGui::TableSetupColumn("Size");
+                ImGui::TableSetupColumn("MiB");
+                ImGui::TableSetupColumn("Site");
+                ImGui::TableHeadersRow();
+                auto allocations = gpuMemory.allocations();
+                for (size_t i = 0; i < std::min(kListed, allocations.size()); ++i) {
+                    const auto& a = allocations[i];
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(PBRE::Wrapper::GpuMemory::name(a.category));
+                    ImGui::TableNextColumn();
+                    if (a.width > 0) {
+                        ImGui::Text("%dx%d%s", a.width, a.height, a.layers > 1 ? " cube" : "");
+                    } else {
+                        ImGui::TextUnformatted("-");
+                    }
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", a.bytes / kMiB);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s:%u", std::filesystem::path(a.site.file_name()).filename().string().c_str(), static_cast<unsigned>(a.site.line()));
+                }
+                ImGui::EndTable();
+            }
+            if (ImGui::Button("Dump to gpu_memory.json")) gpuMemory.writeJson("gpu_memory.json");
+        }
+        if (ImGui::CollapsingHeader("Capture")) {
+            static const char* kCaptureFormats[] = {"PNG (tonemapped)", "HDR (scene color)"};
+            if (!capture.active()) ImGui::Combo("Format", &captureFormat, kCaptureFormats, IM_ARRAYSIZE(kCaptureFormats));
+            if (ImGui::Button(capture.active() ? "Stop Recording" : "Record")) {
+                if (capture.active()) {
+                    capture.stop();
+                } else {
+                    capture.start("captures/session_" + std::to_string(captureSession++), static_cast<PBRE::Render::CaptureFormat>(captureFormat));
+                }
+            }
+            auto stats = capture.stats();
+            ImGui::Text("%d/%d frames written, %d dropped, %.1f fps, %.0f MB/s read back", stats.encoded, stats.requested, stats.dropped,
+                        stats.framesPerSecond(), stats.readbackMegabytesPerSecond());
+        }
+        if (ImGui::CollapsingHeader("Path Traced Reference")) {
+            ImGui::SliderInt("Samples", &referenceSamples, 1, 1024);
+            if (ImGui::Button("Trace View to reference.exr")) {
+                if (!tracerLoaded) {
+                    tracerHasEnvironment = tracer.loadEnvironment(kEnvironmentPath);
+                    referenceModels = std::make_unique<std::array<PBRE::Wrapper::Model, 3>>();
+                    if (!decodeBundledModels(*referenceModels)) referenceModels.reset();
+                    tracerLoaded = true;
+                }
+                // Rebuilt every time, the scene may have moved
+                tracer.clearGeometry();
+                for (const auto& r : scene.renderables()) {
+                    // Stress scene primitives keep every stream already
+                    bool bundled = r.model >= models && r.model < models + 3;
+                    const auto& source = referenceModels && bundled ? (*referenceModels)[r.model - models] : *r.model;
+                    tracer.submit(source, source.meshes[r.mesh], scene.world(r.node));
+                }
+                tracer.build();
+                tracer.resize(renderWidth, renderHeight);
+                tracer.setCamera(camera.getViewMatrix(), camera.getProjectionMatrix());
+                PBRE::Render::PathTracerSettings settings;
+                settings.lightPosition = lightPosition;
+                settings.lightColor = lightColor;
+                settings.lightIntensity = lightIntensity;
+                settings.iblIntensity = iblIntensity;
+                settings.enableDirect = direct;
+                settings.enableIBL = ibl && tracerHasEnvironment;
+                referenceStats = tracer.render(settings, referenceSamples);
+                referenceNoise = tracer.noiseEstimate();
+                auto rgb = tracer.image();
+                PBRE::Core::writeImage("reference.exr", tracer.width(), tracer.height(), rgb.data());
+            }
+            if (tracer.sampleCount() > 0) {
+                ImGui::Text("%d spp in %.0f ms, %.2f Mrays/s, noise %.4f", tracer.sampleCount(), referenceStats.ms,
+                            referenceStats.raysPerSecond() / 1.0e6, referenceNoise);
+            }
+        }
+        if (!comparison.results.empty() && ImGui::BeginTable("Comparison", 3)) {
+            ImGui::TableSetupColumn("Path");
+            ImGui::TableSetupColumn("Resolution");
+            ImGui::TableSetupColumn("GPU ms");
+            ImGui::TableHeadersRow();
+            for (const auto& r : comparison.results) {
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(kRenderPathNames[static_cast<int>(r.path)]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%dx%d", r.width, r.height);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", r.gpuMs);
+            }
+            ImGui::EndTable();
+        }
+        ImGui::End();
+
         if (!mouseLocked) {
             ImGui::Begin("Settings");
 
@@ -148,17 +1277,8 @@ int run() {
             ImGui::ColorEdit3("Color", &lightColor.x);
             ImGui::SliderFloat("Intensity", &lightIntensity, 0.0f, 100.0f);
 
-            shader.use();
-            shader.set("light.position", lightPosition);
-            shader.set("light.color", lightColor);
-            shader.set("light.intensity", lightIntensity);
-
             ImGui::Separator();
             ImGui::Text("Debug");
-            static int debugMode = 0;
-            static bool ibl = true, direct = true;
-            static float iblIntensity = 1.0f;
-            static float horizonFadePower = 2.0f;
             ImGui::Checkbox("Enable IBL", &ibl);
             ImGui::SameLine();
             ImGui::Checkbox("Enable Direct", &direct);
@@ -168,51 +1288,20 @@ int run() {
             ImGui::Separator();
             ImGui::SliderFloat("Exposure", &exposure, 0.0f, 5.0f);
 
-            shader.use();
-            shader.set("debugMode", debugMode);
-            shader.set("enableIBL", ibl ? 1 : 0);
-            shader.set("enableDirect", direct ? 1 : 0);
-            shader.set("iblIntensity", iblIntensity);
-            shader.set("horizonFadePower", horizonFadePower);
-            tonemap.use();
-            tonemap.set("uExposure", exposure);
-
-            if (auto metallicPtr = std::get_if<float>(&material.metallic); metallicPtr) {
-                if (auto roughnessPtr = std::get_if<float>(&material.roughness); roughnessPtr) {
-                    ImGui::SliderFloat("Metallic", metallicPtr, 0.0f, 1.0f);
-                    ImGui::SliderFloat("Roughness", roughnessPtr, 0.0f, 1.0f);
-                    shader.use();
-                    shader.set("material.Metallic", *metallicPtr);
-                    shader.set("material.Roughness", *roughnessPtr);
-                }
-            }
-
-            // AO
-            if (auto aoPtr = std::get_if<float>(&material.ao); aoPtr) {
-                ImGui::SliderFloat("AO", aoPtr, 0.0f, 1.0f);
-                shader.use();
-                shader.set("material.AO", *aoPtr);
-            }
-
-            shader.use();
-            // shader.set("material.albedo", material.albedo);
-            // BIND_MATERIAL_PARAM(material, albedo, Albedo, 1, shader, PBRE::vec3);
-
-            if (auto albVec3 = std::get_if<PBRE::vec3>(&material.albedo); albVec3) {
-                ImGui::ColorEdit3("Albedo Color", &albVec3->x);
-                shader.set("material.Albedo", *albVec3);
-            } else if (auto albTex = std::get_if<std::shared_ptr<PBRE::Wrapper::Texture>>(&material.albedo); albTex && *albTex) {
-                ImGui::Text("Albedo Texture: %dx%d", (*albTex)->getWidth(), (*albTex)->getHeight());
-            }
-
             ImGui::Separator();
             ImGui::Text("Camera: ESC toggle mouse look");
             ImGui::End();
         }
 
+        // Late latch holds input sampling back until just before the frame has to be submitted
+        if (pacer.mode == PBRE::Render::PacingMode::LateLatch) {
+            pacer.waitForLatch();
+            window.pollEvents();
+        }
+        float inputSeconds = pacer.sampleInput();
         if (mouseLocked) {
-            // Camera movement
-            const float cameraSpeed = 5.0f * 0.016f; // adjust accordingly
+            // Camera movement, 5 units per second
+            const float cameraSpeed = 5.0f * inputSeconds;
 
             if (glfwGetKey(window.getGLFWwindow(), GLFW_KEY_W) == GLFW_PRESS)
                 camera.setPosition(camera.getPosition() + cameraSpeed * glm::normalize(camera.getRotation() * PBRE::vec3(0.0f, 0.0f, -1.0f)));
@@ -255,83 +1344,251 @@ int run() {
             }
         }
 
-        // Ensure HDR framebuffer matches window size
-        hdrFbo.resize(window.getWidth(), window.getHeight());
-
-        // Render scene into HDR (MSAA) FBO
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LESS);
-        hdrFbo.bind();
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glDepthMask(GL_TRUE);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // The comparison overrides the selected path and scale while it runs
+        RenderPath activePath = comparison.running ? comparison.path() : renderPath;
+        bool showOverdraw = activePath == RenderPath::Forward && forwardOptions.overdraw;
+        float activeScale = comparison.running ? comparison.scale() : (dynamicResolution ? dynres.scale() : renderScale);
+        renderWidth = std::max(1, static_cast<int>(window.getWidth() * activeScale));
+        renderHeight = std::max(1, static_cast<int>(window.getHeight() * activeScale));
+        // Targets are allocated at no less than window size and rendered with a viewport, so scales below
+        // 1.0 (dynamic resolution) keep acquiring the same pooled textures every frame
+        targetWidth = std::max(window.getWidth(), renderWidth);
+        targetHeight = std::max(window.getHeight(), renderHeight);
 
-        shader.use();
         PBRE::mat4 view = camera.getViewMatrix();
         PBRE::mat4 projection = camera.getProjectionMatrix();
 
-        // Update light uniforms in case the light moved
-        shader.set("light.position", lightPosition);
-        shader.set("light.color", lightColor);
-        shader.set("light.intensity", lightIntensity);
-        shader.set("view", view);
-        shader.set("projection", projection);
-        shader.set("viewPos", camera.getPosition());
-
-        PBRE::Transform t;
-        PBRE::mat4 modelMat = t.toMat4();
-        shader.set("model", modelMat);
-        // Draw loaded model
-        model.draw(shader);
-
-        // Draw table
-        PBRE::Transform tableTransform;
-        tableTransform.position = PBRE::vec3(0.0f, -0.75f, 0.0f);
-        shader.set("model", tableTransform.toMat4());
-        tableModel.draw(shader);
-
-        // Draw camera model on table
-        PBRE::Transform cameraTransform;
-        cameraTransform.position = PBRE::vec3(0.2f, 0.0f, 0.0f);
-        cameraTransform.rotation = glm::angleAxis(glm::radians(12.0f), PBRE::vec3(0.0f, 1.0f, 0.0f));
-        shader.set("model", cameraTransform.toMat4());
-        cameraModel.draw(shader);
+        // Per frame lighting state, identical for both paths
+        PBRE::Render::FrameData frameData;
+        frameData.view = view;
+        frameData.projection = projection;
+        frameData.lightPosition = lightPosition;
+        frameData.lightColor = lightColor;
+        frameData.lightIntensity = lightIntensity;
+        frameData.viewPos = camera.getPosition();
+        // Environment map mip count for roughness-based LOD
+        frameData.envMaxMips = envIBL.getMaxMips();
+        frameData.iblIntensity = iblIntensity;
+        frameData.horizonFadePower = horizonFadePower;
+        frameData.debugMode = debugMode;
+        frameData.enableIBL = ibl ? 1 : 0;
+        frameData.enableDirect = direct ? 1 : 0;
 
         ImGui::Begin("Table");
 
         // DragFloat3 for position
-        ImGui::DragFloat3("Position", &cameraTransform.position.x, 0.1f);
+        if (ImGui::DragFloat3("Position", &cameraTransform.position.x, 0.1f)) {
+            scene.setPosition(cameraNode, cameraTransform.position);
+        }
+        ImGui::Checkbox("Place on Click", &placeOnClick);
+        if (selection.renderable < scene.renderables().size()) {
+            const auto& r = scene.renderables()[selection.renderable];
+            ImGui::Text("Selected: %s mesh %zu at %.2f", r.model->path.c_str(), r.mesh, selection.t);
+        } else {
+            ImGui::Text("Selected: none, click the scene to pick");
+        }
+        const auto& sceneBvh = picker.bvh();
+        ImGui::Text("Scene BVH: %zu nodes, refit %.3f ms, cost x%.2f of build, %d rebuilds", sceneBvh.nodeCount(), sceneBvh.refitMs(),
+                    sceneBvh.costRatio(), sceneBvh.rebuilds());
 
         ImGui::End();
 
-        lightShader.use();
-        PBRE::Transform lightTransform;
-        lightTransform.position = lightPosition;
-        lightTransform.scale = PBRE::vec3(0.2f);
-        PBRE::mat4 lightModel = lightTransform.toMat4();
-        lightShader.set("model", lightModel);
-        lightShader.set("view", view);
-        lightShader.set("projection", projection);
-        PBRE::vec3 indicatorColor = PBRE::vec3(1.0f, 1.0f, 0.8f);
-        lightShader.set("color", indicatorColor);
-        buffers.draw();
-
-        // Resolve MSAA to single-sample color
-        hdrFbo.resolve();
-
-        // Tonemap to default framebuffer
-        PBRE::Wrapper::Framebuffer::unbind();
-        glDisable(GL_DEPTH_TEST);
-        // Tonemap shader outputs gamma-corrected (sRGB) LDR. Ensure the default framebuffer doesn't apply another sRGB conversion.
-        glDisable(GL_FRAMEBUFFER_SRGB);
-        glBindVertexArray(screenVAO);
-        tonemap.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, hdrFbo.colorTex());
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        glBindVertexArray(0);
-
-        window.endFrame();
+        // Only the subtrees that moved are recomposed
+        auto updateStart = std::chrono::steady_clock::now();
+        scene.update();
+        picker.update(scene);
+        timings.updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - updateStart).count();
+        if (!mouseLocked && !ImGui::GetIO().WantCaptureMouse && ImGui::IsMouseClicked(0)) {
+            const auto& io = ImGui::GetIO();
+            PBRE::vec2 ndc(io.MousePos.x / io.DisplaySize.x * 2.0f - 1.0f, 1.0f - io.MousePos.y / io.DisplaySize.y * 2.0f);
+            PBRE::Render::ScenePicker::Hit hit;
+            if (placeOnClick) {
+                // The camera model can't be placed on itself
+                if (picker.pick(scene, camera.getRay(ndc), hit, &cameraModel)) {
+                    cameraTransform.position = hit.position;
+                    scene.setPosition(cameraNode, cameraTransform.position);
+                }
+            } else {
+                picker.pick(scene, camera.getRay(ndc), hit);
+                selection = hit;
+            }
+        }
+        auto cullStart = std::chrono::steady_clock::now();
+        if (occlusionCulling) occlusion.cull(scene, projection * view);
+        timings.cullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cullStart).count();
+        auto drawn = [&](size_t renderable) { return !occlusionCulling || occlusion.visible(renderable); };
+
+        // Room for the frame constants and one DrawData per renderable, whichever path draws them. The batched
+        // path's two arrays take less but each is padded to the alignment.
+        ring.beginFrame(ring.alignedSize(sizeof(PBRE::Render::FrameData)) +
+                        scene.renderables().size() * ring.alignedSize(sizeof(PBRE::Render::DrawData)) + 2 * ring.alignedSize(1));
+        ring.bindUniform(PBRE::Render::kFrameDataBinding, ring.write(frameData));
+
+        // Frame graph: scene -> MSAA resolve -> tonemap -> UI
+        PBRE::Render::TextureDesc colorDesc{targetWidth, targetHeight, PBRE::Wrapper::Framebuffer::colorInternalFormat(hdrFormat.color), kSceneSamples};
+        PBRE::Render::TextureDesc depthDesc{targetWidth, targetHeight, PBRE::Wrapper::Framebuffer::depthInternalFormat(hdrFormat.depth), kSceneSamples};
+        graph.reset();
+        auto sceneColor = graph.createTexture("SceneColor", colorDesc);
+        auto sceneDepth = graph.createTexture("SceneDepth", depthDesc);
+        auto resolvedColor = graph.createTexture("ResolvedColor", {targetWidth, targetHeight, colorDesc.format, 1});
+        auto backbuffer = graph.importBackbuffer("Backbuffer", window.getWidth(), window.getHeight());
+
+        graph.addPass(
+            "Scene",
+            [&](RenderGraph::Builder& builder) {
+                builder.write(sceneColor);
+                builder.write(sceneDepth);
+            },
+            [&](RenderGraph::Resources& resources) {
+                GLuint sceneFbo = resources.framebuffer();
+                auto submitStart = std::chrono::steady_clock::now();
+                if (activePath == RenderPath::Forward) {
+                    // Render scene into HDR (MSAA) targets
+                    glState.setEnabled(GL_DEPTH_TEST, true);
+                    glState.depthFunc(GL_LESS);
+                    glState.bindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+                    glViewport(0, 0, renderWidth, renderHeight);
+                    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+                    glState.depthMask(true);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                    forward.clearDraws();
+                    // Loaded model, table and the camera model on the table
+                    for (size_t i = 0; i < scene.renderables().size(); ++i) {
+                        const auto& r = scene.renderables()[i];
+                        if (drawn(i)) forward.submit(*r.model, r.model->meshes[r.mesh], scene.world(r.node));
+                    }
+                    forward.render(ring, forwardOptions, &materialTable);
+                } else {
+                    visibility.resize(renderWidth, renderHeight, kSceneSamples, depthDesc.format);
+                    visibility.clearDraws();
+                    for (size_t i = 0; i < scene.renderables().size(); ++i) {
+                        const auto& r = scene.renderables()[i];
+                        if (drawn(i)) visibility.submit(*r.model, r.model->meshes[r.mesh], scene.world(r.node));
+                    }
+                    visibility.renderVisibility(ring);
+                    // Leaves the scene targets bound with the scene depth for the light indicator
+                    visibility.resolve(ring, sceneFbo, kSceneSamples, view, projection);
+                }
+                timings.submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
+
+                // The light indicator would be counted as overdraw
+                if (!showOverdraw) {
+                    lightShader.use();
+                    PBRE::Transform lightTransform;
+                    lightTransform.position = lightPosition;
+                    lightTransform.scale = PBRE::vec3(0.2f);
+                    PBRE::mat4 lightModel = lightTransform.toMat4();
+                    lightShader.set("model", lightModel);
+                    PBRE::vec3 indicatorColor = PBRE::vec3(1.0f, 1.0f, 0.8f);
+                    lightShader.set("color", indicatorColor);
+                    buffers.draw();
+                }
+            });
+
+        // Resolve MSAA to single-sample color. Culled by the graph when the tonemap pass resolves per sample.
+        graph.addPass(
+            "Resolve",
+            [&](RenderGraph::Builder& builder) {
+                builder.read(sceneColor);
+                builder.write(resolvedColor);
+            },
+            [&](RenderGraph::Resources& resources) {
+                glState.bindFramebuffer(GL_READ_FRAMEBUFFER, resources.framebuffer({sceneColor}));
+                glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, resources.framebuffer());
+                glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+            });
+
+        bool fusedResolve = shaderResolve && kSceneSamples > 1;
+        auto tonemapInput = fusedResolve ? sceneColor : resolvedColor;
+        graph.addPass(
+            "Tonemap",
+            [&](RenderGraph::Builder& builder) {
+                builder.read(tonemapInput);
+                builder.write(backbuffer);
+            },
+            [&](RenderGraph::Resources& resources) {
+                // Tonemap to default framebuffer
+                glState.bindFramebuffer(GL_FRAMEBUFFER, resources.framebuffer());
+                glViewport(0, 0, window.getWidth(), window.getHeight());
+                glState.setEnabled(GL_DEPTH_TEST, false);
+                // Tonemap shader outputs gamma-corrected (sRGB) LDR. Ensure the default framebuffer doesn't apply another sRGB conversion.
+                glState.setEnabled(GL_FRAMEBUFFER_SRGB, false);
+                const auto& inputDesc = resources.desc(tonemapInput);
+                auto& post = tonemap[fusedResolve ? 1 : 0];
+                post.use();
+                post.set("uExposure", exposure);
+                post.set("uSamples", inputDesc.samples);
+                post.set("uOverdraw", showOverdraw ? 1 : 0);
+                post.set("uUVScale", PBRE::vec2(static_cast<float>(renderWidth) / inputDesc.width,
+                                                static_cast<float>(renderHeight) / inputDesc.height));
+                post.set("uRenderSize", PBRE::ivec2(renderWidth, renderHeight));
+                post.set("uOutputSize", PBRE::ivec2(window.getWidth(), window.getHeight()));
+                post.set("uUpscale", renderWidth < window.getWidth() ? 1 : 0);
+                glState.bindTexture(0, PBRE::Render::TexturePool::target(inputDesc), resources.texture(tonemapInput));
+                resources.drawFullscreenTriangle();
+            });
+
+        // Capture reads after tonemapping and before the UI is drawn. The HDR capture reads the resolved
+        // color, which keeps the resolve pass alive even when the tonemap pass resolves per sample.
+        if (capture.active() && capture.format() == PBRE::Render::CaptureFormat::Png) {
+            graph.addPass(
+                "Capture",
+                [&](RenderGraph::Builder& builder) {
+                    builder.read(backbuffer);
+                    builder.sideEffect();
+                },
+                [&](RenderGraph::Resources&) { capture.capture(0, window.getWidth(), window.getHeight()); });
+        } else if (capture.active()) {
+            graph.addPass(
+                "Capture",
+                [&](RenderGraph::Builder& builder) {
+                    builder.read(resolvedColor);
+                    builder.sideEffect();
+                },
+                [&](RenderGraph::Resources& resources) { capture.capture(resources.framebuffer({resolvedColor}), renderWidth, renderHeight); });
+        }
+
+        graph.addPass(
+            "UI",
+            [&](RenderGraph::Builder& builder) {
+                builder.write(backbuffer);
+                builder.sideEffect();
+            },
+            [&](RenderGraph::Resources&) { window.renderUI(); });
+
+        graph.compile();
+        graph.execute();
+        ring.endFrame();
+
+        // Pass timings come back a few frames late, so these always see a completed measurement
+        comparison.advance(graph.gpuMs("Scene"), renderWidth, renderHeight);
+        if (dynamicResolution && !comparison.running) dynres.update(graph.gpuMs("Scene"));
+        timings.gpuMs = graph.gpuMs("Scene");
+        if (sweep.running) {
+            if (sweep.advance(timings, scene.renderables().size())) regenerate(sweep.instances);
+            if (!sweep.running) {
+                pacer.mode = pacingBeforeSweep;
+                window.setSwapInterval(pacer.swapInterval());
+                sweep.write(std::cout, '\t');
+                std::ofstream csv("stress_sweep.csv");
+                sweep.write(csv, ',');
+                std::cout << "Wrote stress_sweep.csv\n";
+                if (exitAfterSweep) glfwSetWindowShouldClose(window.getGLFWwindow(), GLFW_TRUE);
+            }
+        }
+
+        pacer.submitted();
+        window.swapBuffers();
+        if (pacer.finishAfterSwap()) glFinish();
+        pacer.presented(graph.gpuMs("Scene") + graph.gpuMs("Resolve") + graph.gpuMs("Tonemap"));
+        glState.endFrame();
+        // The limiter waits before polling, so the next frame's input is as fresh as possible
+        pacer.waitForFrame();
+        window.pollEvents();
+        // Recycles finished readbacks even on frames that don't capture
+        capture.poll();
     }
 
     return 0;
@@ -339,7 +1596,43 @@ int run() {
 
 int main(int argc, char** argv) {
     try {
-        return run();
+        // Created first so this is the thread its main thread (GL) tasks run on
+        PBRE::Core::JobSystem::instance();
+        if (argc >= 2 && std::string_view(argv[1]) == "--bench-load") {
+            return runLoadBenchmark();
+        }
+        if (argc >= 2 && std::string_view(argv[1]) == "--path-trace") {
+            return runPathTrace(argc >= 3 ? std::stoi(argv[2]) : 64, argc >= 4 ? argv[3] : "reference.exr");
+        }
+        if (argc >= 2 && std::string_view(argv[1]) == "--bench-capture") {
+            return runCaptureBenchmark(argc >= 3 ? std::stoi(argv[2]) : 120);
+        }
+        if (argc >= 2 && std::string_view(argv[1]) == "--bench-hdr") {
+            return runHdrBenchmark(argc >= 3 ? std::stoi(argv[2]) : 512);
+        }
+        if (argc >= 2 && std::string_view(argv[1]) == "--bench-jobs") {
+            return runJobBenchmark(argc >= 3 ? std::stoi(argv[2]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+        }
+        if (argc >= 2 && std::string_view(argv[1]) == "--bench-bvh") {
+            return runBvhBenchmark(argc >= 3 ? std::stoul(argv[2]) : 1000000);
+        }
+        if (argc >= 2 && std::string_view(argv[1]) == "--bench-scene") {
+            return runSceneBenchmark(argc >= 3 ? std::stoul(argv[2]) : 1000000);
+        }
+        // --stress [instances] [seed] adds a generated scene, --bench-stress [max instances] [seed] sweeps it
+        if (argc >= 2 && (std::string_view(argv[1]) == "--stress" || std::string_view(argv[1]) == "--bench-stress")) {
+            bool sweep = std::string_view(argv[1]) == "--bench-stress";
+            StressOptions options;
+            size_t instances = argc >= 3 ? std::stoul(argv[2]) : (sweep ? 64000 : 10000);
+            if (sweep) {
+                options.sweepMax = instances;
+            } else {
+                options.instances = instances;
+            }
+            if (argc >= 4) options.seed = static_cast<uint32_t>(std::stoul(argv[3]));
+            return run(options);
+        }
+        return run({});
     } catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << std::endl;
         return -1;
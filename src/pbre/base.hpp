@@ -9,9 +9,11 @@ namespace PBRE {
 using vec2 = glm::vec2;
 using vec3 = glm::vec3;
 using vec4 = glm::vec4;
+using mat3 = glm::mat3;
 using mat4 = glm::mat4;
 using quat = glm::quat;
 using ivec2 = glm::ivec2;
+using ivec4 = glm::ivec4;
 
 enum class Axis {
     X,
@@ -32,6 +34,19 @@ struct Transform {
         return model;
     }
 
+    // Splits an affine TRS matrix (no shear) back into its parts, a mirroring is folded into scale.x
+    static Transform fromMat4(const mat4& m) {
+        Transform t;
+        vec3 c0 = vec3(m[0]), c1 = vec3(m[1]), c2 = vec3(m[2]);
+        t.position = vec3(m[3]);
+        t.scale = vec3(glm::length(c0), glm::length(c1), glm::length(c2));
+        if (glm::dot(glm::cross(c0, c1), c2) < 0.0f) t.scale.x = -t.scale.x;
+        if (t.scale.x != 0.0f && t.scale.y != 0.0f && t.scale.z != 0.0f) {
+            t.rotation = glm::normalize(glm::quat_cast(mat3(c0 / t.scale.x, c1 / t.scale.y, c2 / t.scale.z)));
+        }
+        return t;
+    }
+
     Transform()
         : position(0.0f, 0.0f, 0.0f),
           rotation(1.0f, 0.0f, 0.0f, 0.0f),
@@ -44,16 +59,3 @@ template<typename T, typename... Ts>
 const T* get_if(const std::variant<Ts...>& v) {
     return std::get_if<T>(&v);
 }
-
-#define BIND_MATERIAL_PARAM(material, paramName, uniformName, texUnit, shader, fallbackType) \
-do { \
-    if (auto tex = std::get_if<std::shared_ptr<PBRE::Wrapper::Texture>>(&material.paramName); tex && *tex) { \
-        shader.set("material.has" #uniformName "Map", 1); \
-        shader.set("material." #uniformName "Map", texUnit); \
-        glActiveTexture(GL_TEXTURE0 + texUnit); \
-        (*tex)->bind(texUnit); \
-    } else { \
-        shader.set("material.has" #uniformName "Map", 0); \
-        shader.set("material." #uniformName, std::get<fallbackType>(material.paramName)); \
-    } \
-} while(0)
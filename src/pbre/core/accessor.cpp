@@ -0,0 +1,374 @@
+#include "accessor.hpp"
+
+#include <tiny_gltf.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PBRE_ACCESSOR_SSE 1
+#else
+#define PBRE_ACCESSOR_SSE 0
+#endif
+
+using namespace PBRE;
+
+namespace {
+template <class T> T load(const uint8_t* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T)); // sources are not guaranteed to be aligned
+    return v;
+}
+
+// glTF 2.0 normalized integer decoding, signed types clamp -max - 1 to -1. Multiplies by the reciprocal
+// like the SSE path so both give identical results.
+float readComponent(const uint8_t* p, int componentType, bool normalized) {
+    switch (componentType) {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: return load<float>(p);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: return normalized ? *p * (1.0f / 255.0f) : *p;
+    case TINYGLTF_COMPONENT_TYPE_BYTE: {
+        float v = static_cast<int8_t>(*p);
+        return normalized ? std::max(v * (1.0f / 127.0f), -1.0f) : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+        float v = load<uint16_t>(p);
+        return normalized ? v * (1.0f / 65535.0f) : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_SHORT: {
+        float v = load<int16_t>(p);
+        return normalized ? std::max(v * (1.0f / 32767.0f), -1.0f) : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: return static_cast<float>(load<uint32_t>(p));
+    case TINYGLTF_COMPONENT_TYPE_INT: return static_cast<float>(load<int32_t>(p));
+    case TINYGLTF_COMPONENT_TYPE_DOUBLE: return static_cast<float>(load<double>(p));
+    default: return 0.0f;
+    }
+}
+
+uint32_t readIndex(const uint8_t* p, int componentType) {
+    switch (componentType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: return *p;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: return load<uint16_t>(p);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: return load<uint32_t>(p);
+    default: return 0;
+    }
+}
+
+// Converts n tightly packed values. Returns how many were converted, the caller finishes the tail.
+size_t convertPacked(const uint8_t* src, size_t n, int componentType, bool normalized, float* out) {
+    size_t i = 0;
+#if PBRE_ACCESSOR_SSE
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    auto store = [&](float* dst, __m128i v, __m128 scale, bool clamp) {
+        __m128 f = _mm_cvtepi32_ps(v);
+        if (normalized) {
+            f = _mm_mul_ps(f, scale);
+            if (clamp) f = _mm_max_ps(f, minusOne);
+        }
+        _mm_storeu_ps(dst, f);
+    };
+    switch (componentType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+        const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i lo = _mm_unpacklo_epi8(v, zero);
+            __m128i hi = _mm_unpackhi_epi8(v, zero);
+            store(out + i + 0, _mm_unpacklo_epi16(lo, zero), scale, false);
+            store(out + i + 4, _mm_unpackhi_epi16(lo, zero), scale, false);
+            store(out + i + 8, _mm_unpacklo_epi16(hi, zero), scale, false);
+            store(out + i + 12, _mm_unpackhi_epi16(hi, zero), scale, false);
+        }
+        break;
+    }
+    case TINYGLTF_COMPONENT_TYPE_BYTE: {
+        // Sign extend by duplicating into the high half and shifting back down arithmetically
+        const __m128 scale = _mm_set1_ps(1.0f / 127.0f);
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+            __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+            store(out + i + 0, _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16), scale, true);
+            store(out + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16), scale, true);
+            store(out + i + 8, _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16), scale, true);
+            store(out + i + 12, _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16), scale, true);
+        }
+        break;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+        const __m128 scale = _mm_set1_ps(1.0f / 65535.0f);
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+            store(out + i + 0, _mm_unpacklo_epi16(v, zero), scale, false);
+            store(out + i + 4, _mm_unpackhi_epi16(v, zero), scale, false);
+        }
+        break;
+    }
+    case TINYGLTF_COMPONENT_TYPE_SHORT: {
+        const __m128 scale = _mm_set1_ps(1.0f / 32767.0f);
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+            store(out + i + 0, _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16), scale, true);
+            store(out + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16), scale, true);
+        }
+        break;
+    }
+    default: break;
+    }
+#endif
+    if (componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+        std::memcpy(out, src, n * sizeof(float));
+        return n;
+    }
+    return i;
+}
+
+// Where an element's components sit. The columns of 8 and 16-bit mat2 and mat3 elements start on 4-byte
+// boundaries, so those elements are padded within and between columns.
+struct Layout {
+    size_t componentSize = 0;
+    int columns = 1;
+    int rows = 0;             // components per column
+    size_t columnStride = 0;  // bytes from one column to the next
+    size_t elementSize = 0;   // bytes of an element including the padding
+    bool padded() const { return columnStride != rows * componentSize; }
+};
+
+Layout layoutOf(const tinygltf::Accessor& accessor, const Core::AccessorInfo& info) {
+    Layout layout;
+    layout.componentSize = Core::componentSize(info.componentType);
+    switch (accessor.type) {
+    case TINYGLTF_TYPE_MAT2: layout.columns = 2; break;
+    case TINYGLTF_TYPE_MAT3: layout.columns = 3; break;
+    case TINYGLTF_TYPE_MAT4: layout.columns = 4; break;
+    default: break;
+    }
+    layout.rows = info.components / layout.columns;
+    layout.columnStride = layout.rows * layout.componentSize;
+    if (layout.columns > 1) layout.columnStride = (layout.columnStride + 3) & ~size_t(3);
+    layout.elementSize = layout.columnStride * layout.columns;
+    return layout;
+}
+
+// convertToFloat for padded matrices, a column at a time
+void convertColumns(const uint8_t* src, size_t count, size_t stride, const Layout& layout, int componentType, bool normalized, float* out, int outComponents) {
+    int components = layout.columns * layout.rows;
+    for (size_t e = 0; e < count; ++e) {
+        const uint8_t* element = src + e * stride;
+        float* dst = out + e * outComponents;
+        for (int c = 0; c < std::min(components, outComponents); ++c) {
+            const uint8_t* p = element + (c / layout.rows) * layout.columnStride + (c % layout.rows) * layout.componentSize;
+            dst[c] = readComponent(p, componentType, normalized);
+        }
+        for (int c = components; c < outComponents; ++c) dst[c] = 0.0f;
+    }
+}
+
+struct View {
+    const uint8_t* data = nullptr; // first element, null for accessors without a buffer view
+    size_t stride = 0;
+};
+
+// Resolves and bounds checks where the accessor's elements live
+bool resolveView(const tinygltf::Model& model, const Core::BufferSpans& buffers, const tinygltf::Accessor& accessor, size_t elementSize, View& view) {
+    if (accessor.bufferView < 0) return true; // all zeros, possibly with sparse values on top
+    if (accessor.bufferView >= static_cast<int>(model.bufferViews.size())) return false;
+    const auto& bufferView = model.bufferViews[accessor.bufferView];
+    if (bufferView.buffer < 0 || bufferView.buffer >= static_cast<int>(buffers.size())) return false;
+    const auto& buffer = buffers[bufferView.buffer];
+    if (bufferView.byteOffset + bufferView.byteLength > buffer.size()) return false;
+
+    view.stride = bufferView.byteStride ? bufferView.byteStride : elementSize;
+    if (accessor.count > 0) {
+        size_t end = accessor.byteOffset + (accessor.count - 1) * view.stride + elementSize;
+        if (end > bufferView.byteLength) return false;
+    }
+    view.data = buffer.data() + bufferView.byteOffset + accessor.byteOffset;
+    return true;
+}
+
+// Tightly packed bytes of a sparse indices or values view
+const uint8_t* sparseData(const tinygltf::Model& model, const Core::BufferSpans& buffers, int viewIndex, size_t byteOffset, size_t bytes) {
+    if (viewIndex < 0 || viewIndex >= static_cast<int>(model.bufferViews.size())) return nullptr;
+    const auto& bufferView = model.bufferViews[viewIndex];
+    if (bufferView.buffer < 0 || bufferView.buffer >= static_cast<int>(buffers.size())) return nullptr;
+    const auto& buffer = buffers[bufferView.buffer];
+    if (bufferView.byteOffset + bufferView.byteLength > buffer.size()) return nullptr;
+    if (byteOffset + bytes > bufferView.byteLength) return nullptr;
+    return buffer.data() + bufferView.byteOffset + byteOffset;
+}
+
+// Calls write(element, source) for every sparse substitution
+template <class Write> bool applySparse(const tinygltf::Model& model, const Core::BufferSpans& buffers, const tinygltf::Accessor& accessor, size_t elementSize, Write&& write) {
+    const auto& sparse = accessor.sparse;
+    if (!sparse.isSparse || sparse.count <= 0) return true;
+    size_t count = static_cast<size_t>(sparse.count);
+    int indexType = sparse.indices.componentType;
+    if (indexType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && indexType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT && indexType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) return false;
+    size_t indexSize = Core::componentSize(indexType);
+    const uint8_t* indices = sparseData(model, buffers, sparse.indices.bufferView, sparse.indices.byteOffset, count * indexSize);
+    const uint8_t* values = sparseData(model, buffers, sparse.values.bufferView, sparse.values.byteOffset, count * elementSize);
+    if (!indices || !values) return false;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t element = readIndex(indices + i * indexSize, indexType);
+        if (element >= accessor.count) return false;
+        write(element, values + i * elementSize);
+    }
+    return true;
+}
+} // namespace
+
+Core::BufferSpans Core::ownedBufferSpans(const tinygltf::Model& model) {
+    BufferSpans spans;
+    spans.reserve(model.buffers.size());
+    for (const auto& buffer : model.buffers) spans.emplace_back(buffer.data.data(), buffer.data.size());
+    return spans;
+}
+
+size_t Core::componentSize(int componentType) {
+    switch (componentType) {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: return 1;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: return 2;
+    case TINYGLTF_COMPONENT_TYPE_INT:
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: return 4;
+    case TINYGLTF_COMPONENT_TYPE_DOUBLE: return 8;
+    default: return 0;
+    }
+}
+
+bool Core::accessorInfo(const tinygltf::Model& model, int accessor, AccessorInfo& info) {
+    if (accessor < 0 || accessor >= static_cast<int>(model.accessors.size())) return false;
+    const auto& a = model.accessors[accessor];
+    int components = tinygltf::GetNumComponentsInType(static_cast<uint32_t>(a.type));
+    if (components <= 0 || componentSize(a.componentType) == 0) return false;
+    info.count = a.count;
+    info.components = components;
+    info.componentType = a.componentType;
+    info.normalized = a.normalized;
+    return true;
+}
+
+void Core::convertToFloat(const uint8_t* src, size_t count, size_t stride, int componentType, int components, bool normalized, float* out, int outComponents) {
+    size_t size = componentSize(componentType);
+    size_t elementSize = size * components;
+    if (stride == elementSize && components == outComponents) {
+        size_t n = count * static_cast<size_t>(components);
+        size_t done = convertPacked(src, n, componentType, normalized, out);
+        for (size_t i = done; i < n; ++i) out[i] = readComponent(src + i * size, componentType, normalized);
+        return;
+    }
+
+    int copied = std::min(components, outComponents);
+    for (size_t e = 0; e < count; ++e) {
+        const uint8_t* element = src + e * stride;
+        float* dst = out + e * outComponents;
+        if (componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+            std::memcpy(dst, element, copied * sizeof(float));
+        } else {
+            for (int c = 0; c < copied; ++c) dst[c] = readComponent(element + c * size, componentType, normalized);
+        }
+        for (int c = copied; c < outComponents; ++c) dst[c] = 0.0f;
+    }
+}
+
+bool Core::decodeFloats(const tinygltf::Model& model, const BufferSpans& buffers, int accessor, float* out, int outComponents) {
+    AccessorInfo info;
+    if (!accessorInfo(model, accessor, info)) return false;
+    const auto& a = model.accessors[accessor];
+    Layout layout = layoutOf(a, info);
+    size_t elementSize = layout.elementSize;
+    auto convert = [&](const uint8_t* src, size_t count, size_t stride, float* dst) {
+        if (layout.padded()) {
+            convertColumns(src, count, stride, layout, info.componentType, info.normalized, dst, outComponents);
+        } else {
+            convertToFloat(src, count, stride, info.componentType, info.components, info.normalized, dst, outComponents);
+        }
+    };
+
+    View view;
+    if (!resolveView(model, buffers, a, elementSize, view)) return false;
+    if (view.data) {
+        convert(view.data, info.count, view.stride, out);
+    } else {
+        std::fill(out, out + info.count * outComponents, 0.0f);
+    }
+
+    return applySparse(model, buffers, a, elementSize, [&](uint32_t element, const uint8_t* value) {
+        convert(value, 1, elementSize, out + static_cast<size_t>(element) * outComponents);
+    });
+}
+
+bool Core::decodeIndices(const tinygltf::Model& model, const BufferSpans& buffers, int accessor, uint32_t* out) {
+    AccessorInfo info;
+    if (!accessorInfo(model, accessor, info) || info.components != 1) return false;
+    int type = info.componentType;
+    if (type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT && type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) return false;
+    const auto& a = model.accessors[accessor];
+    size_t size = componentSize(type);
+
+    View view;
+    if (!resolveView(model, buffers, a, size, view)) return false;
+    size_t count = info.count;
+    if (!view.data) {
+        std::fill(out, out + count, 0u);
+    } else if (view.stride != size) {
+        for (size_t i = 0; i < count; ++i) out[i] = readIndex(view.data + i * view.stride, type);
+    } else if (type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+        std::memcpy(out, view.data, count * sizeof(uint32_t));
+    } else {
+        size_t i = 0;
+#if PBRE_ACCESSOR_SSE
+        const __m128i zero = _mm_setzero_si128();
+        if (type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+            for (; i + 8 <= count; i += 8) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(view.data + i * 2));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(v, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(v, zero));
+            }
+        } else {
+            for (; i + 16 <= count; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(view.data + i));
+                __m128i lo = _mm_unpacklo_epi8(v, zero);
+                __m128i hi = _mm_unpackhi_epi8(v, zero);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(lo, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(lo, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpacklo_epi16(hi, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 12), _mm_unpackhi_epi16(hi, zero));
+            }
+        }
+#endif
+        for (; i < count; ++i) out[i] = readIndex(view.data + i * size, type);
+    }
+
+    return applySparse(model, buffers, a, size, [&](uint32_t element, const uint8_t* value) { out[element] = readIndex(value, type); });
+}
+
+std::span<const uint8_t> Core::packedData(const tinygltf::Model& model, const BufferSpans& buffers, int accessor, int componentType, int components) {
+    AccessorInfo info;
+    if (!accessorInfo(model, accessor, info)) return {};
+    const auto& a = model.accessors[accessor];
+    if (a.sparse.isSparse || info.componentType != componentType || info.components != components) return {};
+    Layout layout = layoutOf(a, info);
+    if (layout.padded()) return {};
+    size_t elementSize = layout.elementSize;
+    View view;
+    if (!resolveView(model, buffers, a, elementSize, view) || !view.data || view.stride != elementSize) return {};
+    return {view.data, info.count * elementSize};
+}
+
+std::span<const uint8_t> Core::stridedData(const tinygltf::Model& model, const BufferSpans& buffers, int accessor, size_t& stride) {
+    AccessorInfo info;
+    if (!accessorInfo(model, accessor, info) || info.count == 0) return {};
+    const auto& a = model.accessors[accessor];
+    if (a.sparse.isSparse) return {};
+    size_t elementSize = layoutOf(a, info).elementSize;
+    View view;
+    if (!resolveView(model, buffers, a, elementSize, view) || !view.data) return {};
+    stride = view.stride;
+    return {view.data, (info.count - 1) * view.stride + elementSize};
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace tinygltf {
+class Model;
+}
+
+namespace PBRE::Core {
+struct AccessorInfo {
+    size_t count = 0;
+    int components = 0;    // 1 for SCALAR .. 16 for MAT4
+    int componentType = 0; // TINYGLTF_COMPONENT_TYPE_*
+    bool normalized = false;
+};
+
+// Bytes of each glTF buffer, indexed like tinygltf::Model::buffers. Normally the buffers tinygltf loaded, but
+// the loader can point them at a file mapping instead.
+using BufferSpans = std::vector<std::span<const uint8_t>>;
+BufferSpans ownedBufferSpans(const tinygltf::Model& model);
+
+// Size in bytes of a glTF component type, 0 if unknown
+size_t componentSize(int componentType);
+
+bool accessorInfo(const tinygltf::Model& model, int accessor, AccessorInfo& info);
+
+// Decodes any accessor to floats, honouring the buffer view stride, normalized integer types, the column
+// padding of 8 and 16-bit matrices and sparse substitution. Writes info.count * outComponents floats; components the accessor lacks are zero and
+// extra ones are dropped. Returns false for out of range or malformed accessors.
+bool decodeFloats(const tinygltf::Model& model, const BufferSpans& buffers, int accessor, float* out, int outComponents);
+
+// Decodes an unsigned byte/short/int scalar accessor to 32-bit indices
+bool decodeIndices(const tinygltf::Model& model, const BufferSpans& buffers, int accessor, uint32_t* out);
+
+// The accessor's bytes when they are tightly packed, non-sparse and already of the requested layout, so
+// they can be uploaded as is. Empty otherwise.
+std::span<const uint8_t> packedData(const tinygltf::Model& model, const BufferSpans& buffers, int accessor, int componentType, int components);
+
+// The accessor's bytes in place, from the first element to the end of the last, with stride set to the
+// distance between elements. Empty for sparse accessors and ones without a buffer view.
+std::span<const uint8_t> stridedData(const tinygltf::Model& model, const BufferSpans& buffers, int accessor, size_t& stride);
+
+// Converts count elements of components values each, stride bytes apart, to floats. Packed 8 and 16-bit
+// inputs and float inputs take SSE2 or memcpy paths.
+void convertToFloat(const uint8_t* src, size_t count, size_t stride, int componentType, int components, bool normalized, float* out, int outComponents);
+} // namespace PBRE::Core
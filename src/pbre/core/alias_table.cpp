@@ -0,0 +1,47 @@
+#include "alias_table.hpp"
+
+#include <algorithm>
+
+using namespace PBRE;
+
+bool Core::AliasTable::build(std::span<const float> weights) {
+    size_t n = weights.size();
+    slots_.assign(n, {1.0f, 0});
+    probabilities_.assign(n, 0.0f);
+    total_ = 0.0;
+    for (float w : weights) total_ += std::max(w, 0.0f);
+    if (n == 0 || total_ <= 0.0) {
+        slots_.clear();
+        probabilities_.clear();
+        return false;
+    }
+
+    // Scaled so the average slot holds 1, then small slots are topped up from large ones
+    std::vector<double> scaled(n);
+    std::vector<uint32_t> small, large;
+    for (size_t i = 0; i < n; ++i) {
+        double p = std::max(weights[i], 0.0f) / total_;
+        probabilities_[i] = static_cast<float>(p);
+        scaled[i] = p * n;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+    }
+    while (!small.empty() && !large.empty()) {
+        uint32_t s = small.back(), l = large.back();
+        small.pop_back();
+        slots_[s] = {static_cast<float>(scaled[s]), l};
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // Whatever is left is 1 up to rounding
+    for (uint32_t i : small) slots_[i] = {1.0f, i};
+    for (uint32_t i : large) slots_[i] = {1.0f, i};
+    return true;
+}
+
+size_t Core::AliasTable::sample(float u1, float u2) const {
+    size_t i = std::min(static_cast<size_t>(u1 * slots_.size()), slots_.size() - 1);
+    return u2 < slots_[i].threshold ? i : slots_[i].alias;
+}
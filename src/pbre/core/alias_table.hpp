@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace PBRE::Core {
+// Walker/Vose alias table: draws index i with probability weights[i] / sum in constant time
+class AliasTable {
+  public:
+    // Negative weights count as zero. Returns false if every weight is zero.
+    bool build(std::span<const float> weights);
+
+    // u1 picks the slot, u2 picks between the slot and its alias, both in [0, 1)
+    size_t sample(float u1, float u2) const;
+    // Probability of drawing i
+    float probability(size_t i) const { return i < probabilities_.size() ? probabilities_[i] : 0.0f; }
+    size_t size() const { return slots_.size(); }
+    double total() const { return total_; }
+
+  private:
+    struct Slot {
+        float threshold; // keep the slot when u2 < threshold, else take the alias
+        uint32_t alias;
+    };
+    std::vector<Slot> slots_;
+    std::vector<float> probabilities_;
+    double total_ = 0.0;
+};
+} // namespace PBRE::Core
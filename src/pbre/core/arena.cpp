@@ -0,0 +1,38 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace PBRE;
+
+Core::LinearArena::LinearArena(size_t blockBytes) : blockBytes_(blockBytes) {}
+
+void* Core::LinearArena::allocate(size_t bytes, size_t alignment) {
+    if (!blocks_.empty()) {
+        auto& block = blocks_.back();
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+        size_t start = ((base + offset_ + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+        if (start + bytes <= block.size) {
+            offset_ = start + bytes;
+            used_ += bytes;
+            peak_ = std::max(peak_, used_);
+            return block.data.get() + start;
+        }
+    }
+    // Allocations bigger than a block get one of their own; what's left of the current block is abandoned
+    size_t size = std::max(blockBytes_, bytes + alignment);
+    // Left uninitialized, pages only become resident once something is written to them
+    blocks_.push_back({std::unique_ptr<std::byte[]>(new std::byte[size]), size});
+    reserved_ += size;
+    offset_ = 0;
+    return allocate(bytes, alignment);
+}
+
+void Core::LinearArena::reset() {
+    bool keepFirst = !blocks_.empty() && blocks_.front().size == blockBytes_;
+    blocks_.erase(blocks_.begin() + (keepFirst ? 1 : 0), blocks_.end());
+    reserved_ = keepFirst ? blockBytes_ : 0;
+    offset_ = 0;
+    used_ = 0;
+    peak_ = 0;
+}
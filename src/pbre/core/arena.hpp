@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace PBRE::Core {
+// Bump allocator for load time scratch. Allocations are carved out of large blocks and are only freed all
+// at once by reset(). Not thread safe, each load uses its own arena.
+class LinearArena {
+  public:
+    explicit LinearArena(size_t blockBytes = size_t(4) << 20);
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+    // Uninitialized storage for count elements
+    template <class T> std::span<T> allocateArray(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+        if (count == 0) return {};
+        return {static_cast<T*>(allocate(count * sizeof(T), alignof(T))), count};
+    }
+    template <class T> std::span<T> copy(std::span<const T> source) {
+        auto out = allocateArray<T>(source.size());
+        std::copy(source.begin(), source.end(), out.begin());
+        return out;
+    }
+
+    // Frees everything allocated since the last reset. One standard block is kept for the next load,
+    // oversized blocks are returned to the system.
+    void reset();
+
+    size_t usedBytes() const { return used_; }
+    size_t peakBytes() const { return peak_; } // since the last reset
+    size_t reservedBytes() const { return reserved_; }
+
+  private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    std::vector<Block> blocks_; // the last one is being carved
+    size_t blockBytes_;
+    size_t offset_ = 0; // into the last block
+    size_t used_ = 0;
+    size_t peak_ = 0;
+    size_t reserved_ = 0;
+};
+} // namespace PBRE::Core
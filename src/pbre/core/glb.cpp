@@ -0,0 +1,45 @@
+#include "glb.hpp"
+
+#include <cstring>
+
+using namespace PBRE;
+
+namespace {
+constexpr uint32_t kMagic = 0x46546C67;     // "glTF"
+constexpr uint32_t kChunkJson = 0x4E4F534A; // "JSON"
+constexpr uint32_t kChunkBin = 0x004E4942;  // "BIN\0"
+
+uint32_t readU32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v)); // little endian like every platform we target
+    return v;
+}
+} // namespace
+
+bool Core::isGlb(std::span<const uint8_t> file) {
+    return file.size() >= 12 && readU32(file.data()) == kMagic;
+}
+
+bool Core::parseGlb(std::span<const uint8_t> file, GlbChunks& chunks) {
+    if (!isGlb(file) || readU32(file.data() + 4) != 2) return false;
+    size_t length = readU32(file.data() + 8);
+    if (length > file.size()) return false;
+
+    chunks = {};
+    bool haveJson = false;
+    for (size_t offset = 12; offset + 8 <= length;) {
+        size_t chunkLength = readU32(file.data() + offset);
+        uint32_t type = readU32(file.data() + offset + 4);
+        offset += 8;
+        if (chunkLength > length - offset) return false;
+        const uint8_t* data = file.data() + offset;
+        if (type == kChunkJson && !haveJson) {
+            chunks.json = {reinterpret_cast<const char*>(data), chunkLength};
+            haveJson = true;
+        } else if (type == kChunkBin && chunks.bin.empty()) {
+            chunks.bin = {data, chunkLength};
+        }
+        offset += (chunkLength + 3) & ~size_t(3); // chunks are 4-byte aligned
+    }
+    return haveJson;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace PBRE::Core {
+// Chunks of a binary glTF container, pointing into the file's bytes
+struct GlbChunks {
+    std::string_view json;
+    std::span<const uint8_t> bin; // empty if the file has no BIN chunk
+};
+
+bool isGlb(std::span<const uint8_t> file);
+// Validates the header and chunk table, returns false for truncated or malformed files
+bool parseGlb(std::span<const uint8_t> file, GlbChunks& chunks);
+} // namespace PBRE::Core
@@ -0,0 +1,445 @@
+#include "hdr_compress.hpp"
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <mutex>
+
+using namespace PBRE;
+
+namespace {
+// BC6H mode 11: one region, two 10-bit endpoints, 4-bit indices
+constexpr int kWeights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+constexpr int kEndpointBits = 10;
+constexpr int kMaxEndpoint = (1 << kEndpointBits) - 1;
+constexpr uint16_t kMaxHalf = 0x7BFF; // 65504, the largest value unsigned BC6H decodes to
+
+constexpr uint32_t kCacheMagic = 0x43524448; // "HDRC"
+constexpr uint32_t kCacheVersion = 1;
+
+struct CacheHeader {
+    uint32_t magic = kCacheMagic;
+    uint32_t version = kCacheVersion;
+    uint32_t format = 0;
+    uint32_t faceSize = 0;
+    uint32_t levels = 0;
+    uint32_t images = 0;
+    uint64_t sourceBytes = 0;
+    int64_t sourceTime = 0;
+    double meanStops = 0.0;
+    double maxStops = 0.0;
+    double encodeMs = 0.0;
+};
+
+struct BlockFit {
+    int endpoints[2][3] = {};
+    uint8_t indices[16] = {};
+    int64_t error = std::numeric_limits<int64_t>::max();
+};
+
+int unquantize(int q) {
+    if (q == 0) return 0;
+    if (q == kMaxEndpoint) return 0xFFFF;
+    return ((q << 16) + 0x8000) >> kEndpointBits;
+}
+
+// Nearest endpoint for a value of the 16-bit unquantized range, where unquantize(q) = 64 * q + 32
+int quantize(float u) {
+    return std::clamp(static_cast<int>(std::lround((u - 32.0f) / 64.0f)), 0, kMaxEndpoint);
+}
+
+// Half float bits the hardware produces for each index
+void palette(const int endpoints[2][3], int colors[16][3]) {
+    for (int c = 0; c < 3; ++c) {
+        int a = unquantize(endpoints[0][c]), b = unquantize(endpoints[1][c]);
+        for (int i = 0; i < 16; ++i) colors[i][c] = ((((64 - kWeights[i]) * a + kWeights[i] * b + 32) >> 6) * 31) >> 6;
+    }
+}
+
+int64_t assignIndices(const int texels[16][3], BlockFit& fit) {
+    int colors[16][3];
+    palette(fit.endpoints, colors);
+    int64_t total = 0;
+    for (int t = 0; t < 16; ++t) {
+        int64_t best = std::numeric_limits<int64_t>::max();
+        for (int i = 0; i < 16; ++i) {
+            int64_t error = 0;
+            for (int c = 0; c < 3; ++c) {
+                int64_t d = colors[i][c] - texels[t][c];
+                error += d * d;
+            }
+            if (error < best) {
+                best = error;
+                fit.indices[t] = static_cast<uint8_t>(i);
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+BlockFit fitBlock(const int texels[16][3]) {
+    // Half bits h come out of the unquantized endpoint range as u * 31 / 64, so the fit works on h * 64 / 31
+    float points[16][3];
+    float mean[3] = {};
+    for (int t = 0; t < 16; ++t) {
+        for (int c = 0; c < 3; ++c) {
+            points[t][c] = texels[t][c] * (64.0f / 31.0f);
+            mean[c] += points[t][c] / 16.0f;
+        }
+    }
+    float cov[3][3] = {};
+    for (int t = 0; t < 16; ++t) {
+        float d[3] = {points[t][0] - mean[0], points[t][1] - mean[1], points[t][2] - mean[2]};
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) cov[i][j] += d[i] * d[j];
+        }
+    }
+    // Principal axis by power iteration
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[3];
+        for (int i = 0; i < 3; ++i) next[i] = cov[i][0] * axis[0] + cov[i][1] * axis[1] + cov[i][2] * axis[2];
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f) break;
+        for (int i = 0; i < 3; ++i) axis[i] = next[i] / length;
+    }
+    float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (float& a : axis) a /= axisLength;
+    float lo = std::numeric_limits<float>::max(), hi = std::numeric_limits<float>::lowest();
+    for (int t = 0; t < 16; ++t) {
+        float projected = (points[t][0] - mean[0]) * axis[0] + (points[t][1] - mean[1]) * axis[1] + (points[t][2] - mean[2]) * axis[2];
+        lo = std::min(lo, projected);
+        hi = std::max(hi, projected);
+    }
+
+    BlockFit fit;
+    for (int c = 0; c < 3; ++c) {
+        fit.endpoints[0][c] = quantize(std::clamp(mean[c] + axis[c] * lo, 0.0f, 65535.0f));
+        fit.endpoints[1][c] = quantize(std::clamp(mean[c] + axis[c] * hi, 0.0f, 65535.0f));
+    }
+    fit.error = assignIndices(texels, fit);
+
+    // Least squares endpoints for the chosen indices, kept while they lower the error
+    for (int iteration = 0; iteration < 2 && fit.error > 0; ++iteration) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f, ap[3] = {}, bp[3] = {};
+        for (int t = 0; t < 16; ++t) {
+            float w = kWeights[fit.indices[t]] / 64.0f;
+            aa += (1.0f - w) * (1.0f - w);
+            ab += (1.0f - w) * w;
+            bb += w * w;
+            for (int c = 0; c < 3; ++c) {
+                ap[c] += (1.0f - w) * points[t][c];
+                bp[c] += w * points[t][c];
+            }
+        }
+        float det = aa * bb - ab * ab;
+        if (std::abs(det) < 1e-6f) break;
+        BlockFit refined;
+        for (int c = 0; c < 3; ++c) {
+            refined.endpoints[0][c] = quantize(std::clamp((bb * ap[c] - ab * bp[c]) / det, 0.0f, 65535.0f));
+            refined.endpoints[1][c] = quantize(std::clamp((aa * bp[c] - ab * ap[c]) / det, 0.0f, 65535.0f));
+        }
+        refined.error = assignIndices(texels, refined);
+        if (refined.error >= fit.error) break;
+        fit = refined;
+    }
+
+    // The first index is stored without its top bit, the weights are symmetric so swapping the endpoints flips it
+    if (fit.indices[0] >= 8) {
+        for (int c = 0; c < 3; ++c) std::swap(fit.endpoints[0][c], fit.endpoints[1][c]);
+        for (auto& index : fit.indices) index = static_cast<uint8_t>(15 - index);
+    }
+    return fit;
+}
+
+void writeBlock(const BlockFit& fit, uint8_t* out) {
+    std::memset(out, 0, 16);
+    int bit = 0;
+    auto put = [&](uint32_t value, int count) {
+        for (int i = 0; i < count; ++i, ++bit) {
+            if ((value >> i) & 1u) out[bit >> 3] |= static_cast<uint8_t>(1u << (bit & 7));
+        }
+    };
+    put(0x03, 5); // mode 11
+    for (int e = 0; e < 2; ++e) {
+        for (int c = 0; c < 3; ++c) put(static_cast<uint32_t>(fit.endpoints[e][c]), kEndpointBits);
+    }
+    put(fit.indices[0], 3);
+    for (int t = 1; t < 16; ++t) put(fit.indices[t], 4);
+}
+
+uint16_t halfBits(float value) {
+    if (!(value > 0.0f)) return 0;
+    return std::min(Core::floatToHalf(value), kMaxHalf);
+}
+
+int mipLevels(int size) {
+    int levels = 1;
+    while (size > 1) {
+        size /= 2;
+        ++levels;
+    }
+    return levels;
+}
+
+size_t imageBytes(Core::HdrFormat format, int size) {
+    return format == Core::HdrFormat::BC6H ? Core::bc6hBytes(size, size) : static_cast<size_t>(size) * size * 4;
+}
+
+float luminance(const float* rgb) {
+    return 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2];
+}
+
+bool sourceStamp(const std::string& path, uint64_t& bytes, int64_t& time) {
+    std::error_code error;
+    bytes = std::filesystem::file_size(path, error);
+    if (error) return false;
+    auto written = std::filesystem::last_write_time(path, error);
+    if (error) return false;
+    time = static_cast<int64_t>(written.time_since_epoch().count());
+    return true;
+}
+} // namespace
+
+uint16_t Core::floatToHalf(float value) {
+    uint32_t bits = std::bit_cast<uint32_t>(value);
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    bits &= 0x7FFFFFFFu;
+    uint32_t half;
+    if (bits >= 0x47800000u) {
+        // Overflow to infinity, NaN stays NaN
+        half = bits > 0x7F800000u ? 0x7E00u : 0x7C00u;
+    } else if (bits < 0x38800000u) {
+        // Subnormal: let the float adder round the mantissa into place
+        float shifted = std::bit_cast<float>(bits) + std::bit_cast<float>(126u << 23);
+        half = std::bit_cast<uint32_t>(shifted) - (126u << 23);
+    } else {
+        uint32_t odd = (bits >> 13) & 1u;
+        bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xFFFu + odd;
+        half = bits >> 13;
+    }
+    return static_cast<uint16_t>(half | sign);
+}
+
+float Core::halfToFloat(uint16_t half) {
+    uint32_t bits = static_cast<uint32_t>(half & 0x7FFFu) << 13;
+    uint32_t exponent = bits & (0x7C00u << 13);
+    bits += static_cast<uint32_t>(127 - 15) << 23;
+    if (exponent == (0x7C00u << 13)) {
+        bits += static_cast<uint32_t>(128 - 16) << 23; // infinity or NaN
+    } else if (exponent == 0) {
+        bits += 1u << 23; // subnormal, renormalized by the subtraction
+        bits = std::bit_cast<uint32_t>(std::bit_cast<float>(bits) - std::bit_cast<float>(113u << 23));
+    }
+    return std::bit_cast<float>(bits | (static_cast<uint32_t>(half & 0x8000u) << 16));
+}
+
+// EXT_texture_shared_exponent's encoding
+uint32_t Core::packRGB9E5(const float* rgb) {
+    constexpr int kMantissaBits = 9, kBias = 15;
+    constexpr float kMaxValue = 511.0f / 512.0f * 65536.0f;
+    float c[3];
+    for (int i = 0; i < 3; ++i) c[i] = rgb[i] > 0.0f ? std::min(rgb[i], kMaxValue) : 0.0f;
+    float maxc = std::max({c[0], c[1], c[2]});
+    int exponent = 0;
+    if (maxc > 0.0f) {
+        int e = 0;
+        std::frexp(maxc, &e); // maxc = m * 2^e with m in [0.5, 1)
+        exponent = std::max(-kBias - 1, e - 1) + 1 + kBias;
+    }
+    float scale = std::ldexp(1.0f, exponent - kBias - kMantissaBits);
+    if (static_cast<int>(std::floor(maxc / scale + 0.5f)) == (1 << kMantissaBits)) {
+        ++exponent;
+        scale *= 2.0f;
+    }
+    uint32_t packed = static_cast<uint32_t>(exponent) << 27;
+    for (int i = 0; i < 3; ++i) {
+        uint32_t mantissa = std::min(static_cast<uint32_t>(std::floor(c[i] / scale + 0.5f)), (1u << kMantissaBits) - 1u);
+        packed |= mantissa << (kMantissaBits * i);
+    }
+    return packed;
+}
+
+void Core::unpackRGB9E5(uint32_t packed, float* rgb) {
+    float scale = std::ldexp(1.0f, static_cast<int>(packed >> 27) - 15 - 9);
+    for (int i = 0; i < 3; ++i) rgb[i] = static_cast<float>((packed >> (9 * i)) & 0x1FFu) * scale;
+}
+
+size_t Core::bc6hBytes(int width, int height) {
+    return static_cast<size_t>((width + 3) / 4) * static_cast<size_t>((height + 3) / 4) * 16;
+}
+
+void Core::encodeBC6H(const float* rgb, int width, int height, uint8_t* blocks, float* decoded) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    parallelFor(static_cast<size_t>(blocksY), 1, [&](size_t begin, size_t end) {
+        for (size_t by = begin; by < end; ++by) {
+            for (int bx = 0; bx < blocksX; ++bx) {
+                int texels[16][3];
+                for (int t = 0; t < 16; ++t) {
+                    int px = std::min(bx * 4 + t % 4, width - 1);
+                    int py = std::min(static_cast<int>(by) * 4 + t / 4, height - 1);
+                    const float* src = rgb + (static_cast<size_t>(py) * width + px) * 3;
+                    for (int c = 0; c < 3; ++c) texels[t][c] = halfBits(src[c]);
+                }
+                BlockFit fit = fitBlock(texels);
+                writeBlock(fit, blocks + (by * blocksX + bx) * 16);
+                if (!decoded) continue;
+                int colors[16][3];
+                palette(fit.endpoints, colors);
+                for (int t = 0; t < 16; ++t) {
+                    int px = bx * 4 + t % 4, py = static_cast<int>(by) * 4 + t / 4;
+                    if (px >= width || py >= height) continue;
+                    float* dst = decoded + (static_cast<size_t>(py) * width + px) * 3;
+                    for (int c = 0; c < 3; ++c) dst[c] = halfToFloat(static_cast<uint16_t>(colors[fit.indices[t]][c]));
+                }
+            }
+        }
+    });
+}
+
+size_t Core::CompressedCubemap::bytes() const {
+    size_t total = 0;
+    for (const auto& image : images) total += image.size();
+    return total;
+}
+
+bool Core::CompressedCubemap::load(const std::string& path, const std::string& sourcePath, HdrFormat expectedFormat, int expectedFaceSize) {
+    images.clear();
+    uint64_t sourceBytes = 0;
+    int64_t sourceTime = 0;
+    if (!sourceStamp(sourcePath, sourceBytes, sourceTime)) return false;
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != kCacheMagic || header.version != kCacheVersion ||
+        header.format != static_cast<uint32_t>(expectedFormat) || header.faceSize != static_cast<uint32_t>(expectedFaceSize) ||
+        header.levels != static_cast<uint32_t>(mipLevels(expectedFaceSize)) || header.images != header.levels * 6 ||
+        header.sourceBytes != sourceBytes || header.sourceTime != sourceTime) {
+        return false;
+    }
+    for (uint32_t i = 0; i < header.images; ++i) {
+        int size = std::max(1, expectedFaceSize >> (i / 6));
+        uint64_t bytes = 0;
+        if (!file.read(reinterpret_cast<char*>(&bytes), sizeof(bytes)) || bytes != imageBytes(expectedFormat, size)) {
+            images.clear();
+            return false;
+        }
+        auto& image = images.emplace_back(bytes);
+        if (!file.read(reinterpret_cast<char*>(image.data()), static_cast<std::streamsize>(bytes))) {
+            images.clear();
+            return false;
+        }
+    }
+    format = expectedFormat;
+    faceSize = expectedFaceSize;
+    levels = static_cast<int>(header.levels);
+    meanStops = header.meanStops;
+    maxStops = header.maxStops;
+    encodeMs = header.encodeMs;
+    return true;
+}
+
+bool Core::CompressedCubemap::save(const std::string& path, const std::string& sourcePath) const {
+    CacheHeader header;
+    if (!sourceStamp(sourcePath, header.sourceBytes, header.sourceTime)) return false;
+    header.format = static_cast<uint32_t>(format);
+    header.faceSize = static_cast<uint32_t>(faceSize);
+    header.levels = static_cast<uint32_t>(levels);
+    header.images = static_cast<uint32_t>(images.size());
+    header.meanStops = meanStops;
+    header.maxStops = maxStops;
+    header.encodeMs = encodeMs;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& image : images) {
+        uint64_t bytes = image.size();
+        file.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+        file.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(bytes));
+    }
+    return static_cast<bool>(file);
+}
+
+Core::CompressedCubemap Core::compressCubemap(std::span<const float> faces, int faceSize, HdrFormat format) {
+    auto start = std::chrono::steady_clock::now();
+    CompressedCubemap result;
+    result.format = format;
+    result.faceSize = faceSize;
+    result.levels = mipLevels(faceSize);
+
+    std::vector<float> level(faces.begin(), faces.end());
+    std::vector<float> decoded;
+    double stopsSum = 0.0;
+    size_t texelCount = 0;
+    std::mutex errorMutex;
+    int size = faceSize;
+    for (int l = 0; l < result.levels; ++l) {
+        if (l > 0) {
+            // 2x2 box filter, clamped at the edge of odd sizes
+            int next = std::max(1, size / 2);
+            std::vector<float> smaller(static_cast<size_t>(next) * next * 3 * 6);
+            parallelFor(static_cast<size_t>(6) * next, 16, [&](size_t begin, size_t end) {
+                for (size_t row = begin; row < end; ++row) {
+                    size_t f = row / next;
+                    int y = static_cast<int>(row % next);
+                    const float* src = level.data() + static_cast<size_t>(size) * size * 3 * f;
+                    float* dst = smaller.data() + static_cast<size_t>(next) * next * 3 * f;
+                    for (int x = 0; x < next; ++x) {
+                        int x0 = std::min(2 * x, size - 1), x1 = std::min(2 * x + 1, size - 1);
+                        int y0 = std::min(2 * y, size - 1), y1 = std::min(2 * y + 1, size - 1);
+                        for (int c = 0; c < 3; ++c) {
+                            float sum = src[(static_cast<size_t>(y0) * size + x0) * 3 + c] + src[(static_cast<size_t>(y0) * size + x1) * 3 + c] +
+                                        src[(static_cast<size_t>(y1) * size + x0) * 3 + c] + src[(static_cast<size_t>(y1) * size + x1) * 3 + c];
+                            dst[(static_cast<size_t>(y) * next + x) * 3 + c] = sum * 0.25f;
+                        }
+                    }
+                }
+            });
+            level = std::move(smaller);
+            size = next;
+        }
+
+        size_t faceFloats = static_cast<size_t>(size) * size * 3;
+        decoded.resize(faceFloats);
+        for (int f = 0; f < 6; ++f) {
+            const float* face = level.data() + faceFloats * f;
+            auto& image = result.images.emplace_back(imageBytes(format, size));
+            if (format == HdrFormat::BC6H) {
+                encodeBC6H(face, size, size, image.data(), decoded.data());
+            } else {
+                auto* texels = reinterpret_cast<uint32_t*>(image.data());
+                parallelFor(static_cast<size_t>(size), 16, [&](size_t begin, size_t end) {
+                    for (size_t t = begin * size; t < end * size; ++t) {
+                        texels[t] = packRGB9E5(face + t * 3);
+                        unpackRGB9E5(texels[t], decoded.data() + t * 3);
+                    }
+                });
+            }
+            // A floor keeps near black texels from dominating the ratio
+            constexpr float kFloor = 1e-3f;
+            parallelFor(static_cast<size_t>(size), 16, [&](size_t begin, size_t end) {
+                double sum = 0.0, worst = 0.0;
+                for (size_t t = begin * size; t < end * size; ++t) {
+                    double stops = std::abs(std::log2((luminance(decoded.data() + t * 3) + kFloor) / (luminance(face + t * 3) + kFloor)));
+                    sum += stops;
+                    worst = std::max(worst, stops);
+                }
+                std::lock_guard lock(errorMutex);
+                stopsSum += sum;
+                result.maxStops = std::max(result.maxStops, worst);
+            });
+            texelCount += static_cast<size_t>(size) * size;
+        }
+    }
+    result.meanStops = texelCount > 0 ? stopsSum / static_cast<double>(texelCount) : 0.0;
+    result.encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
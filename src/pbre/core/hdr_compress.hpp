@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace PBRE::Core {
+// IEEE half floats, rounded to nearest even
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t half);
+
+// GL_RGB9_E5 texels (GL_UNSIGNED_INT_5_9_9_9_REV), negative and NaN inputs become 0
+uint32_t packRGB9E5(const float* rgb);
+void unpackRGB9E5(uint32_t packed, float* rgb);
+
+// BC6H unsigned (GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT) blocks of an RGB float image, rows top to bottom.
+// Every block uses mode 11, one region with 10-bit endpoints, which the encoder fits along the block's
+// principal axis in half float bit space and refines by least squares. Edge blocks repeat the last row and
+// column. decoded, if given, receives what the GPU will sample (3 floats per pixel). Block rows run in parallel.
+void encodeBC6H(const float* rgb, int width, int height, uint8_t* blocks, float* decoded = nullptr);
+size_t bc6hBytes(int width, int height);
+
+enum class HdrFormat : uint32_t {
+    BC6H,
+    RGB9E5,
+};
+
+// The full mip chain of a cubemap in one of the HdrFormats, images level major (level * 6 + face)
+struct CompressedCubemap {
+    HdrFormat format = HdrFormat::BC6H;
+    int faceSize = 0;
+    int levels = 0;
+    std::vector<std::vector<uint8_t>> images;
+    // Luminance error against the float faces over every texel of every level, in stops (log2 ratio)
+    double meanStops = 0.0;
+    double maxStops = 0.0;
+    double encodeMs = 0.0;
+
+    size_t bytes() const;
+    // Cached next to the source, valid while the source's size and modification time match. A missing or
+    // stale file returns false.
+    bool load(const std::string& path, const std::string& sourcePath, HdrFormat expectedFormat, int expectedFaceSize);
+    bool save(const std::string& path, const std::string& sourcePath) const;
+};
+
+// Box filters the mip chain and encodes every level. faces are 6 square faces of 3 floats per texel.
+CompressedCubemap compressCubemap(std::span<const float> faces, int faceSize, HdrFormat format);
+} // namespace PBRE::Core
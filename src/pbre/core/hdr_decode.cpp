@@ -0,0 +1,379 @@
+#include "hdr_decode.hpp"
+
+#include "hdr_compress.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PBRE_HDR_SSE 1
+#else
+#define PBRE_HDR_SSE 0
+#endif
+
+using namespace PBRE;
+
+namespace {
+// Pages of the mapping walked by open() are dropped in steps of this size
+constexpr size_t kReleaseStep = size_t(4) << 20;
+
+bool isRle(const uint8_t* p, const uint8_t* end, int width) {
+    return width >= 8 && width < 32768 && end - p >= 4 && p[0] == 2 && p[1] == 2 && (p[2] & 0x80) == 0;
+}
+
+// m * 2^(e - 136) like stbi__hdr_convert, built as (m / 256) * 2^(e - 128) so the scale is a normal float
+float rgbeComponent(uint8_t m, uint8_t e) {
+    if (e <= 1) return 0.0f;
+    return (m * (1.0f / 256.0f)) * std::bit_cast<float>(static_cast<uint32_t>(e - 1) << 23);
+}
+
+// Planar RGBE bytes of a row to interleaved RGB floats
+void convertRow(const uint8_t* planes, int width, float* out) {
+    const uint8_t* r = planes;
+    const uint8_t* g = planes + width;
+    const uint8_t* b = planes + 2 * width;
+    const uint8_t* e = planes + 3 * width;
+    int x = 0;
+#if PBRE_HDR_SSE
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 inv256 = _mm_set1_ps(1.0f / 256.0f);
+    auto widen = [&](const uint8_t* p) {
+        int32_t bytes;
+        std::memcpy(&bytes, p, 4);
+        return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+    };
+    for (; x + 4 <= width; x += 4) {
+        __m128i exponent = widen(e + x);
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(exponent, _mm_set1_epi32(1)), 23));
+        scale = _mm_and_ps(scale, _mm_castsi128_ps(_mm_cmpgt_epi32(exponent, _mm_set1_epi32(1))));
+        scale = _mm_mul_ps(scale, inv256);
+        __m128 rs = _mm_mul_ps(_mm_cvtepi32_ps(widen(r + x)), scale);
+        __m128 gs = _mm_mul_ps(_mm_cvtepi32_ps(widen(g + x)), scale);
+        __m128 bs = _mm_mul_ps(_mm_cvtepi32_ps(widen(b + x)), scale);
+        // Planar to r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+        __m128 rg = _mm_unpacklo_ps(rs, gs), rgHigh = _mm_unpackhi_ps(rs, gs);
+        __m128 br = _mm_unpacklo_ps(bs, rs), brHigh = _mm_unpackhi_ps(bs, rs);
+        __m128 gb = _mm_unpacklo_ps(gs, bs), gbHigh = _mm_unpackhi_ps(gs, bs);
+        float* dst = out + static_cast<size_t>(x) * 3;
+        _mm_storeu_ps(dst, _mm_shuffle_ps(rg, br, _MM_SHUFFLE(3, 0, 1, 0)));
+        _mm_storeu_ps(dst + 4, _mm_shuffle_ps(gb, rgHigh, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_storeu_ps(dst + 8, _mm_shuffle_ps(brHigh, gbHigh, _MM_SHUFFLE(3, 2, 3, 0)));
+    }
+#endif
+    for (; x < width; ++x) {
+        out[x * 3 + 0] = rgbeComponent(r[x], e[x]);
+        out[x * 3 + 1] = rgbeComponent(g[x], e[x]);
+        out[x * 3 + 2] = rgbeComponent(b[x], e[x]);
+    }
+}
+
+// Same as Core::floatToHalf for the non-negative values RGBE holds
+#if PBRE_HDR_SSE
+__m128i halves(__m128 values) {
+    __m128i bits = _mm_castps_si128(values);
+    __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+    __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(static_cast<int>(0xC8000FFFu))), odd), 13);
+    const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(126 << 23));
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(values, magic)), _mm_set1_epi32(126 << 23));
+    __m128i isSubnormal = _mm_cmplt_epi32(bits, _mm_set1_epi32(0x38800000));
+    __m128i isOverflow = _mm_cmpgt_epi32(bits, _mm_set1_epi32(0x477FFFFF));
+    __m128i result = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+    return _mm_or_si128(_mm_and_si128(isOverflow, _mm_set1_epi32(0x7C00)), _mm_andnot_si128(isOverflow, result));
+}
+#endif
+
+void convertRow(const uint8_t* planes, int width, uint16_t* out) {
+    // Through floats a few pixels at a time, the halves are exact conversions of them
+    constexpr int kChunk = 64;
+    alignas(16) float chunk[kChunk * 3];
+    std::vector<uint8_t> scratch;
+    for (int x = 0; x < width; x += kChunk) {
+        int n = std::min(kChunk, width - x);
+        // convertRow reads each plane at a stride of width, so pack this chunk's planes together
+        scratch.resize(static_cast<size_t>(n) * 4);
+        for (int c = 0; c < 4; ++c) std::memcpy(scratch.data() + c * n, planes + static_cast<size_t>(c) * width + x, n);
+        convertRow(scratch.data(), n, chunk);
+        uint16_t* dst = out + static_cast<size_t>(x) * 3;
+        int i = 0;
+#if PBRE_HDR_SSE
+        for (; i + 8 <= n * 3; i += 8) {
+            __m128i packed = _mm_packs_epi32(halves(_mm_load_ps(chunk + i)), halves(_mm_load_ps(chunk + i + 4)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+        }
+#endif
+        for (; i < n * 3; ++i) dst[i] = Core::floatToHalf(chunk[i]);
+    }
+}
+
+// Reads "key" lines up to the blank one, then the resolution line
+bool readHeader(const uint8_t* data, size_t size, size_t& pos, int& width, int& height, std::string& error) {
+    auto line = [&](std::string_view& text) {
+        if (pos >= size) return false;
+        const uint8_t* begin = data + pos;
+        const void* newline = std::memchr(begin, '\n', size - pos);
+        if (!newline) return false;
+        size_t length = static_cast<const uint8_t*>(newline) - begin;
+        text = std::string_view(reinterpret_cast<const char*>(begin), length);
+        pos += length + 1;
+        return true;
+    };
+    std::string_view text;
+    if (!line(text) || (text != "#?RADIANCE" && text != "#?RGBE")) {
+        error = "not a Radiance file";
+        return false;
+    }
+    while (true) {
+        if (!line(text)) {
+            error = "truncated header";
+            return false;
+        }
+        if (text.empty()) break;
+        if (text.starts_with("FORMAT=") && text != "FORMAT=32-bit_rle_rgbe") {
+            error = "unsupported format " + std::string(text);
+            return false;
+        }
+    }
+    if (!line(text)) {
+        error = "missing resolution";
+        return false;
+    }
+    std::string resolution(text);
+    if (std::sscanf(resolution.c_str(), "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0) {
+        error = "unsupported orientation " + resolution;
+        return false;
+    }
+    return true;
+}
+
+std::array<float, 3> faceDirection(int face, float x, float y) {
+    // x, y in [-1, 1], OpenGL cubemap face directions
+    std::array<float, 3> d{};
+    switch (face) {
+    case 0: d = {1.0f, y, -x}; break;  // +X
+    case 1: d = {-1.0f, y, x}; break;  // -X
+    case 2: d = {x, 1.0f, -y}; break;  // +Y (z neg)
+    case 3: d = {x, -1.0f, y}; break;  // -Y (z pos)
+    case 4: d = {x, y, 1.0f}; break;   // +Z
+    default: d = {-x, y, -1.0f}; break; // -Z
+    }
+    float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    for (float& c : d) c /= length;
+    return d;
+}
+
+// Where a face texel samples the equirect image: rows y0 and y1, columns x0 and x1 and the bilinear weights.
+// U wraps, V clamps, +Y maps to the top row.
+struct EquirectSample {
+    int x0, x1, y0, y1;
+    float tx, ty;
+};
+
+EquirectSample equirectSample(size_t texel, int faceSize, int width, int height) {
+    size_t faceTexels = static_cast<size_t>(faceSize) * faceSize;
+    int face = static_cast<int>(texel / faceTexels);
+    int y = static_cast<int>(texel % faceTexels / faceSize);
+    int x = static_cast<int>(texel % faceSize);
+    float sx = (2.0f * (x + 0.5f) / faceSize) - 1.0f;
+    // make +y upwards on the face
+    float sy = -((2.0f * (y + 0.5f) / faceSize) - 1.0f);
+    auto dir = faceDirection(face, sx, sy);
+    float u = std::atan2(dir[2], dir[0]) / (2.0f * 3.14159265359f) + 0.5f;
+    float v = 0.5f - std::asin(std::clamp(dir[1], -1.0f, 1.0f)) / 3.14159265359f;
+    u = u - std::floor(u);
+    v = std::clamp(v, 0.0f, 1.0f);
+    float fx = u * (width - 1), fy = v * (height - 1);
+    EquirectSample s;
+    s.x0 = static_cast<int>(std::floor(fx));
+    s.y0 = static_cast<int>(std::floor(fy));
+    s.x1 = (s.x0 + 1) % width;
+    s.y1 = s.y0 + 1 < height ? s.y0 + 1 : height - 1;
+    s.tx = fx - s.x0;
+    s.ty = fy - s.y0;
+    return s;
+}
+
+// Face texels are bucketed by the first row they read, then each band of rows resamples the texels whose
+// rows it holds. band(first, count) returns rows [first, first + count) as RGB floats.
+std::vector<float> resampleBands(int width, int height, int faceSize, int bandRows, const std::function<const float*(int, int)>& band) {
+    size_t texels = static_cast<size_t>(faceSize) * faceSize * 6;
+    std::vector<uint32_t> firstRow(texels);
+    Core::parallelFor(texels, 4096, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) firstRow[t] = static_cast<uint32_t>(equirectSample(t, faceSize, width, height).y0);
+    });
+    std::vector<size_t> rowStart(static_cast<size_t>(height) + 1, 0);
+    for (uint32_t row : firstRow) ++rowStart[row + 1];
+    for (int row = 0; row < height; ++row) rowStart[row + 1] += rowStart[row];
+    std::vector<uint32_t> order(texels);
+    {
+        std::vector<size_t> next(rowStart.begin(), rowStart.end() - 1);
+        for (size_t t = 0; t < texels; ++t) order[next[firstRow[t]]++] = static_cast<uint32_t>(t);
+    }
+    std::vector<uint32_t>().swap(firstRow);
+
+    std::vector<float> faces(texels * 3);
+    bandRows = std::max(bandRows, 1);
+    for (int first = 0; first < height; first += bandRows) {
+        int last = std::min(first + bandRows, height); // texels starting in [first, last)
+        size_t begin = rowStart[first], end = rowStart[last];
+        if (begin == end) continue;
+        // Plus the row after the band for the bilinear taps
+        int count = std::min(last + 1, height) - first;
+        const float* rows = band(first, count);
+        Core::parallelFor(end - begin, 1024, [&](size_t b, size_t e) {
+            for (size_t i = begin + b; i < begin + e; ++i) {
+                size_t t = order[i];
+                EquirectSample s = equirectSample(t, faceSize, width, height);
+                const float* row0 = rows + static_cast<size_t>(s.y0 - first) * width * 3;
+                const float* row1 = rows + static_cast<size_t>(s.y1 - first) * width * 3;
+                for (int c = 0; c < 3; ++c) {
+                    float top = row0[s.x0 * 3 + c] * (1.0f - s.tx) + row0[s.x1 * 3 + c] * s.tx;
+                    float bottom = row1[s.x0 * 3 + c] * (1.0f - s.tx) + row1[s.x1 * 3 + c] * s.tx;
+                    faces[t * 3 + c] = top * (1.0f - s.ty) + bottom * s.ty;
+                }
+            }
+        });
+    }
+    return faces;
+}
+} // namespace
+
+bool Core::HdrDecoder::open(const std::string& path) {
+    close();
+    if (!file_.open(path)) {
+        error_ = "can't open " + path;
+        return false;
+    }
+    const uint8_t* data = file_.bytes().data();
+    size_t size = file_.size();
+    size_t pos = 0;
+    if (!readHeader(data, size, pos, width_, height_, error_)) {
+        close();
+        return false;
+    }
+
+    // Only the run lengths are read, the literal bytes are skipped over
+    rows_.resize(static_cast<size_t>(height_) + 1);
+    size_t released = 0;
+    for (int y = 0; y < height_; ++y) {
+        rows_[y] = pos;
+        if (isRle(data + pos, data + size, width_)) {
+            if (((data[pos + 2] << 8) | data[pos + 3]) != width_) {
+                error_ = "scanline width mismatch";
+                close();
+                return false;
+            }
+            pos += 4;
+            for (int c = 0; c < 4; ++c) {
+                for (int x = 0; x < width_;) {
+                    if (pos >= size) {
+                        error_ = "truncated scanline";
+                        close();
+                        return false;
+                    }
+                    int count = data[pos++];
+                    int n = count > 128 ? count - 128 : count;
+                    pos += count > 128 ? 1 : count;
+                    if (n == 0 || x + n > width_) {
+                        error_ = "corrupt run length";
+                        close();
+                        return false;
+                    }
+                    x += n;
+                }
+            }
+        } else {
+            pos += static_cast<size_t>(width_) * 4;
+        }
+        if (pos > size) {
+            error_ = "truncated scanline";
+            close();
+            return false;
+        }
+        if (pos - released >= kReleaseStep) {
+            file_.release(released, pos - released);
+            released = pos;
+        }
+    }
+    rows_[height_] = pos;
+    file_.release(released, pos - released);
+    return true;
+}
+
+void Core::HdrDecoder::close() {
+    file_.close();
+    rows_.clear();
+    width_ = height_ = 0;
+}
+
+template <class T> bool Core::HdrDecoder::decode(int first, int count, T* rgb) const {
+    if (first < 0 || count < 0 || first + count > height_) return false;
+    const uint8_t* data = file_.bytes().data();
+    parallelFor(static_cast<size_t>(count), 4, [&](size_t begin, size_t end) {
+        std::vector<uint8_t> planes(static_cast<size_t>(width_) * 4);
+        for (size_t r = begin; r < end; ++r) {
+            size_t row = static_cast<size_t>(first) + r;
+            const uint8_t* p = data + rows_[row];
+            if (isRle(p, data + rows_[row + 1], width_)) {
+                p += 4;
+                // open() validated the runs
+                for (int c = 0; c < 4; ++c) {
+                    uint8_t* plane = planes.data() + static_cast<size_t>(c) * width_;
+                    for (int x = 0; x < width_;) {
+                        int count = *p++;
+                        if (count > 128) {
+                            std::memset(plane + x, *p++, count - 128);
+                            x += count - 128;
+                        } else {
+                            std::memcpy(plane + x, p, count);
+                            p += count;
+                            x += count;
+                        }
+                    }
+                }
+            } else {
+                for (int x = 0; x < width_; ++x) {
+                    for (int c = 0; c < 4; ++c) planes[static_cast<size_t>(c) * width_ + x] = p[x * 4 + c];
+                }
+            }
+            convertRow(planes.data(), width_, rgb + r * width_ * 3);
+        }
+    });
+    return true;
+}
+
+bool Core::HdrDecoder::decodeRows(int first, int count, float* rgb) const {
+    return decode(first, count, rgb);
+}
+
+bool Core::HdrDecoder::decodeRows(int first, int count, uint16_t* rgbHalf) const {
+    return decode(first, count, rgbHalf);
+}
+
+void Core::HdrDecoder::releaseRows(int first, int count) const {
+    if (first < 0 || count <= 0 || first + count > height_) return;
+    file_.release(rows_[first], rows_[first + count] - rows_[first]);
+}
+
+std::vector<float> Core::equirectToCubeFaces(const float* rgb, int width, int height, int faceSize) {
+    return resampleBands(width, height, faceSize, height, [&](int first, int) { return rgb + static_cast<size_t>(first) * width * 3; });
+}
+
+std::vector<float> Core::equirectToCubeFaces(const HdrDecoder& decoder, int faceSize, int bandRows) {
+    std::vector<float> rows(static_cast<size_t>(bandRows + 1) * decoder.width() * 3);
+    int previous = 0;
+    return resampleBands(decoder.width(), decoder.height(), faceSize, bandRows, [&](int first, int count) {
+        decoder.decodeRows(first, count, rows.data());
+        // Every band re-reads the last row of the one before
+        decoder.releaseRows(previous, first - previous);
+        previous = first;
+        return rows.data();
+    });
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PBRE::Core {
+// Radiance .hdr images (32-bit_rle_rgbe, -Y H +X W) read straight from a memory mapping. open() walks the
+// scanlines once to find where each starts, after which any range of rows decodes on its own, rows in
+// parallel. Decoded values match stbi_loadf's, except exponent 1 (under 1e-36) which flushes to zero.
+class HdrDecoder {
+  public:
+    // Fails (see error()) for anything but a Radiance file in the standard orientation
+    bool open(const std::string& path);
+    void close();
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    const std::string& error() const { return error_; }
+
+    // Rows [first, first + count) top to bottom, 3 values per pixel
+    bool decodeRows(int first, int count, float* rgb) const;
+    bool decodeRows(int first, int count, uint16_t* rgbHalf) const;
+    // Drops the file pages of rows a streaming caller is done with from memory
+    void releaseRows(int first, int count) const;
+
+  private:
+    template <class T> bool decode(int first, int count, T* rgb) const;
+
+    MappedFile file_;
+    std::vector<size_t> rows_; // offset of every scanline in the file, plus the end of the last
+    int width_ = 0;
+    int height_ = 0;
+    std::string error_;
+};
+
+// 6 faces of faceSize * faceSize RGB floats in GL face order, bilinearly resampled from an equirect image
+std::vector<float> equirectToCubeFaces(const float* rgb, int width, int height, int faceSize);
+// The same decoding bandRows rows at a time, so besides the faces only a band of the image is ever in memory
+std::vector<float> equirectToCubeFaces(const HdrDecoder& decoder, int faceSize, int bandRows = 64);
+} // namespace PBRE::Core
@@ -0,0 +1,181 @@
+#include "image_write.hpp"
+
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+using namespace PBRE;
+
+namespace {
+// EXR is little endian throughout
+template <typename T> void put(std::vector<char>& out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void putString(std::vector<char>& out, const char* s) {
+    out.insert(out.end(), s, s + std::strlen(s) + 1);
+}
+
+void putAttribute(std::vector<char>& out, const char* name, const char* type, int32_t size) {
+    putString(out, name);
+    putString(out, type);
+    put(out, size);
+}
+
+// Radiance run length encoding of one channel: runs of 4 or more equal bytes, literals in between
+void encodeRuns(const uint8_t* data, int count, std::vector<uint8_t>& out) {
+    int x = 0;
+    while (x < count) {
+        int runStart = x, runLength = 0;
+        while (runStart < count) {
+            runLength = 1;
+            while (runStart + runLength < count && runLength < 127 && data[runStart + runLength] == data[runStart]) ++runLength;
+            if (runLength >= 4) break;
+            runStart += runLength;
+        }
+        if (runLength < 4) runStart = count;
+        while (x < runStart) {
+            int literal = std::min(128, runStart - x);
+            out.push_back(static_cast<uint8_t>(literal));
+            out.insert(out.end(), data + x, data + x + literal);
+            x += literal;
+        }
+        if (runStart < count) {
+            out.push_back(static_cast<uint8_t>(128 + runLength));
+            out.push_back(data[runStart]);
+            x = runStart + runLength;
+        }
+    }
+}
+} // namespace
+
+bool Core::writeExr(const std::string& path, int width, int height, const float* rgb) {
+    if (width <= 0 || height <= 0 || !rgb) return false;
+    constexpr int32_t kFloat = 2;
+    // Channels must be listed in alphabetical order
+    const char* channels[3] = {"B", "G", "R"};
+    const int channelOffset[3] = {2, 1, 0};
+
+    std::vector<char> header;
+    put<uint32_t>(header, 20000630); // magic
+    put<uint32_t>(header, 2);        // version 2, single part scanline file
+
+    putAttribute(header, "channels", "chlist", 3 * (2 + 16) + 1);
+    for (const char* c : channels) {
+        putString(header, c);
+        put<int32_t>(header, kFloat);
+        put<uint32_t>(header, 0); // pLinear + reserved
+        put<int32_t>(header, 1);  // x sampling
+        put<int32_t>(header, 1);  // y sampling
+    }
+    header.push_back(0);
+    putAttribute(header, "compression", "compression", 1);
+    header.push_back(0); // none
+    for (const char* window : {"dataWindow", "displayWindow"}) {
+        putAttribute(header, window, "box2i", 16);
+        put<int32_t>(header, 0);
+        put<int32_t>(header, 0);
+        put<int32_t>(header, width - 1);
+        put<int32_t>(header, height - 1);
+    }
+    putAttribute(header, "lineOrder", "lineOrder", 1);
+    header.push_back(0); // increasing y
+    putAttribute(header, "pixelAspectRatio", "float", 4);
+    put(header, 1.0f);
+    putAttribute(header, "screenWindowCenter", "v2f", 8);
+    put(header, 0.0f);
+    put(header, 0.0f);
+    putAttribute(header, "screenWindowWidth", "float", 4);
+    put(header, 1.0f);
+    header.push_back(0); // end of header
+
+    // One scanline per chunk: y, byte count, then each channel's row
+    const uint64_t lineBytes = 3ull * width * sizeof(float);
+    const uint64_t chunkBytes = 8 + lineBytes;
+    uint64_t firstChunk = header.size() + 8ull * height;
+    for (int y = 0; y < height; ++y) put<uint64_t>(header, firstChunk + chunkBytes * y);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write(header.data(), header.size());
+    std::vector<char> line;
+    line.reserve(chunkBytes);
+    for (int y = 0; y < height; ++y) {
+        line.clear();
+        put<int32_t>(line, y);
+        put<int32_t>(line, static_cast<int32_t>(lineBytes));
+        const float* row = rgb + static_cast<size_t>(y) * width * 3;
+        for (int c = 0; c < 3; ++c) {
+            for (int x = 0; x < width; ++x) put(line, row[x * 3 + channelOffset[c]]);
+        }
+        file.write(line.data(), line.size());
+    }
+    return static_cast<bool>(file);
+}
+
+bool Core::writeHdr(const std::string& path, int width, int height, const float* rgb) {
+    if (width <= 0 || height <= 0 || !rgb) return false;
+    return stbi_write_hdr(path.c_str(), width, height, 3, rgb) != 0;
+}
+
+bool Core::writeImage(const std::string& path, int width, int height, const float* rgb) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    if (ext == ".hdr" || ext == ".HDR") return writeHdr(path, width, height, rgb);
+    return writeExr(path, width, height, rgb);
+}
+
+bool Core::HdrWriter::open(const std::string& path, int width, int height) {
+    if (width <= 0 || height <= 0) return false;
+    file_.open(path, std::ios::binary);
+    if (!file_) return false;
+    width_ = width;
+    height_ = height;
+    rows_ = 0;
+    file_ << "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " << height << " +X " << width << "\n";
+    planes_.resize(static_cast<size_t>(width) * 4);
+    return static_cast<bool>(file_);
+}
+
+bool Core::HdrWriter::writeRow(const float* rgb) {
+    if (!file_.is_open() || rows_ >= height_) return false;
+    for (int x = 0; x < width_; ++x) {
+        const float* p = rgb + static_cast<size_t>(x) * 3;
+        float peak = std::max({p[0], p[1], p[2]});
+        uint8_t rgbe[4] = {0, 0, 0, 0};
+        if (peak >= 1e-32f) {
+            int exponent;
+            float scale = std::frexp(peak, &exponent) * 256.0f / peak;
+            for (int c = 0; c < 3; ++c) rgbe[c] = static_cast<uint8_t>(std::max(p[c], 0.0f) * scale);
+            rgbe[3] = static_cast<uint8_t>(exponent + 128);
+        }
+        for (int c = 0; c < 4; ++c) planes_[static_cast<size_t>(c) * width_ + x] = rgbe[c];
+    }
+    line_.clear();
+    if (width_ >= 8 && width_ < 32768) {
+        line_.insert(line_.end(), {2, 2, static_cast<uint8_t>(width_ >> 8), static_cast<uint8_t>(width_ & 0xFF)});
+        for (int c = 0; c < 4; ++c) encodeRuns(planes_.data() + static_cast<size_t>(c) * width_, width_, line_);
+    } else {
+        // Too narrow or wide for RLE, flat RGBE pixels
+        for (int x = 0; x < width_; ++x) {
+            for (int c = 0; c < 4; ++c) line_.push_back(planes_[static_cast<size_t>(c) * width_ + x]);
+        }
+    }
+    file_.write(reinterpret_cast<const char*>(line_.data()), static_cast<std::streamsize>(line_.size()));
+    ++rows_;
+    return static_cast<bool>(file_);
+}
+
+bool Core::HdrWriter::close() {
+    if (!file_.is_open()) return false;
+    bool complete = rows_ == height_ && static_cast<bool>(file_);
+    file_.close();
+    return complete;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace PBRE::Core {
+// Linear RGB float images, rows top to bottom, 3 floats per pixel
+
+// OpenEXR, uncompressed 32-bit float scanlines
+bool writeExr(const std::string& path, int width, int height, const float* rgb);
+// Radiance RGBE
+bool writeHdr(const std::string& path, int width, int height, const float* rgb);
+// Picks the format from the extension (.exr or .hdr)
+bool writeImage(const std::string& path, int width, int height, const float* rgb);
+
+// Radiance RGBE written a row at a time with run length encoded scanlines, for images too large to hold
+class HdrWriter {
+  public:
+    bool open(const std::string& path, int width, int height);
+    bool writeRow(const float* rgb);
+    // False if any write failed or fewer rows than the height were written
+    bool close();
+
+  private:
+    std::ofstream file_;
+    std::vector<uint8_t> planes_;
+    std::vector<uint8_t> line_;
+    int width_ = 0;
+    int height_ = 0;
+    int rows_ = 0;
+};
+} // namespace PBRE::Core
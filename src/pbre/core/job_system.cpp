@@ -0,0 +1,254 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace PBRE;
+
+namespace {
+// Yields before an idle worker goes to sleep, or a waiting thread starts sleeping between checks
+constexpr int kSpinRounds = 64;
+
+thread_local const Core::JobSystem* tlsSystem = nullptr;
+thread_local int tlsWorker = -1;
+thread_local uint32_t tlsRandom = 0x9e3779b9u;
+
+uint32_t nextRandom() {
+    // xorshift32, only picks the first victim to steal from
+    tlsRandom ^= tlsRandom << 13;
+    tlsRandom ^= tlsRandom >> 17;
+    tlsRandom ^= tlsRandom << 5;
+    return tlsRandom;
+}
+} // namespace
+
+Core::JobSystem::JobSystem(int workers) : mainThread_(std::this_thread::get_id()) {
+    if (workers < 0) workers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) - 1;
+    workers_.reserve(workers);
+    for (int i = 0; i < workers; ++i) workers_.push_back(std::make_unique<Worker>());
+    // Started once every deque exists, a worker steals from all of them
+    for (int i = 0; i < workers; ++i) workers_[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+}
+
+Core::JobSystem::~JobSystem() {
+    {
+        std::lock_guard lock(sleepMutex_);
+        quit_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) worker->thread.join();
+    // Main thread tasks nobody ran
+    runMainThreadTasks();
+}
+
+Core::JobSystem& Core::JobSystem::instance() {
+    static JobSystem system;
+    return system;
+}
+
+Core::TaskHandle Core::JobSystem::schedule(std::function<void()> fn, const std::vector<TaskHandle>& dependencies) {
+    return submit(std::move(fn), false, dependencies);
+}
+
+Core::TaskHandle Core::JobSystem::scheduleOnMain(std::function<void()> fn, const std::vector<TaskHandle>& dependencies) {
+    return submit(std::move(fn), true, dependencies);
+}
+
+Core::TaskHandle Core::JobSystem::submit(std::function<void()> fn, bool mainThread, const std::vector<TaskHandle>& dependencies) {
+    auto task = std::make_shared<Task>();
+    task->fn_ = std::move(fn);
+    task->mainThread_ = mainThread;
+    for (const auto& dependency : dependencies) {
+        if (!dependency) continue;
+        std::lock_guard lock(dependency->mutex_);
+        if (dependency->finished_.load(std::memory_order_relaxed)) continue;
+        task->pending_.fetch_add(1, std::memory_order_relaxed);
+        dependency->continuations_.push_back(task);
+    }
+    // Drop the scheduling reference, whoever brings the count to zero queues it
+    if (task->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) enqueue(task);
+    return task;
+}
+
+int Core::JobSystem::currentWorker() const {
+    return tlsSystem == this ? tlsWorker : -1;
+}
+
+void Core::JobSystem::enqueue(TaskHandle task) {
+    Task* raw = task.get();
+    raw->self_ = std::move(task);
+    if (raw->mainThread_) {
+        std::lock_guard lock(mainMutex_);
+        main_.push_back(raw);
+        return;
+    }
+
+    // Counted before it is visible so a worker about to sleep can't miss it
+    queued_.fetch_add(1);
+    int self = currentWorker();
+    if (self >= 0) {
+        workers_[self]->deque.push(raw);
+    } else {
+        std::lock_guard lock(sharedMutex_);
+        shared_.push_back(raw);
+    }
+    if (sleeping_.load() > 0) {
+        std::lock_guard lock(sleepMutex_);
+        wake_.notify_one();
+    }
+}
+
+Core::Task* Core::JobSystem::findTask(int self) {
+    if (queued_.load(std::memory_order_relaxed) <= 0) return nullptr;
+    Task* task = nullptr;
+    bool found = self >= 0 && workers_[self]->deque.pop(task);
+    if (!found) {
+        std::lock_guard lock(sharedMutex_);
+        if (!shared_.empty()) {
+            task = shared_.front();
+            shared_.pop_front();
+            found = true;
+        }
+    }
+    if (!found && !workers_.empty()) {
+        size_t count = workers_.size();
+        size_t start = nextRandom() % count;
+        for (size_t i = 0; i < count && !found; ++i) {
+            size_t victim = (start + i) % count;
+            if (static_cast<int>(victim) != self) found = workers_[victim]->deque.steal(task);
+        }
+    }
+    if (!found) return nullptr;
+    queued_.fetch_sub(1);
+    return task;
+}
+
+void Core::JobSystem::execute(Task* task) {
+    TaskHandle keep = std::move(task->self_);
+    try {
+        task->fn_();
+    } catch (...) {
+        task->error_ = std::current_exception();
+    }
+    task->fn_ = nullptr; // release what it captured
+
+    std::vector<TaskHandle> continuations;
+    {
+        std::lock_guard lock(task->mutex_);
+        task->finished_.store(true, std::memory_order_release);
+        continuations.swap(task->continuations_);
+    }
+    for (auto& next : continuations) {
+        if (next->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) enqueue(std::move(next));
+    }
+}
+
+void Core::JobSystem::workerLoop(int index) {
+    tlsSystem = this;
+    tlsWorker = index;
+    tlsRandom = 0x9e3779b9u * static_cast<uint32_t>(index + 1);
+    int idle = 0;
+    while (true) {
+        if (Task* task = findTask(index)) {
+            execute(task);
+            idle = 0;
+            continue;
+        }
+        if (++idle < kSpinRounds) {
+            std::this_thread::yield();
+            continue;
+        }
+        idle = 0;
+        std::unique_lock lock(sleepMutex_);
+        ++sleeping_;
+        wake_.wait(lock, [&] { return quit_ || queued_.load() > 0; });
+        --sleeping_;
+        if (quit_ && queued_.load() <= 0) return;
+    }
+}
+
+void Core::JobSystem::wait(const TaskHandle& task) {
+    if (!task) return;
+    int self = currentWorker();
+    bool main = isMainThread();
+    int idle = 0;
+    while (!task->done()) {
+        if (main && runMainThreadTasks() > 0) {
+            idle = 0;
+            continue;
+        }
+        if (Task* other = findTask(self)) {
+            execute(other);
+            idle = 0;
+            continue;
+        }
+        // Nothing to help with, the task is running on another thread
+        if (++idle < kSpinRounds) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+    if (task->error_) std::rethrow_exception(task->error_);
+}
+
+size_t Core::JobSystem::runMainThreadTasks() {
+    if (!isMainThread()) return 0;
+    size_t ran = 0;
+    while (true) {
+        Task* task = nullptr;
+        {
+            std::lock_guard lock(mainMutex_);
+            if (main_.empty()) break;
+            task = main_.front();
+            main_.pop_front();
+        }
+        execute(task);
+        ++ran;
+    }
+    return ran;
+}
+
+void Core::JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t threads = threadCount();
+    if (threads == 1 || count <= grain) {
+        fn(0, count);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    auto body = [&]() {
+        size_t begin = next.load(std::memory_order_relaxed);
+        while (begin < count) {
+            size_t size = std::max(grain, (count - begin) / (2 * threads));
+            size_t end = std::min(count, begin + size);
+            // On failure begin is reloaded with the current position
+            if (next.compare_exchange_weak(begin, end, std::memory_order_relaxed)) {
+                fn(begin, end);
+                begin = next.load(std::memory_order_relaxed);
+            }
+        }
+    };
+    // One helper per other thread at most, idle workers steal them; the caller claims chunks too
+    size_t helperCount = std::min(threads - 1, (count + grain - 1) / grain - 1);
+    std::vector<TaskHandle> helpers;
+    helpers.reserve(helperCount);
+    for (size_t i = 0; i < helperCount; ++i) helpers.push_back(schedule(body));
+    std::exception_ptr error;
+    try {
+        body();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    // Every helper has to be done with the captured state before it goes out of scope
+    for (auto& helper : helpers) {
+        try {
+            wait(helper);
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "pbre/core/work_stealing_deque.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace PBRE::Core {
+class JobSystem;
+
+// One unit of work. It becomes runnable once every task it depends on has finished.
+class Task {
+  public:
+    bool done() const { return finished_.load(std::memory_order_acquire); }
+
+  private:
+    friend class JobSystem;
+
+    std::function<void()> fn_;
+    bool mainThread_ = false;
+    std::atomic<int> pending_{1}; // unfinished dependencies, plus one until scheduling is complete
+    std::atomic<bool> finished_{false};
+    std::exception_ptr error_;
+    std::mutex mutex_; // guards continuations_ against finishing
+    std::vector<std::shared_ptr<Task>> continuations_;
+    std::shared_ptr<Task> self_; // keeps a queued task alive
+};
+using TaskHandle = std::shared_ptr<Task>;
+
+// Work stealing task scheduler. Every worker owns a Chase-Lev deque: tasks scheduled from a worker go to
+// its own deque and run newest first, idle workers steal the oldest task of another. Tasks scheduled from
+// other threads go through a shared queue. Main thread tasks (GL calls) only run on the thread that created
+// the system, from runMainThreadTasks() or while it waits.
+class JobSystem {
+  public:
+    // A negative count starts one worker per hardware thread besides the calling one, 0 runs everything on
+    // the threads that wait
+    explicit JobSystem(int workers = -1);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Shared instance, created by the first call, which should come from the main (GL) thread
+    static JobSystem& instance();
+
+    TaskHandle schedule(std::function<void()> fn, const std::vector<TaskHandle>& dependencies = {});
+    TaskHandle scheduleOnMain(std::function<void()> fn, const std::vector<TaskHandle>& dependencies = {});
+    // Runs other tasks until this one has finished, so tasks may wait on each other. Rethrows what the task threw.
+    void wait(const TaskHandle& task);
+
+    // Runs fn(begin, end) over [0, count) and returns when every item is done. Chunks are claimed with guided
+    // scheduling: each takes a share of what is left (never less than grain), so there are few claims while
+    // most of the range remains and small ones that balance the finish.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn);
+
+    // Runs the main thread tasks that are ready, main thread only. Returns how many ran.
+    size_t runMainThreadTasks();
+
+    unsigned threadCount() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+  private:
+    struct Worker {
+        WorkStealingDeque<Task*> deque;
+        std::thread thread;
+    };
+
+    TaskHandle submit(std::function<void()> fn, bool mainThread, const std::vector<TaskHandle>& dependencies);
+    void enqueue(TaskHandle task);
+    Task* findTask(int self);
+    void execute(Task* task);
+    void workerLoop(int index);
+    int currentWorker() const;
+    bool isMainThread() const { return std::this_thread::get_id() == mainThread_; }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::thread::id mainThread_;
+
+    std::mutex sharedMutex_; // tasks from threads that aren't workers
+    std::deque<Task*> shared_;
+    std::mutex mainMutex_;
+    std::deque<Task*> main_;
+
+    std::atomic<int> queued_{0}; // in the deques and the shared queue
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::atomic<int> sleeping_{0};
+    std::atomic<bool> quit_{false};
+};
+} // namespace PBRE::Core
@@ -0,0 +1,114 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace PBRE;
+
+Core::MappedFile::~MappedFile() {
+    close();
+}
+
+Core::MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+Core::MappedFile& Core::MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        opened_ = std::exchange(other.opened_, false);
+#ifdef _WIN32
+        file_ = std::exchange(other.file_, nullptr);
+        mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+bool Core::MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+    file_ = file;
+    opened_ = true;
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ == 0) return true; // empty files can't be mapped
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    opened_ = true;
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ == 0) {
+        ::close(fd);
+        return true;
+    }
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference
+    if (data != MAP_FAILED) {
+        data_ = static_cast<const uint8_t*>(data);
+        // Loaders stream through buffers front to back
+        madvise(data, size_, MADV_SEQUENTIAL);
+    }
+#endif
+    if (!data_) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void Core::MappedFile::release(size_t offset, size_t size) const {
+    if (!data_ || offset >= size_) return;
+    size = std::min(size, size_ - offset);
+#ifdef _WIN32
+    // Unlocking pages that aren't locked takes them out of the working set
+    VirtualUnlock(const_cast<uint8_t*>(data_ + offset), size);
+#else
+    // Whole pages inside the range only, a page shared with a neighbouring range may still be in use
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = (offset + size) / page * page;
+    if (offset + size == size_) end = (size_ + page - 1) / page * page;
+    if (end > begin) madvise(const_cast<uint8_t*>(data_ + begin), end - begin, MADV_DONTNEED);
+#endif
+}
+
+void Core::MappedFile::close() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_) CloseHandle(file_);
+    mapping_ = file_ = nullptr;
+#else
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    opened_ = false;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace PBRE::Core {
+// Read-only memory mapping of a whole file. Pages are only read in when touched and are shared with the
+// OS file cache, so nothing is copied into the process heap.
+class MappedFile {
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return opened_; }
+    std::span<const uint8_t> bytes() const { return {data_, size_}; }
+    size_t size() const { return size_; }
+    // Drops the resident pages of a range the caller is done with, so streaming through a large file doesn't
+    // grow the RSS. Reading the range again faults the pages back in from the file.
+    void release(size_t offset, size_t size) const;
+
+  private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool opened_ = false;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+} // namespace PBRE::Core
@@ -0,0 +1,70 @@
+#include "memory_stats.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <cstdio>
+#include <cstring>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace PBRE;
+
+#if defined(__linux__)
+// Reads a "Key:   1234 kB" line of /proc/self/status
+static size_t statusKilobytes(const char* key) {
+    FILE* file = std::fopen("/proc/self/status", "r");
+    if (!file) return 0;
+    char line[256];
+    size_t kb = 0;
+    size_t keyLength = std::strlen(key);
+    while (std::fgets(line, sizeof(line), file)) {
+        if (std::strncmp(line, key, keyLength) == 0 && line[keyLength] == ':') {
+            std::sscanf(line + keyLength + 1, "%zu", &kb);
+            break;
+        }
+    }
+    std::fclose(file);
+    return kb * 1024;
+}
+#endif
+
+size_t Core::currentRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#elif defined(__linux__)
+    return statusKilobytes("VmRSS");
+#else
+    return 0;
+#endif
+}
+
+size_t Core::peakRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#elif defined(__linux__)
+    return statusKilobytes("VmHWM");
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return static_cast<size_t>(usage.ru_maxrss); // bytes on macOS
+#endif
+}
+
+bool Core::resetPeakRss() {
+#if defined(__linux__)
+    // Writing 5 to clear_refs resets VmHWM to the current RSS
+    FILE* file = std::fopen("/proc/self/clear_refs", "w");
+    if (!file) return false;
+    bool ok = std::fputs("5", file) >= 0;
+    return std::fclose(file) == 0 && ok;
+#else
+    return false;
+#endif
+}
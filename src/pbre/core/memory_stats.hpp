@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+namespace PBRE::Core {
+// Resident set size of the process in bytes, 0 where unsupported
+size_t currentRssBytes();
+size_t peakRssBytes();
+// Restarts peak tracking from the current RSS (Linux only), returns false if the peak can't be reset
+bool resetPeakRss();
+} // namespace PBRE::Core
@@ -0,0 +1,140 @@
+#include "meshopt.hpp"
+#include "parallel.hpp"
+
+#include <meshoptimizer.h>
+#include <tiny_gltf.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace PBRE;
+
+namespace {
+enum class Mode { Attributes, Triangles, Indices };
+enum class Filter { None, Octahedral, Quaternion, Exponential };
+
+struct Job {
+    int sourceBuffer;
+    size_t sourceOffset;
+    size_t sourceSize;
+    int targetBuffer;
+    size_t targetOffset;
+    const uint8_t* source = nullptr;
+    uint8_t* destination = nullptr;
+    size_t count;
+    size_t stride;
+    Mode mode;
+    Filter filter;
+};
+
+int intProperty(const tinygltf::Value& object, const char* name, int fallback) {
+    return object.Has(name) && object.Get(name).IsNumber() ? object.Get(name).GetNumberAsInt() : fallback;
+}
+
+std::string stringProperty(const tinygltf::Value& object, const char* name) {
+    return object.Has(name) ? object.Get(name).Get<std::string>() : std::string();
+}
+
+bool parseJob(tinygltf::Model& model, Core::BufferSpans& buffers, const tinygltf::BufferView& view, const tinygltf::Value& ext, Job& job) {
+    int buffer = intProperty(ext, "buffer", -1);
+    size_t offset = static_cast<size_t>(intProperty(ext, "byteOffset", 0));
+    size_t length = static_cast<size_t>(intProperty(ext, "byteLength", 0));
+    job.stride = static_cast<size_t>(intProperty(ext, "byteStride", 0));
+    job.count = static_cast<size_t>(intProperty(ext, "count", 0));
+    if (buffer < 0 || buffer >= static_cast<int>(buffers.size())) return false;
+    if (view.buffer < 0 || view.buffer >= static_cast<int>(buffers.size())) return false;
+    if (offset + length > buffers[buffer].size()) return false;
+    if (job.stride == 0 || job.count * job.stride > view.byteLength) return false;
+
+    std::string mode = stringProperty(ext, "mode");
+    if (mode == "ATTRIBUTES") {
+        job.mode = Mode::Attributes;
+    } else if (mode == "TRIANGLES") {
+        job.mode = Mode::Triangles;
+    } else if (mode == "INDICES") {
+        job.mode = Mode::Indices;
+    } else {
+        return false;
+    }
+    std::string filter = stringProperty(ext, "filter");
+    job.filter = filter == "OCTAHEDRAL" ? Filter::Octahedral : filter == "QUATERNION" ? Filter::Quaternion : filter == "EXPONENTIAL" ? Filter::Exponential : Filter::None;
+
+    job.sourceBuffer = buffer;
+    job.sourceOffset = offset;
+    job.sourceSize = length;
+    job.targetBuffer = view.buffer;
+    job.targetOffset = view.byteOffset;
+
+    // The fallback buffer usually has no data of its own. If it does and it's mapped, take a copy so the
+    // decoded views can be written next to the rest of it.
+    auto& target = model.buffers[view.buffer].data;
+    auto& span = buffers[view.buffer];
+    if (!span.empty() && span.data() != target.data()) target.assign(span.begin(), span.end());
+    if (target.size() < view.byteOffset + view.byteLength) target.resize(view.byteOffset + view.byteLength);
+    span = {target.data(), target.size()};
+    return true;
+}
+
+bool runJob(const Job& job) {
+    int result = -1;
+    switch (job.mode) {
+    case Mode::Attributes: result = meshopt_decodeVertexBuffer(job.destination, job.count, job.stride, job.source, job.sourceSize); break;
+    case Mode::Triangles: result = meshopt_decodeIndexBuffer(job.destination, job.count, job.stride, job.source, job.sourceSize); break;
+    case Mode::Indices: result = meshopt_decodeIndexSequence(job.destination, job.count, job.stride, job.source, job.sourceSize); break;
+    }
+    if (result != 0) return false;
+    switch (job.filter) {
+    case Filter::None: break;
+    case Filter::Octahedral: meshopt_decodeFilterOct(job.destination, job.count, job.stride); break;
+    case Filter::Quaternion: meshopt_decodeFilterQuat(job.destination, job.count, job.stride); break;
+    case Filter::Exponential: meshopt_decodeFilterExp(job.destination, job.count, job.stride); break;
+    }
+    return true;
+}
+} // namespace
+
+bool Core::decodeMeshoptBufferViews(tinygltf::Model& model, BufferSpans& buffers, MeshoptStats& stats) {
+    // Collect and resize the fallback buffers up front, the workers then only write disjoint ranges
+    std::vector<Job> jobs;
+    for (size_t i = 0; i < model.bufferViews.size(); ++i) {
+        const auto& view = model.bufferViews[i];
+        auto it = view.extensions.find("EXT_meshopt_compression");
+        if (it == view.extensions.end()) continue;
+        Job job;
+        if (!it->second.IsObject() || !parseJob(model, buffers, view, it->second, job)) {
+            std::cerr << "Malformed EXT_meshopt_compression buffer view " << i << std::endl;
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    if (jobs.empty()) return true;
+    for (auto& job : jobs) {
+        job.source = buffers[job.sourceBuffer].data() + job.sourceOffset;
+        job.destination = model.buffers[job.targetBuffer].data.data() + job.targetOffset;
+    }
+
+    // Largest first so one big view doesn't end up last on a single thread
+    std::sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.count * a.stride > b.count * b.stride; });
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<bool> ok{true};
+    parallelFor(jobs.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            if (!runJob(jobs[j])) ok = false;
+        }
+    });
+    stats.decodeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (const auto& job : jobs) {
+        ++stats.views;
+        stats.compressedBytes += job.sourceSize;
+        stats.decodedBytes += job.count * job.stride;
+    }
+    if (!ok) std::cerr << "Failed to decode EXT_meshopt_compression data" << std::endl;
+    return ok;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "pbre/core/accessor.hpp"
+
+#include <cstddef>
+
+namespace PBRE::Core {
+struct MeshoptStats {
+    int views = 0;
+    size_t compressedBytes = 0;
+    size_t decodedBytes = 0;
+    double decodeMs = 0.0; // wall time across all worker threads
+
+    double megabytesPerSecond() const { return decodeMs > 0.0 ? decodedBytes / (decodeMs * 1000.0) : 0.0; }
+};
+
+// Decodes every EXT_meshopt_compression buffer view in place. The decoded bytes are written into the view's
+// fallback buffer at the view's offset (that buffer becomes owned by the model and buffers is pointed at it),
+// so accessors then read them like any other buffer view. Views are spread over worker threads. Returns
+// false if a view is malformed or fails to decode.
+bool decodeMeshoptBufferViews(tinygltf::Model& model, BufferSpans& buffers, MeshoptStats& stats);
+} // namespace PBRE::Core
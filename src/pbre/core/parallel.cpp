@@ -0,0 +1,9 @@
+#include "parallel.hpp"
+
+#include "pbre/core/job_system.hpp"
+
+using namespace PBRE;
+
+void Core::parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn) {
+    JobSystem::instance().parallelFor(count, grain, fn);
+}
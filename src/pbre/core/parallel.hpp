@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace PBRE::Core {
+// Runs fn(begin, end) over [0, count) on the shared JobSystem's workers and the calling thread, which returns
+// once every item has run. Chunks are sized adaptively and are never smaller than grain (except the last).
+void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn);
+} // namespace PBRE::Core
@@ -0,0 +1,235 @@
+#include "tangents.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+using namespace PBRE;
+
+namespace {
+constexpr size_t kTriangleGrain = 16384;
+constexpr size_t kVertexGrain = 32768;
+constexpr uint32_t kCacheMagic = 0x4E415450; // "PTAN"
+constexpr uint32_t kCacheVersion = 2; // 2 added the split vertices
+
+vec3 safeNormalize(const vec3& v) {
+    float len2 = glm::dot(v, v);
+    return len2 > 1e-20f ? v / std::sqrt(len2) : vec3(0.0f);
+}
+
+// Any unit vector perpendicular to n
+vec3 orthogonal(const vec3& n) {
+    vec3 up = std::abs(n.z) < 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+    return safeNormalize(glm::cross(up, n));
+}
+
+float cornerAngle(const vec3& a, const vec3& b) {
+    float cosine = glm::dot(safeNormalize(a), safeNormalize(b));
+    return std::acos(std::clamp(cosine, -1.0f, 1.0f));
+}
+
+uint64_t mix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    return h * 0xBF58476D1CE4E5B9ull;
+}
+
+uint64_t hashBytes(uint64_t h, const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        h = mix(h, word);
+    }
+    uint64_t tail = 0;
+    if (i < size) std::memcpy(&tail, bytes + i, size - i);
+    return mix(mix(h, tail), size);
+}
+} // namespace
+
+void Core::generateTangents(std::span<const vec3> positions, std::span<const vec3> normals, std::span<const vec2> uvs,
+                            std::span<const uint32_t> indices, GeneratedTangents& out) {
+    size_t vertexCount = positions.size();
+    size_t triangleCount = indices.size() / 3;
+    out.tangents.assign(vertexCount, vec4(0.0f));
+    out.splitSources.clear();
+    out.splitCorners.clear();
+    if (normals.size() != vertexCount || uvs.size() != vertexCount) return;
+
+    // Per corner directions, weights and handedness (the sign of the UV area, 0 for degenerate triangles),
+    // each triangle only writes its own three corners
+    std::vector<vec3> cornerT(triangleCount * 3), cornerB(triangleCount * 3);
+    std::vector<float> cornerWeight(triangleCount * 3, 0.0f);
+    std::vector<int8_t> cornerSign(triangleCount * 3, 0);
+    parallelFor(triangleCount, kTriangleGrain, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            uint32_t v[3] = {indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]};
+            if (v[0] >= vertexCount || v[1] >= vertexCount || v[2] >= vertexCount) continue;
+            vec3 e1 = positions[v[1]] - positions[v[0]];
+            vec3 e2 = positions[v[2]] - positions[v[0]];
+            vec2 d1 = uvs[v[1]] - uvs[v[0]];
+            vec2 d2 = uvs[v[2]] - uvs[v[0]];
+            float area = d1.x * d2.y - d1.y * d2.x;
+            if (std::abs(area) < 1e-20f) continue; // degenerate in UV space, contributes nothing
+            // Only the sign of the UV area matters, the directions are normalized per corner
+            float orientation = area > 0.0f ? 1.0f : -1.0f;
+            vec3 os = (e1 * d2.y - e2 * d1.y) * orientation;
+            vec3 ot = (e2 * d1.x - e1 * d2.x) * orientation;
+
+            for (int c = 0; c < 3; ++c) {
+                const vec3& n = normals[v[c]];
+                const vec3& p = positions[v[c]];
+                size_t corner = t * 3 + c;
+                cornerT[corner] = safeNormalize(os - n * glm::dot(n, os));
+                cornerB[corner] = safeNormalize(ot - n * glm::dot(n, ot));
+                cornerWeight[corner] = cornerAngle(positions[v[(c + 1) % 3]] - p, positions[v[(c + 2) % 3]] - p);
+                cornerSign[corner] = area > 0.0f ? 1 : -1;
+            }
+        }
+    });
+
+    // Corners of each vertex in index order (CSR), so the sums below are deterministic
+    std::vector<uint32_t> firstCorner(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        if (indices[i] < vertexCount) ++firstCorner[indices[i] + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v) firstCorner[v + 1] += firstCorner[v];
+    std::vector<uint32_t> corners(firstCorner[vertexCount]);
+    {
+        std::vector<uint32_t> fill(firstCorner.begin(), firstCorner.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i) {
+            if (indices[i] < vertexCount) corners[fill[indices[i]]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // Vertices with corners of both handedness give the lighter side (negative on a tie) to a copy
+    std::vector<int8_t> splitSign(vertexCount, 0);
+    parallelFor(vertexCount, kVertexGrain, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            float weight[2] = {0.0f, 0.0f}; // negative, positive
+            bool seen[2] = {false, false};
+            for (uint32_t k = firstCorner[v]; k < firstCorner[v + 1]; ++k) {
+                uint32_t corner = corners[k];
+                if (cornerSign[corner] == 0) continue;
+                int side = cornerSign[corner] > 0 ? 1 : 0;
+                weight[side] += cornerWeight[corner];
+                seen[side] = true;
+            }
+            if (seen[0] && seen[1]) splitSign[v] = weight[1] >= weight[0] ? -1 : 1;
+        }
+    });
+    std::vector<uint32_t> splitVertex(vertexCount, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (splitSign[v] == 0) continue;
+        splitVertex[v] = static_cast<uint32_t>(vertexCount + out.splitSources.size());
+        out.splitSources.push_back(static_cast<uint32_t>(v));
+    }
+    out.tangents.resize(vertexCount + out.splitSources.size(), vec4(0.0f));
+
+    parallelFor(vertexCount, kVertexGrain, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            vec3 t[2] = {vec3(0.0f), vec3(0.0f)}, b[2] = {vec3(0.0f), vec3(0.0f)}; // kept, split off
+            for (uint32_t k = firstCorner[v]; k < firstCorner[v + 1]; ++k) {
+                uint32_t corner = corners[k];
+                int group = splitSign[v] != 0 && cornerSign[corner] == splitSign[v] ? 1 : 0;
+                t[group] += cornerT[corner] * cornerWeight[corner];
+                b[group] += cornerB[corner] * cornerWeight[corner];
+            }
+            const vec3& n = normals[v];
+            auto finish = [&](const vec3& tSum, const vec3& bSum) {
+                vec3 tangent = safeNormalize(tSum - n * glm::dot(n, tSum));
+                if (tangent == vec3(0.0f)) tangent = orthogonal(n);
+                float sign = glm::dot(glm::cross(n, tangent), bSum) < 0.0f ? -1.0f : 1.0f;
+                return vec4(tangent, sign);
+            };
+            out.tangents[v] = finish(t[0], b[0]);
+            if (splitSign[v] != 0) out.tangents[splitVertex[v]] = finish(t[1], b[1]);
+        }
+    });
+
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (splitSign[v] == 0) continue;
+        for (uint32_t k = firstCorner[v]; k < firstCorner[v + 1]; ++k) {
+            if (cornerSign[corners[k]] == splitSign[v]) out.splitCorners.push_back({corners[k], splitVertex[v]});
+        }
+    }
+}
+
+uint64_t Core::tangentKey(std::span<const vec3> positions, std::span<const vec3> normals, std::span<const vec2> uvs,
+                          std::span<const uint32_t> indices) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    h = hashBytes(h, positions.data(), positions.size_bytes());
+    h = hashBytes(h, normals.data(), normals.size_bytes());
+    h = hashBytes(h, uvs.data(), uvs.size_bytes());
+    return hashBytes(h, indices.data(), indices.size_bytes());
+}
+
+bool Core::TangentCache::load(const std::string& path) {
+    entries_.clear();
+    modified_ = false;
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    uint64_t remaining = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    uint32_t header[3] = {};
+    if (remaining < sizeof(header) || !file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != kCacheMagic ||
+        header[1] != kCacheVersion)
+        return false;
+    remaining -= sizeof(header);
+    // A corrupt or truncated count must not drive the allocation, the whole cache is dropped instead
+    auto readArray = [&](auto& out) {
+        using T = typename std::remove_reference_t<decltype(out)>::value_type;
+        uint64_t count = 0;
+        if (remaining < sizeof(count) || !file.read(reinterpret_cast<char*>(&count), sizeof(count))) return false;
+        remaining -= sizeof(count);
+        if (count > remaining / sizeof(T)) return false;
+        out.resize(count);
+        if (!file.read(reinterpret_cast<char*>(out.data()), count * sizeof(T))) return false;
+        remaining -= count * sizeof(T);
+        return true;
+    };
+    for (uint32_t e = 0; e < header[2]; ++e) {
+        uint64_t key = 0;
+        GeneratedTangents generated;
+        if (remaining < sizeof(key) || !file.read(reinterpret_cast<char*>(&key), sizeof(key))) break;
+        remaining -= sizeof(key);
+        if (!readArray(generated.tangents) || !readArray(generated.splitSources) || !readArray(generated.splitCorners)) {
+            entries_.clear();
+            return false;
+        }
+        entries_.emplace(key, std::move(generated));
+    }
+    return true;
+}
+
+bool Core::TangentCache::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    uint32_t header[3] = {kCacheMagic, kCacheVersion, static_cast<uint32_t>(entries_.size())};
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    auto writeArray = [&](const auto& array) {
+        uint64_t count = array.size();
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        file.write(reinterpret_cast<const char*>(array.data()), count * sizeof(array[0]));
+    };
+    for (const auto& [key, generated] : entries_) {
+        file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        writeArray(generated.tangents);
+        writeArray(generated.splitSources);
+        writeArray(generated.splitCorners);
+    }
+    return static_cast<bool>(file);
+}
+
+const Core::GeneratedTangents* Core::TangentCache::find(uint64_t key) const {
+    auto it = entries_.find(key);
+    return it != entries_.end() ? &it->second : nullptr;
+}
+
+void Core::TangentCache::store(uint64_t key, GeneratedTangents tangents) {
+    entries_[key] = std::move(tangents);
+    modified_ = true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "pbre/base.hpp"
+
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace PBRE::Core {
+// A corner of the index list moved to a vertex split off its original one
+struct SplitCorner {
+    uint32_t corner; // position in the index list
+    uint32_t vertex; // the split off vertex it now refers to
+};
+
+struct GeneratedTangents {
+    std::vector<vec4> tangents;         // one per vertex, the split off vertices after the mesh's own
+    std::vector<uint32_t> splitSources; // the vertex each split off vertex copies its attributes from
+    std::vector<SplitCorner> splitCorners;
+};
+
+// MikkTSpace style tangents for an indexed triangle list: per corner tangent and bitangent directions
+// projected onto the vertex normal's plane, accumulated per vertex weighted by the corner angle, then
+// orthogonalized. w holds the bitangent sign, bitangent = cross(normal, tangent.xyz) * w as glTF expects.
+// Like MikkTSpace, a vertex whose corners disagree on handedness (mirrored UVs) is split: the corners of the
+// lighter handedness move to a copy of the vertex with its own tangent. Triangles are processed in parallel
+// chunks; the result doesn't depend on the thread count.
+void generateTangents(std::span<const vec3> positions, std::span<const vec3> normals, std::span<const vec2> uvs,
+                      std::span<const uint32_t> indices, GeneratedTangents& out);
+
+// Identifies a mesh's tangent inputs, so generated tangents can be cached with the baked mesh
+uint64_t tangentKey(std::span<const vec3> positions, std::span<const vec3> normals, std::span<const vec2> uvs,
+                    std::span<const uint32_t> indices);
+
+// Generated tangents keyed by tangentKey, stored in one file per model
+class TangentCache {
+  public:
+    // A missing or stale file leaves the cache empty
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    const GeneratedTangents* find(uint64_t key) const;
+    void store(uint64_t key, GeneratedTangents tangents);
+    bool modified() const { return modified_; }
+
+  private:
+    std::map<uint64_t, GeneratedTangents> entries_;
+    bool modified_ = false;
+};
+} // namespace PBRE::Core
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace PBRE::Core {
+// Chase-Lev work stealing deque (with the memory orderings of Le et al., "Correct and Efficient Work-Stealing
+// for Weak Memory Models"). The owning thread pushes and pops at the bottom, any thread steals from the top.
+// T must be trivially copyable (the job system stores task pointers). The array grows when full; the old
+// arrays are kept until the deque is destroyed since a thief may still be reading from one.
+template <typename T>
+class WorkStealingDeque {
+  public:
+    // capacity must be a power of two
+    explicit WorkStealingDeque(int64_t capacity = 256) {
+        arrays_.push_back(std::make_unique<Array>(capacity));
+        array_.store(arrays_.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only
+    void push(T item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array* array = array_.load(std::memory_order_relaxed);
+        if (b - t > array->capacity - 1) array = grow(array, t, b);
+        array->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only, newest first. False when empty or a thief won the last item.
+    bool pop(T& item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* array = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = array->get(b);
+        if (t == b) {
+            // Last item, race the thieves for it
+            bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread, oldest first. False when empty or another thread got there first.
+    bool steal(T& item) {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) return false;
+        Array* array = array_.load(std::memory_order_acquire);
+        item = array->get(t);
+        return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // Approximate, for idle checks
+    bool empty() const {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct Array {
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> items;
+
+        explicit Array(int64_t size) : capacity(size), mask(size - 1), items(new std::atomic<T>[size]) {}
+        T get(int64_t i) const { return items[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T item) { items[i & mask].store(item, std::memory_order_relaxed); }
+    };
+
+    Array* grow(Array* old, int64_t top, int64_t bottom) {
+        arrays_.push_back(std::make_unique<Array>(old->capacity * 2));
+        Array* array = arrays_.back().get();
+        for (int64_t i = top; i < bottom; ++i) array->put(i, old->get(i));
+        array_.store(array, std::memory_order_release);
+        return array;
+    }
+
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<Array*> array_{nullptr};
+    std::vector<std::unique_ptr<Array>> arrays_; // owner only
+};
+} // namespace PBRE::Core
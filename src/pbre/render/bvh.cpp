@@ -0,0 +1,377 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define PBRE_BVH_SSE 1
+#else
+#define PBRE_BVH_SSE 0
+#endif
+
+using namespace PBRE;
+
+namespace {
+constexpr int kBins = 16;
+constexpr uint32_t kMaxLeaf = 8;
+constexpr int kMaxDepth = 96; // deeper nodes become leaves, the traversal stack has room for them
+constexpr int kStackSize = 128;
+constexpr float kTraversalCost = 1.0f; // relative to one triangle test
+constexpr float kMinDeterminant = 1e-20f;
+
+struct Bounds {
+    vec3 min = vec3(1e30f);
+    vec3 max = vec3(-1e30f);
+
+    void grow(const vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    void grow(const Bounds& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+    float halfArea() const {
+        vec3 e = max - min;
+        return e.x < 0.0f ? 0.0f : e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+};
+
+// Avoids 0 * inf = NaN in the slab test for axis aligned rays
+float safeReciprocal(float d) {
+    return 1.0f / (std::abs(d) > 1e-20f ? d : std::copysign(1e-20f, d));
+}
+} // namespace
+
+void Render::RayPacket::set(int lane, const Ray& ray) {
+    ox[lane] = ray.origin.x;
+    oy[lane] = ray.origin.y;
+    oz[lane] = ray.origin.z;
+    dx[lane] = ray.direction.x;
+    dy[lane] = ray.direction.y;
+    dz[lane] = ray.direction.z;
+    tMax[lane] = ray.tMax;
+}
+
+void Render::Bvh::build(std::span<const vec3> positions, std::span<const uint32_t> indices) {
+    auto start = std::chrono::steady_clock::now();
+    nodes_.clear();
+    triangles_.clear();
+    triangleIds_.clear();
+    size_t count = indices.size() / 3;
+    if (count == 0) return;
+
+    std::vector<Bounds> triBounds(count);
+    std::vector<vec3> centroids(count);
+    for (size_t i = 0; i < count; ++i) {
+        for (int k = 0; k < 3; ++k) triBounds[i].grow(positions[indices[i * 3 + k]]);
+        centroids[i] = (triBounds[i].min + triBounds[i].max) * 0.5f;
+    }
+    triangleIds_.resize(count);
+    for (size_t i = 0; i < count; ++i) triangleIds_[i] = static_cast<uint32_t>(i);
+
+    nodes_.reserve(count * 2);
+    nodes_.push_back({vec3(0.0f), 0, vec3(0.0f), static_cast<uint32_t>(count)});
+    struct Task {
+        uint32_t node;
+        int depth;
+    };
+    std::vector<Task> tasks = {{0, 0}};
+    while (!tasks.empty()) {
+        Task task = tasks.back();
+        tasks.pop_back();
+        uint32_t first = nodes_[task.node].first, n = nodes_[task.node].count;
+        uint32_t* ids = triangleIds_.data() + first;
+
+        Bounds bounds, centroidBounds;
+        for (uint32_t i = 0; i < n; ++i) {
+            bounds.grow(triBounds[ids[i]]);
+            centroidBounds.grow(centroids[ids[i]]);
+        }
+        nodes_[task.node].boundsMin = bounds.min;
+        nodes_[task.node].boundsMax = bounds.max;
+        if (n <= 2 || task.depth >= kMaxDepth) continue;
+
+        // Binned SAH over the centroid extent of each axis
+        float bestCost = 1e30f;
+        int bestAxis = -1, bestSplit = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            float lo = centroidBounds.min[axis], extent = centroidBounds.max[axis] - lo;
+            if (extent <= 1e-12f) continue;
+            float scale = kBins / extent;
+            Bounds binBounds[kBins];
+            uint32_t binCount[kBins] = {};
+            for (uint32_t i = 0; i < n; ++i) {
+                int b = std::min(kBins - 1, static_cast<int>((centroids[ids[i]][axis] - lo) * scale));
+                binBounds[b].grow(triBounds[ids[i]]);
+                ++binCount[b];
+            }
+            // Sweep from the right, then evaluate every plane from the left
+            float rightArea[kBins - 1];
+            uint32_t rightCount[kBins - 1];
+            Bounds right;
+            uint32_t rightN = 0;
+            for (int b = kBins - 1; b > 0; --b) {
+                right.grow(binBounds[b]);
+                rightN += binCount[b];
+                rightArea[b - 1] = right.halfArea();
+                rightCount[b - 1] = rightN;
+            }
+            Bounds left;
+            uint32_t leftN = 0;
+            for (int b = 0; b < kBins - 1; ++b) {
+                left.grow(binBounds[b]);
+                leftN += binCount[b];
+                if (leftN == 0 || rightCount[b] == 0) continue;
+                float cost = leftN * left.halfArea() + rightCount[b] * rightArea[b];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b + 1;
+                }
+            }
+        }
+
+        float area = bounds.halfArea();
+        float leafCost = static_cast<float>(n);
+        float splitCost = area > 0.0f ? kTraversalCost + bestCost / area : 1e30f;
+        if (n <= kMaxLeaf && (bestAxis < 0 || splitCost >= leafCost)) continue;
+
+        uint32_t mid;
+        if (bestAxis >= 0) {
+            float lo = centroidBounds.min[bestAxis];
+            float scale = kBins / (centroidBounds.max[bestAxis] - lo);
+            uint32_t* split = std::partition(ids, ids + n, [&](uint32_t id) {
+                return std::min(kBins - 1, static_cast<int>((centroids[id][bestAxis] - lo) * scale)) < bestSplit;
+            });
+            mid = static_cast<uint32_t>(split - ids);
+        } else {
+            // Every centroid coincides but the node is too big for a leaf: split the list in half
+            mid = n / 2;
+        }
+        if (mid == 0 || mid == n) mid = n / 2;
+
+        uint32_t left = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back({vec3(0.0f), first, vec3(0.0f), mid});
+        nodes_.push_back({vec3(0.0f), first + mid, vec3(0.0f), n - mid});
+        nodes_[task.node].first = left;
+        nodes_[task.node].count = 0;
+        tasks.push_back({left + 1, task.depth + 1});
+        tasks.push_back({left, task.depth + 1});
+    }
+
+    triangles_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t* tri = indices.data() + triangleIds_[i] * 3;
+        const vec3& v0 = positions[tri[0]];
+        triangles_[i] = {v0, positions[tri[1]] - v0, positions[tri[2]] - v0};
+    }
+    buildMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <bool AnyHit>
+bool Render::Bvh::traverse(const Ray& ray, RayHit& hit, HitFilter filter, const void* context) const {
+    hit = RayHit{};
+    if (nodes_.empty()) return false;
+    const vec3 o = ray.origin, d = ray.direction;
+    const vec3 inv(safeReciprocal(d.x), safeReciprocal(d.y), safeReciprocal(d.z));
+    float tMax = ray.tMax;
+    bool found = false;
+
+    auto slab = [&](const Node& n, float& tNear) {
+        float tx1 = (n.boundsMin.x - o.x) * inv.x, tx2 = (n.boundsMax.x - o.x) * inv.x;
+        float ty1 = (n.boundsMin.y - o.y) * inv.y, ty2 = (n.boundsMax.y - o.y) * inv.y;
+        float tz1 = (n.boundsMin.z - o.z) * inv.z, tz2 = (n.boundsMax.z - o.z) * inv.z;
+        float tmin = std::max({std::min(tx1, tx2), std::min(ty1, ty2), std::min(tz1, tz2), 0.0f});
+        float tmax = std::min({std::max(tx1, tx2), std::max(ty1, ty2), std::max(tz1, tz2), tMax});
+        tNear = tmin;
+        return tmin <= tmax;
+    };
+
+    struct Entry {
+        uint32_t node;
+        float tNear;
+    };
+    Entry stack[kStackSize];
+    int sp = 0;
+    float rootNear;
+    if (!slab(nodes_[0], rootNear)) return false;
+    stack[sp++] = {0, rootNear};
+    while (sp > 0) {
+        Entry entry = stack[--sp];
+        if (entry.tNear > tMax) continue; // a closer hit was found since it was pushed
+        const Node& node = nodes_[entry.node];
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                const Triangle& tri = triangles_[i];
+                vec3 p = glm::cross(d, tri.e2);
+                float det = glm::dot(tri.e1, p);
+                if (std::abs(det) < kMinDeterminant) continue;
+                float invDet = 1.0f / det;
+                vec3 s = o - tri.v0;
+                float u = glm::dot(s, p) * invDet;
+                if (u < 0.0f || u > 1.0f) continue;
+                vec3 q = glm::cross(s, tri.e1);
+                float v = glm::dot(d, q) * invDet;
+                if (v < 0.0f || u + v > 1.0f) continue;
+                float t = glm::dot(tri.e2, q) * invDet;
+                if (t <= 0.0f || t >= tMax) continue;
+                if (filter && !filter(context, triangleIds_[i], u, v)) continue;
+                found = true;
+                if constexpr (AnyHit) return true;
+                tMax = t;
+                hit = {t, triangleIds_[i], u, v};
+            }
+            continue;
+        }
+        // Near child on top of the stack
+        uint32_t a = node.first, b = node.first + 1;
+        float ta, tb;
+        bool hitA = slab(nodes_[a], ta), hitB = slab(nodes_[b], tb);
+        if (hitA && hitB) {
+            if (tb < ta) {
+                std::swap(a, b);
+                std::swap(ta, tb);
+            }
+            stack[sp++] = {b, tb};
+            stack[sp++] = {a, ta};
+        } else if (hitA) {
+            stack[sp++] = {a, ta};
+        } else if (hitB) {
+            stack[sp++] = {b, tb};
+        }
+    }
+    return found;
+}
+
+bool Render::Bvh::intersect(const Ray& ray, RayHit& hit, HitFilter filter, const void* context) const {
+    return traverse<false>(ray, hit, filter, context);
+}
+
+bool Render::Bvh::occluded(const Ray& ray, HitFilter filter, const void* context) const {
+    RayHit hit;
+    return traverse<true>(ray, hit, filter, context);
+}
+
+void Render::Bvh::intersect(const RayPacket& packet, RayHit hits[4], HitFilter filter, const void* context) const {
+#if PBRE_BVH_SSE
+    for (int l = 0; l < 4; ++l) hits[l] = RayHit{};
+    if (nodes_.empty()) return;
+    const __m128 ox = _mm_loadu_ps(packet.ox), oy = _mm_loadu_ps(packet.oy), oz = _mm_loadu_ps(packet.oz);
+    const __m128 dx = _mm_loadu_ps(packet.dx), dy = _mm_loadu_ps(packet.dy), dz = _mm_loadu_ps(packet.dz);
+    float invArray[3][4];
+    for (int l = 0; l < 4; ++l) {
+        invArray[0][l] = safeReciprocal(packet.dx[l]);
+        invArray[1][l] = safeReciprocal(packet.dy[l]);
+        invArray[2][l] = safeReciprocal(packet.dz[l]);
+    }
+    const __m128 ix = _mm_loadu_ps(invArray[0]), iy = _mm_loadu_ps(invArray[1]), iz = _mm_loadu_ps(invArray[2]);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 signMask = _mm_set1_ps(-0.0f), minDet = _mm_set1_ps(kMinDeterminant);
+    __m128 tHit = _mm_loadu_ps(packet.tMax);
+
+    // Lanes whose ray enters the box before its current closest hit, and the nearest entry among them
+    auto slab = [&](const Node& n, float& tNear) {
+        __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.boundsMin.x), ox), ix);
+        __m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.boundsMax.x), ox), ix);
+        __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.boundsMin.y), oy), iy);
+        __m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.boundsMax.y), oy), iy);
+        __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.boundsMin.z), oz), iz);
+        __m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.boundsMax.z), oz), iz);
+        __m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_max_ps(_mm_min_ps(tz1, tz2), zero));
+        __m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_min_ps(_mm_max_ps(tz1, tz2), tHit));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+        if (mask) {
+            float lanes[4];
+            _mm_storeu_ps(lanes, tmin);
+            tNear = 1e30f;
+            for (int l = 0; l < 4; ++l) {
+                if (mask & (1 << l)) tNear = std::min(tNear, lanes[l]);
+            }
+        }
+        return mask;
+    };
+
+    uint32_t stack[kStackSize];
+    int sp = 0;
+    float rootNear;
+    if (!slab(nodes_[0], rootNear)) return;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        const Node& node = nodes_[stack[--sp]];
+        if (node.count > 0) {
+            float nearUnused;
+            if (!slab(node, nearUnused)) continue; // every lane found something closer since the push
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                const Triangle& tri = triangles_[i];
+                const __m128 e1x = _mm_set1_ps(tri.e1.x), e1y = _mm_set1_ps(tri.e1.y), e1z = _mm_set1_ps(tri.e1.z);
+                const __m128 e2x = _mm_set1_ps(tri.e2.x), e2y = _mm_set1_ps(tri.e2.y), e2z = _mm_set1_ps(tri.e2.z);
+                // p = cross(d, e2)
+                __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+                __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+                __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+                __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+                __m128 valid = _mm_cmpge_ps(_mm_andnot_ps(signMask, det), minDet);
+                if (!_mm_movemask_ps(valid)) continue;
+                __m128 invDet = _mm_div_ps(one, det);
+                __m128 sx = _mm_sub_ps(ox, _mm_set1_ps(tri.v0.x));
+                __m128 sy = _mm_sub_ps(oy, _mm_set1_ps(tri.v0.y));
+                __m128 sz = _mm_sub_ps(oz, _mm_set1_ps(tri.v0.z));
+                __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+                // q = cross(s, e1)
+                __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+                __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+                __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+                __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+                __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+                valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+                valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+                valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+                valid = _mm_and_ps(valid, _mm_cmpgt_ps(t, zero));
+                valid = _mm_and_ps(valid, _mm_cmplt_ps(t, tHit));
+                int mask = _mm_movemask_ps(valid);
+                if (!mask) continue;
+
+                float tLanes[4], uLanes[4], vLanes[4];
+                _mm_storeu_ps(tLanes, t);
+                _mm_storeu_ps(uLanes, u);
+                _mm_storeu_ps(vLanes, v);
+                for (int l = 0; l < 4; ++l) {
+                    if (!(mask & (1 << l))) continue;
+                    if (filter && !filter(context, triangleIds_[i], uLanes[l], vLanes[l])) {
+                        mask &= ~(1 << l);
+                        continue;
+                    }
+                    hits[l] = {tLanes[l], triangleIds_[i], uLanes[l], vLanes[l]};
+                }
+                float tNew[4];
+                _mm_storeu_ps(tNew, tHit);
+                for (int l = 0; l < 4; ++l) {
+                    if (mask & (1 << l)) tNew[l] = tLanes[l];
+                }
+                tHit = _mm_loadu_ps(tNew);
+            }
+            continue;
+        }
+        uint32_t a = node.first, b = node.first + 1;
+        float ta = 0.0f, tb = 0.0f;
+        bool hitA = slab(nodes_[a], ta) != 0, hitB = slab(nodes_[b], tb) != 0;
+        if (hitA && hitB) {
+            if (tb < ta) std::swap(a, b);
+            stack[sp++] = b;
+            stack[sp++] = a;
+        } else if (hitA) {
+            stack[sp++] = a;
+        } else if (hitB) {
+            stack[sp++] = b;
+        }
+    }
+#else
+    for (int l = 0; l < 4; ++l) {
+        Ray ray{vec3(packet.ox[l], packet.oy[l], packet.oz[l]), vec3(packet.dx[l], packet.dy[l], packet.dz[l]), packet.tMax[l]};
+        intersect(ray, hits[l], filter, context);
+    }
+#endif
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "pbre/base.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace PBRE::Render {
+struct Ray {
+    vec3 origin;
+    vec3 direction; // need not be normalized, t is in units of its length
+    float tMax = 1e30f;
+};
+
+struct RayHit {
+    static constexpr uint32_t kNone = UINT32_MAX;
+    float t = 1e30f;
+    uint32_t triangle = kNone; // index into the indices the BVH was built from, / 3
+    float u = 0.0f, v = 0.0f;  // barycentrics of the second and third vertex
+};
+
+// Four rays in SIMD lanes, traversed together. Meant for coherent rays such as neighbouring camera rays.
+struct RayPacket {
+    float ox[4], oy[4], oz[4];
+    float dx[4], dy[4], dz[4];
+    float tMax[4];
+    void set(int lane, const Ray& ray);
+};
+
+// Binary BVH over a triangle list built with binned SAH. Triangles are stored in leaf order.
+class Bvh {
+  public:
+    // Lets the caller reject a candidate hit, for alpha tested surfaces. Returns false to ignore the hit.
+    using HitFilter = bool (*)(const void* context, uint32_t triangle, float u, float v);
+
+    void build(std::span<const vec3> positions, std::span<const uint32_t> indices);
+
+    // Closest hit with t in (0, ray.tMax)
+    bool intersect(const Ray& ray, RayHit& hit, HitFilter filter = nullptr, const void* context = nullptr) const;
+    // Any hit with t in (0, ray.tMax), for shadow rays
+    bool occluded(const Ray& ray, HitFilter filter = nullptr, const void* context = nullptr) const;
+    // Closest hits of four rays. Uses SSE where available, else traces them one by one.
+    void intersect(const RayPacket& packet, RayHit hits[4], HitFilter filter = nullptr, const void* context = nullptr) const;
+
+    size_t nodeCount() const { return nodes_.size(); }
+    size_t triangleCount() const { return triangles_.size(); }
+    double buildMs() const { return buildMs_; }
+
+  private:
+    // 32 bytes. Interior nodes have count 0 and their children at first and first + 1.
+    struct Node {
+        vec3 boundsMin;
+        uint32_t first;
+        vec3 boundsMax;
+        uint32_t count;
+    };
+    // Precomputed for Moller-Trumbore
+    struct Triangle {
+        vec3 v0, e1, e2;
+    };
+
+    template <bool AnyHit> bool traverse(const Ray& ray, RayHit& hit, HitFilter filter, const void* context) const;
+
+    std::vector<Node> nodes_;
+    std::vector<Triangle> triangles_;
+    std::vector<uint32_t> triangleIds_; // leaf order -> input triangle
+    double buildMs_ = 0.0;
+};
+} // namespace PBRE::Render
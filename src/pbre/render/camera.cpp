@@ -65,3 +65,10 @@ mat4 Render::Camera::getViewMatrix() const {
 mat4 Render::Camera::getProjectionMatrix() const {
     return glm::perspective(glm::radians(fov_), aspect_, nearPlane_, farPlane_);
 }
+Render::Ray Render::Camera::getRay(const vec2& ndc) const {
+    vec4 far = glm::inverse(getProjectionMatrix() * getViewMatrix()) * vec4(ndc, 1.0f, 1.0f);
+    Ray ray;
+    ray.origin = position_;
+    ray.direction = glm::normalize(vec3(far) / far.w - position_);
+    return ray;
+}
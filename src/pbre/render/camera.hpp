@@ -4,6 +4,7 @@
 #include <glad/glad.h>
 
 #include "pbre/base.hpp"
+#include "pbre/render/bvh.hpp"
 
 namespace PBRE::Render {
 // 3d perspective camera
@@ -25,6 +26,8 @@ class Camera {
     quat getRotation() const;
     mat4 getViewMatrix() const;
     mat4 getProjectionMatrix() const;
+    // World space ray from the camera through a point given in NDC, for picking
+    Ray getRay(const vec2& ndc) const;
 
   private:
     vec3 position_;
@@ -0,0 +1,35 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace PBRE;
+
+float Render::DynamicResolution::update(double gpuMs) {
+    scaleHistory_[historyHead_] = scale_;
+    gpuMsHistory_[historyHead_] = static_cast<float>(gpuMs);
+    historyHead_ = (historyHead_ + 1) % kHistorySize;
+
+    accumMs_ += gpuMs;
+    if (++framesSinceAdjust_ < adjustInterval) return scale_;
+
+    double averageMs = accumMs_ / framesSinceAdjust_;
+    framesSinceAdjust_ = 0;
+    accumMs_ = 0.0;
+    if (averageMs <= 0.0) return scale_;
+
+    // Pixel count ~ scale^2, so the ideal scale changes with the square root of the time ratio
+    double ratio = (targetMs * headroom) / averageMs;
+    float ideal = scale_ * static_cast<float>(std::sqrt(ratio));
+    // Ignore small errors, otherwise the scale wobbles with timer noise
+    if (std::abs(ideal - scale_) < 0.02f) return scale_;
+
+    scale_ = std::clamp(scale_ + (ideal - scale_) * damping, minScale, maxScale);
+    return scale_;
+}
+
+void Render::DynamicResolution::reset() {
+    scale_ = maxScale;
+    framesSinceAdjust_ = 0;
+    accumMs_ = 0.0;
+}
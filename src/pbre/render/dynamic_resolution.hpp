@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+
+namespace PBRE::Render {
+// Chooses a render scale from measured GPU frame times. GPU cost is treated as proportional to
+// pixel count (scale squared), so each adjustment jumps most of the way to the scale that would
+// hit the target, damped and rate limited because timer results arrive a few frames late.
+class DynamicResolution {
+  public:
+    static constexpr int kHistorySize = 240;
+
+    // Feed the latest GPU time (ms) once per frame, returns the scale to render the next frame at
+    float update(double gpuMs);
+    void reset();
+
+    float scale() const { return scale_; }
+
+    float targetMs = 16.0f;
+    // Aim slightly below the target so noise does not push frames over budget
+    float headroom = 0.9f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // Fraction of the way to the ideal scale moved per adjustment
+    float damping = 0.5f;
+    // Frames between adjustments, longer than the GpuTimer readback latency so we see our last change
+    int adjustInterval = 6;
+
+    // Ring buffers for plotting, use historyOffset() as the ImGui::PlotLines values_offset
+    const std::array<float, kHistorySize>& scaleHistory() const { return scaleHistory_; }
+    const std::array<float, kHistorySize>& gpuMsHistory() const { return gpuMsHistory_; }
+    int historyOffset() const { return historyHead_; }
+
+  private:
+    float scale_ = 1.0f;
+    int framesSinceAdjust_ = 0;
+    double accumMs_ = 0.0;
+
+    std::array<float, kHistorySize> scaleHistory_{};
+    std::array<float, kHistorySize> gpuMsHistory_{};
+    int historyHead_ = 0;
+};
+} // namespace PBRE::Render
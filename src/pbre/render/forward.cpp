@@ -0,0 +1,209 @@
+#include "forward.hpp"
+
+#include "pbre/wrapper/gl_state.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <tuple>
+
+using namespace PBRE;
+
+static constexpr Wrapper::DrawFilter kVariantFilters[2] = {Wrapper::DrawFilter::Opaque, Wrapper::DrawFilter::AlphaTested};
+
+// glMultiDrawElementsIndirect's command layout
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance; // the draw's DrawInstance
+};
+
+Render::ForwardRenderer::ForwardRenderer() {
+    shading_[0].loadFromFiles("shaders/vert.glsl", "shaders/frag.glsl");
+    shading_[1].loadFromFiles("shaders/vert.glsl", "shaders/frag.glsl", {"ALPHA_MASK"});
+    depth_[0].loadFromFiles("shaders/depth_vert.glsl", "shaders/depth_frag.glsl");
+    depth_[1].loadFromFiles("shaders/depth_vert.glsl", "shaders/depth_frag.glsl", {"ALPHA_MASK"});
+    overdraw_[0].loadFromFiles("shaders/depth_vert.glsl", "shaders/depth_frag.glsl", {"OVERDRAW"});
+    overdraw_[1].loadFromFiles("shaders/depth_vert.glsl", "shaders/depth_frag.glsl", {"ALPHA_MASK", "OVERDRAW"});
+}
+
+void Render::ForwardRenderer::clearDraws() {
+    draws_.clear();
+}
+
+void Render::ForwardRenderer::submit(const Wrapper::Model& model, const mat4& transform) {
+    for (const auto& mesh : model.meshes) submit(model, mesh, transform);
+}
+
+void Render::ForwardRenderer::submit(const Wrapper::Model& model, const Wrapper::Mesh& mesh, const mat4& transform) {
+    if (mesh.indexCount == 0) return;
+    draws_.push_back({&model, &mesh, transform, glm::transpose(glm::inverse(mat3(transform)))});
+}
+
+void Render::ForwardRenderer::loadTableShaders(bool bindless) {
+    if (tableShadersLoaded_[bindless]) return;
+    std::vector<std::string> base = {"MATERIAL_TABLE"};
+    if (bindless) base.push_back("BINDLESS");
+    auto with = [&](std::initializer_list<const char*> extra) {
+        auto defines = base;
+        defines.insert(defines.end(), extra.begin(), extra.end());
+        return defines;
+    };
+    tableShading_[bindless][0].loadFromFiles("shaders/vert.glsl", "shaders/frag.glsl", base);
+    tableShading_[bindless][1].loadFromFiles("shaders/vert.glsl", "shaders/frag.glsl", with({"ALPHA_MASK"}));
+    tableDepth_[bindless][0].loadFromFiles("shaders/depth_vert.glsl", "shaders/depth_frag.glsl", base);
+    tableDepth_[bindless][1].loadFromFiles("shaders/depth_vert.glsl", "shaders/depth_frag.glsl", with({"ALPHA_MASK"}));
+    tableOverdraw_[bindless][0].loadFromFiles("shaders/depth_vert.glsl", "shaders/depth_frag.glsl", with({"OVERDRAW"}));
+    tableOverdraw_[bindless][1].loadFromFiles("shaders/depth_vert.glsl", "shaders/depth_frag.glsl", with({"ALPHA_MASK", "OVERDRAW"}));
+    tableShadersLoaded_[bindless] = true;
+}
+
+void Render::ForwardRenderer::render(Wrapper::RingBuffer& ring, const ForwardOptions& options, const MaterialTable* table) {
+    auto& state = Wrapper::GlState::instance();
+    stats_ = {};
+    if (options.materialTable && table && !table->empty() &&
+        std::all_of(draws_.begin(), draws_.end(), [&](const DrawRecord& draw) { return table->contains(*draw.model); })) {
+        renderBatched(ring, options, *table);
+        return;
+    }
+
+    drawData_.clear();
+    for (const auto& draw : draws_) {
+        DrawData data;
+        data.setTransform(draw.transform, draw.normalMatrix);
+        data.material = draw.model->materialData(draw.mesh->materialIndex);
+        drawData_.push_back(ring.write(data));
+    }
+
+    state.setEnabled(GL_DEPTH_TEST, true);
+    state.depthFunc(GL_LESS);
+    state.depthMask(true);
+
+    if (options.depthPrepass) {
+        state.colorMask(false);
+        // Opaque first: they are cheap and fill depth before the alpha tested ones run
+        for (int v = 0; v < 2; ++v) {
+            depth_[v].use();
+            for (size_t i = 0; i < draws_.size(); ++i) {
+                const auto& draw = draws_[i];
+                if (draw.model->isAlphaTested(*draw.mesh) != (v == 1)) continue;
+                ring.bindUniform(kDrawDataBinding, drawData_[i]);
+                stats_.textureBinds += draw.model->drawMeshDepth(*draw.mesh, kVariantFilters[v]);
+                ++stats_.draws;
+                ++stats_.drawCalls;
+            }
+        }
+        state.colorMask(true);
+        // Depth is final, only the visible surface of each sample passes
+        state.depthFunc(GL_EQUAL);
+        state.depthMask(false);
+    }
+
+    if (options.overdraw) {
+        state.setEnabled(GL_BLEND, true);
+        state.blendFunc(GL_ONE, GL_ONE);
+    }
+
+    Wrapper::Shader* shaders = options.overdraw ? overdraw_ : shading_;
+    for (int v = 0; v < 2; ++v) {
+        shaders[v].use();
+        shaders[v].set("uShaderNormalMatrix", options.shaderNormalMatrix ? 1 : 0);
+        for (size_t i = 0; i < draws_.size(); ++i) {
+            const auto& draw = draws_[i];
+            if (draw.model->isAlphaTested(*draw.mesh) != (v == 1)) continue;
+            ring.bindUniform(kDrawDataBinding, drawData_[i]);
+            stats_.textureBinds += draw.model->drawMesh(*draw.mesh, kVariantFilters[v]);
+            ++stats_.draws;
+            ++stats_.drawCalls;
+        }
+    }
+
+    if (options.overdraw) state.setEnabled(GL_BLEND, false);
+    state.depthFunc(GL_LESS);
+    state.depthMask(true);
+}
+
+void Render::ForwardRenderer::renderBatched(Wrapper::RingBuffer& ring, const ForwardOptions& options, const MaterialTable& table) {
+    auto& state = Wrapper::GlState::instance();
+    stats_.batched = true;
+    if (draws_.empty()) return;
+    int bindless = table.bindless() ? 1 : 0;
+    loadTableShaders(bindless);
+
+    // Opaque before alpha tested, then by vertex arrays so meshes sharing buffers end up in one batch
+    order_.resize(draws_.size());
+    for (size_t i = 0; i < draws_.size(); ++i) order_[i] = static_cast<uint32_t>(i);
+    auto key = [&](uint32_t i) {
+        const auto& draw = draws_[i];
+        return std::tuple(draw.model->isAlphaTested(*draw.mesh), draw.mesh->vao, draw.mesh->depthVao);
+    };
+    std::stable_sort(order_.begin(), order_.end(), [&](uint32_t a, uint32_t b) { return key(a) < key(b); });
+
+    auto instances = ring.allocate(draws_.size() * sizeof(DrawInstance));
+    auto commands = ring.allocate(draws_.size() * sizeof(DrawElementsIndirectCommand));
+    for (auto& batches : batches_) batches.clear();
+    for (size_t k = 0; k < order_.size(); ++k) {
+        uint32_t i = order_[k];
+        const auto& draw = draws_[i];
+        DrawInstance instance;
+        instance.setTransform(draw.transform, draw.normalMatrix);
+        instance.material = table.material(*draw.model, draw.mesh->materialIndex);
+        std::memcpy(static_cast<DrawInstance*>(instances.data) + i, &instance, sizeof(instance));
+        DrawElementsIndirectCommand command{static_cast<GLuint>(draw.mesh->indexCount), 1, 0, 0, i};
+        std::memcpy(static_cast<DrawElementsIndirectCommand*>(commands.data) + k, &command, sizeof(command));
+
+        auto& batches = batches_[draw.model->isAlphaTested(*draw.mesh) ? 1 : 0];
+        if (batches.empty() || batches.back().vao != draw.mesh->vao || batches.back().depthVao != draw.mesh->depthVao) {
+            batches.push_back({draw.mesh->vao, draw.mesh->depthVao, k, 0});
+        }
+        ++batches.back().count;
+    }
+
+    ring.bindStorage(kDrawInstanceBinding, instances);
+    stats_.textureBinds += table.bind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.buffer());
+    auto drawBatches = [&](int v, bool depthOnly) {
+        for (const auto& batch : batches_[v]) {
+            // Opaque depth draws only need the position stream
+            state.bindVertexArray(depthOnly && v == 0 ? batch.depthVao : batch.vao);
+            auto offset = static_cast<size_t>(commands.offset) + batch.first * sizeof(DrawElementsIndirectCommand);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(offset), static_cast<GLsizei>(batch.count), 0);
+            stats_.draws += static_cast<int>(batch.count);
+            ++stats_.drawCalls;
+        }
+    };
+
+    state.setEnabled(GL_DEPTH_TEST, true);
+    state.depthFunc(GL_LESS);
+    state.depthMask(true);
+
+    if (options.depthPrepass) {
+        state.colorMask(false);
+        for (int v = 0; v < 2; ++v) {
+            tableDepth_[bindless][v].use();
+            drawBatches(v, true);
+        }
+        state.colorMask(true);
+        state.depthFunc(GL_EQUAL);
+        state.depthMask(false);
+    }
+
+    if (options.overdraw) {
+        state.setEnabled(GL_BLEND, true);
+        state.blendFunc(GL_ONE, GL_ONE);
+    }
+
+    Wrapper::Shader* shaders = options.overdraw ? tableOverdraw_[bindless] : tableShading_[bindless];
+    for (int v = 0; v < 2; ++v) {
+        shaders[v].use();
+        shaders[v].set("uShaderNormalMatrix", options.shaderNormalMatrix ? 1 : 0);
+        drawBatches(v, false);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    if (options.overdraw) state.setEnabled(GL_BLEND, false);
+    state.depthFunc(GL_LESS);
+    state.depthMask(true);
+}
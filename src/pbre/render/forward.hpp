@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "pbre/base.hpp"
+#include "pbre/render/material_table.hpp"
+#include "pbre/wrapper/model.hpp"
+#include "pbre/wrapper/ring_buffer.hpp"
+#include "pbre/wrapper/shader.hpp"
+
+#include <array>
+#include <vector>
+
+namespace PBRE::Render {
+struct ForwardOptions {
+    // Depth only pass first, then shade with GL_EQUAL so each sample is shaded at most once
+    bool depthPrepass = false;
+    // Replace shading with a fragment counter (additive) for the tonemap pass to show as a heat map
+    bool overdraw = false;
+    // Compute the normal matrix per vertex in the shader instead of once per draw, for measuring
+    bool shaderNormalMatrix = false;
+    // Read materials from the MaterialTable given to render() and draw meshes sharing vertex buffers with
+    // one multi draw, instead of a draw and the material's texture binds per mesh
+    bool materialTable = false;
+};
+
+// Counted over the last render()
+struct ForwardStats {
+    int draws = 0;     // meshes drawn, summed over the passes
+    int drawCalls = 0; // GL draw calls issued for them
+    int textureBinds = 0;
+    bool batched = false;
+};
+
+// Forward renderer for the MSAA path. Opaque meshes use shader variants compiled without the alpha
+// test discard so early depth testing stays enabled, alpha tested meshes are drawn after them with
+// the ALPHA_MASK variants.
+class ForwardRenderer {
+  public:
+    ForwardRenderer();
+
+    void clearDraws();
+    // Every mesh of the model with one transform
+    void submit(const Wrapper::Model& model, const mat4& transform);
+    void submit(const Wrapper::Model& model, const Wrapper::Mesh& mesh, const mat4& transform);
+
+    // Draws into the currently bound framebuffer, which the caller has cleared. Each draw's DrawData is
+    // written to the ring once and bound by offset in every pass; FrameData must already be bound.
+    // options.materialTable needs a table containing every submitted model, otherwise the draws go one by one.
+    void render(Wrapper::RingBuffer& ring, const ForwardOptions& options, const MaterialTable* table = nullptr);
+
+    const ForwardStats& stats() const { return stats_; }
+
+  private:
+    // A run of the batched draw order sharing vertex arrays
+    struct Batch {
+        GLuint vao;
+        GLuint depthVao;
+        size_t first; // into the indirect commands
+        size_t count;
+    };
+
+    void renderBatched(Wrapper::RingBuffer& ring, const ForwardOptions& options, const MaterialTable& table);
+    // The MATERIAL_TABLE variants, compiled on first use per bindless mode
+    void loadTableShaders(bool bindless);
+
+    struct DrawRecord {
+        const Wrapper::Model* model;
+        const Wrapper::Mesh* mesh;
+        mat4 transform;
+        mat3 normalMatrix; // inverse transpose of the transform's 3x3
+    };
+
+    // Index 0 = opaque, 1 = alpha tested
+    Wrapper::Shader shading_[2];
+    Wrapper::Shader depth_[2];
+    Wrapper::Shader overdraw_[2];
+    std::vector<DrawRecord> draws_;
+    std::vector<Wrapper::RingBuffer::Allocation> drawData_; // per draw record, this frame
+
+    // [bindless][alpha tested]
+    Wrapper::Shader tableShading_[2][2];
+    Wrapper::Shader tableDepth_[2][2];
+    Wrapper::Shader tableOverdraw_[2][2];
+    bool tableShadersLoaded_[2] = {};
+    std::vector<uint32_t> order_; // draw indices sorted into batches
+    std::vector<Batch> batches_[2];
+    ForwardStats stats_;
+};
+} // namespace PBRE::Render
@@ -0,0 +1,216 @@
+#include "frame_capture.hpp"
+
+#include "pbre/wrapper/gl_state.hpp"
+#include "pbre/wrapper/gpu_memory.hpp"
+
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+using namespace PBRE;
+
+namespace {
+size_t pixelBytes(Render::CaptureFormat format) {
+    return format == Render::CaptureFormat::Png ? 3 : 3 * sizeof(float);
+}
+} // namespace
+
+Render::FrameCapture::FrameCapture(int workers) {
+    for (int i = 0; i < std::max(workers, 1); ++i) workers_.emplace_back(&FrameCapture::workerLoop, this);
+}
+
+Render::FrameCapture::~FrameCapture() {
+    flush();
+    {
+        std::lock_guard lock(mutex_);
+        quit_ = true;
+    }
+    jobReady_.notify_all();
+    for (auto& worker : workers_) worker.join();
+    for (auto& slot : slots_) {
+        if (!slot.pbo) continue;
+        Wrapper::GpuMemory::instance().release(GL_BUFFER, slot.pbo);
+        glDeleteBuffers(1, &slot.pbo);
+    }
+}
+
+bool Render::FrameCapture::start(const std::string& directory, CaptureFormat format) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) return false;
+    {
+        std::lock_guard lock(mutex_);
+        stats_ = {};
+        startTime_ = std::chrono::steady_clock::now();
+    }
+    directory_ = directory;
+    format_ = format;
+    nextFrame_ = 0;
+    active_ = true;
+    return true;
+}
+
+void Render::FrameCapture::stop() {
+    active_ = false;
+}
+
+void Render::FrameCapture::capture(GLuint framebuffer, int width, int height) {
+    if (!active_ || width <= 0 || height <= 0) return;
+    poll();
+    {
+        std::lock_guard lock(mutex_);
+        ++stats_.requested;
+        if (slots_[head_].state != SlotState::Free) {
+            ++stats_.dropped;
+            return;
+        }
+    }
+
+    Slot& slot = slots_[head_];
+    size_t bytes = static_cast<size_t>(width) * height * pixelBytes(format_);
+    if (!slot.pbo) glGenBuffers(1, &slot.pbo);
+    if (slot.capacity < bytes) {
+        if (!Wrapper::GpuMemory::instance().track({.objectType = GL_BUFFER, .name = slot.pbo, .category = Wrapper::GpuCategory::Readback, .bytes = bytes, .owner = "FrameCapture", .site = std::source_location::current()})) {
+            std::lock_guard lock(mutex_);
+            ++stats_.dropped;
+            return;
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (slot.capacity < bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        slot.capacity = bytes;
+    }
+    Wrapper::GlState::instance().bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // Into the bound pack buffer, returns without waiting for the GPU
+    glReadPixels(0, 0, width, height, GL_RGB, format_ == CaptureFormat::Png ? GL_UNSIGNED_BYTE : GL_FLOAT, nullptr);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    Wrapper::GlState::instance().bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state = SlotState::Reading;
+    slot.copied = false;
+    slot.width = width;
+    slot.height = height;
+    slot.format = format_;
+    slot.frame = nextFrame_++;
+    head_ = (head_ + 1) % kRingSize;
+    ++inFlight_;
+}
+
+void Render::FrameCapture::poll() {
+    // Map finished readbacks while the encoders have room
+    for (int i = 0; i < inFlight_; ++i) {
+        Slot& slot = slots_[(tail_ + i) % kRingSize];
+        if (slot.state != SlotState::Reading) continue;
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+        {
+            std::lock_guard lock(mutex_);
+            if (queue_.size() >= kQueueCapacity) break;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        size_t bytes = static_cast<size_t>(slot.width) * slot.height * pixelBytes(slot.format);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.state = SlotState::Mapped;
+        slot.mapped = pixels != nullptr;
+        {
+            std::lock_guard lock(mutex_);
+            if (!pixels) {
+                ++stats_.failed;
+                slot.copied = true;
+                continue;
+            }
+            char path[32];
+            std::snprintf(path, sizeof(path), "frame_%06llu.%s", static_cast<unsigned long long>(slot.frame),
+                          slot.format == CaptureFormat::Png ? "png" : "hdr");
+            queue_.push_back({(tail_ + i) % kRingSize, static_cast<const uint8_t*>(pixels), slot.width, slot.height, slot.format,
+                              (std::filesystem::path(directory_) / path).string()});
+            stats_.readbackBytes += bytes;
+        }
+        jobReady_.notify_one();
+    }
+
+    // Recycle buffers in order once their pixels have been copied out
+    while (inFlight_ > 0) {
+        Slot& slot = slots_[tail_];
+        if (slot.state != SlotState::Mapped || !slot.copied.load(std::memory_order_acquire)) break;
+        if (slot.mapped) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.mapped = false;
+        }
+        slot.state = SlotState::Free;
+        tail_ = (tail_ + 1) % kRingSize;
+        --inFlight_;
+    }
+}
+
+void Render::FrameCapture::flush() {
+    glFlush(); // make sure the fences get submitted
+    while (true) {
+        poll();
+        std::unique_lock lock(mutex_);
+        if (inFlight_ == 0 && queue_.empty() && encoding_ == 0) return;
+        jobDone_.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+Render::CaptureStats Render::FrameCapture::stats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+void Render::FrameCapture::workerLoop() {
+    std::vector<uint8_t> pixels;
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(mutex_);
+            jobReady_.wait(lock, [&] { return quit_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            job = std::move(queue_.front());
+            queue_.pop_front();
+            ++encoding_;
+        }
+
+        // GL rows are bottom up; copy them out flipped so the buffer can go back to the render thread
+        auto start = std::chrono::steady_clock::now();
+        size_t row = static_cast<size_t>(job.width) * pixelBytes(job.format);
+        pixels.resize(row * job.height);
+        for (int y = 0; y < job.height; ++y) {
+            std::memcpy(pixels.data() + row * y, job.pixels + row * (job.height - 1 - y), row);
+        }
+        slots_[job.slot].copied.store(true, std::memory_order_release);
+
+        bool ok = job.format == CaptureFormat::Png
+                      ? stbi_write_png(job.path.c_str(), job.width, job.height, 3, pixels.data(), static_cast<int>(row)) != 0
+                      : stbi_write_hdr(job.path.c_str(), job.width, job.height, 3, reinterpret_cast<const float*>(pixels.data())) != 0;
+        std::error_code error;
+        size_t written = ok ? std::filesystem::file_size(job.path, error) : 0;
+        auto end = std::chrono::steady_clock::now();
+        {
+            std::lock_guard lock(mutex_);
+            --encoding_;
+            if (ok) {
+                ++stats_.encoded;
+                stats_.writtenBytes += error ? 0 : written;
+            } else {
+                ++stats_.failed;
+            }
+            stats_.encodeMs += std::chrono::duration<double, std::milli>(end - start).count();
+            stats_.seconds = std::chrono::duration<double>(end - startTime_).count();
+        }
+        jobDone_.notify_all();
+    }
+}
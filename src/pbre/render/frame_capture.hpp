@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace PBRE::Render {
+enum class CaptureFormat {
+    Png, // 8-bit RGB, for the tonemapped frame
+    Hdr, // float RGB (Radiance RGBE), for the linear scene color
+};
+
+struct CaptureStats {
+    int requested = 0;
+    int dropped = 0; // every readback buffer was still busy
+    int encoded = 0;
+    int failed = 0;
+    size_t readbackBytes = 0;
+    size_t writtenBytes = 0;
+    double encodeMs = 0.0; // summed over the workers
+    double seconds = 0.0;  // from start() to the last finished encode
+
+    double framesPerSecond() const { return seconds > 0.0 ? encoded / seconds : 0.0; }
+    double readbackMegabytesPerSecond() const { return seconds > 0.0 ? readbackBytes / (seconds * 1.0e6) : 0.0; }
+};
+
+// Captures frames to numbered image files without stalling the render thread. Reads go into a ring of
+// pixel pack buffers and are fenced; poll() maps the ones the GPU has finished and hands them to encoder
+// threads, which copy the rows out (the buffer is unmapped on the next poll) and encode them. The encode
+// queue is bounded: when it is full, finished readbacks stay in their buffers, and once every buffer is
+// busy new captures are dropped and counted instead of waiting.
+class FrameCapture {
+  public:
+    static constexpr int kRingSize = 3;
+    static constexpr size_t kQueueCapacity = 4;
+
+    explicit FrameCapture(int workers = 2);
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Frames go to directory/frame_000000.png (or .hdr), the directory is created if needed
+    bool start(const std::string& directory, CaptureFormat format);
+    // Stops accepting frames, the ones already read keep encoding
+    void stop();
+    bool active() const { return active_; }
+    CaptureFormat format() const { return format_; }
+
+    // Reads color attachment 0 of framebuffer (the back buffer for 0) asynchronously
+    void capture(GLuint framebuffer, int width, int height);
+    // Hands finished readbacks to the encoders and recycles copied buffers. Call once per frame, never waits.
+    void poll();
+    // Waits for every readback and encode in flight, for benchmarks and shutdown
+    void flush();
+
+    CaptureStats stats() const;
+
+  private:
+    enum class SlotState {
+        Free,
+        Reading, // glReadPixels issued, fence pending
+        Mapped,  // handed to an encoder, which sets copied once it has the pixels
+    };
+    struct Slot {
+        GLuint pbo = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        SlotState state = SlotState::Free;
+        std::atomic<bool> copied{false};
+        bool mapped = false;
+        int width = 0, height = 0;
+        CaptureFormat format = CaptureFormat::Png;
+        uint64_t frame = 0;
+    };
+    // Everything the encoder needs, the slot itself is reused once its pixels are copied
+    struct Job {
+        int slot = 0;
+        const uint8_t* pixels = nullptr;
+        int width = 0, height = 0;
+        CaptureFormat format = CaptureFormat::Png;
+        std::string path;
+    };
+
+    void workerLoop();
+
+    std::array<Slot, kRingSize> slots_;
+    int head_ = 0; // next slot to read into
+    int tail_ = 0; // oldest slot not yet recycled
+    int inFlight_ = 0;
+
+    bool active_ = false;
+    CaptureFormat format_ = CaptureFormat::Png;
+    std::string directory_;
+    uint64_t nextFrame_ = 0;
+    std::chrono::steady_clock::time_point startTime_; // guarded by mutex_
+
+    std::vector<std::thread> workers_;
+    mutable std::mutex mutex_;
+    std::condition_variable jobReady_;
+    std::condition_variable jobDone_;
+    std::deque<Job> queue_;
+    int encoding_ = 0;
+    bool quit_ = false;
+    CaptureStats stats_;
+};
+} // namespace PBRE::Render
@@ -0,0 +1,97 @@
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+using namespace PBRE;
+
+namespace {
+double msBetween(Render::FramePacer::Clock::time_point from, Render::FramePacer::Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+} // namespace
+
+void Render::FramePacer::waitUntil(Clock::time_point deadline) {
+    auto start = Clock::now();
+    auto spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(spinMs));
+    if (deadline - start > spin) std::this_thread::sleep_until(deadline - spin);
+    while (Clock::now() < deadline) std::this_thread::yield();
+    waitMs_ += msBetween(start, Clock::now());
+}
+
+double Render::FramePacer::periodMs() const {
+    switch (mode) {
+    case PacingMode::Vsync:
+    case PacingMode::LateLatch: return refreshMs;
+    case PacingMode::Limiter: return 1000.0 / std::max(targetFps, 1.0f);
+    default: return stats_.frameMs;
+    }
+}
+
+void Render::FramePacer::waitForLatch() {
+    if (mode != PacingMode::LateLatch || !started_) return;
+    // The swap returned at the last vblank, the next one is a refresh later. Sample input as late as the
+    // predicted work still fits before it.
+    auto vblank = lastPresent_ + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(refreshMs));
+    auto latch = vblank - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(workMs_ + latchMarginMs));
+    if (latch > Clock::now()) waitUntil(latch);
+}
+
+float Render::FramePacer::sampleInput() {
+    auto now = Clock::now();
+    float seconds = lastInput_ == Clock::time_point{} ? 0.0f : static_cast<float>(msBetween(lastInput_, now) / 1000.0);
+    lastInput_ = now;
+    return std::min(seconds, 0.1f);
+}
+
+void Render::FramePacer::submitted() {
+    submit_ = Clock::now();
+}
+
+void Render::FramePacer::presented(double gpuMs) {
+    auto now = Clock::now();
+    if (started_) {
+        frameMsHistory_[historyHead_] = static_cast<float>(msBetween(lastPresent_, now));
+        latencyMsHistory_[historyHead_] = static_cast<float>(msBetween(lastInput_, now) + refreshMs * 0.5);
+        historyHead_ = (historyHead_ + 1) % kHistorySize;
+        historyCount_ = std::min(historyCount_ + 1, kHistorySize);
+
+        // Rises at once with a slow frame and decays slowly, a late latch that misses the vblank costs a frame
+        double work = std::max(msBetween(lastInput_, submit_), 0.0) + gpuMs;
+        workMs_ = std::max(work, workMs_ + (work - workMs_) * 0.05);
+
+        double sum = 0.0, sumSquares = 0.0, latency = 0.0, maxMs = 0.0;
+        for (int i = 0; i < historyCount_; ++i) {
+            sum += frameMsHistory_[i];
+            sumSquares += static_cast<double>(frameMsHistory_[i]) * frameMsHistory_[i];
+            latency += latencyMsHistory_[i];
+            maxMs = std::max(maxMs, static_cast<double>(frameMsHistory_[i]));
+        }
+        stats_.frameMs = sum / historyCount_;
+        stats_.jitterMs = std::sqrt(std::max(sumSquares / historyCount_ - stats_.frameMs * stats_.frameMs, 0.0));
+        stats_.maxFrameMs = maxMs;
+        stats_.latencyMs = latency / historyCount_;
+        stats_.predictedWorkMs = workMs_;
+        double missedMs = periodMs() * 1.5;
+        stats_.missed = static_cast<int>(std::count_if(frameMsHistory_.begin(), frameMsHistory_.begin() + historyCount_,
+                                                       [&](float ms) { return ms > missedMs; }));
+    }
+    stats_.waitMs = waitMs_;
+    waitMs_ = 0.0;
+    lastPresent_ = now;
+    started_ = true;
+}
+
+void Render::FramePacer::waitForFrame() {
+    if (mode != PacingMode::Limiter) {
+        deadline_ = {};
+        return;
+    }
+    auto now = Clock::now();
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(periodMs()));
+    // Fixed deadlines keep the average on target, a frame that ran more than a period over starts afresh
+    deadline_ += period;
+    if (deadline_ < now - period) deadline_ = now;
+    waitUntil(deadline_);
+}
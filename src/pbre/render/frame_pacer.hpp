@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+
+namespace PBRE::Render {
+enum class PacingMode {
+    Uncapped,  // no vsync, no limit
+    Vsync,     // swap interval 1
+    Limiter,   // no vsync, sleep then spin to targetFps
+    LateLatch, // vsync, waits to sample input until just enough time is left to make the next vblank
+};
+
+// Paces frames and measures the result. Per frame, in this order:
+//   waitForLatch() (late latch only, then poll events), sampleInput() before input moves the camera,
+//   submitted() right before the swap, presented() once it returns, waitForFrame() before polling events.
+// Input latency is estimated as input sample to swap return plus half a refresh of scanout, so it leaves
+// out display processing and any frames the driver queues past the swap.
+class FramePacer {
+  public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr int kHistorySize = 240;
+
+    PacingMode mode = PacingMode::Vsync;
+    float targetFps = 60.0f;
+    // The limiter sleeps until this close to the deadline and spins the rest, OS sleeps overshoot by ~1 ms
+    float spinMs = 1.5f;
+    // Late latch safety margin on top of the predicted CPU + GPU work
+    float latchMarginMs = 1.0f;
+    // Display refresh, for the late latch vblank prediction and the scanout part of the latency
+    double refreshMs = 1000.0 / 60.0;
+
+    int swapInterval() const { return mode == PacingMode::Vsync || mode == PacingMode::LateLatch ? 1 : 0; }
+    // Late latch glFinish()es after the swap, so the swap returns at the vblank instead of queuing frames
+    bool finishAfterSwap() const { return mode == PacingMode::LateLatch; }
+
+    void waitForLatch();
+    // Seconds since the previous sample, the step camera movement should use (clamped to 0.1 s)
+    float sampleInput();
+    void submitted();
+    // gpuMs is the latest measured GPU frame time, for the late latch work prediction
+    void presented(double gpuMs);
+    void waitForFrame();
+
+    struct Stats {
+        double frameMs = 0.0;   // mean frame interval over the history
+        double jitterMs = 0.0;  // standard deviation of the frame interval
+        double maxFrameMs = 0.0;
+        double latencyMs = 0.0; // mean estimated input latency
+        double waitMs = 0.0;    // time the last frame spent in waitForFrame or waitForLatch
+        double predictedWorkMs = 0.0;
+        int missed = 0;         // intervals over 1.5x the paced period in the history
+    };
+    const Stats& stats() const { return stats_; }
+
+    // Ring buffers for plotting, use historyOffset() as the ImGui::PlotLines values_offset
+    const std::array<float, kHistorySize>& frameMsHistory() const { return frameMsHistory_; }
+    const std::array<float, kHistorySize>& latencyMsHistory() const { return latencyMsHistory_; }
+    int historyOffset() const { return historyHead_; }
+
+  private:
+    // Sleeps until shortly before the deadline, then spins
+    void waitUntil(Clock::time_point deadline);
+    double periodMs() const;
+
+    Clock::time_point lastInput_{};
+    Clock::time_point lastPresent_{};
+    Clock::time_point submit_{};
+    Clock::time_point deadline_{};
+    double waitMs_ = 0.0;
+    double workMs_ = 0.0;
+    bool started_ = false;
+    Stats stats_;
+
+    std::array<float, kHistorySize> frameMsHistory_{};
+    std::array<float, kHistorySize> latencyMsHistory_{};
+    int historyHead_ = 0;
+    int historyCount_ = 0;
+};
+} // namespace PBRE::Render
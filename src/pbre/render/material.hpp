@@ -16,6 +16,13 @@ using NormalParam = std::shared_ptr<PBRE::Wrapper::Texture>; // only texture
 using AOParam = std::variant<float, std::shared_ptr<PBRE::Wrapper::Texture>>;
 using EmissiveParam = std::variant<vec3, std::shared_ptr<PBRE::Wrapper::Texture>>;
 
+// glTF alpha modes. BLEND has no sorted transparency pass yet and is alpha tested like MASK.
+enum class AlphaMode {
+    Opaque,
+    Mask,
+    Blend,
+};
+
 struct Material {
     AlbedoParam albedo = vec3(1.0f);
     MetallicParam metallic = 0.0f;
@@ -23,8 +30,28 @@ struct Material {
     NormalParam normal = nullptr;
     AOParam ao = 1.0f;
     EmissiveParam emissive = vec3(0.0f);
+    // The metallic, roughness and AO textures are one packed ORM texture (Model::decode packs the glTF ones),
+    // each parameter read from its channel. Shaders fetch it once and don't support three different textures.
+    int metallicChannel = 2;
+    int roughnessChannel = 1;
+    int aoChannel = 0;
+    // glTF metallicFactor, roughnessFactor and occlusion strength, applied to the packed texture's channels:
+    // metallic and roughness are scaled, AO moves from 1 towards the channel by the strength. Constants
+    // already have them folded in.
+    float metallicFactor = 1.0f;
+    float roughnessFactor = 1.0f;
+    float aoStrength = 1.0f;
 
     bool doubleSided = false; // not used yet (glTF extension, default false)
-    float alphaCutoff = 0.5f; // not used yet (glTF extension, default 0.5)
+    AlphaMode alphaMode = AlphaMode::Opaque;
+    float alphaCutoff = 0.5f; // only used when alphaMode is Mask
+
+    // The packed texture, null when all three are constants
+    std::shared_ptr<PBRE::Wrapper::Texture> ormTexture() const {
+        for (const auto* param : {&metallic, &roughness, &ao}) {
+            if (auto tex = std::get_if<std::shared_ptr<PBRE::Wrapper::Texture>>(param); tex && *tex) return *tex;
+        }
+        return nullptr;
+    }
 };
 }; // namespace PBRE::Render
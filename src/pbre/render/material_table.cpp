@@ -0,0 +1,276 @@
+#include "material_table.hpp"
+
+#include "pbre/wrapper/gl_state.hpp"
+#include "pbre/wrapper/gpu_memory.hpp"
+#include "pbre/wrapper/model.hpp"
+#include "pbre/wrapper/texture.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+using namespace PBRE;
+
+namespace {
+// ARB_bindless_texture is loaded here rather than through glad, whose build only has the core profile
+struct BindlessApi {
+    using GetTextureHandle = GLuint64(APIENTRY*)(GLuint texture);
+    using HandleResidency = void(APIENTRY*)(GLuint64 handle);
+    GetTextureHandle getTextureHandle = nullptr;
+    HandleResidency makeResident = nullptr;
+    HandleResidency makeNonResident = nullptr;
+};
+
+// Null without the extension, must be called with a current context the first time
+const BindlessApi* bindlessApi() {
+    static const BindlessApi api = [] {
+        BindlessApi api;
+        if (!glfwExtensionSupported("GL_ARB_bindless_texture")) return api;
+        api.getTextureHandle = reinterpret_cast<BindlessApi::GetTextureHandle>(glfwGetProcAddress("glGetTextureHandleARB"));
+        api.makeResident = reinterpret_cast<BindlessApi::HandleResidency>(glfwGetProcAddress("glMakeTextureHandleResidentARB"));
+        api.makeNonResident = reinterpret_cast<BindlessApi::HandleResidency>(glfwGetProcAddress("glMakeTextureHandleNonResidentARB"));
+        if (!api.getTextureHandle || !api.makeResident || !api.makeNonResident) return BindlessApi{};
+        return api;
+    }();
+    return api.getTextureHandle ? &api : nullptr;
+}
+
+// The 8-bit loads pass unsized formats, texture storage needs the sized ones
+GLenum sizedFormat(GLenum format) {
+    switch (format) {
+    case GL_RED: return GL_R8;
+    case GL_RG: return GL_RG8;
+    case GL_RGB: return GL_RGB8;
+    case GL_RGBA: return GL_RGBA8;
+    default: return format;
+    }
+}
+
+const Wrapper::Texture* mapTexture(const Render::Material& material, int map) {
+    auto texture = [](const auto& param) -> const Wrapper::Texture* {
+        auto tex = std::get_if<std::shared_ptr<Wrapper::Texture>>(&param);
+        return tex ? tex->get() : nullptr;
+    };
+    switch (map) {
+    case Render::kAlbedoMap: return texture(material.albedo);
+    case Render::kOrmMap: return material.ormTexture().get();
+    case Render::kNormalMap: return material.normal.get();
+    case Render::kEmissiveMap: return texture(material.emissive);
+    default: return nullptr;
+    }
+}
+
+// Falls back to the constants a map stands for. Under an ORM map they hold the factors, which are the
+// metallic and roughness without it; the AO strength alone is no occlusion.
+void dropMap(Render::MaterialData& data, int map) {
+    switch (map) {
+    case Render::kAlbedoMap: data.hasAlbedoMap = 0; break;
+    case Render::kOrmMap:
+        if (data.hasAOMap) data.ao = 1.0f;
+        data.hasMetallicMap = data.hasRoughnessMap = data.hasAOMap = 0;
+        break;
+    case Render::kNormalMap: data.hasNormalMap = 0; break;
+    default: data.hasEmissiveMap = 0; break;
+    }
+}
+} // namespace
+
+Render::MaterialTable::~MaterialTable() {
+    clear();
+}
+
+void Render::MaterialTable::clear() {
+    releaseTextures();
+    if (buffer_) {
+        Wrapper::GpuMemory::instance().release(GL_BUFFER, buffer_);
+        glDeleteBuffers(1, &buffer_);
+        buffer_ = 0;
+    }
+    models_.clear();
+    firstMaterial_.clear();
+    materialCount_ = 0;
+    stats_ = {};
+}
+
+void Render::MaterialTable::releaseTextures() {
+    if (const auto* api = bindlessApi()) {
+        for (GLuint64 handle : handles_) api->makeNonResident(handle);
+    }
+    handles_.clear();
+    for (GLuint array : arrays_) {
+        Wrapper::GpuMemory::instance().release(GL_TEXTURE, array);
+        Wrapper::GlState::instance().forgetTexture(array);
+        glDeleteTextures(1, &array);
+    }
+    arrays_.clear();
+    refs_.clear();
+}
+
+void Render::MaterialTable::build(std::span<const Wrapper::Model* const> models) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<const Wrapper::Model*> keep(models.begin(), models.end());
+    clear();
+    models_ = std::move(keep);
+
+    std::vector<const Wrapper::Texture*> textures;
+    for (const auto* model : models_) {
+        firstMaterial_[model] = static_cast<uint32_t>(materialCount_);
+        materialCount_ += model->materials.size();
+        for (const auto& material : model->materials) {
+            for (int map = 0; map < kMaterialMapCount; ++map) {
+                const auto* texture = mapTexture(material, map);
+                if (texture && texture->getTarget() == GL_TEXTURE_2D && !refs_.contains(texture)) {
+                    refs_[texture] = {};
+                    textures.push_back(texture);
+                }
+            }
+        }
+    }
+    refs_.clear();
+    stats_.materials = materialCount_;
+    stats_.textures = textures.size();
+    stats_.bindless = useBindless && bindlessApi();
+    if (stats_.bindless) {
+        buildHandles(textures);
+    } else {
+        buildArrays(textures);
+    }
+
+    glGenBuffers(1, &buffer_);
+    size_t bytes = std::max<size_t>(materialCount_, 1) * sizeof(MaterialRecord);
+    if (!Wrapper::GpuMemory::instance().track({.objectType = GL_BUFFER, .name = buffer_, .category = Wrapper::GpuCategory::UniformBuffer,
+                                               .bytes = bytes, .owner = "MaterialTable", .site = std::source_location::current()})) {
+        glDeleteBuffers(1, &buffer_);
+        buffer_ = 0;
+        throw std::runtime_error("GPU memory budget refused the material table");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    update();
+    stats_.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Render::MaterialTable::buildHandles(const std::vector<const Wrapper::Texture*>& textures) {
+    const auto* api = bindlessApi();
+    for (const auto* texture : textures) {
+        // The handle freezes the texture's sampler state, which the loads have already set
+        GLuint64 handle = api->getTextureHandle(texture->getID());
+        if (handle == 0) {
+            ++stats_.droppedTextures;
+            continue;
+        }
+        api->makeResident(handle);
+        handles_.push_back(handle);
+        refs_[texture] = {static_cast<uint32_t>(handle), static_cast<uint32_t>(handle >> 32)};
+    }
+}
+
+void Render::MaterialTable::buildArrays(const std::vector<const Wrapper::Texture*>& textures) {
+    // Every load builds the full mip chain, so size and format decide the array
+    using Key = std::tuple<int, int, GLenum>;
+    std::map<Key, std::vector<const Wrapper::Texture*>> groups;
+    for (const auto* texture : textures) {
+        groups[{texture->getWidth(), texture->getHeight(), sizedFormat(texture->getFormat())}].push_back(texture);
+    }
+    // The units run out first for the smallest groups
+    std::vector<std::pair<Key, std::vector<const Wrapper::Texture*>>> ordered(groups.begin(), groups.end());
+    auto groupBytes = [](const auto& group) {
+        auto [width, height, format] = group.first;
+        return Wrapper::GpuMemory::imageBytes(format, width, height, static_cast<int>(group.second.size()), Wrapper::GpuMemory::mipLevels(width, height));
+    };
+    std::stable_sort(ordered.begin(), ordered.end(), [&](const auto& a, const auto& b) { return groupBytes(a) > groupBytes(b); });
+
+    for (const auto& group : ordered) {
+        const auto& [key, members] = group;
+        if (static_cast<int>(arrays_.size()) == kMaxMaterialArrays) {
+            stats_.droppedTextures += members.size();
+            continue;
+        }
+        auto [width, height, format] = key;
+        int layers = static_cast<int>(members.size());
+        int levels = Wrapper::GpuMemory::mipLevels(width, height);
+        size_t bytes = groupBytes(group);
+        GLuint array = 0;
+        glGenTextures(1, &array);
+        if (!Wrapper::GpuMemory::instance().track({.objectType = GL_TEXTURE, .name = array, .category = Wrapper::GpuCategory::Texture,
+                                                   .format = format, .width = width, .height = height, .layers = layers, .levels = levels,
+                                                   .bytes = bytes, .owner = "MaterialTable", .site = std::source_location::current()})) {
+            glDeleteTextures(1, &array);
+            stats_.droppedTextures += members.size();
+            continue;
+        }
+        Wrapper::GlState::instance().bindTextureForUpdate(GL_TEXTURE_2D_ARRAY, array);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format, width, height, layers);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        uint32_t slot = static_cast<uint32_t>(arrays_.size());
+        for (int layer = 0; layer < layers; ++layer) {
+            for (int level = 0; level < levels; ++level) {
+                glCopyImageSubData(members[layer]->getID(), GL_TEXTURE_2D, level, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                                   std::max(1, width >> level), std::max(1, height >> level), 1);
+            }
+            refs_[members[layer]] = {slot, static_cast<uint32_t>(layer)};
+        }
+        arrays_.push_back(array);
+        stats_.arrayBytes += bytes;
+    }
+    stats_.arrays = static_cast<int>(arrays_.size());
+    if (stats_.droppedTextures > 0) {
+        std::cerr << "MaterialTable: " << stats_.droppedTextures << " textures left out, more than " << kMaxMaterialArrays
+                  << " sizes and formats" << std::endl;
+    }
+}
+
+Render::MaterialRecord Render::MaterialTable::record(const Wrapper::Model& model, size_t materialIndex) const {
+    MaterialRecord record;
+    record.constants = model.materialData(materialIndex);
+    const auto& material = model.materials[materialIndex];
+    for (int map = 0; map < kMaterialMapCount; ++map) {
+        const auto* texture = mapTexture(material, map);
+        auto ref = texture ? refs_.find(texture) : refs_.end();
+        if (ref == refs_.end()) {
+            // Left out of the table, the constant stands in
+            dropMap(record.constants, map);
+            continue;
+        }
+        record.maps[map][0] = ref->second.a;
+        record.maps[map][1] = ref->second.b;
+    }
+    return record;
+}
+
+void Render::MaterialTable::update() {
+    if (!buffer_) return;
+    size_t count = 0;
+    for (const auto* model : models_) count += model->materials.size();
+    if (count != materialCount_) {
+        auto models = models_;
+        build(models);
+        return;
+    }
+    std::vector<MaterialRecord> records;
+    records.reserve(materialCount_);
+    for (const auto* model : models_) {
+        for (size_t i = 0; i < model->materials.size(); ++i) records.push_back(record(*model, i));
+    }
+    if (records.empty()) return;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(records.size() * sizeof(MaterialRecord)), records.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+int Render::MaterialTable::bind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kMaterialTableBinding, buffer_);
+    for (size_t i = 0; i < arrays_.size(); ++i) {
+        Wrapper::GlState::instance().bindTexture(kMaterialArrayUnit + static_cast<GLuint>(i), GL_TEXTURE_2D_ARRAY, arrays_[i]);
+    }
+    return static_cast<int>(arrays_.size());
+}
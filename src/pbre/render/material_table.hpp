@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "pbre/base.hpp"
+#include "pbre/render/shader_data.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace PBRE::Wrapper {
+class Texture;
+struct Model;
+} // namespace PBRE::Wrapper
+
+namespace PBRE::Render {
+// Texture units of the material arrays, above the visibility buffer's 7
+constexpr GLuint kMaterialArrayUnit = 8;
+constexpr int kMaxMaterialArrays = 8;
+
+struct MaterialTableStats {
+    size_t materials = 0;
+    size_t textures = 0; // distinct material textures
+    int arrays = 0;
+    size_t arrayBytes = 0; // the copies in the arrays, bindless handles reference the textures themselves
+    size_t droppedTextures = 0; // no array unit left for their size and format, their materials use the constants
+    bool bindless = false;
+    double buildMs = 0.0;
+};
+
+// Every material of a set of models in one shader storage buffer, so draws select their material by index
+// instead of binding its textures and draws with different materials can be batched. Textures are referenced
+// through ARB_bindless_texture handles where the driver has them, otherwise they are copied on the GPU into
+// GL_TEXTURE_2D_ARRAYs grouped by size and format. Read by the MATERIAL_TABLE (and BINDLESS) shader variants.
+class MaterialTable {
+  public:
+    MaterialTable() = default;
+    ~MaterialTable();
+
+    MaterialTable(const MaterialTable&) = delete;
+    MaterialTable& operator=(const MaterialTable&) = delete;
+
+    // Replaces the previous contents. GL thread only.
+    void build(std::span<const Wrapper::Model* const> models);
+    // Rewrites the records from the models' current materials after constants changed. Rebuilds if the
+    // material counts changed; new textures need a build().
+    void update();
+    void clear();
+
+    bool contains(const Wrapper::Model& model) const { return firstMaterial_.contains(&model); }
+    // Table index of one of the model's materials, the model must be contained
+    uint32_t material(const Wrapper::Model& model, size_t materialIndex) const {
+        return firstMaterial_.at(&model) + static_cast<uint32_t>(materialIndex);
+    }
+    // Binds the records and the arrays, returns how many textures it bound (bindless handles stay resident)
+    int bind() const;
+
+    bool empty() const { return buffer_ == 0; }
+    bool bindless() const { return stats_.bindless; }
+    const MaterialTableStats& stats() const { return stats_; }
+
+    // Bindless handles when the driver supports them, arrays otherwise. Takes effect on the next build().
+    bool useBindless = true;
+
+  private:
+    struct TextureRef {
+        uint32_t a = 0, b = 0; // handle low and high, or array and layer
+    };
+
+    MaterialRecord record(const Wrapper::Model& model, size_t materialIndex) const;
+    void buildArrays(const std::vector<const Wrapper::Texture*>& textures);
+    void buildHandles(const std::vector<const Wrapper::Texture*>& textures);
+    void releaseTextures();
+
+    std::vector<const Wrapper::Model*> models_;
+    std::unordered_map<const Wrapper::Model*, uint32_t> firstMaterial_;
+    std::unordered_map<const Wrapper::Texture*, TextureRef> refs_;
+    std::vector<GLuint> arrays_;
+    std::vector<GLuint64> handles_; // resident
+    GLuint buffer_ = 0;
+    size_t materialCount_ = 0;
+    MaterialTableStats stats_;
+};
+} // namespace PBRE::Render
@@ -0,0 +1,375 @@
+#include "occlusion.hpp"
+#include "pbre/core/parallel.hpp"
+#include "pbre/render/scene.hpp"
+#include "pbre/wrapper/model.hpp"
+
+#include <meshoptimizer.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define PBRE_OCCLUSION_SSE 1
+#else
+#define PBRE_OCCLUSION_SSE 0
+#endif
+
+using namespace PBRE;
+
+namespace {
+constexpr float kFar = 1e30f;
+// Clip space w below which a vertex counts as behind the camera
+constexpr float kMinW = 1e-5f;
+// Occluders must stay inside the surface, or they hide what pokes out of it. With no error allowed the
+// simplification only merges coplanar triangles and collapses collinear edges, the silhouette and depth
+// stay exactly those of the mesh.
+constexpr float kSimplifyError = 0.0f;
+
+enum class Projection { OnScreen, CrossesNear, Outside };
+
+// Screen rectangle in NDC and nearest depth in [0, 1] of a box, valid when OnScreen
+struct ScreenRect {
+    float x0, y0, x1, y1;
+    float zNear;
+};
+
+Projection projectBounds(const vec3& boundsMin, const vec3& boundsMax, const mat4& mvp, ScreenRect& rect) {
+    int outside[6] = {};
+    bool crossesNear = false;
+    rect = {kFar, kFar, -kFar, -kFar, kFar};
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+        vec4 p = mvp * vec4(corner, 1.0f);
+        outside[0] += p.x < -p.w;
+        outside[1] += p.x > p.w;
+        outside[2] += p.y < -p.w;
+        outside[3] += p.y > p.w;
+        outside[4] += p.z < -p.w;
+        outside[5] += p.z > p.w;
+        if (p.w <= kMinW) {
+            crossesNear = true;
+            continue;
+        }
+        vec3 ndc = vec3(p) / p.w;
+        rect.x0 = std::min(rect.x0, ndc.x);
+        rect.y0 = std::min(rect.y0, ndc.y);
+        rect.x1 = std::max(rect.x1, ndc.x);
+        rect.y1 = std::max(rect.y1, ndc.y);
+        rect.zNear = std::min(rect.zNear, ndc.z * 0.5f + 0.5f);
+    }
+    for (int count : outside) {
+        if (count == 8) return Projection::Outside;
+    }
+    return crossesNear ? Projection::CrossesNear : Projection::OnScreen;
+}
+
+uint32_t spanBits(int first, int last) {
+    int count = last - first + 1;
+    return (count >= 32 ? ~0u : (1u << count) - 1u) << first;
+}
+} // namespace
+
+void Render::OcclusionCuller::clear() {
+    triangles_.clear();
+    std::fill(tiles_.begin(), tiles_.end(), Tile{});
+    std::fill(tileDepth_.begin(), tileDepth_.end(), 1.0f);
+}
+
+void Render::OcclusionCuller::addOccluder(std::span<const vec3> positions, std::span<const uint32_t> indices, const mat4& modelViewProjection) {
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        float x[3], y[3], z[3];
+        bool clipped = false;
+        for (int v = 0; v < 3; ++v) {
+            vec4 p = modelViewProjection * vec4(positions[indices[i + v]], 1.0f);
+            // Behind the camera or between it and the near plane: the GPU clips that part of the triangle,
+            // so rasterizing its projection would hide what shows through there
+            if (p.w <= kMinW || p.z < -p.w) {
+                clipped = true;
+                break;
+            }
+            x[v] = (p.x / p.w * 0.5f + 0.5f) * kWidth;
+            y[v] = (p.y / p.w * 0.5f + 0.5f) * kHeight;
+            z[v] = p.z / p.w * 0.5f + 0.5f;
+        }
+        if (clipped) continue;
+
+        // Twice the signed area; both windings are rasterized
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (std::abs(area) < 1e-6f) continue;
+        if (area < 0.0f) {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            area = -area;
+        }
+
+        Triangle t;
+        t.minX = std::max(0, static_cast<int>(std::floor(std::min({x[0], x[1], x[2]}))));
+        t.maxX = std::min(kWidth - 1, static_cast<int>(std::floor(std::max({x[0], x[1], x[2]}))));
+        t.minY = std::max(0, static_cast<int>(std::floor(std::min({y[0], y[1], y[2]}))));
+        t.maxY = std::min(kHeight - 1, static_cast<int>(std::floor(std::max({y[0], y[1], y[2]}))));
+        t.zMax = std::max({z[0], z[1], z[2]});
+        if (t.minX > t.maxX || t.minY > t.maxY || std::min({z[0], z[1], z[2]}) > 1.0f) continue;
+        t.zMax = std::min(t.zMax, 1.0f);
+
+        t.zA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+        t.zB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+        t.zC = z[0] - t.zA * x[0] - t.zB * y[0];
+
+        // Edge from vertex e to the next, inside where a * x + b * y + c >= 0
+        for (int e = 0; e < 3; ++e) {
+            int n = (e + 1) % 3;
+            float a = y[e] - y[n];
+            float b = x[n] - x[e];
+            float c = -(a * x[e] + b * y[e]);
+            if (std::abs(a) < 1e-12f) {
+                t.side[e] = 0;
+                t.slope[e] = b;
+                t.offset[e] = c;
+            } else {
+                t.side[e] = a > 0.0f ? -1 : 1;
+                t.slope[e] = -b / a;
+                t.offset[e] = -c / a;
+            }
+        }
+        triangles_.push_back(t);
+    }
+}
+
+void Render::OcclusionCuller::spans(const Triangle& t, int y0, float lo[kTileHeight], float hi[kTileHeight]) const {
+#if PBRE_OCCLUSION_SSE
+    if (useSimd) {
+        for (int r = 0; r < kTileHeight; r += 4) {
+            __m128 y = _mm_add_ps(_mm_set1_ps(static_cast<float>(y0 + r)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+            __m128 l = _mm_set1_ps(-kFar), h = _mm_set1_ps(kFar);
+            for (int e = 0; e < 3; ++e) {
+                __m128 bound = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.slope[e]), y), _mm_set1_ps(t.offset[e]));
+                if (t.side[e] < 0) {
+                    l = _mm_max_ps(l, bound);
+                } else if (t.side[e] > 0) {
+                    h = _mm_min_ps(h, bound);
+                } else {
+                    // Rows outside a horizontal edge's half plane get an empty span
+                    __m128 out = _mm_cmplt_ps(bound, _mm_setzero_ps());
+                    h = _mm_or_ps(_mm_and_ps(out, _mm_set1_ps(-kFar)), _mm_andnot_ps(out, h));
+                }
+            }
+            _mm_storeu_ps(lo + r, l);
+            _mm_storeu_ps(hi + r, h);
+        }
+        return;
+    }
+#endif
+    for (int r = 0; r < kTileHeight; ++r) {
+        float y = static_cast<float>(y0 + r) + 0.5f;
+        lo[r] = -kFar;
+        hi[r] = kFar;
+        for (int e = 0; e < 3; ++e) {
+            float bound = t.slope[e] * y + t.offset[e];
+            if (t.side[e] < 0) {
+                lo[r] = std::max(lo[r], bound);
+            } else if (t.side[e] > 0) {
+                hi[r] = std::min(hi[r], bound);
+            } else if (bound < 0.0f) {
+                hi[r] = -kFar;
+            }
+        }
+    }
+}
+
+void Render::OcclusionCuller::updateTile(int index, const uint32_t mask[kTileHeight], float z) {
+    float& zMax0 = tileDepth_[index];
+    Tile& tile = tiles_[index];
+    // Nothing the tile doesn't already guarantee
+    if (z >= zMax0) return;
+    // A triangle much nearer than the working layer starts a new one instead of being merged at the
+    // layer's farther depth
+    if (tile.zMax1 - z > zMax0 - tile.zMax1) {
+        tile.mask.fill(0);
+        tile.zMax1 = 0.0f;
+    }
+    tile.zMax1 = std::max(tile.zMax1, z);
+    bool full = true;
+    for (int r = 0; r < kTileHeight; ++r) {
+        tile.mask[r] |= mask[r];
+        full &= tile.mask[r] == ~0u;
+    }
+    // Covered: the working layer becomes the tile depth
+    if (full) {
+        zMax0 = tile.zMax1;
+        tile.mask.fill(0);
+        tile.zMax1 = 0.0f;
+    }
+}
+
+void Render::OcclusionCuller::rasterizeRow(int tileY) {
+    int y0 = tileY * kTileHeight;
+    float lo[kTileHeight], hi[kTileHeight];
+    int first[kTileHeight], last[kTileHeight];
+    for (const Triangle& t : triangles_) {
+        if (t.maxY < y0 || t.minY >= y0 + kTileHeight) continue;
+        spans(t, y0, lo, hi);
+        // Pixels whose centers are inside, clamped to the triangle's bounds
+        for (int r = 0; r < kTileHeight; ++r) {
+            float l = std::clamp(lo[r], t.minX - 1.0f, t.maxX + 2.0f);
+            float h = std::clamp(hi[r], t.minX - 1.0f, t.maxX + 2.0f);
+            first[r] = std::max(t.minX, static_cast<int>(std::ceil(l - 0.5f)));
+            last[r] = std::min(t.maxX, static_cast<int>(std::floor(h - 0.5f)));
+        }
+        for (int tileX = t.minX / kTileWidth; tileX <= t.maxX / kTileWidth; ++tileX) {
+            int x0 = tileX * kTileWidth;
+            uint32_t mask[kTileHeight];
+            int coveredX0 = kWidth, coveredX1 = -1, coveredY0 = kTileHeight, coveredY1 = -1;
+            for (int r = 0; r < kTileHeight; ++r) {
+                int a = std::max(first[r], x0), b = std::min(last[r], x0 + kTileWidth - 1);
+                mask[r] = a <= b ? spanBits(a - x0, b - x0) : 0u;
+                if (a > b) continue;
+                coveredX0 = std::min(coveredX0, a);
+                coveredX1 = std::max(coveredX1, b);
+                coveredY0 = std::min(coveredY0, r);
+                coveredY1 = std::max(coveredY1, r);
+            }
+            if (coveredY1 < 0) continue;
+            // Farthest point of the depth plane over the covered pixel centers
+            float z = t.zC + std::max(t.zA * (coveredX0 + 0.5f), t.zA * (coveredX1 + 0.5f)) +
+                      std::max(t.zB * (y0 + coveredY0 + 0.5f), t.zB * (y0 + coveredY1 + 0.5f));
+            updateTile(tileY * kTilesX + tileX, mask, std::min(z, t.zMax));
+        }
+    }
+}
+
+void Render::OcclusionCuller::rasterize() {
+    // Each job owns a row of tiles, so triangles reach every tile in submission order without locking
+    Core::parallelFor(kTilesY, 1, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) rasterizeRow(static_cast<int>(row));
+    });
+}
+
+Render::OcclusionCuller::Result Render::OcclusionCuller::test(const vec3& boundsMin, const vec3& boundsMax, const mat4& modelViewProjection) const {
+    ScreenRect rect;
+    Projection projection = projectBounds(boundsMin, boundsMax, modelViewProjection, rect);
+    if (projection == Projection::Outside) return Result::OutsideFrustum;
+    if (projection == Projection::CrossesNear) return Result::Visible;
+
+    int px0 = std::max(0, static_cast<int>(std::floor((rect.x0 * 0.5f + 0.5f) * kWidth)));
+    int px1 = std::min(kWidth - 1, static_cast<int>(std::floor((rect.x1 * 0.5f + 0.5f) * kWidth)));
+    int py0 = std::max(0, static_cast<int>(std::floor((rect.y0 * 0.5f + 0.5f) * kHeight)));
+    int py1 = std::min(kHeight - 1, static_cast<int>(std::floor((rect.y1 * 0.5f + 0.5f) * kHeight)));
+    if (px0 > px1 || py0 > py1) return Result::OutsideFrustum;
+    float zNear = std::max(rect.zNear, 0.0f);
+
+    // Tiles the rectangle may be visible in: not covered at least as near as the bounds
+    int tileX0 = px0 / kTileWidth, tileX1 = px1 / kTileWidth;
+    for (int tileY = py0 / kTileHeight; tileY <= py1 / kTileHeight; ++tileY) {
+        const float* depths = tileDepth_.data() + tileY * kTilesX;
+        for (int tileX = tileX0; tileX <= tileX1; tileX += 4) {
+            int candidates = 0;
+#if PBRE_OCCLUSION_SSE
+            if (useSimd && tileX + 4 <= tileX1 + 1) {
+                candidates = _mm_movemask_ps(_mm_cmple_ps(_mm_set1_ps(zNear), _mm_loadu_ps(depths + tileX)));
+            } else
+#endif
+            {
+                for (int i = 0; i < 4 && tileX + i <= tileX1; ++i) candidates |= (zNear <= depths[tileX + i]) << i;
+            }
+            for (; candidates; candidates &= candidates - 1) {
+                int x = tileX + std::countr_zero(static_cast<unsigned>(candidates));
+                // Still hidden if the working layer covers the rectangle's part of the tile in front of it
+                const Tile& tile = tiles_[tileY * kTilesX + x];
+                if (zNear <= tile.zMax1) return Result::Visible;
+                int a = std::max(px0, x * kTileWidth) - x * kTileWidth;
+                int b = std::min(px1, (x + 1) * kTileWidth - 1) - x * kTileWidth;
+                uint32_t bits = spanBits(a, b);
+                int r0 = std::max(py0, tileY * kTileHeight) - tileY * kTileHeight;
+                int r1 = std::min(py1, (tileY + 1) * kTileHeight - 1) - tileY * kTileHeight;
+                for (int r = r0; r <= r1; ++r) {
+                    if ((tile.mask[r] & bits) != bits) return Result::Visible;
+                }
+            }
+        }
+    }
+    return Result::Occluded;
+}
+
+const std::vector<uint32_t>& Render::OcclusionCuller::occluderIndices(const Wrapper::Model& model, size_t meshIndex) {
+    const auto& mesh = model.meshes[meshIndex];
+    auto& entry = simplified_[{&model, meshIndex}];
+    // A model loaded again in place has new index storage
+    if (entry.source == mesh.indices.data() && entry.sourceCount == mesh.indices.size()) return entry.indices;
+    std::vector<uint32_t> indices = mesh.indices;
+    if (indices.size() / 3 > occluderTriangles) {
+        size_t count = meshopt_simplify(indices.data(), mesh.indices.data(), mesh.indices.size(), &mesh.positions[0].x, mesh.positions.size(),
+                                        sizeof(vec3), occluderTriangles * 3, kSimplifyError, 0, nullptr);
+        indices.resize(count);
+        indices.shrink_to_fit();
+    }
+    entry = {mesh.indices.data(), mesh.indices.size(), std::move(indices)};
+    return entry.indices;
+}
+
+void Render::OcclusionCuller::cull(const Scene& scene, const mat4& viewProjection) {
+    auto start = std::chrono::high_resolution_clock::now();
+    const auto& renderables = scene.renderables();
+    size_t count = renderables.size();
+    stats_ = {};
+    stats_.tested = static_cast<int>(count);
+    visible_.assign(count, 1);
+    clear();
+
+    // Occluders: meshes with CPU geometry that are large on screen, nearest first so the near ones fill
+    // the tiles before the far ones are merged into them
+    struct Occluder {
+        size_t renderable;
+        float zNear;
+    };
+    std::vector<Occluder> occluders;
+    std::vector<mat4> mvps(count);
+    std::vector<uint8_t> isOccluder(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const auto& r = renderables[i];
+        const auto& mesh = r.model->meshes[r.mesh];
+        mvps[i] = viewProjection * scene.world(r.node);
+        if (mesh.positions.empty() || mesh.indices.empty()) continue;
+        ScreenRect rect;
+        Projection projection = projectBounds(mesh.boundsMin, mesh.boundsMax, mvps[i], rect);
+        if (projection == Projection::Outside) continue;
+        float area = 1.0f;
+        if (projection == Projection::OnScreen) {
+            area = (std::clamp(rect.x1, -1.0f, 1.0f) - std::clamp(rect.x0, -1.0f, 1.0f)) *
+                   (std::clamp(rect.y1, -1.0f, 1.0f) - std::clamp(rect.y0, -1.0f, 1.0f)) * 0.25f;
+        }
+        if (area < occluderArea) continue;
+        occluders.push_back({i, projection == Projection::OnScreen ? rect.zNear : 0.0f});
+        isOccluder[i] = 1;
+    }
+    std::sort(occluders.begin(), occluders.end(), [](const Occluder& a, const Occluder& b) { return a.zNear < b.zNear; });
+    for (const auto& occluder : occluders) {
+        const auto& r = renderables[occluder.renderable];
+        addOccluder(r.model->meshes[r.mesh].positions, occluderIndices(*r.model, r.mesh), mvps[occluder.renderable]);
+    }
+    stats_.occluders = static_cast<int>(occluders.size());
+    stats_.occluderTriangles = triangles_.size();
+    rasterize();
+    auto rasterized = std::chrono::high_resolution_clock::now();
+    stats_.rasterMs = std::chrono::duration<double, std::milli>(rasterized - start).count();
+
+    std::vector<Result> results(count, Result::Visible);
+    Core::parallelFor(count, 64, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const auto& mesh = renderables[i].model->meshes[renderables[i].mesh];
+            Result result = test(mesh.boundsMin, mesh.boundsMax, mvps[i]);
+            // Only rounding could hide an occluder behind its own depth, it just needs the frustum test
+            if (isOccluder[i] && result == Result::Occluded) result = Result::Visible;
+            results[i] = result;
+            visible_[i] = result == Result::Visible;
+        }
+    });
+    for (Result result : results) {
+        stats_.frustumCulled += result == Result::OutsideFrustum;
+        stats_.occlusionCulled += result == Result::Occluded;
+    }
+    stats_.testMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - rasterized).count();
+}
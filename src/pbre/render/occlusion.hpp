@@ -0,0 +1,114 @@
+#pragma once
+
+#include "pbre/base.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace PBRE::Wrapper {
+struct Model;
+}
+
+namespace PBRE::Render {
+class Scene;
+
+struct OcclusionStats {
+    int tested = 0; // renderables
+    int frustumCulled = 0;
+    int occlusionCulled = 0;
+    int occluders = 0;
+    size_t occluderTriangles = 0; // after simplification, set up for rasterization
+    double rasterMs = 0.0;        // occluder setup and rasterization
+    double testMs = 0.0;
+};
+
+// Masked software occlusion culling (after Hasselgren et al.). The low resolution depth buffer is split in
+// 32x8 pixel tiles which keep a coverage bit per pixel and two depths instead of a depth per pixel: the
+// farthest depth of the whole tile, and a working layer gathering partially covering triangles until they
+// cover the tile. Occluders are the meshes that are large on screen, simplified only where that leaves the
+// surface in place so they never hide more than the mesh itself, rasterized one tile row per job with the scanline spans of four rows computed together with SSE. Occludees are tested
+// conservatively by the screen rectangle and nearest depth of their bounds. Depths are NDC z mapped to [0, 1].
+class OcclusionCuller {
+  public:
+    static constexpr int kTileWidth = 32; // a row of a tile is one uint32_t of coverage
+    static constexpr int kTileHeight = 8;
+    static constexpr int kTilesX = 10;
+    static constexpr int kTilesY = 24;
+    static constexpr int kWidth = kTilesX * kTileWidth;
+    static constexpr int kHeight = kTilesY * kTileHeight;
+
+    enum class Result {
+        Visible,
+        Occluded,
+        OutsideFrustum,
+    };
+
+    // Frustum and occlusion culls every renderable of the scene. Renderables whose bounds cover at least
+    // occluderArea of the screen are rasterized first, nearest first, and are never culled themselves.
+    void cull(const Scene& scene, const mat4& viewProjection);
+    // After cull(), indexed like Scene::renderables()
+    bool visible(size_t renderable) const { return renderable >= visible_.size() || visible_[renderable]; }
+    const OcclusionStats& stats() const { return stats_; }
+
+    // The steps of cull() for callers picking their own occluders: clear(), addOccluder() for each of them,
+    // rasterize(), then test()
+    void clear();
+    // Triangles crossing the near plane are skipped, occluders only ever have to be a subset of the scene
+    void addOccluder(std::span<const vec3> positions, std::span<const uint32_t> indices, const mat4& modelViewProjection);
+    void rasterize();
+    Result test(const vec3& boundsMin, const vec3& boundsMax, const mat4& modelViewProjection) const;
+
+    // Drops the simplified occluder meshes. An entry is rebuilt when its mesh's indices change, this frees
+    // the ones of meshes that are gone.
+    void clearOccluderCache() { simplified_.clear(); }
+
+    // Fraction of the screen a renderable's bounds must cover to be an occluder
+    float occluderArea = 0.02f;
+    // Occluder meshes are simplified towards this many triangles, as far as merging coplanar ones gets
+    size_t occluderTriangles = 512;
+    // Compute spans with SSE where available (the scalar path is kept for comparison)
+    bool useSimd = true;
+
+    // Per tile farthest depth, row major, for a debug view
+    std::span<const float> tileDepths() const { return tileDepth_; }
+
+  private:
+    // Screen space, counter-clockwise, with the edges as x bounds of a row: x >= slope * y + offset for a
+    // left edge, x <= for a right one. Horizontal edges keep the half plane b * y + c >= 0.
+    struct Triangle {
+        float slope[3], offset[3];
+        int8_t side[3]; // -1 left, 1 right, 0 horizontal
+        float zA, zB, zC; // depth plane z = zA * x + zB * y + zC
+        float zMax;
+        int minX, maxX, minY, maxY; // pixel bounds clamped to the screen, inclusive
+    };
+    struct Tile {
+        std::array<uint32_t, kTileHeight> mask{}; // coverage of the working layer
+        float zMax1 = 0.0f;                       // farthest depth of the working layer
+    };
+
+    struct SimplifiedMesh {
+        const uint32_t* source = nullptr; // the mesh's indices it was made from
+        size_t sourceCount = 0;
+        std::vector<uint32_t> indices;
+    };
+
+    const std::vector<uint32_t>& occluderIndices(const Wrapper::Model& model, size_t mesh);
+    void rasterizeRow(int tileY);
+    void spans(const Triangle& triangle, int y0, float lo[kTileHeight], float hi[kTileHeight]) const;
+    void updateTile(int tile, const uint32_t mask[kTileHeight], float z);
+
+    std::vector<Triangle> triangles_;
+    std::vector<Tile> tiles_ = std::vector<Tile>(kTilesX * kTilesY);
+    std::vector<float> tileDepth_ = std::vector<float>(kTilesX * kTilesY, 1.0f); // everything below is nearer
+
+    std::map<std::pair<const Wrapper::Model*, size_t>, SimplifiedMesh> simplified_;
+    std::vector<uint8_t> visible_;
+    OcclusionStats stats_;
+};
+} // namespace PBRE::Render
@@ -0,0 +1,551 @@
+#include "path_tracer.hpp"
+#include "pbre/core/hdr_decode.hpp"
+#include "pbre/core/parallel.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using namespace PBRE;
+
+namespace {
+constexpr float kPi = 3.14159265359f;
+constexpr int kRouletteDepth = 3; // bounces before Russian roulette may end a path
+
+float luminance(const vec3& c) {
+    return glm::dot(c, vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Same terms as pbr_common.glsl
+vec3 fresnelSchlick(float cosTheta, const vec3& f0) {
+    return f0 + (vec3(1.0f) - f0) * std::pow(std::clamp(1.0f - cosTheta, 0.0f, 1.0f), 5.0f);
+}
+
+float distributionGGX(float NdotH, float roughness) {
+    float a = std::max(roughness * roughness, 1e-4f);
+    float a2 = a * a;
+    float denom = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+    return a2 / (kPi * denom * denom);
+}
+
+float geometrySchlickGGX(float NdotX, float roughness) {
+    float k = std::max(roughness, 1e-4f) + 1.0f;
+    k = (k * k) / 8.0f;
+    return NdotX / (NdotX * (1.0f - k) + k);
+}
+
+float powerHeuristic(float a, float b) {
+    return a * a / std::max(a * a + b * b, 1e-30f);
+}
+
+// Orthonormal basis around n (Duff et al. 2017)
+void basis(const vec3& n, vec3& t, vec3& b) {
+    float sign = std::copysign(1.0f, n.z);
+    float a = -1.0f / (sign + n.z);
+    float c = n.x * n.y * a;
+    t = vec3(1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+    b = vec3(c, sign + n.y * n.y * a, -n.y);
+}
+
+vec3 srgbToLinear(const vec3& c) {
+    // Matches the pow(2.2) in frag.glsl rather than the exact sRGB curve
+    return vec3(std::pow(std::max(c.x, 0.0f), 2.2f), std::pow(std::max(c.y, 0.0f), 2.2f), std::pow(std::max(c.z, 0.0f), 2.2f));
+}
+
+bool isFinite(const vec3& c) {
+    return std::isfinite(c.x) && std::isfinite(c.y) && std::isfinite(c.z);
+}
+} // namespace
+
+// PCG hash driven sequence, seeded by pixel and sample so the image doesn't depend on scheduling
+struct Render::PathTracer::Sampler {
+    uint32_t state;
+
+    static uint32_t hash(uint32_t v) {
+        uint32_t s = v * 747796405u + 2891336453u;
+        uint32_t w = ((s >> ((s >> 28u) + 4u)) ^ s) * 277803737u;
+        return (w >> 22u) ^ w;
+    }
+    Sampler(uint32_t pixel, uint32_t sample) : state(hash(pixel ^ hash(sample + 0x9E3779B9u))) {}
+    float next() {
+        state = hash(state);
+        return (state >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+struct Render::PathTracer::SurfacePoint {
+    vec3 position;
+    vec3 geometricNormal; // facing the incoming ray
+    vec3 normal;          // shading normal, on the same side
+    vec3 baseColor;
+    float metallic;
+    float roughness;
+    vec3 emissive;
+};
+
+vec4 Render::PathTracer::CpuTexture::sample(vec2 uv) const {
+    if (rgba.empty()) return vec4(1.0f);
+    float x = uv.x * width - 0.5f, y = uv.y * height - 0.5f;
+    float fx = std::floor(x), fy = std::floor(y);
+    float tx = x - fx, ty = y - fy;
+    auto wrap = [](int i, int n) { return ((i % n) + n) % n; };
+    int x0 = wrap(static_cast<int>(fx), width), x1 = wrap(static_cast<int>(fx) + 1, width);
+    int y0 = wrap(static_cast<int>(fy), height), y1 = wrap(static_cast<int>(fy) + 1, height);
+    auto fetch = [&](int px, int py) {
+        const unsigned char* p = rgba.data() + (static_cast<size_t>(py) * width + px) * 4;
+        return vec4(p[0], p[1], p[2], p[3]);
+    };
+    vec4 top = fetch(x0, y0) * (1.0f - tx) + fetch(x1, y0) * tx;
+    vec4 bottom = fetch(x0, y1) * (1.0f - tx) + fetch(x1, y1) * tx;
+    return (top * (1.0f - ty) + bottom * ty) * (1.0f / 255.0f);
+}
+
+bool Render::PathTracer::loadEnvironment(const std::string& path) {
+    static_assert(sizeof(vec3) == 3 * sizeof(float));
+    Core::HdrDecoder decoder;
+    if (decoder.open(path)) {
+        // Radiance files decode straight into the texels
+        envWidth_ = decoder.width();
+        envHeight_ = decoder.height();
+        envTexels_.resize(static_cast<size_t>(envWidth_) * envHeight_);
+        decoder.decodeRows(0, envHeight_, reinterpret_cast<float*>(envTexels_.data()));
+    } else {
+        stbi_set_flip_vertically_on_load(false);
+        int w, h, channels;
+        float* data = stbi_loadf(path.c_str(), &w, &h, &channels, 3);
+        if (!data) {
+            std::cerr << "Path tracer: failed to load environment " << path << ": " << stbi_failure_reason() << std::endl;
+            return false;
+        }
+        envWidth_ = w;
+        envHeight_ = h;
+        envTexels_.assign(reinterpret_cast<const vec3*>(data), reinterpret_cast<const vec3*>(data) + static_cast<size_t>(w) * h);
+        stbi_image_free(data);
+    }
+    int w = envWidth_, h = envHeight_;
+    // Texel weight is its luminance times its solid angle, which shrinks with cos(elevation)
+    std::vector<float> weights(envTexels_.size());
+    for (int y = 0; y < h; ++y) {
+        float elevation = (0.5f - (y + 0.5f) / h) * kPi;
+        for (int x = 0; x < w; ++x) {
+            size_t i = static_cast<size_t>(y) * w + x;
+            weights[i] = std::max(luminance(envTexels_[i]), 0.0f) * std::cos(elevation);
+        }
+    }
+    return envTable_.build(weights);
+}
+
+void Render::PathTracer::clearGeometry() {
+    positions_.clear();
+    normals_.clear();
+    tangents_.clear();
+    uvs_.clear();
+    indices_.clear();
+    triangleMaterials_.clear();
+    materials_.clear();
+    materialLookup_.clear();
+    textures_.clear();
+    textureSources_.clear();
+    textureLookup_.clear();
+    bvh_ = Bvh();
+}
+
+int Render::PathTracer::textureIndex(const std::shared_ptr<Wrapper::Texture>& texture) {
+    if (!texture) return -1;
+    auto [it, inserted] = textureLookup_.emplace(texture.get(), static_cast<int>(textures_.size()));
+    if (inserted) {
+        textures_.emplace_back();
+        textureSources_.push_back(texture);
+    }
+    return it->second;
+}
+
+uint32_t Render::PathTracer::materialIndex(const Wrapper::Model& model, size_t index) {
+    auto [it, inserted] = materialLookup_.emplace(std::make_pair(&model, index), static_cast<uint32_t>(materials_.size()));
+    if (!inserted) return it->second;
+
+    TracerMaterial m;
+    if (index < model.materials.size()) {
+        const auto& src = model.materials[index];
+        using TexturePtr = std::shared_ptr<Wrapper::Texture>;
+        if (auto tex = std::get_if<TexturePtr>(&src.albedo)) m.albedoMap = textureIndex(*tex);
+        else m.albedo = std::get<vec3>(src.albedo);
+        // With a map the constant is the factor scaling its channel, as in frag.glsl
+        if (auto tex = std::get_if<TexturePtr>(&src.metallic)) {
+            m.metallicMap = textureIndex(*tex);
+            m.metallic = src.metallicFactor;
+        } else {
+            m.metallic = std::get<float>(src.metallic);
+        }
+        if (auto tex = std::get_if<TexturePtr>(&src.roughness)) {
+            m.roughnessMap = textureIndex(*tex);
+            m.roughness = src.roughnessFactor;
+        } else {
+            m.roughness = std::get<float>(src.roughness);
+        }
+        if (auto tex = std::get_if<TexturePtr>(&src.emissive)) m.emissiveMap = textureIndex(*tex);
+        else m.emissive = std::get<vec3>(src.emissive);
+        m.metallicChannel = src.metallicChannel;
+        m.roughnessChannel = src.roughnessChannel;
+        m.normalMap = textureIndex(src.normal);
+        m.alphaTested = src.alphaMode == AlphaMode::Mask;
+        m.alphaCutoff = src.alphaCutoff;
+    }
+    materials_.push_back(m);
+    return it->second;
+}
+
+void Render::PathTracer::submit(const Wrapper::Model& model, const Wrapper::Mesh& mesh, const mat4& transform) {
+    if (mesh.positions.empty() || mesh.indices.size() < 3) return;
+    uint32_t base = static_cast<uint32_t>(positions_.size());
+    mat3 normalMatrix = glm::transpose(glm::inverse(mat3(transform)));
+    for (size_t i = 0; i < mesh.positions.size(); ++i) {
+        positions_.push_back(vec3(transform * vec4(mesh.positions[i], 1.0f)));
+        normals_.push_back(i < mesh.normals.size() ? glm::normalize(normalMatrix * mesh.normals[i]) : vec3(0.0f));
+        // Transformed by the normal matrix like vert.glsl does
+        tangents_.push_back(i < mesh.tangents.size() ? vec4(normalMatrix * vec3(mesh.tangents[i]), mesh.tangents[i].w) : vec4(0.0f));
+        uvs_.push_back(i < mesh.uvs.size() ? mesh.uvs[i] : vec2(0.0f));
+    }
+    uint32_t material = materialIndex(model, mesh.materialIndex);
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        for (int k = 0; k < 3; ++k) indices_.push_back(base + mesh.indices[i + k]);
+        triangleMaterials_.push_back(material);
+    }
+}
+
+void Render::PathTracer::build() {
+    for (size_t i = 0; i < textures_.size(); ++i) {
+        // Missing channels read as GL returns them for the unsized formats: 0 for color, 255 for alpha
+        const auto& pixels = textureSources_[i]->cpuPixels();
+        auto& texture = textures_[i];
+        texture.width = pixels.width;
+        texture.height = pixels.height;
+        texture.rgba.clear();
+        if (!pixels.data || pixels.width <= 0 || pixels.height <= 0) continue;
+        size_t texels = static_cast<size_t>(pixels.width) * pixels.height;
+        texture.rgba.resize(texels * 4);
+        for (size_t t = 0; t < texels; ++t) {
+            const unsigned char* in = pixels.data.get() + t * pixels.channels;
+            unsigned char* out = texture.rgba.data() + t * 4;
+            for (int c = 0; c < 4; ++c) out[c] = c < pixels.channels ? in[c] : (c == 3 ? 255 : 0);
+        }
+    }
+    bvh_.build(positions_, indices_);
+}
+
+void Render::PathTracer::setCamera(const mat4& view, const mat4& projection) {
+    inverseViewProj_ = glm::inverse(projection * view);
+    reset();
+}
+
+void Render::PathTracer::resize(int width, int height) {
+    if (width == width_ && height == height_) return;
+    width_ = width;
+    height_ = height;
+    reset();
+}
+
+void Render::PathTracer::reset() {
+    samples_ = 0;
+    sum_.assign(static_cast<size_t>(width_) * height_, vec3(0.0f));
+    evenSum_.assign(sum_.size(), vec3(0.0f));
+}
+
+Render::Ray Render::PathTracer::cameraRay(float x, float y) const {
+    // From the near plane through the far plane of the same NDC point
+    float ndcX = 2.0f * x / width_ - 1.0f;
+    float ndcY = 1.0f - 2.0f * y / height_;
+    vec4 nearPoint = inverseViewProj_ * vec4(ndcX, ndcY, -1.0f, 1.0f);
+    vec4 farPoint = inverseViewProj_ * vec4(ndcX, ndcY, 1.0f, 1.0f);
+    vec3 origin = vec3(nearPoint) / nearPoint.w;
+    return {origin, glm::normalize(vec3(farPoint) / farPoint.w - origin)};
+}
+
+vec2 Render::PathTracer::triangleUV(uint32_t triangle, float u, float v) const {
+    const uint32_t* tri = indices_.data() + triangle * 3;
+    return uvs_[tri[0]] * (1.0f - u - v) + uvs_[tri[1]] * u + uvs_[tri[2]] * v;
+}
+
+bool Render::PathTracer::alphaFilter(const void* context, uint32_t triangle, float u, float v) {
+    const auto* self = static_cast<const PathTracer*>(context);
+    const TracerMaterial& m = self->materials_[self->triangleMaterials_[triangle]];
+    if (!m.alphaTested || m.albedoMap < 0) return true;
+    return self->textures_[m.albedoMap].sample(self->triangleUV(triangle, u, v)).w >= m.alphaCutoff;
+}
+
+Render::PathTracer::SurfacePoint Render::PathTracer::surface(const Ray& ray, const RayHit& hit) const {
+    const uint32_t* tri = indices_.data() + hit.triangle * 3;
+    float w = 1.0f - hit.u - hit.v;
+    const vec3& p0 = positions_[tri[0]];
+    SurfacePoint s;
+    s.position = p0 * w + positions_[tri[1]] * hit.u + positions_[tri[2]] * hit.v;
+    s.geometricNormal = glm::normalize(glm::cross(positions_[tri[1]] - p0, positions_[tri[2]] - p0));
+    vec3 n = normals_[tri[0]] * w + normals_[tri[1]] * hit.u + normals_[tri[2]] * hit.v;
+    s.normal = glm::dot(n, n) > 1e-12f ? glm::normalize(n) : s.geometricNormal;
+    vec2 uv = uvs_[tri[0]] * w + uvs_[tri[1]] * hit.u + uvs_[tri[2]] * hit.v;
+
+    const TracerMaterial& m = materials_[triangleMaterials_[hit.triangle]];
+    s.baseColor = m.albedoMap >= 0 ? srgbToLinear(vec3(textures_[m.albedoMap].sample(uv))) : m.albedo;
+    s.metallic = m.metallicMap >= 0 ? textures_[m.metallicMap].sample(uv)[m.metallicChannel] * m.metallic : m.metallic;
+    s.roughness = m.roughnessMap >= 0 ? textures_[m.roughnessMap].sample(uv)[m.roughnessChannel] * m.roughness : m.roughness;
+    s.metallic = std::clamp(s.metallic, 0.0f, 1.0f);
+    s.roughness = std::clamp(s.roughness, 0.04f, 1.0f);
+    s.emissive = m.emissiveMap >= 0 ? srgbToLinear(vec3(textures_[m.emissiveMap].sample(uv))) : m.emissive;
+
+    if (m.normalMap >= 0) {
+        vec4 t4 = tangents_[tri[0]] * w + tangents_[tri[1]] * hit.u + tangents_[tri[2]] * hit.v;
+        vec3 t = vec3(t4);
+        // Same fallback as vert.glsl when the mesh has no tangents
+        if (glm::length(t) < 1e-5f) {
+            vec3 up = std::abs(s.normal.z) < 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+            t = glm::cross(up, s.normal);
+        }
+        t = glm::normalize(t);
+        vec3 b = glm::normalize(glm::cross(s.normal, t)) * (tangents_[tri[0]].w < 0.0f ? -1.0f : 1.0f);
+        vec3 nTex = vec3(textures_[m.normalMap].sample(uv)) * 2.0f - vec3(1.0f);
+        vec3 mapped = t * nTex.x + b * nTex.y + s.normal * nTex.z;
+        if (glm::dot(mapped, mapped) > 1e-12f) s.normal = glm::normalize(mapped);
+    }
+
+    // Every surface is two sided, both normals face the viewer's side
+    if (glm::dot(s.geometricNormal, ray.direction) > 0.0f) {
+        s.geometricNormal = -s.geometricNormal;
+        s.normal = -s.normal;
+    }
+    return s;
+}
+
+vec3 Render::PathTracer::environment(const vec3& dir) const {
+    if (envTexels_.empty()) return vec3(0.0f);
+    // dirToEquirectUV in texture.cpp
+    float u = std::atan2(dir.z, dir.x) / (2.0f * kPi) + 0.5f;
+    float v = 0.5f - std::asin(std::clamp(dir.y, -1.0f, 1.0f)) / kPi;
+    int x = std::clamp(static_cast<int>(u * envWidth_), 0, envWidth_ - 1);
+    int y = std::clamp(static_cast<int>(v * envHeight_), 0, envHeight_ - 1);
+    return envTexels_[static_cast<size_t>(y) * envWidth_ + x];
+}
+
+float Render::PathTracer::environmentPdf(const vec3& dir) const {
+    if (envTable_.size() == 0) return 0.0f;
+    float cosElevation = std::sqrt(std::max(1.0f - dir.y * dir.y, 0.0f));
+    if (cosElevation < 1e-6f) return 0.0f;
+    float u = std::atan2(dir.z, dir.x) / (2.0f * kPi) + 0.5f;
+    float v = 0.5f - std::asin(std::clamp(dir.y, -1.0f, 1.0f)) / kPi;
+    int x = std::clamp(static_cast<int>(u * envWidth_), 0, envWidth_ - 1);
+    int y = std::clamp(static_cast<int>(v * envHeight_), 0, envHeight_ - 1);
+    // Texel probability over its uv area, then uv to solid angle
+    float probability = envTable_.probability(static_cast<size_t>(y) * envWidth_ + x);
+    return probability * envWidth_ * envHeight_ / (2.0f * kPi * kPi * cosElevation);
+}
+
+vec3 Render::PathTracer::sampleEnvironment(float u1, float u2, float u3, float u4, vec3& dir, float& pdf) const {
+    size_t i = envTable_.sample(u1, u2);
+    int x = static_cast<int>(i % envWidth_), y = static_cast<int>(i / envWidth_);
+    float phi = ((x + u3) / envWidth_ - 0.5f) * 2.0f * kPi;
+    float elevation = (0.5f - (y + u4) / envHeight_) * kPi;
+    dir = vec3(std::cos(elevation) * std::cos(phi), std::sin(elevation), std::cos(elevation) * std::sin(phi));
+    pdf = environmentPdf(dir);
+    return envTexels_[i];
+}
+
+vec3 Render::PathTracer::tracePath(Ray ray, RayHit hit, Sampler& sampler, const PathTracerSettings& settings, size_t& rays) const {
+    vec3 radiance(0.0f), throughput(1.0f);
+    float bsdfPdf = 0.0f; // of the direction that led here, 0 for camera rays
+    bool sampleEnv = settings.enableIBL && envTable_.size() > 0;
+
+    for (int bounce = 0;; ++bounce) {
+        if (hit.triangle == RayHit::kNone) {
+            if (bounce == 0) {
+                if (settings.showEnvironment) radiance += throughput * environment(ray.direction) * settings.iblIntensity;
+            } else if (settings.enableIBL) {
+                float weight = sampleEnv ? powerHeuristic(bsdfPdf, environmentPdf(ray.direction)) : 1.0f;
+                radiance += throughput * environment(ray.direction) * settings.iblIntensity * weight;
+            }
+            break;
+        }
+
+        SurfacePoint s = surface(ray, hit);
+        radiance += throughput * s.emissive;
+        if (bounce >= settings.maxBounces) break;
+
+        const vec3 n = s.normal;
+        const vec3 v = -glm::normalize(ray.direction);
+        const float NdotV = std::max(glm::dot(n, v), 0.0f);
+        const vec3 f0 = glm::mix(vec3(0.04f), s.baseColor, s.metallic);
+        // Pushed off the surface on the side the ray came from, scaled with the distance from the origin
+        float scale = std::max({1.0f, std::abs(s.position.x), std::abs(s.position.y), std::abs(s.position.z)});
+        const vec3 origin = s.position + s.geometricNormal * (1e-4f * scale);
+
+        auto brdf = [&](const vec3& l) {
+            vec3 h = glm::normalize(v + l);
+            float NdotL = std::max(glm::dot(n, l), 0.0f);
+            float NdotH = std::max(glm::dot(n, h), 0.0f);
+            vec3 f = fresnelSchlick(std::max(glm::dot(h, v), 0.0f), f0);
+            float g = geometrySchlickGGX(NdotV, s.roughness) * geometrySchlickGGX(NdotL, s.roughness);
+            vec3 specular = f * (distributionGGX(NdotH, s.roughness) * g / std::max(4.0f * NdotV * NdotL, 1e-4f));
+            vec3 kD = (vec3(1.0f) - f) * (1.0f - s.metallic);
+            return kD * s.baseColor / kPi + specular;
+        };
+        // Lobe selection by the expected weight of each
+        float specularWeight = luminance(fresnelSchlick(NdotV, f0));
+        float diffuseWeight = luminance(s.baseColor) * (1.0f - s.metallic) * (1.0f - specularWeight);
+        float pSpecular = specularWeight + diffuseWeight > 0.0f ? std::clamp(specularWeight / (specularWeight + diffuseWeight), 0.05f, 1.0f) : 0.5f;
+        auto pdf = [&](const vec3& l) {
+            float NdotL = glm::dot(n, l);
+            if (NdotL <= 0.0f) return 0.0f;
+            vec3 h = glm::normalize(v + l);
+            float VdotH = std::max(glm::dot(v, h), 1e-6f);
+            float specularPdf = distributionGGX(std::max(glm::dot(n, h), 0.0f), s.roughness) * std::max(glm::dot(n, h), 0.0f) / (4.0f * VdotH);
+            return pSpecular * specularPdf + (1.0f - pSpecular) * NdotL / kPi;
+        };
+
+        // Point light, same inverse square falloff as the shader
+        if (settings.enableDirect) {
+            vec3 toLight = settings.lightPosition - s.position;
+            float dist2 = glm::dot(toLight, toLight);
+            vec3 l = toLight / std::sqrt(dist2);
+            float NdotL = glm::dot(n, l);
+            if (NdotL > 0.0f && glm::dot(s.geometricNormal, l) > 0.0f) {
+                ++rays;
+                if (!bvh_.occluded({origin, settings.lightPosition - origin, 1.0f - 1e-4f}, alphaFilter, this)) {
+                    radiance += throughput * brdf(l) * NdotL * settings.lightColor * (settings.lightIntensity / std::max(dist2, 1e-4f));
+                }
+            }
+        }
+
+        // Environment, importance sampled through the alias table
+        if (sampleEnv) {
+            float u1 = sampler.next(), u2 = sampler.next(), u3 = sampler.next(), u4 = sampler.next();
+            vec3 l;
+            float lightPdf;
+            vec3 le = sampleEnvironment(u1, u2, u3, u4, l, lightPdf);
+            float NdotL = glm::dot(n, l);
+            if (lightPdf > 0.0f && NdotL > 0.0f && glm::dot(s.geometricNormal, l) > 0.0f) {
+                ++rays;
+                if (!bvh_.occluded({origin, l}, alphaFilter, this)) {
+                    float weight = powerHeuristic(lightPdf, pdf(l));
+                    radiance += throughput * brdf(l) * NdotL * le * (settings.iblIntensity * weight / lightPdf);
+                }
+            }
+        }
+
+        // Next direction: GGX half vector or cosine weighted
+        vec3 t, b;
+        basis(n, t, b);
+        float u1 = sampler.next(), u2 = sampler.next(), u3 = sampler.next();
+        vec3 l;
+        if (u1 < pSpecular) {
+            float a = std::max(s.roughness * s.roughness, 1e-4f);
+            float phi = 2.0f * kPi * u2;
+            float cosTheta = std::sqrt((1.0f - u3) / (1.0f + (a * a - 1.0f) * u3));
+            float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+            vec3 h = t * (sinTheta * std::cos(phi)) + b * (sinTheta * std::sin(phi)) + n * cosTheta;
+            l = h * (2.0f * glm::dot(v, h)) - v;
+        } else {
+            float r = std::sqrt(u2), phi = 2.0f * kPi * u3;
+            l = t * (r * std::cos(phi)) + b * (r * std::sin(phi)) + n * std::sqrt(std::max(1.0f - u2, 0.0f));
+        }
+        float NdotL = glm::dot(n, l);
+        bsdfPdf = pdf(l);
+        if (NdotL <= 0.0f || bsdfPdf <= 0.0f || glm::dot(s.geometricNormal, l) <= 0.0f) break;
+        throughput *= brdf(l) * (NdotL / bsdfPdf);
+
+        if (bounce >= kRouletteDepth) {
+            float survive = std::min(std::max({throughput.x, throughput.y, throughput.z}), 0.95f);
+            if (sampler.next() >= survive) break;
+            throughput /= survive;
+        }
+
+        ray = {origin, l};
+        ++rays;
+        bvh_.intersect(ray, hit, alphaFilter, this);
+    }
+    return radiance;
+}
+
+Render::PathTracerStats Render::PathTracer::render(const PathTracerSettings& settings, int samplesPerPixel) {
+    PathTracerStats stats;
+    if (width_ <= 0 || height_ <= 0 || samplesPerPixel <= 0) return stats;
+    auto start = std::chrono::steady_clock::now();
+    int tilesX = (width_ + kTileSize - 1) / kTileSize, tilesY = (height_ + kTileSize - 1) / kTileSize;
+    std::atomic<size_t> totalRays{0};
+
+    Core::parallelFor(static_cast<size_t>(tilesX) * tilesY, 1, [&](size_t begin, size_t end) {
+        size_t rays = 0;
+        for (size_t tile = begin; tile < end; ++tile) {
+            int x0 = static_cast<int>(tile % tilesX) * kTileSize, y0 = static_cast<int>(tile / tilesX) * kTileSize;
+            int x1 = std::min(x0 + kTileSize, width_), y1 = std::min(y0 + kTileSize, height_);
+            for (int s = 0; s < samplesPerPixel; ++s) {
+                uint32_t sample = static_cast<uint32_t>(samples_ + s);
+                // Camera rays of 2x2 pixel quads are traversed as one packet
+                for (int y = y0; y < y1; y += 2) {
+                    for (int x = x0; x < x1; x += 2) {
+                        RayPacket packet;
+                        Ray cameraRays[4];
+                        uint32_t pixels[4];
+                        Sampler samplers[4] = {{0, 0}, {0, 0}, {0, 0}, {0, 0}};
+                        int lanes = 0;
+                        for (int l = 0; l < 4; ++l) {
+                            int px = std::min(x + (l & 1), x1 - 1), py = std::min(y + (l >> 1), y1 - 1);
+                            pixels[l] = static_cast<uint32_t>(py * width_ + px);
+                            samplers[l] = Sampler(pixels[l], sample);
+                            float jx = samplers[l].next(), jy = samplers[l].next();
+                            cameraRays[l] = cameraRay(px + jx, py + jy);
+                            packet.set(l, cameraRays[l]);
+                            // Quads hanging over the tile edge repeat a pixel, only its first lane counts
+                            bool duplicate = false;
+                            for (int k = 0; k < l; ++k) duplicate |= pixels[k] == pixels[l];
+                            if (!duplicate) lanes |= 1 << l;
+                        }
+                        RayHit hits[4];
+                        bvh_.intersect(packet, hits, alphaFilter, this);
+                        for (int l = 0; l < 4; ++l) {
+                            if (!(lanes & (1 << l))) continue;
+                            ++rays;
+                            vec3 c = tracePath(cameraRays[l], hits[l], samplers[l], settings, rays);
+                            if (!isFinite(c)) c = vec3(0.0f);
+                            sum_[pixels[l]] += c;
+                            if ((sample & 1) == 0) evenSum_[pixels[l]] += c;
+                        }
+                    }
+                }
+            }
+        }
+        totalRays += rays;
+    });
+
+    samples_ += samplesPerPixel;
+    stats.rays = totalRays;
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+std::vector<float> Render::PathTracer::image() const {
+    std::vector<float> rgb(sum_.size() * 3, 0.0f);
+    if (samples_ == 0) return rgb;
+    float inv = 1.0f / samples_;
+    for (size_t i = 0; i < sum_.size(); ++i) {
+        rgb[i * 3] = sum_[i].x * inv;
+        rgb[i * 3 + 1] = sum_[i].y * inv;
+        rgb[i * 3 + 2] = sum_[i].z * inv;
+    }
+    return rgb;
+}
+
+double Render::PathTracer::noiseEstimate() const {
+    if (samples_ < 2 || sum_.empty()) return 0.0;
+    double evenCount = (samples_ + 1) / 2, oddCount = samples_ / 2;
+    double squared = 0.0;
+    for (size_t i = 0; i < sum_.size(); ++i) {
+        vec3 odd = sum_[i] - evenSum_[i];
+        for (int c = 0; c < 3; ++c) {
+            double d = evenSum_[i][c] / evenCount - odd[c] / oddCount;
+            squared += d * d;
+        }
+    }
+    return 0.5 * std::sqrt(squared / (sum_.size() * 3.0));
+}
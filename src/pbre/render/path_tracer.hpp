@@ -0,0 +1,124 @@
+#pragma once
+
+#include "pbre/base.hpp"
+#include "pbre/core/alias_table.hpp"
+#include "pbre/render/bvh.hpp"
+#include "pbre/wrapper/model.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace PBRE::Render {
+// Lighting inputs, the same ones the raster paths get as uniforms
+struct PathTracerSettings {
+    vec3 lightPosition = vec3(5.0f);
+    vec3 lightColor = vec3(1.0f);
+    float lightIntensity = 1.0f;
+    float iblIntensity = 1.0f;
+    bool enableDirect = true;
+    bool enableIBL = true;
+    // The raster paths clear to black, so camera rays that miss don't see the environment by default
+    bool showEnvironment = false;
+    int maxBounces = 8;
+};
+
+struct PathTracerStats {
+    size_t rays = 0; // camera, bounce and shadow rays
+    double ms = 0.0;
+    double raysPerSecond() const { return ms > 0.0 ? rays / (ms / 1000.0) : 0.0; }
+};
+
+// CPU reference for the PBR shading model: unidirectional path tracing of the same meshes, materials
+// (Cook-Torrance GGX + Lambert as in pbr_common.glsl), point light and equirect environment the raster
+// paths use, with next event estimation and MIS between GGX/cosine sampling and an alias table over
+// the environment. Progressive and deterministic: every sample of every pixel has its own random
+// sequence, and tiles are spread over all cores.
+class PathTracer {
+  public:
+    static constexpr int kTileSize = 16;
+
+    // Equirect HDR in the layout Texture::loadHDRAsCubemap expects
+    bool loadEnvironment(const std::string& path);
+
+    void clearGeometry();
+    // Geometry is flattened to world space, like ForwardRenderer::submit
+    void submit(const Wrapper::Model& model, const Wrapper::Mesh& mesh, const mat4& transform);
+    // Builds the BVH and expands the material textures' CPU pixels to RGBA. No GL calls, models must be
+    // loaded with GeometryRetention::All for their textures to have pixels.
+    void build();
+
+    // Resets the accumulation when the camera or size changes
+    void setCamera(const mat4& view, const mat4& projection);
+    void resize(int width, int height);
+    void reset();
+
+    // Adds samplesPerPixel samples to every pixel
+    PathTracerStats render(const PathTracerSettings& settings, int samplesPerPixel);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int sampleCount() const { return samples_; }
+    // Mean radiance so far, RGB, rows top to bottom
+    std::vector<float> image() const;
+    // Half the RMS difference between the images of the even and the odd samples, which estimates the
+    // RMS error of image() against the converged result
+    double noiseEstimate() const;
+    const Bvh& bvh() const { return bvh_; }
+
+  private:
+    struct CpuTexture {
+        int width = 0, height = 0;
+        std::vector<unsigned char> rgba;
+        vec4 sample(vec2 uv) const; // bilinear, repeat
+    };
+    struct TracerMaterial {
+        vec3 albedo = vec3(1.0f);
+        float metallic = 0.0f;
+        float roughness = 1.0f;
+        vec3 emissive = vec3(0.0f);
+        int albedoMap = -1, metallicMap = -1, roughnessMap = -1, normalMap = -1, emissiveMap = -1; // into textures_
+        int metallicChannel = 2, roughnessChannel = 1; // of the packed ORM texture
+        bool alphaTested = false;
+        float alphaCutoff = 0.5f;
+    };
+    struct SurfacePoint;
+    struct Sampler;
+
+    int textureIndex(const std::shared_ptr<Wrapper::Texture>& texture);
+    uint32_t materialIndex(const Wrapper::Model& model, size_t index);
+    static bool alphaFilter(const void* context, uint32_t triangle, float u, float v);
+    vec2 triangleUV(uint32_t triangle, float u, float v) const;
+    SurfacePoint surface(const Ray& ray, const RayHit& hit) const;
+    vec3 environment(const vec3& dir) const;
+    vec3 sampleEnvironment(float u1, float u2, float u3, float u4, vec3& dir, float& pdf) const;
+    float environmentPdf(const vec3& dir) const;
+    // Radiance along a camera ray whose first hit is already known
+    vec3 tracePath(Ray ray, RayHit hit, Sampler& sampler, const PathTracerSettings& settings, size_t& rays) const;
+    Ray cameraRay(float x, float y) const;
+
+    // World space geometry, one entry per vertex / triangle
+    std::vector<vec3> positions_;
+    std::vector<vec3> normals_;
+    std::vector<vec4> tangents_;
+    std::vector<vec2> uvs_;
+    std::vector<uint32_t> indices_;
+    std::vector<uint32_t> triangleMaterials_;
+    std::vector<TracerMaterial> materials_;
+    std::map<std::pair<const Wrapper::Model*, size_t>, uint32_t> materialLookup_;
+    std::vector<CpuTexture> textures_;
+    std::vector<std::shared_ptr<Wrapper::Texture>> textureSources_; // expanded in build()
+    std::map<const Wrapper::Texture*, int> textureLookup_;
+    Bvh bvh_;
+
+    int envWidth_ = 0, envHeight_ = 0;
+    std::vector<vec3> envTexels_;
+    Core::AliasTable envTable_;
+
+    mat4 inverseViewProj_ = mat4(1.0f);
+    int width_ = 0, height_ = 0;
+    int samples_ = 0;
+    std::vector<vec3> sum_;     // every sample
+    std::vector<vec3> evenSum_; // samples 0, 2, 4...
+};
+} // namespace PBRE::Render
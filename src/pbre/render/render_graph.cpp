@@ -0,0 +1,227 @@
+#include "render_graph.hpp"
+
+#include "pbre/wrapper/gl_state.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace PBRE;
+
+Render::RenderGraph::Handle Render::RenderGraph::Builder::read(Handle resource) {
+    graph_.passes_[pass_].reads.push_back(resource.index);
+    return resource;
+}
+
+Render::RenderGraph::Handle Render::RenderGraph::Builder::write(Handle resource) {
+    graph_.passes_[pass_].writes.push_back(resource.index);
+    graph_.resources_[resource.index].producers.push_back(pass_);
+    return resource;
+}
+
+void Render::RenderGraph::Builder::sideEffect() {
+    graph_.passes_[pass_].sideEffect = true;
+}
+
+GLuint Render::RenderGraph::Resources::texture(Handle resource) const {
+    return graph_.resources_[resource.index].texture;
+}
+
+const Render::TextureDesc& Render::RenderGraph::Resources::desc(Handle resource) const {
+    return graph_.resources_[resource.index].desc;
+}
+
+GLuint Render::RenderGraph::Resources::framebuffer() const {
+    const auto& writes = graph_.passes_[pass_].writes;
+    for (uint32_t r : writes) {
+        if (graph_.resources_[r].imported) return 0; // the backbuffer
+    }
+    return graph_.cachedFramebuffer(writes);
+}
+
+GLuint Render::RenderGraph::Resources::framebuffer(std::initializer_list<Handle> attachments) const {
+    std::vector<uint32_t> resources;
+    for (Handle h : attachments) resources.push_back(h.index);
+    return graph_.cachedFramebuffer(resources);
+}
+
+void Render::RenderGraph::Resources::drawFullscreenTriangle() const {
+    Wrapper::GlState::instance().bindVertexArray(graph_.emptyVao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+Render::RenderGraph::RenderGraph(TexturePool& pool) : pool_(pool) {
+    glGenVertexArrays(1, &emptyVao_);
+}
+
+Render::RenderGraph::~RenderGraph() {
+    auto& state = Wrapper::GlState::instance();
+    for (auto& [key, fbo] : framebuffers_) {
+        state.forgetFramebuffer(fbo);
+        glDeleteFramebuffers(1, &fbo);
+    }
+    state.forgetVertexArray(emptyVao_);
+    if (emptyVao_) glDeleteVertexArrays(1, &emptyVao_);
+}
+
+void Render::RenderGraph::reset() {
+    resources_.clear();
+    passes_.clear();
+}
+
+Render::RenderGraph::Handle Render::RenderGraph::createTexture(std::string name, const TextureDesc& desc) {
+    Resource resource;
+    resource.name = std::move(name);
+    resource.desc = desc;
+    resources_.push_back(std::move(resource));
+    return {static_cast<uint32_t>(resources_.size() - 1)};
+}
+
+Render::RenderGraph::Handle Render::RenderGraph::importBackbuffer(std::string name, int width, int height) {
+    Resource resource;
+    resource.name = std::move(name);
+    resource.desc = {width, height, GL_SRGB8_ALPHA8, 1};
+    resource.imported = true;
+    resources_.push_back(std::move(resource));
+    return {static_cast<uint32_t>(resources_.size() - 1)};
+}
+
+void Render::RenderGraph::compile() {
+    for (auto& pass : passes_) {
+        pass.culled = false;
+        pass.refCount = static_cast<int>(pass.writes.size());
+    }
+    for (auto& resource : resources_) {
+        resource.refCount = resource.imported ? 1 : 0;
+        resource.firstPass = resource.lastPass = -1;
+    }
+    for (const auto& pass : passes_) {
+        for (uint32_t r : pass.reads) ++resources_[r].refCount;
+    }
+
+    // Flood backwards from unreferenced resources, culling producers that end up with no consumers. Seeded
+    // before any pass is culled, so a resource is only queued once: unread from the start or on the 1 -> 0
+    // transition, never both, which would take its producers' counts down twice.
+    std::vector<uint32_t> unreferenced;
+    for (uint32_t r = 0; r < resources_.size(); ++r) {
+        if (resources_[r].refCount == 0) unreferenced.push_back(r);
+    }
+    auto cull = [&](Pass& pass) {
+        pass.culled = true;
+        for (uint32_t r : pass.reads) {
+            if (--resources_[r].refCount == 0) unreferenced.push_back(r);
+        }
+    };
+    for (auto& pass : passes_) {
+        if (pass.refCount == 0 && !pass.sideEffect) cull(pass);
+    }
+    while (!unreferenced.empty()) {
+        uint32_t r = unreferenced.back();
+        unreferenced.pop_back();
+        for (uint32_t p : resources_[r].producers) {
+            auto& pass = passes_[p];
+            if (pass.culled) continue;
+            if (--pass.refCount == 0 && !pass.sideEffect) cull(pass);
+        }
+    }
+
+    for (int i = 0; i < static_cast<int>(passes_.size()); ++i) {
+        const auto& pass = passes_[i];
+        if (pass.culled) continue;
+        auto touch = [&](uint32_t r) {
+            auto& resource = resources_[r];
+            if (resource.firstPass < 0) resource.firstPass = i;
+            resource.lastPass = i;
+        };
+        for (uint32_t r : pass.reads) touch(r);
+        for (uint32_t r : pass.writes) touch(r);
+    }
+}
+
+void Render::RenderGraph::execute() {
+    for (int i = 0; i < static_cast<int>(passes_.size()); ++i) {
+        auto& pass = passes_[i];
+        if (pass.culled) continue;
+
+        for (auto& resource : resources_) {
+            if (!resource.imported && resource.firstPass == i) resource.texture = pool_.acquire(resource.desc);
+        }
+
+        auto& passTimer = timer(pass.name);
+        passTimer.begin();
+        Resources resources(*this, static_cast<uint32_t>(i));
+        if (pass.execute) pass.execute(resources);
+        passTimer.end();
+
+        for (auto& resource : resources_) {
+            if (!resource.imported && resource.lastPass == i) pool_.release(resource.texture);
+        }
+    }
+
+    for (GLuint texture : pool_.endFrame()) dropFramebuffers(texture);
+}
+
+std::vector<Render::RenderGraph::PassInfo> Render::RenderGraph::passInfo() const {
+    std::vector<PassInfo> info;
+    info.reserve(passes_.size());
+    for (const auto& pass : passes_) info.push_back({pass.name, pass.culled, gpuMs(pass.name)});
+    return info;
+}
+
+double Render::RenderGraph::gpuMs(std::string_view pass) const {
+    auto it = timers_.find(pass);
+    return it != timers_.end() ? it->second->lastMs() : 0.0;
+}
+
+Wrapper::GpuTimer& Render::RenderGraph::timer(const std::string& pass) {
+    auto it = timers_.find(pass);
+    if (it == timers_.end()) it = timers_.emplace(pass, std::make_unique<Wrapper::GpuTimer>()).first;
+    return *it->second;
+}
+
+GLuint Render::RenderGraph::cachedFramebuffer(const std::vector<uint32_t>& attachments) {
+    std::vector<GLuint> key;
+    key.reserve(attachments.size());
+    for (uint32_t r : attachments) key.push_back(resources_[r].texture);
+    if (auto it = framebuffers_.find(key); it != framebuffers_.end()) return it->second;
+
+    GLuint fbo = 0;
+    glGenFramebuffers(1, &fbo);
+    Wrapper::GlState::instance().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+    std::vector<GLenum> drawBuffers;
+    for (uint32_t r : attachments) {
+        const auto& resource = resources_[r];
+        GLenum format = resource.desc.format;
+        GLenum attachment = GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(drawBuffers.size());
+        if (TexturePool::isDepthFormat(format)) {
+            attachment = TexturePool::hasStencil(format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+        } else {
+            drawBuffers.push_back(attachment);
+        }
+        glFramebufferTexture(GL_FRAMEBUFFER, attachment, resource.texture, 0);
+    }
+    if (drawBuffers.empty()) {
+        glDrawBuffer(GL_NONE);
+    } else {
+        glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        Wrapper::GlState::instance().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        throw std::runtime_error("Render graph framebuffer is incomplete");
+    }
+    Wrapper::GlState::instance().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    framebuffers_.emplace(std::move(key), fbo);
+    return fbo;
+}
+
+void Render::RenderGraph::dropFramebuffers(GLuint texture) {
+    for (auto it = framebuffers_.begin(); it != framebuffers_.end();) {
+        if (std::find(it->first.begin(), it->first.end(), texture) != it->first.end()) {
+            Wrapper::GlState::instance().forgetFramebuffer(it->second);
+            glDeleteFramebuffers(1, &it->second);
+            it = framebuffers_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
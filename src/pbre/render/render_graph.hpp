@@ -0,0 +1,130 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "pbre/render/texture_pool.hpp"
+#include "pbre/wrapper/query.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PBRE::Render {
+// Minimal frame graph. Every frame the passes are declared with the textures they read and write, then
+// compile() culls passes whose outputs nobody consumes and works out each transient's lifetime, and
+// execute() runs the surviving passes in declaration order. Transients are acquired from the TexturePool
+// just before their first use and released right after their last, so non-overlapping ones alias.
+class RenderGraph {
+  public:
+    struct Handle {
+        uint32_t index = UINT32_MAX;
+        bool valid() const { return index != UINT32_MAX; }
+    };
+
+    class Builder {
+      public:
+        Handle read(Handle resource);
+        Handle write(Handle resource);
+        // Keep the pass even if nothing reads what it writes
+        void sideEffect();
+
+      private:
+        friend class RenderGraph;
+        Builder(RenderGraph& graph, uint32_t pass) : graph_(graph), pass_(pass) {}
+        RenderGraph& graph_;
+        uint32_t pass_;
+    };
+
+    class Resources {
+      public:
+        GLuint texture(Handle resource) const;
+        const TextureDesc& desc(Handle resource) const;
+        // FBO with the pass's written textures attached (0 when the pass writes the backbuffer)
+        GLuint framebuffer() const;
+        // FBO with arbitrary attachments, e.g. a blit source
+        GLuint framebuffer(std::initializer_list<Handle> attachments) const;
+        // Fullscreen triangle generated from gl_VertexID
+        void drawFullscreenTriangle() const;
+
+      private:
+        friend class RenderGraph;
+        Resources(RenderGraph& graph, uint32_t pass) : graph_(graph), pass_(pass) {}
+        RenderGraph& graph_;
+        uint32_t pass_;
+    };
+
+    using Execute = std::function<void(Resources&)>;
+
+    struct PassInfo {
+        std::string name;
+        bool culled;
+        double gpuMs; // last completed measurement
+    };
+
+    explicit RenderGraph(TexturePool& pool);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // Starts a new frame's declarations
+    void reset();
+
+    Handle createTexture(std::string name, const TextureDesc& desc);
+    // The default framebuffer. Imported resources count as graph outputs, passes writing them are kept.
+    Handle importBackbuffer(std::string name, int width, int height);
+
+    template <class Setup> void addPass(std::string name, Setup&& setup, Execute execute) {
+        uint32_t index = static_cast<uint32_t>(passes_.size());
+        passes_.push_back({std::move(name), std::move(execute)});
+        Builder builder(*this, index);
+        setup(builder);
+    }
+
+    void compile();
+    void execute();
+
+    // Valid after compile(), in declaration order
+    std::vector<PassInfo> passInfo() const;
+    double gpuMs(std::string_view pass) const;
+    const TexturePool& pool() const { return pool_; }
+
+  private:
+    struct Resource {
+        std::string name;
+        TextureDesc desc;
+        bool imported = false;
+        GLuint texture = 0;
+        int refCount = 0;
+        int firstPass = -1;
+        int lastPass = -1;
+        std::vector<uint32_t> producers;
+    };
+    struct Pass {
+        std::string name;
+        Execute execute;
+        std::vector<uint32_t> reads;
+        std::vector<uint32_t> writes;
+        bool sideEffect = false;
+        bool culled = false;
+        int refCount = 0;
+    };
+
+    GLuint cachedFramebuffer(const std::vector<uint32_t>& resources);
+    void dropFramebuffers(GLuint texture);
+    Wrapper::GpuTimer& timer(const std::string& pass);
+
+    TexturePool& pool_;
+    std::vector<Resource> resources_;
+    std::vector<Pass> passes_;
+    // Keyed by the attached texture names
+    std::map<std::vector<GLuint>, GLuint> framebuffers_;
+    std::map<std::string, std::unique_ptr<Wrapper::GpuTimer>, std::less<>> timers_;
+    GLuint emptyVao_ = 0;
+};
+} // namespace PBRE::Render
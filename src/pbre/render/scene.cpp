@@ -0,0 +1,272 @@
+#include "scene.hpp"
+
+#include "pbre/wrapper/model.hpp"
+
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define PBRE_SCENE_SSE 1
+#else
+#define PBRE_SCENE_SSE 0
+#endif
+
+using namespace PBRE;
+
+alignas(16) static const float kIdentity[16] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                                0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+
+void Render::Scene::reserve(size_t count) {
+    parent_.reserve(count);
+    depth_.reserve(count);
+    for (auto* v : {&tx_, &ty_, &tz_, &rx_, &ry_, &rz_, &rw_, &sx_, &sy_, &sz_}) v->reserve(count);
+    dirty_.reserve(count);
+    changed_.reserve(count);
+    world_.reserve(count);
+    node_.reserve(count);
+    slot_.reserve(count);
+}
+
+void Render::Scene::clear() {
+    parent_.clear();
+    depth_.clear();
+    for (auto* v : {&tx_, &ty_, &tz_, &rx_, &ry_, &rz_, &rw_, &sx_, &sy_, &sz_}) v->clear();
+    dirty_.clear();
+    changed_.clear();
+    world_.clear();
+    node_.clear();
+    slot_.clear();
+    levelStart_.clear();
+    renderables_.clear();
+    layoutDirty_ = false;
+}
+
+Render::NodeId Render::Scene::addNode(NodeId parent, const Transform& local) {
+    uint32_t slot = static_cast<uint32_t>(parent_.size());
+    NodeId id = static_cast<NodeId>(slot_.size());
+    uint32_t parentSlot = parent != kNoNode ? slot_[parent] : kNoNode;
+
+    slot_.push_back(slot);
+    node_.push_back(id);
+    parent_.push_back(parentSlot);
+    depth_.push_back(parentSlot != kNoNode ? depth_[parentSlot] + 1 : 0);
+    tx_.push_back(local.position.x);
+    ty_.push_back(local.position.y);
+    tz_.push_back(local.position.z);
+    rx_.push_back(local.rotation.x);
+    ry_.push_back(local.rotation.y);
+    rz_.push_back(local.rotation.z);
+    rw_.push_back(local.rotation.w);
+    sx_.push_back(local.scale.x);
+    sy_.push_back(local.scale.y);
+    sz_.push_back(local.scale.z);
+    dirty_.push_back(1);
+    changed_.push_back(0);
+    world_.push_back(mat4(1.0f));
+    layoutDirty_ = true;
+    return id;
+}
+
+Render::NodeId Render::Scene::addModel(const Wrapper::Model& model, NodeId parent, const Transform& local) {
+    NodeId root = addNode(parent, local);
+    std::vector<NodeId> ids(model.nodes.size());
+    for (size_t i = 0; i < model.nodes.size(); ++i) {
+        const auto& node = model.nodes[i];
+        ids[i] = addNode(node.parent >= 0 ? ids[node.parent] : root, node.local);
+        if (node.mesh >= 0 && static_cast<size_t>(node.mesh) < model.meshGroups.size()) {
+            const auto& group = model.meshGroups[node.mesh];
+            for (size_t m = group.first; m < group.first + group.count; ++m) renderables_.push_back({ids[i], &model, m});
+        }
+    }
+    return root;
+}
+
+Render::NodeId Render::Scene::addMesh(const Wrapper::Model& model, size_t mesh, NodeId parent, const Transform& local) {
+    NodeId node = addNode(parent, local);
+    renderables_.push_back({node, &model, mesh});
+    return node;
+}
+
+Transform Render::Scene::local(NodeId node) const {
+    uint32_t s = slot_[node];
+    Transform t;
+    t.position = vec3(tx_[s], ty_[s], tz_[s]);
+    t.rotation = quat(rw_[s], rx_[s], ry_[s], rz_[s]);
+    t.scale = vec3(sx_[s], sy_[s], sz_[s]);
+    return t;
+}
+
+void Render::Scene::setLocal(NodeId node, const Transform& local) {
+    setPosition(node, local.position);
+    setRotation(node, local.rotation);
+    setScale(node, local.scale);
+}
+
+void Render::Scene::setPosition(NodeId node, const vec3& position) {
+    uint32_t s = slot_[node];
+    tx_[s] = position.x;
+    ty_[s] = position.y;
+    tz_[s] = position.z;
+    dirty_[s] = 1;
+}
+
+void Render::Scene::setRotation(NodeId node, const quat& rotation) {
+    uint32_t s = slot_[node];
+    rx_[s] = rotation.x;
+    ry_[s] = rotation.y;
+    rz_[s] = rotation.z;
+    rw_[s] = rotation.w;
+    dirty_[s] = 1;
+}
+
+void Render::Scene::setScale(NodeId node, const vec3& scale) {
+    uint32_t s = slot_[node];
+    sx_[s] = scale.x;
+    sy_[s] = scale.y;
+    sz_[s] = scale.z;
+    dirty_[s] = 1;
+}
+
+void Render::Scene::rebuildLayout() {
+    layoutDirty_ = false;
+    size_t count = parent_.size();
+    uint32_t maxDepth = 0;
+    for (uint32_t d : depth_) maxDepth = std::max(maxDepth, d);
+
+    levelStart_.assign(maxDepth + 2, 0);
+    for (uint32_t d : depth_) ++levelStart_[d + 1];
+    for (size_t d = 1; d < levelStart_.size(); ++d) levelStart_[d] += levelStart_[d - 1];
+    // Nodes are usually added breadth first, then the order is already right
+    if (std::is_sorted(depth_.begin(), depth_.end())) return;
+
+    // Stable counting sort by depth, parents keep coming before their children
+    std::vector<uint32_t> next(levelStart_.begin(), levelStart_.end() - 1);
+    std::vector<uint32_t> newSlot(count);
+    for (size_t s = 0; s < count; ++s) newSlot[s] = next[depth_[s]]++;
+
+    auto permute = [&](auto& values) {
+        std::remove_reference_t<decltype(values)> sorted(values.size());
+        for (size_t s = 0; s < count; ++s) sorted[newSlot[s]] = values[s];
+        values.swap(sorted);
+    };
+    for (auto& parent : parent_) {
+        if (parent != kNoNode) parent = newSlot[parent];
+    }
+    permute(parent_);
+    permute(depth_);
+    for (auto* v : {&tx_, &ty_, &tz_, &rx_, &ry_, &rz_, &rw_, &sx_, &sy_, &sz_}) permute(*v);
+    permute(dirty_);
+    permute(changed_);
+    permute(world_);
+    permute(node_);
+    for (auto& slot : slot_) slot = newSlot[slot];
+}
+
+size_t Render::Scene::update() {
+    if (layoutDirty_) rebuildLayout();
+
+    size_t composed = 0;
+    for (size_t level = 0; level + 1 < levelStart_.size(); ++level) {
+        uint32_t begin = levelStart_[level], end = levelStart_[level + 1];
+        // Parents are in earlier levels, so their changed flags are final here
+        for (uint32_t s = begin; s < end; ++s) {
+            uint32_t p = parent_[s];
+            changed_[s] = dirty_[s] | (p != kNoNode ? changed_[p] : 0);
+        }
+        uint32_t s = begin;
+        while (s < end) {
+            if (useSimd && s + 4 <= end && (changed_[s] & changed_[s + 1] & changed_[s + 2] & changed_[s + 3])) {
+                composeBlock(s);
+                composed += 4;
+                s += 4;
+            } else {
+                if (changed_[s]) {
+                    composeScalar(s);
+                    ++composed;
+                }
+                ++s;
+            }
+        }
+    }
+    std::fill(dirty_.begin(), dirty_.end(), 0);
+    return composed;
+}
+
+// world = parentWorld * T * R * S, the same composition as Transform::toMat4
+void Render::Scene::composeScalar(uint32_t s) {
+    float x = rx_[s], y = ry_[s], z = rz_[s], w = rw_[s];
+    float x2 = x + x, y2 = y + y, z2 = z + z;
+    float xx = x * x2, yy = y * y2, zz = z * z2;
+    float xy = x * y2, xz = x * z2, yz = y * z2;
+    float wx = w * x2, wy = w * y2, wz = w * z2;
+
+    mat4 local(1.0f);
+    local[0] = vec4((1.0f - (yy + zz)) * sx_[s], (xy + wz) * sx_[s], (xz - wy) * sx_[s], 0.0f);
+    local[1] = vec4((xy - wz) * sy_[s], (1.0f - (xx + zz)) * sy_[s], (yz + wx) * sy_[s], 0.0f);
+    local[2] = vec4((xz + wy) * sz_[s], (yz - wx) * sz_[s], (1.0f - (xx + yy)) * sz_[s], 0.0f);
+    local[3] = vec4(tx_[s], ty_[s], tz_[s], 1.0f);
+
+    uint32_t p = parent_[s];
+    world_[s] = p != kNoNode ? world_[p] * local : local;
+}
+
+void Render::Scene::composeBlock(uint32_t s) {
+#if PBRE_SCENE_SSE
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    // Local rotation * scale columns for four nodes, lane i = node s + i
+    __m128 x = _mm_loadu_ps(&rx_[s]), y = _mm_loadu_ps(&ry_[s]), z = _mm_loadu_ps(&rz_[s]), w = _mm_loadu_ps(&rw_[s]);
+    __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+    __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+    __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+    __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+    __m128 sx = _mm_loadu_ps(&sx_[s]), sy = _mm_loadu_ps(&sy_[s]), sz = _mm_loadu_ps(&sz_[s]);
+
+    __m128 l[4][3]; // column, row
+    l[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+    l[0][1] = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+    l[0][2] = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+    l[1][0] = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+    l[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+    l[1][2] = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+    l[2][0] = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+    l[2][1] = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+    l[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+    l[3][0] = _mm_loadu_ps(&tx_[s]);
+    l[3][1] = _mm_loadu_ps(&ty_[s]);
+    l[3][2] = _mm_loadu_ps(&tz_[s]);
+
+    // Parent world matrices transposed so each register holds one element for the four nodes
+    const float* parents[4];
+    for (int i = 0; i < 4; ++i) {
+        uint32_t p = parent_[s + i];
+        parents[i] = p != kNoNode ? &world_[p][0][0] : kIdentity;
+    }
+    __m128 pm[4][3];
+    for (int c = 0; c < 4; ++c) {
+        __m128 a0 = _mm_loadu_ps(parents[0] + 4 * c), a1 = _mm_loadu_ps(parents[1] + 4 * c);
+        __m128 a2 = _mm_loadu_ps(parents[2] + 4 * c), a3 = _mm_loadu_ps(parents[3] + 4 * c);
+        _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+        pm[c][0] = a0;
+        pm[c][1] = a1;
+        pm[c][2] = a2;
+    }
+
+    // Affine multiply, the bottom row stays (0, 0, 0, 1)
+    for (int c = 0; c < 4; ++c) {
+        __m128 r[4];
+        for (int row = 0; row < 3; ++row) {
+            r[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pm[0][row], l[c][0]), _mm_mul_ps(pm[1][row], l[c][1])),
+                                _mm_mul_ps(pm[2][row], l[c][2]));
+            if (c == 3) r[row] = _mm_add_ps(r[row], pm[3][row]);
+        }
+        r[3] = c == 3 ? one : zero;
+        _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+        for (int i = 0; i < 4; ++i) _mm_storeu_ps(&world_[s + i][c][0], r[i]);
+    }
+#else
+    for (uint32_t i = 0; i < 4; ++i) composeScalar(s + i);
+#endif
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "pbre/base.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace PBRE::Wrapper {
+struct Model;
+}
+
+namespace PBRE::Render {
+using NodeId = uint32_t;
+inline constexpr NodeId kNoNode = UINT32_MAX;
+
+// Flattened transform hierarchy. Nodes live in arrays sorted by depth, with the local translation,
+// rotation and scale split into one float array per component. update() walks the arrays once in
+// order: a node is recomposed only if its local transform or an ancestor's world transform changed,
+// and since no node in a depth level depends on another, runs of four are composed together with SSE.
+// NodeIds stay stable when nodes are re-sorted.
+class Scene {
+  public:
+    struct Renderable {
+        NodeId node;
+        const Wrapper::Model* model;
+        size_t mesh;
+    };
+
+    void reserve(size_t count);
+    void clear();
+
+    NodeId addNode(NodeId parent, const Transform& local = {});
+    // Instantiates the model's glTF node hierarchy under a new node placed at local, returns that node.
+    // Nodes referencing a mesh add one renderable per primitive.
+    NodeId addModel(const Wrapper::Model& model, NodeId parent, const Transform& local = {});
+    // One renderable for a single mesh of the model, on a new node placed at local
+    NodeId addMesh(const Wrapper::Model& model, size_t mesh, NodeId parent, const Transform& local = {});
+
+    Transform local(NodeId node) const;
+    void setLocal(NodeId node, const Transform& local);
+    void setPosition(NodeId node, const vec3& position);
+    void setRotation(NodeId node, const quat& rotation);
+    void setScale(NodeId node, const vec3& scale);
+
+    // Recomposes the world matrices of changed subtrees, returns how many were recomposed
+    size_t update();
+    // Valid after update()
+    const mat4& world(NodeId node) const { return world_[slot_[node]]; }
+    // Whether the last update() recomposed the node's world matrix
+    bool changed(NodeId node) const { return changed_[slot_[node]] != 0; }
+
+    size_t size() const { return parent_.size(); }
+    size_t depthCount() const { return levelStart_.empty() ? 0 : levelStart_.size() - 1; }
+    const std::vector<Renderable>& renderables() const { return renderables_; }
+
+    // Compose in blocks of four with SSE where available (the scalar path is kept for comparison)
+    bool useSimd = true;
+
+  private:
+    void rebuildLayout();
+    void composeScalar(uint32_t slot);
+    void composeBlock(uint32_t slot); // slot .. slot + 3
+
+    // Per slot, sorted by depth
+    std::vector<uint32_t> parent_; // parent slot or kNoNode
+    std::vector<uint32_t> depth_;
+    std::vector<float> tx_, ty_, tz_;
+    std::vector<float> rx_, ry_, rz_, rw_;
+    std::vector<float> sx_, sy_, sz_;
+    std::vector<uint8_t> dirty_;   // local transform changed since the last update
+    std::vector<uint8_t> changed_; // world matrix recomposed by the last update
+    std::vector<mat4> world_;      // kept as matrices, they go straight to uniforms
+    std::vector<NodeId> node_;
+
+    std::vector<uint32_t> slot_;       // NodeId -> slot
+    std::vector<uint32_t> levelStart_; // first slot of each depth, plus the end
+    bool layoutDirty_ = false;
+
+    std::vector<Renderable> renderables_;
+};
+} // namespace PBRE::Render
@@ -0,0 +1,355 @@
+#include "scene_bvh.hpp"
+#include "pbre/render/scene.hpp"
+#include "pbre/wrapper/model.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace PBRE;
+
+namespace {
+constexpr int kBins = 16;
+constexpr uint32_t kMaxLeaf = 4;
+constexpr int kMaxDepth = 64; // deeper nodes become leaves, the traversal stack has room for them
+constexpr int kStackSize = 128;
+constexpr float kTraversalCost = 1.0f; // relative to one object test
+// Above this fraction of objects changed, one bottom up pass over every node beats walking each path
+constexpr size_t kFullRefitDivisor = 8;
+
+// Avoids 0 * inf = NaN in the slab test for axis aligned rays
+float safeReciprocal(float d) {
+    return 1.0f / (std::abs(d) > 1e-20f ? d : std::copysign(1e-20f, d));
+}
+
+// Entry distance of the ray into the box clamped to 0, or 1e30 if it misses within tMax
+float boxEntry(const vec3& boundsMin, const vec3& boundsMax, const vec3& origin, const vec3& inverseDirection, float tMax) {
+    vec3 t1 = (boundsMin - origin) * inverseDirection, t2 = (boundsMax - origin) * inverseDirection;
+    vec3 tmin = glm::min(t1, t2), tmax = glm::max(t1, t2);
+    float tNear = std::max({tmin.x, tmin.y, tmin.z, 0.0f});
+    float tFar = std::min({tmax.x, tmax.y, tmax.z, tMax});
+    return tNear <= tFar ? tNear : 1e30f;
+}
+
+vec3 inverseDirection(const vec3& d) {
+    return vec3(safeReciprocal(d.x), safeReciprocal(d.y), safeReciprocal(d.z));
+}
+} // namespace
+
+Render::Aabb Render::Aabb::transformed(const mat4& m) const {
+    // Each column of the linear part stretches the box by its smaller and larger product along that axis
+    Aabb out;
+    out.min = out.max = vec3(m[3]);
+    for (int c = 0; c < 3; ++c) {
+        vec3 a = vec3(m[c]) * min[c], b = vec3(m[c]) * max[c];
+        out.min += glm::min(a, b);
+        out.max += glm::max(a, b);
+    }
+    return out;
+}
+
+void Render::SceneBvh::build(std::span<const Aabb> bounds) {
+    auto start = std::chrono::steady_clock::now();
+    size_t count = bounds.size();
+    bounds_.assign(bounds.begin(), bounds.end());
+    nodes_.clear();
+    parents_.clear();
+    objects_.resize(count);
+    leafOf_.assign(count, kNone);
+    dirty_.clear();
+    dirtyFlag_.assign(count, 0);
+    costSum_ = 0.0;
+    builtCost_ = 0.0;
+    if (count == 0) return;
+
+    std::vector<vec3> centroids(count);
+    for (size_t i = 0; i < count; ++i) {
+        centroids[i] = (bounds_[i].min + bounds_[i].max) * 0.5f;
+        objects_[i] = static_cast<uint32_t>(i);
+    }
+
+    nodes_.reserve(count * 2 / kMaxLeaf + 1);
+    parents_.reserve(count * 2 / kMaxLeaf + 1);
+    nodes_.push_back({vec3(0.0f), 0, vec3(0.0f), static_cast<uint32_t>(count)});
+    parents_.push_back(kNone);
+    struct Task {
+        uint32_t node;
+        int depth;
+    };
+    std::vector<Task> tasks = {{0, 0}};
+    while (!tasks.empty()) {
+        Task task = tasks.back();
+        tasks.pop_back();
+        uint32_t first = nodes_[task.node].first, n = nodes_[task.node].count;
+        uint32_t* ids = objects_.data() + first;
+
+        Aabb box, centroidBounds;
+        for (uint32_t i = 0; i < n; ++i) {
+            box.grow(bounds_[ids[i]]);
+            centroidBounds.grow(centroids[ids[i]]);
+        }
+        nodes_[task.node].boundsMin = box.min;
+        nodes_[task.node].boundsMax = box.max;
+
+        // Binned SAH over the centroid extent of each axis, as in Bvh::build
+        float bestCost = 1e30f;
+        int bestAxis = -1, bestSplit = 0;
+        for (int axis = 0; axis < 3 && n > 1 && task.depth < kMaxDepth; ++axis) {
+            float lo = centroidBounds.min[axis], extent = centroidBounds.max[axis] - lo;
+            if (extent <= 1e-12f) continue;
+            float scale = kBins / extent;
+            Aabb binBounds[kBins];
+            uint32_t binCount[kBins] = {};
+            for (uint32_t i = 0; i < n; ++i) {
+                int b = std::min(kBins - 1, static_cast<int>((centroids[ids[i]][axis] - lo) * scale));
+                binBounds[b].grow(bounds_[ids[i]]);
+                ++binCount[b];
+            }
+            float rightArea[kBins - 1];
+            uint32_t rightCount[kBins - 1];
+            Aabb right;
+            uint32_t rightN = 0;
+            for (int b = kBins - 1; b > 0; --b) {
+                right.grow(binBounds[b]);
+                rightN += binCount[b];
+                rightArea[b - 1] = right.halfArea();
+                rightCount[b - 1] = rightN;
+            }
+            Aabb left;
+            uint32_t leftN = 0;
+            for (int b = 0; b < kBins - 1; ++b) {
+                left.grow(binBounds[b]);
+                leftN += binCount[b];
+                if (leftN == 0 || rightCount[b] == 0) continue;
+                float cost = leftN * left.halfArea() + rightCount[b] * rightArea[b];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b + 1;
+                }
+            }
+        }
+
+        float area = box.halfArea();
+        float splitCost = area > 0.0f ? kTraversalCost + bestCost / area : 1e30f;
+        bool leaf = n <= 1 || task.depth >= kMaxDepth || (n <= kMaxLeaf && (bestAxis < 0 || splitCost >= static_cast<float>(n)));
+        if (leaf) {
+            for (uint32_t i = 0; i < n; ++i) leafOf_[ids[i]] = task.node;
+            continue;
+        }
+
+        uint32_t mid;
+        if (bestAxis >= 0) {
+            float lo = centroidBounds.min[bestAxis];
+            float scale = kBins / (centroidBounds.max[bestAxis] - lo);
+            uint32_t* split = std::partition(ids, ids + n, [&](uint32_t id) {
+                return std::min(kBins - 1, static_cast<int>((centroids[id][bestAxis] - lo) * scale)) < bestSplit;
+            });
+            mid = static_cast<uint32_t>(split - ids);
+        } else {
+            // Every centroid coincides: split the list in half
+            mid = n / 2;
+        }
+        if (mid == 0 || mid == n) mid = n / 2;
+
+        uint32_t leftChild = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back({vec3(0.0f), first, vec3(0.0f), mid});
+        nodes_.push_back({vec3(0.0f), first + mid, vec3(0.0f), n - mid});
+        parents_.push_back(task.node);
+        parents_.push_back(task.node);
+        nodes_[task.node].first = leftChild;
+        nodes_[task.node].count = 0;
+        tasks.push_back({leftChild + 1, task.depth + 1});
+        tasks.push_back({leftChild, task.depth + 1});
+    }
+
+    for (const Node& node : nodes_) costSum_ += nodeCost(node);
+    builtCost_ = cost();
+    buildMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double Render::SceneBvh::nodeCost(const Node& node) const {
+    vec3 e = node.boundsMax - node.boundsMin;
+    double area = e.x < 0.0f ? 0.0 : e.x * e.y + e.y * e.z + e.z * e.x;
+    return area * (node.count > 0 ? static_cast<double>(node.count) : kTraversalCost);
+}
+
+double Render::SceneBvh::cost() const {
+    if (nodes_.empty()) return 0.0;
+    vec3 e = nodes_[0].boundsMax - nodes_[0].boundsMin;
+    double rootArea = e.x * e.y + e.y * e.z + e.z * e.x;
+    return rootArea > 0.0 ? costSum_ / rootArea : 0.0;
+}
+
+void Render::SceneBvh::update(uint32_t object, const Aabb& bounds) {
+    bounds_[object] = bounds;
+    if (!dirtyFlag_[object]) {
+        dirtyFlag_[object] = 1;
+        dirty_.push_back(object);
+    }
+}
+
+bool Render::SceneBvh::refitNode(uint32_t index) {
+    Node& node = nodes_[index];
+    Aabb box;
+    if (node.count > 0) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) box.grow(bounds_[objects_[i]]);
+    } else {
+        for (uint32_t child : {node.first, node.first + 1}) {
+            box.grow(nodes_[child].boundsMin);
+            box.grow(nodes_[child].boundsMax);
+        }
+    }
+    if (box.min == node.boundsMin && box.max == node.boundsMax) return false;
+    costSum_ -= nodeCost(node);
+    node.boundsMin = box.min;
+    node.boundsMax = box.max;
+    costSum_ += nodeCost(node);
+    return true;
+}
+
+bool Render::SceneBvh::refit() {
+    auto start = std::chrono::steady_clock::now();
+    if (dirty_.empty()) {
+        refitMs_ = 0.0;
+        return false;
+    }
+    if (dirty_.size() * kFullRefitDivisor > bounds_.size()) {
+        // Children come after their parents
+        for (size_t i = nodes_.size(); i-- > 0;) refitNode(static_cast<uint32_t>(i));
+    } else {
+        // Up from each changed leaf until a box stays the same, the rest of the path then does too
+        for (uint32_t object : dirty_) {
+            for (uint32_t node = leafOf_[object]; node != kNone && refitNode(node); node = parents_[node]) {}
+        }
+    }
+    for (uint32_t object : dirty_) dirtyFlag_[object] = 0;
+    dirty_.clear();
+
+    bool rebuilt = false;
+    if (costRatio() > rebuildThreshold) {
+        std::vector<Aabb> bounds = std::move(bounds_);
+        build(bounds);
+        ++rebuilds_;
+        rebuilt = true;
+    }
+    refitMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return rebuilt;
+}
+
+bool Render::SceneBvh::intersect(const Ray& ray, Hit& hit, ObjectIntersector intersector, const void* context) const {
+    hit = Hit{};
+    if (nodes_.empty()) return false;
+    const vec3 inv = inverseDirection(ray.direction);
+    float tMax = ray.tMax;
+
+    struct Entry {
+        uint32_t node;
+        float tNear;
+    };
+    Entry stack[kStackSize];
+    int sp = 0;
+    float rootNear = boxEntry(nodes_[0].boundsMin, nodes_[0].boundsMax, ray.origin, inv, tMax);
+    if (rootNear >= 1e30f) return false;
+    stack[sp++] = {0, rootNear};
+    while (sp > 0) {
+        Entry entry = stack[--sp];
+        if (entry.tNear > tMax) continue; // a closer hit was found since it was pushed
+        const Node& node = nodes_[entry.node];
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                uint32_t object = objects_[i];
+                float t = boxEntry(bounds_[object].min, bounds_[object].max, ray.origin, inv, tMax);
+                if (t >= tMax) continue;
+                if (intersector) t = intersector(context, object, {ray.origin, ray.direction, tMax});
+                if (t >= tMax) continue;
+                tMax = t;
+                hit = {object, t};
+            }
+            continue;
+        }
+        // Near child on top of the stack
+        uint32_t a = node.first, b = node.first + 1;
+        float ta = boxEntry(nodes_[a].boundsMin, nodes_[a].boundsMax, ray.origin, inv, tMax);
+        float tb = boxEntry(nodes_[b].boundsMin, nodes_[b].boundsMax, ray.origin, inv, tMax);
+        if (tb < ta) {
+            std::swap(a, b);
+            std::swap(ta, tb);
+        }
+        if (tb < 1e30f) stack[sp++] = {b, tb};
+        if (ta < 1e30f) stack[sp++] = {a, ta};
+    }
+    return hit.object != kNone;
+}
+
+void Render::SceneBvh::overlap(const Aabb& box, std::vector<uint32_t>& objects) const {
+    if (nodes_.empty()) return;
+    uint32_t stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        const Node& node = nodes_[stack[--sp]];
+        if (!box.overlaps({node.boundsMin, node.boundsMax})) continue;
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                if (box.overlaps(bounds_[objects_[i]])) objects.push_back(objects_[i]);
+            }
+            continue;
+        }
+        stack[sp++] = node.first;
+        stack[sp++] = node.first + 1;
+    }
+}
+
+static Render::Aabb worldBounds(const Render::Scene& scene, const Render::Scene::Renderable& r) {
+    const auto& mesh = r.model->meshes[r.mesh];
+    return Render::Aabb{mesh.boundsMin, mesh.boundsMax}.transformed(scene.world(r.node));
+}
+
+void Render::ScenePicker::update(const Scene& scene) {
+    const auto& renderables = scene.renderables();
+    if (bvh_.objectCount() != renderables.size()) {
+        std::vector<Aabb> bounds(renderables.size());
+        for (size_t i = 0; i < renderables.size(); ++i) bounds[i] = worldBounds(scene, renderables[i]);
+        bvh_.build(bounds);
+        return;
+    }
+    for (size_t i = 0; i < renderables.size(); ++i) {
+        if (scene.changed(renderables[i].node)) bvh_.update(static_cast<uint32_t>(i), worldBounds(scene, renderables[i]));
+    }
+    bvh_.refit();
+}
+
+const Render::Bvh& Render::ScenePicker::meshBvh(const Wrapper::Mesh& mesh) const {
+    auto it = meshBvhs_.find(&mesh);
+    if (it != meshBvhs_.end()) return it->second;
+    Bvh& bvh = meshBvhs_[&mesh];
+    bvh.build(mesh.positions, mesh.indices);
+    return bvh;
+}
+
+bool Render::ScenePicker::pick(const Scene& scene, const Ray& ray, Hit& hit, const Wrapper::Model* ignore) const {
+    struct Context {
+        const ScenePicker* picker;
+        const Scene* scene;
+        const Wrapper::Model* ignore;
+    } context{this, &scene, ignore};
+    auto intersector = [](const void* data, uint32_t object, const Ray& worldRay) -> float {
+        const auto& c = *static_cast<const Context*>(data);
+        const auto& r = c.scene->renderables()[object];
+        if (r.model == c.ignore) return worldRay.tMax;
+        const auto& mesh = r.model->meshes[r.mesh];
+        // Into object space; the direction isn't renormalized, so t stays the same along the ray
+        mat4 toObject = glm::inverse(c.scene->world(r.node));
+        Ray local{vec3(toObject * vec4(worldRay.origin, 1.0f)), vec3(toObject * vec4(worldRay.direction, 0.0f)), worldRay.tMax};
+        if (mesh.positions.empty() || mesh.indices.empty()) {
+            return std::min(worldRay.tMax, boxEntry(mesh.boundsMin, mesh.boundsMax, local.origin, inverseDirection(local.direction), local.tMax));
+        }
+        RayHit meshHit;
+        return c.picker->meshBvh(mesh).intersect(local, meshHit) ? meshHit.t : worldRay.tMax;
+    };
+    SceneBvh::Hit sceneHit;
+    if (!bvh_.intersect(ray, sceneHit, intersector, &context)) return false;
+    hit = {sceneHit.object, sceneHit.t, ray.origin + ray.direction * sceneHit.t};
+    return true;
+}
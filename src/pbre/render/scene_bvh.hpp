@@ -0,0 +1,139 @@
+#pragma once
+
+#include "pbre/base.hpp"
+#include "pbre/render/bvh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace PBRE::Wrapper {
+struct Mesh;
+struct Model;
+} // namespace PBRE::Wrapper
+
+namespace PBRE::Render {
+class Scene;
+
+struct Aabb {
+    vec3 min = vec3(1e30f);
+    vec3 max = vec3(-1e30f);
+
+    void grow(const vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    void grow(const Aabb& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+    bool overlaps(const Aabb& b) const {
+        return min.x <= b.max.x && max.x >= b.min.x && min.y <= b.max.y && max.y >= b.min.y && min.z <= b.max.z && max.z >= b.min.z;
+    }
+    float halfArea() const {
+        vec3 e = max - min;
+        return e.x < 0.0f ? 0.0f : e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+    // Bounds of this box under an affine transform
+    Aabb transformed(const mat4& m) const;
+};
+
+// Dynamic BVH over object bounds. Built top down with binned SAH, then kept up to date by refitting: update()
+// records an object's new bounds and refit() recomputes the boxes on the paths from the changed leaves to
+// the root. Refitting keeps the topology, so the tree degrades as objects drift apart from their neighbours;
+// its SAH cost is maintained with every box change and refit() rebuilds once the cost grows past
+// rebuildThreshold times the cost right after the last build.
+class SceneBvh {
+  public:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    // Exact test of one object against a ray, returns the hit distance or a value >= ray.tMax for a miss
+    using ObjectIntersector = float (*)(const void* context, uint32_t object, const Ray& ray);
+
+    struct Hit {
+        uint32_t object = kNone;
+        float t = 1e30f;
+    };
+
+    void build(std::span<const Aabb> bounds);
+    // Takes effect on the next refit()
+    void update(uint32_t object, const Aabb& bounds);
+    // Returns true if it rebuilt instead
+    bool refit();
+
+    // Closest object along the ray. Without an intersector the objects' boxes are the hit surfaces.
+    bool intersect(const Ray& ray, Hit& hit, ObjectIntersector intersector = nullptr, const void* context = nullptr) const;
+    // Appends the objects whose bounds overlap box
+    void overlap(const Aabb& box, std::vector<uint32_t>& objects) const;
+
+    size_t objectCount() const { return bounds_.size(); }
+    size_t nodeCount() const { return nodes_.size(); }
+    const Aabb& bounds(uint32_t object) const { return bounds_[object]; }
+    // SAH cost relative to the cost after the last build
+    float costRatio() const { return builtCost_ > 0.0 ? static_cast<float>(cost() / builtCost_) : 1.0f; }
+    double cost() const;
+
+    double buildMs() const { return buildMs_; }
+    double refitMs() const { return refitMs_; }
+    int rebuilds() const { return rebuilds_; } // triggered by refit()
+
+    float rebuildThreshold = 1.5f;
+
+  private:
+    // 32 bytes. Interior nodes have count 0 and their children at first and first + 1.
+    struct Node {
+        vec3 boundsMin;
+        uint32_t first;
+        vec3 boundsMax;
+        uint32_t count;
+    };
+
+    // Recomputes a node's box from its objects or children, returns false if it didn't change
+    bool refitNode(uint32_t node);
+    double nodeCost(const Node& node) const;
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> parents_;
+    std::vector<uint32_t> objects_; // leaf order -> object
+    std::vector<uint32_t> leafOf_;  // object -> leaf node
+    std::vector<Aabb> bounds_;      // per object
+    std::vector<uint32_t> dirty_;   // objects updated since the last refit
+    std::vector<uint8_t> dirtyFlag_;
+    double costSum_ = 0.0; // unnormalized SAH cost, kept in step with the node boxes
+    double builtCost_ = 0.0;
+    double buildMs_ = 0.0;
+    double refitMs_ = 0.0;
+    int rebuilds_ = 0;
+};
+
+// Mouse picking against the renderables of a scene. A SceneBvh over their world bounds finds the candidates
+// along the ray, each is then tested exactly against a triangle BVH of its mesh, built on first use from the
+// mesh's CPU positions (meshes that kept none are picked by their bounds).
+class ScenePicker {
+  public:
+    struct Hit {
+        size_t renderable = SIZE_MAX;
+        float t = 1e30f;
+        vec3 position = vec3(0.0f);
+    };
+
+    // Call after every Scene::update(): refits the bounds of renderables whose nodes were recomposed, or
+    // builds the BVH if the renderables changed
+    void update(const Scene& scene);
+    // Renderables of the ignored model are skipped
+    bool pick(const Scene& scene, const Ray& ray, Hit& hit, const Wrapper::Model* ignore = nullptr) const;
+
+    const SceneBvh& bvh() const { return bvh_; }
+    // Drops the triangle BVHs, when the meshes they were built from go away
+    void clearMeshCache() { meshBvhs_.clear(); }
+
+  private:
+    const Bvh& meshBvh(const Wrapper::Mesh& mesh) const;
+
+    SceneBvh bvh_;
+    // Built lazily by the const pick()
+    mutable std::unordered_map<const Wrapper::Mesh*, Bvh> meshBvhs_;
+};
+} // namespace PBRE::Render
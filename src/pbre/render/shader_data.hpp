@@ -0,0 +1,102 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "pbre/base.hpp"
+
+#include <cstdint>
+
+namespace PBRE::Render {
+// Uniform block bindings of shaders/frame_data.glsl and shaders/draw_data.glsl
+constexpr GLuint kFrameDataBinding = 0;
+constexpr GLuint kDrawDataBinding = 1;
+// Shader storage bindings of the MATERIAL_TABLE variants, above the visibility resolve's 0-4
+constexpr GLuint kMaterialTableBinding = 5;
+constexpr GLuint kDrawInstanceBinding = 6;
+
+// std140 mirror of the FrameData block, written once per frame
+struct FrameData {
+    mat4 view = mat4(1.0f);
+    mat4 projection = mat4(1.0f);
+    vec3 lightPosition = vec3(0.0f);
+    float pad0 = 0.0f;
+    vec3 lightColor = vec3(1.0f);
+    float lightIntensity = 1.0f;
+    vec3 viewPos = vec3(0.0f);
+    float envMaxMips = 0.0f;
+    float iblIntensity = 1.0f;
+    float horizonFadePower = 2.0f;
+    int debugMode = 0; // 0=off, 1=NdotL, 2=NdotV, 3=DirectOnly, 4=IBLOnly
+    int enableIBL = 1;
+    int enableDirect = 1;
+    int pad1[3] = {};
+};
+static_assert(sizeof(FrameData) == 208, "FrameData must match the std140 block");
+
+// std140 mirror of MaterialData in shaders/draw_data.glsl. Constants are used where the has flag is 0, with a map
+// metallic and roughness scale its channel and ao is the occlusion strength (Render::Material's factors).
+struct MaterialData {
+    vec3 albedo = vec3(1.0f);
+    float metallic = 0.0f;
+    vec3 emissive = vec3(0.0f);
+    float roughness = 1.0f;
+    float ao = 1.0f;
+    float alphaCutoff = 0.5f;
+    int hasAlbedoMap = 0;
+    int hasMetallicMap = 0;
+    int hasRoughnessMap = 0;
+    int hasAOMap = 0;
+    int hasEmissiveMap = 0;
+    int hasNormalMap = 0;
+    int doubleSided = 0;
+    // Channels of the packed ORM texture (Render::Material) the maps read
+    int metallicChannel = 2;
+    int roughnessChannel = 1;
+    int aoChannel = 0;
+};
+static_assert(sizeof(MaterialData) == 80, "MaterialData must match the std140 struct");
+
+// std140 mirror of the DrawData block, one per draw record
+struct DrawData {
+    mat4 model = mat4(1.0f);
+    vec4 normalMatrix[3] = {}; // mat3 columns, padded to vec4 like std140
+    MaterialData material;
+
+    void setTransform(const mat4& transform, const mat3& normal) {
+        model = transform;
+        for (int c = 0; c < 3; ++c) normalMatrix[c] = vec4(normal[c], 0.0f);
+    }
+};
+static_assert(sizeof(DrawData) == 192, "DrawData must match the std140 block");
+
+// Material texture slots, in MaterialRecord::maps and materialMap() of shaders/draw_data.glsl
+enum MaterialMap {
+    kAlbedoMap,
+    kOrmMap, // occlusion, roughness and metallic in one texture
+    kNormalMap,
+    kEmissiveMap,
+    kMaterialMapCount,
+};
+
+// std430 mirror of MaterialRecord, one per material of the MaterialTable. Each map is either a bindless
+// handle (low, high) or (texture array, layer).
+struct MaterialRecord {
+    MaterialData constants;
+    uint32_t maps[kMaterialMapCount][2] = {};
+};
+static_assert(sizeof(MaterialRecord) == 112, "MaterialRecord must match the std430 struct");
+
+// std430 mirror of DrawInstance, the per draw data of batched draws, read at gl_BaseInstance
+struct DrawInstance {
+    mat4 model = mat4(1.0f);
+    vec4 normalMatrix[3] = {};
+    uint32_t material = 0; // into the MaterialTable
+    uint32_t pad[3] = {};
+
+    void setTransform(const mat4& transform, const mat3& normal) {
+        model = transform;
+        for (int c = 0; c < 3; ++c) normalMatrix[c] = vec4(normal[c], 0.0f);
+    }
+};
+static_assert(sizeof(DrawInstance) == 128, "DrawInstance must match the std430 struct");
+} // namespace PBRE::Render
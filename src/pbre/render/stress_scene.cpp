@@ -0,0 +1,80 @@
+#include "stress_scene.hpp"
+#include "pbre/wrapper/model.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace PBRE;
+
+namespace {
+constexpr float kPi = 3.14159265359f;
+
+// Floats from the raw generator output, std::uniform_real_distribution differs between standard libraries
+class Random {
+  public:
+    explicit Random(uint32_t seed) : engine_(seed) {}
+
+    float unit() { return static_cast<float>(engine_() >> 8) * (1.0f / 16777216.0f); }
+    float range(float lo, float hi) { return lo + (hi - lo) * unit(); }
+    size_t index(size_t count) { return std::min(count - 1, static_cast<size_t>(unit() * count)); }
+    // Uniform over all rotations (Shoemake)
+    quat rotation() {
+        float u1 = unit(), u2 = unit() * 2.0f * kPi, u3 = unit() * 2.0f * kPi;
+        float a = std::sqrt(1.0f - u1), b = std::sqrt(u1);
+        return quat(b * std::cos(u3), a * std::sin(u2), a * std::cos(u2), b * std::sin(u3));
+    }
+
+  private:
+    std::mt19937 engine_;
+};
+} // namespace
+
+std::vector<Render::Material> Render::randomMaterials(size_t count, uint32_t seed) {
+    Random random(seed);
+    std::vector<Material> materials(count);
+    for (auto& material : materials) {
+        vec3 albedo(random.range(0.05f, 0.95f), random.range(0.05f, 0.95f), random.range(0.05f, 0.95f));
+        material.albedo = albedo;
+        material.metallic = random.unit() < 0.3f ? 1.0f : 0.0f;
+        material.roughness = random.range(0.05f, 1.0f);
+        if (random.unit() < 0.05f) material.emissive = albedo * 2.0f;
+    }
+    return materials;
+}
+
+Render::StressScene Render::generateStressScene(Scene& scene, std::span<const Wrapper::Model* const> models,
+                                                std::span<const Wrapper::Model* const> primitives, const StressSceneSettings& settings) {
+    auto start = std::chrono::steady_clock::now();
+    Random random(settings.seed);
+    StressScene out;
+    out.halfExtent = std::sqrt(static_cast<float>(settings.instances) / std::max(settings.density, 1e-3f)) * 0.5f;
+    out.root = scene.addNode(kNoNode);
+    scene.reserve(scene.size() + settings.instances * 2);
+
+    float e = out.halfExtent;
+    for (size_t i = 0; i < settings.instances; ++i) {
+        bool model = random.unit() < settings.modelShare;
+        Transform local;
+        local.scale = vec3(random.range(settings.minScale, settings.maxScale));
+        if (model && !models.empty()) {
+            local.position = vec3(random.range(-e, e), 0.0f, random.range(-e, e));
+            local.rotation = glm::angleAxis(random.range(0.0f, 2.0f * kPi), vec3(0.0f, 1.0f, 0.0f));
+            scene.addModel(*models[random.index(models.size())], out.root, local);
+            ++out.modelInstances;
+        } else if (!primitives.empty()) {
+            local.position = vec3(random.range(-e, e), random.range(0.0f, settings.maxHeight), random.range(-e, e));
+            local.rotation = random.rotation();
+            const auto& primitive = *primitives[random.index(primitives.size())];
+            scene.addMesh(primitive, random.index(primitive.meshes.size()), out.root, local);
+            ++out.primitiveInstances;
+        }
+    }
+
+    out.light.position = vec3(random.range(-e, e) * 0.5f, random.range(2.0f, 2.0f + settings.maxHeight * 2.0f), random.range(-e, e) * 0.5f);
+    out.light.color = vec3(random.range(0.6f, 1.0f), random.range(0.6f, 1.0f), random.range(0.6f, 1.0f));
+    out.light.intensity = random.range(settings.minLightIntensity, settings.maxLightIntensity);
+    out.generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return out;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "pbre/base.hpp"
+#include "pbre/render/material.hpp"
+#include "pbre/render/scene.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace PBRE::Render {
+struct StressSceneSettings {
+    uint32_t seed = 1;
+    size_t instances = 1000;
+    // Instances per square unit of floor, the floor grows with the count
+    float density = 0.5f;
+    // Fraction of the instances that are models, the rest are primitives
+    float modelShare = 0.2f;
+    float minScale = 0.2f;
+    float maxScale = 0.8f;
+    // Primitives float anywhere up to this height, models stand on the floor
+    float maxHeight = 3.0f;
+    float minLightIntensity = 0.5f;
+    float maxLightIntensity = 3.0f;
+};
+
+struct StressLight {
+    vec3 position = vec3(0.0f);
+    vec3 color = vec3(1.0f);
+    float intensity = 1.0f;
+};
+
+struct StressScene {
+    NodeId root = kNoNode;
+    float halfExtent = 0.0f; // of the square floor, centered on the origin
+    size_t modelInstances = 0;
+    size_t primitiveInstances = 0;
+    StressLight light;
+    double generateMs = 0.0;
+};
+
+// Random PBR constants for primitive variants: albedo, metallic mostly 0 or 1, roughness, and now and then
+// an emissive one. Deterministic for a seed.
+std::vector<Material> randomMaterials(size_t count, uint32_t seed);
+
+// Scatters settings.instances instances under a new root node of the scene: whole models standing on the
+// floor with a random yaw, and single meshes of the primitives (one of their material variants, see
+// Model::create) anywhere above it with a random rotation. Also picks the light. The same seed and settings
+// give the same scene on every platform; the random numbers come straight from mt19937.
+StressScene generateStressScene(Scene& scene, std::span<const Wrapper::Model* const> models, std::span<const Wrapper::Model* const> primitives,
+                                const StressSceneSettings& settings);
+} // namespace PBRE::Render
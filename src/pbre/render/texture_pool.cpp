@@ -0,0 +1,121 @@
+#include "texture_pool.hpp"
+
+#include "pbre/wrapper/gl_state.hpp"
+#include "pbre/wrapper/gpu_memory.hpp"
+
+#include <stdexcept>
+
+using namespace PBRE;
+
+Render::TexturePool::~TexturePool() {
+    clear();
+}
+
+size_t Render::TexturePool::bytes(const TextureDesc& desc) {
+    return Wrapper::GpuMemory::imageBytes(desc.format, desc.width, desc.height, 1, 1, desc.samples);
+}
+
+bool Render::TexturePool::isDepthFormat(GLenum format) {
+    return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8 || format == GL_DEPTH_COMPONENT16 ||
+           format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+}
+
+GLuint Render::TexturePool::acquire(const TextureDesc& desc) {
+    ++stats_.acquires;
+    Entry* entry = nullptr;
+    for (auto& e : entries_) {
+        if (!e.inUse && e.desc == desc) {
+            entry = &e;
+            break;
+        }
+    }
+
+    if (!entry) {
+        GLuint texture = 0;
+        GLenum textureTarget = target(desc);
+        glGenTextures(1, &texture);
+        bool tracked = Wrapper::GpuMemory::instance().track({.objectType = GL_TEXTURE,
+                                                             .name = texture,
+                                                             .category = Wrapper::GpuCategory::RenderTarget,
+                                                             .format = desc.format,
+                                                             .width = desc.width,
+                                                             .height = desc.height,
+                                                             .samples = desc.samples,
+                                                             .bytes = bytes(desc),
+                                                             .owner = "TexturePool",
+                                                             .site = std::source_location::current()});
+        if (!tracked) {
+            glDeleteTextures(1, &texture);
+            throw std::runtime_error("GPU memory budget refused a pooled render target");
+        }
+        Wrapper::GlState::instance().bindTextureForUpdate(textureTarget, texture);
+        if (desc.samples > 1) {
+            glTexStorage2DMultisample(textureTarget, desc.samples, desc.format, desc.width, desc.height, GL_TRUE);
+        } else {
+            glTexStorage2D(textureTarget, 1, desc.format, desc.width, desc.height);
+            GLint filter = isDepthFormat(desc.format) ? GL_NEAREST : GL_LINEAR;
+            glTexParameteri(textureTarget, GL_TEXTURE_MIN_FILTER, filter);
+            glTexParameteri(textureTarget, GL_TEXTURE_MAG_FILTER, filter);
+            glTexParameteri(textureTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(textureTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        if (!texture) throw std::runtime_error("Failed to allocate pooled render target");
+
+        entries_.push_back({texture, desc, false, frame_});
+        entry = &entries_.back();
+        ++stats_.allocations;
+        stats_.allocatedBytes += bytes(desc);
+    }
+
+    entry->inUse = true;
+    entry->lastUsedFrame = frame_;
+    liveBytes_ += bytes(desc);
+    if (liveBytes_ > stats_.peakLiveBytes) stats_.peakLiveBytes = liveBytes_;
+    return entry->texture;
+}
+
+void Render::TexturePool::release(GLuint texture) {
+    for (auto& e : entries_) {
+        if (e.texture == texture && e.inUse) {
+            e.inUse = false;
+            liveBytes_ -= bytes(e.desc);
+            return;
+        }
+    }
+}
+
+std::vector<GLuint> Render::TexturePool::endFrame() {
+    std::vector<GLuint> evicted;
+    for (size_t i = 0; i < entries_.size();) {
+        auto& e = entries_[i];
+        if (!e.inUse && frame_ - e.lastUsedFrame >= kEvictAfterFrames) {
+            Wrapper::GpuMemory::instance().release(GL_TEXTURE, e.texture);
+            Wrapper::GlState::instance().forgetTexture(e.texture);
+            glDeleteTextures(1, &e.texture);
+            evicted.push_back(e.texture);
+            ++stats_.frees;
+            e = entries_.back();
+            entries_.pop_back();
+        } else {
+            ++i;
+        }
+    }
+
+    stats_.textureCount = static_cast<int>(entries_.size());
+    stats_.pooledBytes = 0;
+    for (const auto& e : entries_) stats_.pooledBytes += bytes(e.desc);
+    lastStats_ = stats_;
+    stats_ = {};
+    ++frame_;
+    return evicted;
+}
+
+void Render::TexturePool::clear() {
+    for (auto& e : entries_) {
+        Wrapper::GpuMemory::instance().release(GL_TEXTURE, e.texture);
+        Wrapper::GlState::instance().forgetTexture(e.texture);
+        glDeleteTextures(1, &e.texture);
+    }
+    entries_.clear();
+    liveBytes_ = 0;
+}
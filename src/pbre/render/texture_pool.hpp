@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace PBRE::Render {
+struct TextureDesc {
+    int width = 0;
+    int height = 0;
+    GLenum format = GL_RGBA16F; // sized internal format, color or depth
+    int samples = 1;            // > 1 allocates a GL_TEXTURE_2D_MULTISAMPLE
+
+    bool operator==(const TextureDesc&) const = default;
+};
+
+// Render target textures shared between passes and frames. A texture released by one pass is handed to
+// the next acquire with the same description, so transients whose lifetimes do not overlap alias the
+// same memory. Textures left unused for a few frames are freed.
+class TexturePool {
+  public:
+    struct Stats {
+        int acquires = 0;
+        int allocations = 0;       // textures created
+        int frees = 0;             // textures evicted
+        size_t allocatedBytes = 0; // created
+        size_t peakLiveBytes = 0;  // most memory acquired at once
+        size_t pooledBytes = 0;    // everything the pool owns at the end of the frame
+        int textureCount = 0;
+    };
+
+    TexturePool() = default;
+    ~TexturePool();
+
+    TexturePool(const TexturePool&) = delete;
+    TexturePool& operator=(const TexturePool&) = delete;
+
+    GLuint acquire(const TextureDesc& desc);
+    void release(GLuint texture);
+
+    // Closes the frame's statistics and evicts textures unused for kEvictAfterFrames. Returns the evicted
+    // names so anything referring to them (framebuffer caches) can drop them.
+    std::vector<GLuint> endFrame();
+    void clear();
+
+    // Statistics of the last completed frame
+    const Stats& stats() const { return lastStats_; }
+
+    static size_t bytes(const TextureDesc& desc);
+    static GLenum target(const TextureDesc& desc) { return desc.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D; }
+    static bool isDepthFormat(GLenum format);
+    static bool hasStencil(GLenum format) { return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8; }
+
+    static constexpr uint64_t kEvictAfterFrames = 3;
+
+  private:
+    struct Entry {
+        GLuint texture;
+        TextureDesc desc;
+        bool inUse;
+        uint64_t lastUsedFrame;
+    };
+
+    std::vector<Entry> entries_;
+    uint64_t frame_ = 0;
+    size_t liveBytes_ = 0;
+    Stats stats_;
+    Stats lastStats_;
+};
+} // namespace PBRE::Render
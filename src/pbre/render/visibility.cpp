@@ -0,0 +1,273 @@
+#include "visibility.hpp"
+
+#include "pbre/wrapper/gl_state.hpp"
+#include "pbre/wrapper/gpu_memory.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace PBRE;
+
+// Texture unit for the visibility buffer, above the ones used by materials (0 = environment, 1-6 = material)
+static constexpr int kVisibilityUnit = 7;
+// Storage binding of the per draw tile masks, after the resolve's vertex streams and the material table's
+static constexpr GLuint kTileMaskBinding = 7;
+// Pixels per side of a resolve tile, visbuffer_bin_comp.glsl's work group covers one
+static constexpr int kResolveTileSize = 32;
+
+Render::VisibilityRenderer::VisibilityRenderer() {
+    visShader_[0].loadFromFiles("shaders/visbuffer_vert.glsl", "shaders/visbuffer_frag.glsl");
+    visShader_[1].loadFromFiles("shaders/visbuffer_vert.glsl", "shaders/visbuffer_frag.glsl", {"ALPHA_MASK"});
+    binShader_.loadComputeFromFile("shaders/visbuffer_bin_comp.glsl");
+    resolveShader_.loadFromFiles("shaders/visbuffer_tile_vert.glsl", "shaders/visbuffer_resolve_frag.glsl");
+    glGenVertexArrays(1, &emptyVao_);
+}
+Render::VisibilityRenderer::~VisibilityRenderer() {
+    destroy();
+    Wrapper::GpuMemory::instance().release(GL_BUFFER, tileMasks_);
+    if (tileMasks_) glDeleteBuffers(1, &tileMasks_);
+    Wrapper::GlState::instance().forgetVertexArray(emptyVao_);
+    if (emptyVao_) glDeleteVertexArrays(1, &emptyVao_);
+}
+
+void Render::VisibilityRenderer::destroy() {
+    Wrapper::GpuMemory::instance().release(GL_RENDERBUFFER, depthRbo_);
+    Wrapper::GpuMemory::instance().release(GL_TEXTURE, visTex_);
+    Wrapper::GlState::instance().forgetTexture(visTex_);
+    Wrapper::GlState::instance().forgetFramebuffer(fbo_);
+    if (depthRbo_) glDeleteRenderbuffers(1, &depthRbo_), depthRbo_ = 0;
+    if (visTex_) glDeleteTextures(1, &visTex_), visTex_ = 0;
+    if (fbo_) glDeleteFramebuffers(1, &fbo_), fbo_ = 0;
+}
+
+void Render::VisibilityRenderer::resize(int width, int height, int samples, GLenum depthFormat) {
+    auto& state = Wrapper::GlState::instance();
+    samples = samples > 1 ? samples : 1;
+    renderWidth_ = width;
+    renderHeight_ = height;
+    if (fbo_ && width <= width_ && height <= height_ && samples == samples_ && depthFormat == depthFormat_) return;
+    destroy();
+    width_ = std::max(width, width_); height_ = std::max(height, height_); samples_ = samples;
+    depthFormat_ = depthFormat;
+
+    auto track = [&](GLenum objectType, GLuint name, GLenum format) {
+        bool ok = Wrapper::GpuMemory::instance().track({.objectType = objectType,
+                                                        .name = name,
+                                                        .category = Wrapper::GpuCategory::RenderTarget,
+                                                        .format = format,
+                                                        .width = width_,
+                                                        .height = height_,
+                                                        .samples = samples_,
+                                                        .bytes = Wrapper::GpuMemory::imageBytes(format, width_, height_, 1, 1, samples_),
+                                                        .owner = "VisibilityRenderer",
+                                                        .site = std::source_location::current()});
+        if (!ok) throw std::runtime_error("GPU memory budget refused the visibility buffer");
+    };
+
+    glGenFramebuffers(1, &fbo_);
+    state.bindFramebuffer(GL_FRAMEBUFFER, fbo_);
+
+    // Always a multisample texture (even with one sample) so the resolve shader has a single sampler type
+    glGenTextures(1, &visTex_);
+    track(GL_TEXTURE, visTex_, GL_RG32UI);
+    state.bindTextureForUpdate(GL_TEXTURE_2D_MULTISAMPLE, visTex_);
+    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples_, GL_RG32UI, width_, height_, GL_TRUE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, visTex_, 0);
+
+    glGenRenderbuffers(1, &depthRbo_);
+    track(GL_RENDERBUFFER, depthRbo_, depthFormat_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRbo_);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, depthFormat_, width_, height_);
+    GLenum depthAttachment = depthFormat_ == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, depthAttachment, GL_RENDERBUFFER, depthRbo_);
+
+    GLenum drawBuf = GL_COLOR_ATTACHMENT0;
+    glDrawBuffers(1, &drawBuf);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        throw std::runtime_error("Visibility buffer framebuffer is incomplete");
+    }
+    state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Render::VisibilityRenderer::clearDraws() {
+    draws_.clear();
+}
+
+void Render::VisibilityRenderer::submit(const Wrapper::Model& model, const mat4& transform) {
+    for (const auto& mesh : model.meshes) submit(model, mesh, transform);
+}
+
+void Render::VisibilityRenderer::submit(const Wrapper::Model& model, const Wrapper::Mesh& mesh, const mat4& transform) {
+    if (mesh.indexCount == 0) return;
+    draws_.push_back({&model, &mesh, transform, glm::transpose(glm::inverse(mat3(transform)))});
+}
+
+void Render::VisibilityRenderer::renderVisibility(Wrapper::RingBuffer& ring) {
+    auto& state = Wrapper::GlState::instance();
+    drawData_.clear();
+    for (const auto& draw : draws_) {
+        DrawData data;
+        data.setTransform(draw.transform, draw.normalMatrix);
+        data.material = draw.model->materialData(draw.mesh->materialIndex);
+        drawData_.push_back(ring.write(data));
+    }
+
+    state.bindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glViewport(0, 0, renderWidth_, renderHeight_);
+    const GLuint clearId[4] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, clearId);
+    state.depthMask(true);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    state.setEnabled(GL_DEPTH_TEST, true);
+    state.depthFunc(GL_LESS);
+
+    // Opaque draws use the variant without discard to keep early depth testing
+    for (int v = 0; v < 2; ++v) {
+        auto& shader = visShader_[v];
+        shader.use();
+        for (size_t i = 0; i < draws_.size(); ++i) {
+            const auto& draw = draws_[i];
+            if (draw.model->isAlphaTested(*draw.mesh) != (v == 1)) continue;
+            shader.set("uDrawID", static_cast<int>(i));
+            ring.bindUniform(kDrawDataBinding, drawData_[i]);
+            if (v == 1) draw.model->bindMaterial(draw.mesh->materialIndex);
+            state.bindVertexArray(draw.mesh->vao);
+            glDrawElements(GL_TRIANGLES, draw.mesh->indexCount, GL_UNSIGNED_INT, 0);
+        }
+    }
+}
+
+bool Render::VisibilityRenderer::screenBounds(const DrawRecord& draw, const mat4& viewProj, ivec2& min, ivec2& max) const {
+    const vec3& lo = draw.mesh->boundsMin;
+    const vec3& hi = draw.mesh->boundsMax;
+    mat4 mvp = viewProj * draw.transform;
+    vec2 ndcMin(1.0f), ndcMax(-1.0f);
+    for (int c = 0; c < 8; ++c) {
+        vec4 clip = mvp * vec4((c & 1) ? hi.x : lo.x, (c & 2) ? hi.y : lo.y, (c & 4) ? hi.z : lo.z, 1.0f);
+        // A corner behind the camera makes the projected rectangle meaningless
+        if (clip.w <= 1e-4f) return false;
+        vec2 ndc = vec2(clip.x, clip.y) / clip.w;
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+    ndcMin = glm::clamp(ndcMin, -1.0f, 1.0f);
+    ndcMax = glm::clamp(ndcMax, -1.0f, 1.0f);
+    vec2 size(static_cast<float>(renderWidth_), static_cast<float>(renderHeight_));
+    min = ivec2(glm::floor((ndcMin * 0.5f + 0.5f) * size));
+    max = ivec2(glm::ceil((ndcMax * 0.5f + 0.5f) * size));
+    return true;
+}
+
+void Render::VisibilityRenderer::binTiles(const ivec2& tiles, int tileWords) {
+    auto& state = Wrapper::GlState::instance();
+    size_t bytes = draws_.size() * static_cast<size_t>(tileWords) * sizeof(uint32_t);
+    if (bytes > tileMaskBytes_) {
+        Wrapper::GpuMemory::instance().release(GL_BUFFER, tileMasks_);
+        if (tileMasks_) glDeleteBuffers(1, &tileMasks_);
+        tileMaskBytes_ = std::max(bytes, tileMaskBytes_ * 2);
+        glGenBuffers(1, &tileMasks_);
+        if (!Wrapper::GpuMemory::instance().track({.objectType = GL_BUFFER, .name = tileMasks_, .category = Wrapper::GpuCategory::UniformBuffer,
+                                                   .bytes = tileMaskBytes_, .owner = "VisibilityRenderer", .site = std::source_location::current()})) {
+            glDeleteBuffers(1, &tileMasks_);
+            tileMasks_ = 0;
+            tileMaskBytes_ = 0;
+            throw std::runtime_error("GPU memory budget refused the visibility tile masks");
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileMasks_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(tileMaskBytes_), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileMasks_);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, static_cast<GLsizeiptr>(bytes), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kTileMaskBinding, tileMasks_);
+
+    binShader_.use();
+    binShader_.set("uVisibility", kVisibilityUnit);
+    binShader_.set("uSamples", samples_);
+    binShader_.set("uViewport", ivec2(renderWidth_, renderHeight_));
+    binShader_.set("uTileWords", tileWords);
+    state.bindTexture(kVisibilityUnit, GL_TEXTURE_2D_MULTISAMPLE, visTex_);
+    glDispatchCompute(static_cast<GLuint>(tiles.x), static_cast<GLuint>(tiles.y), 1);
+    // The resolve's vertex shader reads the masks
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void Render::VisibilityRenderer::resolve(Wrapper::RingBuffer& ring, GLuint targetFbo, int targetSamples, const mat4& view, const mat4& projection) {
+    auto& state = Wrapper::GlState::instance();
+    state.bindFramebuffer(GL_FRAMEBUFFER, targetFbo);
+    glViewport(0, 0, renderWidth_, renderHeight_);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    ivec2 tiles((renderWidth_ + kResolveTileSize - 1) / kResolveTileSize, (renderHeight_ + kResolveTileSize - 1) / kResolveTileSize);
+    int tileWords = (tiles.x * tiles.y + 31) / 32;
+    if (!draws_.empty()) binTiles(tiles, tileWords);
+
+    // Every draw adds its coverage weighted contribution
+    state.setEnabled(GL_DEPTH_TEST, false);
+    state.depthMask(false);
+    state.setEnabled(GL_BLEND, true);
+    state.blendFunc(GL_ONE, GL_ONE);
+
+    resolveShader_.use();
+    resolveShader_.set("uVisibility", kVisibilityUnit);
+    resolveShader_.set("uSamples", samples_);
+    resolveShader_.set("uSampleMask", targetSamples > 1 ? 1 : 0);
+    resolveShader_.set("uViewport", vec2(static_cast<float>(renderWidth_), static_cast<float>(renderHeight_)));
+    resolveShader_.set("uTileWords", tileWords);
+    resolveShader_.set("uTileSize", kResolveTileSize);
+    state.bindTexture(kVisibilityUnit, GL_TEXTURE_2D_MULTISAMPLE, visTex_);
+    state.bindVertexArray(emptyVao_);
+
+    mat4 viewProj = projection * view;
+    for (size_t i = 0; i < draws_.size(); ++i) {
+        const auto& draw = draws_[i];
+        const auto& mesh = *draw.mesh;
+
+        ivec2 min(0), max(renderWidth_, renderHeight_);
+        if (screenBounds(draw, viewProj, min, max)) {
+            if (max.x <= min.x || max.y <= min.y) continue; // off screen
+        } else {
+            min = ivec2(0);
+            max = ivec2(renderWidth_, renderHeight_);
+        }
+        // Tiles of the bounds, the vertex shader drops the ones the binning found no sample of the draw in
+        ivec2 firstTile = glm::clamp(min / kResolveTileSize, ivec2(0), tiles);
+        ivec2 endTile = glm::clamp((max + kResolveTileSize - 1) / kResolveTileSize, ivec2(0), tiles);
+        ivec2 tileCount = endTile - firstTile;
+        if (tileCount.x <= 0 || tileCount.y <= 0) continue;
+
+        resolveShader_.set("uDrawID", static_cast<int>(i));
+        resolveShader_.set("uTileRect", ivec4(firstTile, tileCount.x, tiles.x));
+        ring.bindUniform(kDrawDataBinding, drawData_[i]);
+        resolveShader_.set("uHasNormals", mesh.vboNorm ? 1 : 0);
+        resolveShader_.set("uHasTangents", mesh.vboTan ? 1 : 0);
+        resolveShader_.set("uHasUVs", mesh.vboUV ? 1 : 0);
+        // Missing streams still need a buffer bound, the flags above stop them being read
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mesh.vboPos);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mesh.vboNorm ? mesh.vboNorm : mesh.vboPos);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mesh.vboTan ? mesh.vboTan : mesh.vboPos);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mesh.vboUV ? mesh.vboUV : mesh.vboPos);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mesh.ebo);
+        const Wrapper::VertexFormat* formats[4] = {&mesh.positionFormat, &mesh.normalFormat, &mesh.tangentFormat, &mesh.uvFormat};
+        for (int s = 0; s < 4; ++s) {
+            const auto& f = *formats[s];
+            resolveShader_.set("uStreamFormat[" + std::to_string(s) + "]", ivec4(static_cast<int>(f.type), f.components, f.normalized ? 1 : 0, f.stride));
+            resolveShader_.set("uStreamOffset[" + std::to_string(s) + "]", static_cast<int>(f.offset));
+        }
+        draw.model->bindMaterial(mesh.materialIndex);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, tileCount.x * tileCount.y);
+    }
+
+    state.setEnabled(GL_BLEND, false);
+    state.depthMask(true);
+    state.setEnabled(GL_DEPTH_TEST, true);
+
+    // Depth for anything drawn after the resolve
+    state.bindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
+    state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFbo);
+    glBlitFramebuffer(0, 0, renderWidth_, renderHeight_, 0, 0, renderWidth_, renderHeight_, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    state.bindFramebuffer(GL_FRAMEBUFFER, targetFbo);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "pbre/base.hpp"
+#include "pbre/wrapper/model.hpp"
+#include "pbre/wrapper/ring_buffer.hpp"
+#include "pbre/wrapper/shader.hpp"
+
+#include <vector>
+
+namespace PBRE::Render {
+// Visibility buffer renderer, an alternative to the forward MSAA path.
+// The geometry pass only writes (draw id, triangle id) and depth into a thin MSAA target. A compute pass
+// then bins the buffer into screen tiles, marking which draws each tile holds. The resolve runs one pass
+// per draw over just its tiles, rebuilding the triangle's attributes from the mesh buffers and shading
+// each pixel once, weighting edge pixels by how many samples the draw covers.
+class VisibilityRenderer {
+  public:
+    VisibilityRenderer();
+    ~VisibilityRenderer();
+
+    VisibilityRenderer(const VisibilityRenderer&) = delete;
+    VisibilityRenderer& operator=(const VisibilityRenderer&) = delete;
+
+    // Storage only grows, so changing the render size every frame (dynamic resolution) never reallocates;
+    // the render size is the viewport.
+    // samples and depthFormat must match the resolve target so its depth can be blitted over.
+    void resize(int width, int height, int samples, GLenum depthFormat = GL_DEPTH24_STENCIL8);
+
+    void clearDraws();
+    // Every mesh of the model with one transform
+    void submit(const Wrapper::Model& model, const mat4& transform);
+    void submit(const Wrapper::Model& model, const Wrapper::Mesh& mesh, const mat4& transform);
+
+    // Rasterise the submitted draws into the visibility buffer, writing each draw's DrawData to the ring
+    // for the resolve to reuse. FrameData must already be bound.
+    void renderVisibility(Wrapper::RingBuffer& ring);
+    // Shade into targetFbo and copy the visibility depth into its depth buffer, so later forward
+    // draws (e.g. the light indicator) can be depth tested against the scene. A multisample target
+    // gets each draw's shade written to exactly the samples it covers (via gl_SampleMask).
+    // view and projection only bound the tiles each draw's pass covers, the shader reads them from FrameData.
+    void resolve(Wrapper::RingBuffer& ring, GLuint targetFbo, int targetSamples, const mat4& view, const mat4& projection);
+
+    int width() const { return renderWidth_; }
+    int height() const { return renderHeight_; }
+    int samples() const { return samples_; }
+    size_t drawCount() const { return draws_.size(); }
+
+  private:
+    struct DrawRecord {
+        const Wrapper::Model* model;
+        const Wrapper::Mesh* mesh;
+        mat4 transform;
+        mat3 normalMatrix;
+    };
+
+    void destroy();
+    bool screenBounds(const DrawRecord& draw, const mat4& viewProj, ivec2& min, ivec2& max) const;
+    // Fills tileMasks_ from the visibility buffer, tileWords mask words per draw
+    void binTiles(const ivec2& tiles, int tileWords);
+
+    Wrapper::Shader visShader_[2]; // opaque, alpha tested
+    Wrapper::Shader binShader_;
+    Wrapper::Shader resolveShader_;
+    std::vector<DrawRecord> draws_;
+    std::vector<Wrapper::RingBuffer::Allocation> drawData_; // per draw record, this frame
+
+    GLuint fbo_ = 0;
+    GLuint visTex_ = 0;   // RG32UI multisample texture: draw id + 1, triangle id
+    GLuint depthRbo_ = 0; // same format as the target Framebuffer for the depth blit
+    GLenum depthFormat_ = GL_DEPTH24_STENCIL8;
+    GLuint emptyVao_ = 0; // tile quads are generated from gl_VertexID
+    GLuint tileMasks_ = 0; // storage buffer, a bit per screen tile for every draw; only grows
+    size_t tileMaskBytes_ = 0;
+    int width_ = 0; // allocated
+    int height_ = 0;
+    int renderWidth_ = 0;
+    int renderHeight_ = 0;
+    int samples_ = 1;
+};
+} // namespace PBRE::Render
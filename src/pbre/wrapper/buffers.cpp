@@ -1,5 +1,10 @@
 #include "buffers.hpp"
 
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
+
+#include <stdexcept>
+
 using namespace PBRE::Wrapper;
 
 Buffers::Buffers() {
@@ -8,12 +13,15 @@ Buffers::Buffers() {
     glGenBuffers(1, &ebo_);
 
     // Bind the buffers, this is so that we can set them up
-    glBindVertexArray(vao_);
+    GlState::instance().bindVertexArray(vao_);
     glBindBuffer(GL_ARRAY_BUFFER, vbo_);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
 }
 
 Buffers::~Buffers() {
+    GpuMemory::instance().release(GL_BUFFER, vbo_);
+    GpuMemory::instance().release(GL_BUFFER, ebo_);
+    GlState::instance().forgetVertexArray(vao_);
     glDeleteVertexArrays(1, &vao_);
     glDeleteBuffers(1, &vbo_);
     glDeleteBuffers(1, &ebo_);
@@ -25,15 +33,20 @@ void Buffers::setAttribute(GLuint index, GLint size, GLenum type, GLboolean norm
 }
 
 void Buffers::bind() const {
-    glBindVertexArray(vao_);
+    GlState::instance().bindVertexArray(vao_);
 }
 
 void Buffers::unbind() const {
-    glBindVertexArray(0);
+    GlState::instance().bindVertexArray(0);
 }
 
-void Buffers::uploadData(std::span<const float> vertices, std::span<const GLuint> indices) {
-    glBindVertexArray(vao_);
+void Buffers::uploadData(std::span<const float> vertices, std::span<const GLuint> indices, std::source_location site) {
+    auto& memory = GpuMemory::instance();
+    bool tracked = memory.track({.objectType = GL_BUFFER, .name = vbo_, .category = GpuCategory::VertexBuffer, .bytes = vertices.size_bytes(), .owner = "Buffers", .site = site}) &&
+                   memory.track({.objectType = GL_BUFFER, .name = ebo_, .category = GpuCategory::IndexBuffer, .bytes = indices.size_bytes(), .owner = "Buffers", .site = site});
+    if (!tracked) throw std::runtime_error("GPU memory budget refused vertex buffers");
+
+    GlState::instance().bindVertexArray(vao_);
 
     glBindBuffer(GL_ARRAY_BUFFER, vbo_);
     glBufferData(GL_ARRAY_BUFFER, vertices.size_bytes(), vertices.data(), GL_STATIC_DRAW);
@@ -45,6 +58,6 @@ void Buffers::uploadData(std::span<const float> vertices, std::span<const GLuint
 }
 
 void Buffers::draw() const {
-    glBindVertexArray(vao_);
+    GlState::instance().bindVertexArray(vao_);
     glDrawElements(GL_TRIANGLES, count_, GL_UNSIGNED_INT, 0);
 }
@@ -3,6 +3,7 @@
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
 
+#include <source_location>
 #include <span>
 
 namespace PBRE::Wrapper {
@@ -15,7 +16,8 @@ class Buffers {
     void bind() const;
     void unbind() const;
 
-    void uploadData(std::span<const float> vertices, std::span<const GLuint> indices);
+    // Throws if the GPU memory budget refuses the buffers
+    void uploadData(std::span<const float> vertices, std::span<const GLuint> indices, std::source_location site = std::source_location::current());
     void draw() const;
 
   private:
@@ -1,95 +1,135 @@
 #include "framebuffer.hpp"
 
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
+
+#include <stdexcept>
+
 using namespace PBRE::Wrapper;
 
-Framebuffer::Framebuffer(int w, int h, int samples) { create(w, h, samples); }
+Framebuffer::Framebuffer(int w, int h, const FramebufferFormat& format, std::source_location site) { create(w, h, format, site); }
 Framebuffer::~Framebuffer() { destroy(); }
 
 void Framebuffer::moveFrom(Framebuffer&& other) noexcept {
     fbo_ = other.fbo_; other.fbo_ = 0;
     colorTex_ = other.colorTex_; other.colorTex_ = 0;
     depthRbo_ = other.depthRbo_; other.depthRbo_ = 0;
+    format_ = other.format_;
     width_ = other.width_; other.width_ = 0;
     height_ = other.height_; other.height_ = 0;
+    site_ = other.site_;
+}
+
+GLenum Framebuffer::colorInternalFormat(ColorFormat format) {
+    return format == ColorFormat::R11F_G11F_B10F ? GL_R11F_G11F_B10F : GL_RGBA16F;
+}
+
+GLenum Framebuffer::depthInternalFormat(DepthFormat format) {
+    switch (format) {
+    case DepthFormat::Depth24: return GL_DEPTH_COMPONENT24;
+    case DepthFormat::Depth32F: return GL_DEPTH_COMPONENT32F;
+    default: return GL_DEPTH24_STENCIL8;
+    }
+}
+
+const char* Framebuffer::name(ColorFormat format) {
+    return format == ColorFormat::R11F_G11F_B10F ? "R11F_G11F_B10F" : "RGBA16F";
+}
+
+const char* Framebuffer::name(DepthFormat format) {
+    switch (format) {
+    case DepthFormat::Depth24: return "DEPTH24";
+    case DepthFormat::Depth32F: return "DEPTH32F";
+    default: return "DEPTH24_STENCIL8";
+    }
+}
+
+static size_t colorBytes(ColorFormat format) { return format == ColorFormat::R11F_G11F_B10F ? 4 : 8; }
+// 24 bit depth is padded to 32 bits by every driver we care about
+static size_t depthBytes(DepthFormat) { return 4; }
+
+static GLenum depthAttachment(DepthFormat format) {
+    return format == DepthFormat::Depth24Stencil8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+}
+
+size_t Framebuffer::memoryBytes(const FramebufferFormat& format, int w, int h, int samples, bool shaderResolve) {
+    size_t pixels = static_cast<size_t>(w) * static_cast<size_t>(h);
+    size_t c = colorBytes(format.color), d = depthBytes(format.depth);
+    if (samples <= 1) return pixels * (c + d);
+    size_t msaa = pixels * samples * (c + d);
+    return shaderResolve ? msaa : msaa + pixels * c;
 }
 
-void Framebuffer::create(int w, int h, int samples) {
+size_t Framebuffer::resolveTrafficBytes(const FramebufferFormat& format, int w, int h, int samples, bool shaderResolve, int outputWidth, int outputHeight) {
+    size_t pixels = static_cast<size_t>(w) * static_cast<size_t>(h);
+    size_t outputPixels = static_cast<size_t>(outputWidth) * static_cast<size_t>(outputHeight);
+    size_t c = colorBytes(format.color);
+    // Texels the tonemap pass reads per output pixel, see tonemap_frag.glsl
+    size_t taps = (w == outputWidth && h == outputHeight) ? 1 : (w < outputWidth ? 16 : 4);
+    if (samples <= 1) return outputPixels * taps * c;                   // tonemap reads
+    if (shaderResolve) return outputPixels * taps * samples * c;        // tonemap reads every sample
+    return pixels * samples * c + pixels * c + outputPixels * taps * c; // blit read + write, tonemap reads
+}
+
+void Framebuffer::create(int w, int h, const FramebufferFormat& format, std::source_location site) {
+    auto& state = GlState::instance();
     destroy();
-    width_ = w; height_ = h; samples_ = samples > 1 ? samples : 1;
+    width_ = w; height_ = h;
+    format_ = format;
+    site_ = site;
+    GLenum colorFormat = colorInternalFormat(format_.color);
+    GLenum depthFormat = depthInternalFormat(format_.depth);
+    auto track = [&](GLenum objectType, GLuint name, GLenum internalFormat) {
+        bool ok = GpuMemory::instance().track({.objectType = objectType,
+                                               .name = name,
+                                               .category = GpuCategory::RenderTarget,
+                                               .format = internalFormat,
+                                               .width = width_,
+                                               .height = height_,
+                                               .bytes = GpuMemory::imageBytes(internalFormat, width_, height_, 1, 1),
+                                               .owner = "Framebuffer",
+                                               .site = site_});
+        if (!ok) throw std::runtime_error("GPU memory budget refused a framebuffer attachment");
+    };
 
-    // Single-sample target (always present for tonemapping)
     glGenFramebuffers(1, &fbo_);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    state.bindFramebuffer(GL_FRAMEBUFFER, fbo_);
     glGenTextures(1, &colorTex_);
-    glBindTexture(GL_TEXTURE_2D, colorTex_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width_, height_, 0, GL_RGBA, GL_FLOAT, nullptr);
+    track(GL_TEXTURE, colorTex_, colorFormat);
+    state.bindTextureForUpdate(GL_TEXTURE_2D, colorTex_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, colorFormat, width_, height_);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTex_, 0);
-    // Provide a depth for single-sample if we render directly to it (samples_==1)
     glGenRenderbuffers(1, &depthRbo_);
+    track(GL_RENDERBUFFER, depthRbo_, depthFormat);
     glBindRenderbuffer(GL_RENDERBUFFER, depthRbo_);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width_, height_);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRbo_);
+    glRenderbufferStorage(GL_RENDERBUFFER, depthFormat, width_, height_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, depthAttachment(format_.depth), GL_RENDERBUFFER, depthRbo_);
     GLenum drawBuf = GL_COLOR_ATTACHMENT0;
     glDrawBuffers(1, &drawBuf);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    if (samples_ > 1) {
-        // Multisample rendering target
-        glGenFramebuffers(1, &msaaFbo_);
-        glBindFramebuffer(GL_FRAMEBUFFER, msaaFbo_);
-
-        glGenRenderbuffers(1, &msaaColorRbo_);
-        glBindRenderbuffer(GL_RENDERBUFFER, msaaColorRbo_);
-        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, GL_RGBA16F, width_, height_);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, msaaColorRbo_);
-
-        glGenRenderbuffers(1, &msaaDepthRbo_);
-        glBindRenderbuffer(GL_RENDERBUFFER, msaaDepthRbo_);
-        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, GL_DEPTH24_STENCIL8, width_, height_);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, msaaDepthRbo_);
-
-        GLenum msaaDraw = GL_COLOR_ATTACHMENT0;
-        glDrawBuffers(1, &msaaDraw);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+        throw std::runtime_error("Framebuffer is incomplete");
     }
+    state.bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::destroy() {
+    auto& memory = GpuMemory::instance();
+    memory.release(GL_RENDERBUFFER, depthRbo_);
+    memory.release(GL_TEXTURE, colorTex_);
+    auto& state = GlState::instance();
+    state.forgetTexture(colorTex_);
+    state.forgetFramebuffer(fbo_);
     if (depthRbo_) glDeleteRenderbuffers(1, &depthRbo_), depthRbo_ = 0;
     if (colorTex_) glDeleteTextures(1, &colorTex_), colorTex_ = 0;
     if (fbo_) glDeleteFramebuffers(1, &fbo_), fbo_ = 0;
-    if (msaaDepthRbo_) glDeleteRenderbuffers(1, &msaaDepthRbo_), msaaDepthRbo_ = 0;
-    if (msaaColorRbo_) glDeleteRenderbuffers(1, &msaaColorRbo_), msaaColorRbo_ = 0;
-    if (msaaFbo_) glDeleteFramebuffers(1, &msaaFbo_), msaaFbo_ = 0;
 }
 
 void Framebuffer::resize(int w, int h) {
     if (w == width_ && h == height_) return;
-    create(w, h, samples_);
-}
-
-void Framebuffer::bind() const {
-    if (samples_ > 1 && msaaFbo_) {
-        glBindFramebuffer(GL_FRAMEBUFFER, msaaFbo_);
-    } else {
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
-    }
-    glViewport(0, 0, width_, height_);
-}
-
-void Framebuffer::unbind() {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
-
-void Framebuffer::resolve() const {
-    if (samples_ <= 1 || !msaaFbo_) return; // nothing to resolve
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, msaaFbo_);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_);
-    glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    create(w, h, format_, site_);
 }
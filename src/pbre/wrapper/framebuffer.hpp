@@ -1,13 +1,32 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <cstddef>
+#include <source_location>
 #include <utility>
 
 namespace PBRE::Wrapper {
+enum class ColorFormat {
+    RGBA16F,       // 8 bytes per sample
+    R11F_G11F_B10F // 4 bytes per sample, no alpha or sign, enough for HDR scene color
+};
+enum class DepthFormat {
+    Depth24Stencil8,
+    Depth24, // depth only, no stencil
+    Depth32F,
+};
+
+struct FramebufferFormat {
+    ColorFormat color = ColorFormat::RGBA16F;
+    DepthFormat depth = DepthFormat::Depth24Stencil8;
+};
+
+// Single-sample offscreen color + depth target. The frame's scene targets are render graph transients, the
+// static helpers describe their formats.
 class Framebuffer {
   public:
     Framebuffer() = default;
-    Framebuffer(int width, int height, int samples = 1);
+    Framebuffer(int width, int height, const FramebufferFormat& format = {}, std::source_location site = std::source_location::current());
     ~Framebuffer();
 
     Framebuffer(const Framebuffer&) = delete;
@@ -18,35 +37,43 @@ class Framebuffer {
         return *this;
     }
 
-    void create(int width, int height, int samples = 1);
+    // Attachments are recorded in GpuMemory under the caller's site, later resizes keep it. Throws if the
+    // budget refuses one.
+    void create(int width, int height, const FramebufferFormat& format = {}, std::source_location site = std::source_location::current());
     void destroy();
     void resize(int width, int height);
 
-    // Bind for rendering (MSAA FBO if samples>1, otherwise single-sample FBO)
-    void bind() const;
-    static void unbind();
-
-    // Resolve MSAA color to single-sample color texture if MSAA is enabled
-    void resolve() const;
-
     GLuint colorTex() const { return colorTex_; }
     GLuint fbo() const { return fbo_; }
+    const FramebufferFormat& format() const { return format_; }
     int width() const { return width_; }
     int height() const { return height_; }
-    int samples() const { return samples_; }
+
+    // Estimates for comparing scene target formats. Memory covers every attachment, plus the single-sample
+    // resolve texture unless the tonemap pass resolves the MSAA samples itself (shaderResolve). Traffic is
+    // the color bytes moved per frame from the end of the scene pass to the tonemapped output (MSAA
+    // resolve reads/writes plus the tonemap reads) for a render size scaled to the output size, ignoring
+    // framebuffer compression and texture cache hits. The tonemap pass reads one texel per output pixel at
+    // native size, four when filtering bilinearly and sixteen when upscaling, each of them every sample
+    // when it resolves.
+    static size_t memoryBytes(const FramebufferFormat& format, int width, int height, int samples, bool shaderResolve);
+    static size_t resolveTrafficBytes(const FramebufferFormat& format, int width, int height, int samples, bool shaderResolve,
+                                      int outputWidth, int outputHeight);
+
+    static GLenum colorInternalFormat(ColorFormat format);
+    static GLenum depthInternalFormat(DepthFormat format);
+    static const char* name(ColorFormat format);
+    static const char* name(DepthFormat format);
 
   private:
     void moveFrom(Framebuffer&& other) noexcept;
 
     GLuint fbo_ = 0;
-    GLuint colorTex_ = 0;     // RGBA16F color
-    GLuint depthRbo_ = 0;     // depth buffer
-    // MSAA resources (used when samples_ > 1)
-    GLuint msaaFbo_ = 0;
-    GLuint msaaColorRbo_ = 0;
-    GLuint msaaDepthRbo_ = 0;
+    GLuint colorTex_ = 0;
+    GLuint depthRbo_ = 0;
+    FramebufferFormat format_;
     int width_ = 0;
     int height_ = 0;
-    int samples_ = 1;
+    std::source_location site_;
 };
 } // namespace PBRE::Wrapper
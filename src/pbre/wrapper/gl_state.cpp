@@ -0,0 +1,178 @@
+#include "gl_state.hpp"
+
+#include <iterator>
+#include <numeric>
+
+using namespace PBRE::Wrapper;
+
+namespace {
+constexpr GLenum kTrackedCaps[] = {GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_SCISSOR_TEST, GL_FRAMEBUFFER_SRGB};
+} // namespace
+
+int GlStateCounters::totalIssued() const {
+    return std::accumulate(issued.begin(), issued.end(), 0);
+}
+
+int GlStateCounters::totalElided() const {
+    return std::accumulate(elided.begin(), elided.end(), 0);
+}
+
+GlState& GlState::instance() {
+    static GlState state;
+    return state;
+}
+
+GlState::GlState() {
+    invalidate();
+}
+
+const char* GlState::name(GlStateCategory category) {
+    switch (category) {
+    case GlStateCategory::Program: return "Program";
+    case GlStateCategory::VertexArray: return "Vertex array";
+    case GlStateCategory::Texture: return "Texture";
+    case GlStateCategory::Framebuffer: return "Framebuffer";
+    case GlStateCategory::RenderState: return "Render state";
+    default: return "?";
+    }
+}
+
+bool GlState::change(GlStateCategory category, bool redundant) {
+    size_t index = static_cast<size_t>(category);
+    if (redundant && enabled) {
+        ++frame_.elided[index];
+        return false;
+    }
+    ++frame_.issued[index];
+    return true;
+}
+
+int GlState::capIndex(GLenum cap) {
+    for (int i = 0; i < static_cast<int>(std::size(kTrackedCaps)); ++i) {
+        if (kTrackedCaps[i] == cap) return i;
+    }
+    return -1;
+}
+
+void GlState::useProgram(GLuint program) {
+    if (!change(GlStateCategory::Program, program_ == program)) return;
+    glUseProgram(program);
+    program_ = program;
+}
+
+void GlState::bindVertexArray(GLuint vao) {
+    if (!change(GlStateCategory::VertexArray, vao_ == vao)) return;
+    glBindVertexArray(vao);
+    vao_ = vao;
+}
+
+void GlState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    // A unit holds one texture per target. Only the last bind is remembered, which is enough to know a
+    // repeat of it is redundant.
+    bool tracked = unit < kMaxUnits;
+    bool bound = tracked && units_[unit].target == target && units_[unit].texture == texture;
+    // Counted as the glActiveTexture + glBindTexture pair blind code would make
+    if (!change(GlStateCategory::Texture, bound)) {
+        change(GlStateCategory::Texture, true);
+        return;
+    }
+    if (change(GlStateCategory::Texture, activeUnit_ == unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit_ = unit;
+    }
+    glBindTexture(target, texture);
+    if (tracked) units_[unit] = {target, texture};
+}
+
+void GlState::bindTextureForUpdate(GLenum target, GLuint texture) {
+    // An elided bindTexture(unit) leaves whichever unit was active, so edits must use that one
+    bindTexture(activeUnit_ == kUnknown ? 0 : activeUnit_, target, texture);
+}
+
+void GlState::bindFramebuffer(GLenum target, GLuint fbo) {
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool redundant = (!draw || drawFramebuffer_ == fbo) && (!read || readFramebuffer_ == fbo);
+    if (!change(GlStateCategory::Framebuffer, redundant)) return;
+    glBindFramebuffer(target, fbo);
+    if (draw) drawFramebuffer_ = fbo;
+    if (read) readFramebuffer_ = fbo;
+}
+
+void GlState::setEnabled(GLenum cap, bool on) {
+    int index = capIndex(cap);
+    if (!change(GlStateCategory::RenderState, index >= 0 && caps_[index] == (on ? 1 : 0))) return;
+    if (on) {
+        glEnable(cap);
+    } else {
+        glDisable(cap);
+    }
+    if (index >= 0) caps_[index] = on ? 1 : 0;
+}
+
+void GlState::depthFunc(GLenum func) {
+    if (!change(GlStateCategory::RenderState, depthFunc_ == func)) return;
+    glDepthFunc(func);
+    depthFunc_ = func;
+}
+
+void GlState::depthMask(bool write) {
+    if (!change(GlStateCategory::RenderState, depthMask_ == (write ? 1 : 0))) return;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+    depthMask_ = write ? 1 : 0;
+}
+
+void GlState::cullFace(GLenum face) {
+    if (!change(GlStateCategory::RenderState, cullFace_ == face)) return;
+    glCullFace(face);
+    cullFace_ = face;
+}
+
+void GlState::blendFunc(GLenum source, GLenum destination) {
+    if (!change(GlStateCategory::RenderState, blendSource_ == source && blendDestination_ == destination)) return;
+    glBlendFunc(source, destination);
+    blendSource_ = source;
+    blendDestination_ = destination;
+}
+
+void GlState::colorMask(bool write) {
+    if (!change(GlStateCategory::RenderState, colorMask_ == (write ? 1 : 0))) return;
+    GLboolean value = write ? GL_TRUE : GL_FALSE;
+    glColorMask(value, value, value, value);
+    colorMask_ = write ? 1 : 0;
+}
+
+// Deleting a bound object reverts its binding to 0
+void GlState::forgetProgram(GLuint program) {
+    // A deleted program stays in use until another is, but its name can come back
+    if (program_ == program) program_ = kUnknown;
+}
+
+void GlState::forgetVertexArray(GLuint vao) {
+    if (vao_ == vao) vao_ = 0;
+}
+
+void GlState::forgetTexture(GLuint texture) {
+    for (auto& binding : units_) {
+        if (binding.texture == texture) binding = {};
+    }
+}
+
+void GlState::forgetFramebuffer(GLuint fbo) {
+    if (drawFramebuffer_ == fbo) drawFramebuffer_ = 0;
+    if (readFramebuffer_ == fbo) readFramebuffer_ = 0;
+}
+
+void GlState::invalidate() {
+    program_ = vao_ = activeUnit_ = kUnknown;
+    units_.fill({});
+    drawFramebuffer_ = readFramebuffer_ = kUnknown;
+    caps_.fill(-1);
+    depthFunc_ = cullFace_ = blendSource_ = blendDestination_ = kUnknown;
+    depthMask_ = colorMask_ = -1;
+}
+
+void GlState::endFrame() {
+    lastFrame_ = frame_;
+    frame_ = {};
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstdint>
+
+namespace PBRE::Wrapper {
+enum class GlStateCategory {
+    Program,
+    VertexArray,
+    Texture,     // glActiveTexture and glBindTexture
+    Framebuffer,
+    RenderState, // enables, depth, cull, blend and color mask
+    Count,
+};
+
+struct GlStateCounters {
+    std::array<int, static_cast<size_t>(GlStateCategory::Count)> issued = {};
+    std::array<int, static_cast<size_t>(GlStateCategory::Count)> elided = {};
+
+    int totalIssued() const;
+    int totalElided() const;
+};
+
+// Shadow copy of the GL state the renderer changes, so calls that would set what is already set are
+// skipped. Every bind and state change in the wrapper and render layers goes through here; code that
+// changes state behind it must call invalidate(). Names about to be deleted have to be forgotten, GL hands
+// them out again. Main thread only, like the context.
+class GlState {
+  public:
+    static GlState& instance();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    // Texture units are tracked up to kMaxUnits, binds to higher units are always issued
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    // For glTex* calls, which act on the active unit: binds there instead of switching units
+    void bindTextureForUpdate(GLenum target, GLuint texture);
+    // GL_FRAMEBUFFER sets both the draw and read binding
+    void bindFramebuffer(GLenum target, GLuint fbo);
+    // Depth and scissor test, culling, blending and framebuffer sRGB are tracked, other caps always issue
+    void setEnabled(GLenum cap, bool enabled);
+    void depthFunc(GLenum func);
+    void depthMask(bool write);
+    void cullFace(GLenum face);
+    void blendFunc(GLenum source, GLenum destination);
+    void colorMask(bool write);
+
+    void forgetProgram(GLuint program);
+    void forgetVertexArray(GLuint vao);
+    void forgetTexture(GLuint texture);
+    void forgetFramebuffer(GLuint fbo);
+    // Everything unknown, the next call of each kind is issued
+    void invalidate();
+
+    // Moves this frame's counters to lastFrame() and starts counting again
+    void endFrame();
+    const GlStateCounters& lastFrame() const { return lastFrame_; }
+
+    static const char* name(GlStateCategory category);
+
+    // Off issues every call, to A/B the cache
+    bool enabled = true;
+    static constexpr GLuint kMaxUnits = 32;
+
+  private:
+    GlState();
+
+    // Counts the call and says whether to make it
+    bool change(GlStateCategory category, bool redundant);
+    static int capIndex(GLenum cap);
+
+    // ~0u is "unknown", no real name or enum has that value
+    static constexpr GLuint kUnknown = ~0u;
+    struct TextureBinding {
+        GLenum target = kUnknown;
+        GLuint texture = kUnknown;
+    };
+
+    GLuint program_ = kUnknown;
+    GLuint vao_ = kUnknown;
+    GLuint activeUnit_ = kUnknown;
+    std::array<TextureBinding, kMaxUnits> units_;
+    GLuint drawFramebuffer_ = kUnknown;
+    GLuint readFramebuffer_ = kUnknown;
+    std::array<int, 5> caps_; // 0 off, 1 on, -1 unknown
+    GLenum depthFunc_ = kUnknown;
+    int depthMask_ = -1;
+    GLenum cullFace_ = kUnknown;
+    GLenum blendSource_ = kUnknown;
+    GLenum blendDestination_ = kUnknown;
+    int colorMask_ = -1;
+
+    GlStateCounters frame_;
+    GlStateCounters lastFrame_;
+};
+} // namespace PBRE::Wrapper
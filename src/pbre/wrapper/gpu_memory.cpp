@@ -0,0 +1,167 @@
+#include "gpu_memory.hpp"
+
+#include <tiny_gltf.h> // for the nlohmann::json it bundles
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+using namespace PBRE::Wrapper;
+
+GpuMemory& GpuMemory::instance() {
+    static GpuMemory memory;
+    return memory;
+}
+
+const char* GpuMemory::name(GpuCategory category) {
+    switch (category) {
+    case GpuCategory::Texture: return "Textures";
+    case GpuCategory::RenderTarget: return "Render targets";
+    case GpuCategory::VertexBuffer: return "Vertex buffers";
+    case GpuCategory::IndexBuffer: return "Index buffers";
+    case GpuCategory::UniformBuffer: return "Uniform buffers";
+    case GpuCategory::Readback: return "Readback buffers";
+    default: return "?";
+    }
+}
+
+size_t GpuMemory::texelBytes(GLenum format) {
+    switch (format) {
+    case GL_RGBA32F: case GL_RGB32F: return 16;
+    case GL_RGBA16F: case GL_RGB16F: case GL_RG32F: case GL_RG32UI: case GL_DEPTH32F_STENCIL8: return 8;
+    case GL_RGBA: case GL_RGB: case GL_RGBA8: case GL_RGB8: case GL_SRGB8_ALPHA8: case GL_SRGB8:
+    case GL_RG16F: case GL_R32F: case GL_R32UI: case GL_R11F_G11F_B10F: case GL_RGB9_E5:
+    case GL_DEPTH24_STENCIL8: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F: return 4;
+    case GL_RG: case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+    case GL_RED: case GL_R8: return 1;
+    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT: return 1; // 16 byte 4x4 blocks, mips under 4 texels round up
+    default: return 4;
+    }
+}
+
+int GpuMemory::mipLevels(int width, int height) {
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2) ++levels;
+    return levels;
+}
+
+size_t GpuMemory::imageBytes(GLenum format, int width, int height, int layers, int levels, int samples) {
+    size_t texels = 0;
+    for (int level = 0; level < levels; ++level) {
+        texels += static_cast<size_t>(std::max(width >> level, 1)) * static_cast<size_t>(std::max(height >> level, 1));
+    }
+    return texels * texelBytes(format) * static_cast<size_t>(std::max(layers, 1)) * static_cast<size_t>(std::max(samples, 1));
+}
+
+bool GpuMemory::track(const GpuAllocation& allocation) {
+    std::lock_guard lock(mutex_);
+    auto it = allocations_.find(key(allocation.objectType, allocation.name));
+    size_t previous = it != allocations_.end() ? it->second.bytes : 0;
+    size_t total = stats_.totalBytes - previous + allocation.bytes;
+    if (budgetBytes_ > 0 && total > budgetBytes_ && allocation.bytes > previous) {
+        if (budgetPolicy_ == GpuBudgetPolicy::Refuse) {
+            ++stats_.refused;
+            std::cerr << "GPU memory budget: refused " << allocation.bytes / 1024 << " KiB of " << name(allocation.category) << " for "
+                      << allocation.owner << " at " << allocation.site.file_name() << ":" << allocation.site.line() << std::endl;
+            return false;
+        }
+        // Reported when the total crosses the budget, not for every allocation past it
+        if (stats_.totalBytes <= budgetBytes_) {
+            std::cerr << "GPU memory budget of " << budgetBytes_ / (1024 * 1024) << " MiB exceeded by " << allocation.owner << " at "
+                      << allocation.site.file_name() << ":" << allocation.site.line() << std::endl;
+        }
+        ++stats_.overBudget;
+    }
+
+    if (it != allocations_.end()) {
+        stats_.categoryBytes[static_cast<size_t>(it->second.category)] -= previous;
+        it->second = allocation;
+    } else {
+        allocations_.emplace(key(allocation.objectType, allocation.name), allocation);
+    }
+    stats_.categoryBytes[static_cast<size_t>(allocation.category)] += allocation.bytes;
+    stats_.totalBytes = total;
+    stats_.peakBytes = std::max(stats_.peakBytes, total);
+    stats_.allocations = allocations_.size();
+    return true;
+}
+
+void GpuMemory::release(GLenum objectType, GLuint name) {
+    std::lock_guard lock(mutex_);
+    auto it = allocations_.find(key(objectType, name));
+    if (it == allocations_.end()) return;
+    stats_.categoryBytes[static_cast<size_t>(it->second.category)] -= it->second.bytes;
+    stats_.totalBytes -= it->second.bytes;
+    allocations_.erase(it);
+    stats_.allocations = allocations_.size();
+}
+
+void GpuMemory::setBudget(size_t bytes, GpuBudgetPolicy policy) {
+    std::lock_guard lock(mutex_);
+    budgetBytes_ = bytes;
+    budgetPolicy_ = policy;
+}
+
+GpuMemoryStats GpuMemory::stats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+std::vector<GpuAllocation> GpuMemory::allocations() const {
+    std::vector<GpuAllocation> out;
+    {
+        std::lock_guard lock(mutex_);
+        out.reserve(allocations_.size());
+        for (const auto& [k, allocation] : allocations_) out.push_back(allocation);
+    }
+    std::sort(out.begin(), out.end(), [](const GpuAllocation& a, const GpuAllocation& b) { return a.bytes > b.bytes; });
+    return out;
+}
+
+std::vector<std::pair<std::string, size_t>> GpuMemory::ownerBytes() const {
+    std::map<std::string, size_t> owners;
+    {
+        std::lock_guard lock(mutex_);
+        for (const auto& [k, allocation] : allocations_) owners[allocation.owner] += allocation.bytes;
+    }
+    std::vector<std::pair<std::string, size_t>> out(owners.begin(), owners.end());
+    std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    return out;
+}
+
+bool GpuMemory::writeJson(const std::string& path) const {
+    auto s = stats();
+    nlohmann::json doc;
+    doc["totalBytes"] = s.totalBytes;
+    doc["peakBytes"] = s.peakBytes;
+    doc["budgetBytes"] = budgetBytes_;
+    doc["budgetPolicy"] = budgetPolicy_ == GpuBudgetPolicy::Refuse ? "refuse" : "warn";
+    doc["refused"] = s.refused;
+    auto& categories = doc["categories"] = nlohmann::json::object();
+    for (size_t c = 0; c < s.categoryBytes.size(); ++c) categories[name(static_cast<GpuCategory>(c))] = s.categoryBytes[c];
+    auto& owners = doc["owners"] = nlohmann::json::object();
+    for (const auto& [owner, bytes] : ownerBytes()) owners[owner] = bytes;
+    auto& list = doc["allocations"] = nlohmann::json::array();
+    for (const auto& a : allocations()) {
+        list.push_back({{"category", name(a.category)},
+                        {"bytes", a.bytes},
+                        {"format", a.format},
+                        {"width", a.width},
+                        {"height", a.height},
+                        {"layers", a.layers},
+                        {"levels", a.levels},
+                        {"samples", a.samples},
+                        {"owner", a.owner},
+                        {"site", std::string(a.site.file_name()) + ":" + std::to_string(a.site.line())}});
+    }
+
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    // Owners are file paths, which needn't be valid UTF-8
+    file << doc.dump(2, ' ', false, nlohmann::json::error_handler_t::replace) << "\n";
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace PBRE::Wrapper {
+enum class GpuCategory {
+    Texture,       // sampled images, with their mip chains
+    RenderTarget,  // framebuffer attachments and pooled targets
+    VertexBuffer,
+    IndexBuffer,
+    UniformBuffer,
+    Readback,      // pixel pack buffers
+    Count,
+};
+
+enum class GpuBudgetPolicy {
+    Warn,   // allocations over the budget go ahead and are reported
+    Refuse, // allocations over the budget fail
+};
+
+struct GpuAllocation {
+    GLenum objectType = 0; // GL_TEXTURE, GL_BUFFER or GL_RENDERBUFFER
+    GLuint name = 0;
+    GpuCategory category = GpuCategory::Texture;
+    GLenum format = 0; // internal format of images, 0 for buffers
+    int width = 0, height = 0, layers = 1, levels = 1, samples = 1;
+    size_t bytes = 0;
+    std::string owner;
+    std::source_location site;
+};
+
+struct GpuMemoryStats {
+    size_t totalBytes = 0;
+    size_t peakBytes = 0;
+    std::array<size_t, static_cast<size_t>(GpuCategory::Count)> categoryBytes = {};
+    size_t allocations = 0;
+    int refused = 0;
+    int overBudget = 0; // allocations that went over a warning budget
+};
+
+// Bookkeeping for every GL allocation the wrapper layer makes. Sizes are estimates from the format and
+// dimensions (drivers add alignment and compression on top). The wrappers call track() right before the
+// storage call and release() when they delete the object; tracking a name again replaces its record.
+class GpuMemory {
+  public:
+    static GpuMemory& instance();
+
+    // False if a Refuse budget doesn't leave room, the caller must then skip the allocation
+    bool track(const GpuAllocation& allocation);
+    void release(GLenum objectType, GLuint name);
+
+    // 0 disables the budget
+    void setBudget(size_t bytes, GpuBudgetPolicy policy);
+    size_t budgetBytes() const { return budgetBytes_; }
+    GpuBudgetPolicy budgetPolicy() const { return budgetPolicy_; }
+
+    GpuMemoryStats stats() const;
+    // Every live allocation, largest first
+    std::vector<GpuAllocation> allocations() const;
+    // Live bytes summed per owner, largest first
+    std::vector<std::pair<std::string, size_t>> ownerBytes() const;
+    // Totals, per category and owner, and every allocation
+    bool writeJson(const std::string& path) const;
+
+    static const char* name(GpuCategory category);
+    // Bytes per texel of a sized or unsized internal format, three component formats padded to four
+    static size_t texelBytes(GLenum format);
+    static size_t imageBytes(GLenum format, int width, int height, int layers = 1, int levels = 1, int samples = 1);
+    // Levels of a full mip chain down to 1x1
+    static int mipLevels(int width, int height);
+
+  private:
+    GpuMemory() = default;
+
+    static uint64_t key(GLenum objectType, GLuint name) { return (static_cast<uint64_t>(objectType) << 32) | name; }
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, GpuAllocation> allocations_;
+    GpuMemoryStats stats_;
+    size_t budgetBytes_ = 0;
+    GpuBudgetPolicy budgetPolicy_ = GpuBudgetPolicy::Warn;
+};
+} // namespace PBRE::Wrapper
@@ -3,17 +3,569 @@
 #define TINYGLTF_NOEXCEPTION
 #define TINYGLTF_IMPLEMENTATION
 #include <tiny_gltf.h>
+#include <stb_image.h>
 
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
+#include "pbre/core/accessor.hpp"
+#include "pbre/core/arena.hpp"
+#include "pbre/core/glb.hpp"
+#include "pbre/core/mapped_file.hpp"
+#include "pbre/core/parallel.hpp"
+#include "pbre/core/tangents.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <type_traits>
 
 using namespace PBRE::Wrapper;
 
-bool Model::loadFromFile(const std::string& filename) {
-    tinygltf::Model gltfModel;
+// Decoded vertex streams of a primitive between decode() and upload(), in the load arena
+struct MeshStreams {
+    std::span<PBRE::vec3> positions;
+    std::span<PBRE::vec3> normals;
+    std::span<PBRE::vec4> tangents;
+    std::span<PBRE::vec2> uvs;
+    std::span<uint32_t> indices;
+};
+
+// Load arenas go back here once their model is uploaded, so the next load starts with a block in hand
+static std::mutex arenaPoolMutex;
+static std::vector<std::unique_ptr<PBRE::Core::LinearArena>> arenaPool;
+static constexpr size_t kMaxIdleArenas = 1;
+
+static std::unique_ptr<PBRE::Core::LinearArena> acquireArena() {
+    std::lock_guard lock(arenaPoolMutex);
+    if (arenaPool.empty()) return std::make_unique<PBRE::Core::LinearArena>();
+    auto arena = std::move(arenaPool.back());
+    arenaPool.pop_back();
+    return arena;
+}
+
+static void releaseArena(std::unique_ptr<PBRE::Core::LinearArena> arena) {
+    arena->reset();
+    std::lock_guard lock(arenaPoolMutex);
+    if (arenaPool.size() < kMaxIdleArenas) arenaPool.push_back(std::move(arena));
+}
+
+// Decodes an attribute accessor into float vectors in the arena, false if it exists but can't be decoded
+template <class T> static bool decodeAttribute(const tinygltf::Model& gltfModel, const PBRE::Core::BufferSpans& buffers, const tinygltf::Primitive& prim, const char* name, PBRE::Core::LinearArena& arena, std::span<T>& out) {
+    auto it = prim.attributes.find(name);
+    if (it == prim.attributes.end()) return true;
+    PBRE::Core::AccessorInfo info;
+    if (!PBRE::Core::accessorInfo(gltfModel, it->second, info)) return false;
+    out = arena.allocateArray<T>(info.count);
+    return out.empty() || PBRE::Core::decodeFloats(gltfModel, buffers, it->second, &out.data()->x, T::length());
+}
+
+static bool loadPrimitive(const tinygltf::Model& gltfModel, const PBRE::Core::BufferSpans& buffers, const tinygltf::Primitive& prim, PBRE::Core::LinearArena& arena, MeshStreams& streams, Mesh& mesh) {
+    if (!decodeAttribute(gltfModel, buffers, prim, "POSITION", arena, streams.positions)) return false;
+    if (!decodeAttribute(gltfModel, buffers, prim, "NORMAL", arena, streams.normals)) return false;
+    if (!decodeAttribute(gltfModel, buffers, prim, "TANGENT", arena, streams.tangents)) return false;
+    if (!decodeAttribute(gltfModel, buffers, prim, "TEXCOORD_0", arena, streams.uvs)) return false;
+
+    // Attribute streams shorter than the positions would be read out of bounds by the draw
+    size_t vertexCount = streams.positions.size();
+    if (vertexCount == 0) return false;
+    if (!streams.normals.empty() && streams.normals.size() != vertexCount) streams.normals = {};
+    if (!streams.tangents.empty() && streams.tangents.size() != vertexCount) streams.tangents = {};
+    if (!streams.uvs.empty() && streams.uvs.size() != vertexCount) streams.uvs = {};
+
+    mesh.boundsMin = mesh.boundsMax = streams.positions[0];
+    for (const auto& p : streams.positions) {
+        mesh.boundsMin = glm::min(mesh.boundsMin, p);
+        mesh.boundsMax = glm::max(mesh.boundsMax, p);
+    }
+
+    if (prim.indices >= 0) {
+        PBRE::Core::AccessorInfo info;
+        if (!PBRE::Core::accessorInfo(gltfModel, prim.indices, info)) return false;
+        streams.indices = arena.allocateArray<uint32_t>(info.count);
+        if (!PBRE::Core::decodeIndices(gltfModel, buffers, prim.indices, streams.indices.data())) {
+            std::cerr << "Unsupported index accessor in GLTF." << std::endl;
+            return false;
+        }
+        for (uint32_t index : streams.indices) {
+            if (index >= vertexCount) return false;
+        }
+    } else {
+        // Non-indexed, draw the vertices in order
+        streams.indices = arena.allocateArray<uint32_t>(vertexCount);
+        std::iota(streams.indices.begin(), streams.indices.end(), 0u);
+    }
+
+    mesh.materialIndex = prim.material >= 0 ? static_cast<size_t>(prim.material) : SIZE_MAX;
+    return true;
+}
+
+// Where a vertex stream is uploaded from: the source bytes, so KHR_mesh_quantization streams keep their stored
+// layout, or the decoded floats for sparse and generated streams
+struct StreamSource {
+    const uint8_t* data = nullptr; // first element, null for an absent stream
+    size_t bytes = 0;              // from the first element to the end of the last
+    int view = -1;                 // glTF buffer view holding the bytes, -1 for decoded floats
+    size_t floatBytes = 0;         // the decoded floats, for the load stats
+    VertexFormat format;
+};
+
+template <class T> static StreamSource streamSource(const tinygltf::Model& gltfModel, const PBRE::Core::BufferSpans& buffers, const tinygltf::Primitive& prim, const char* name, std::span<T> decoded) {
+    StreamSource source;
+    if (decoded.empty()) return source;
+    source.data = reinterpret_cast<const uint8_t*>(decoded.data());
+    source.bytes = source.floatBytes = decoded.size_bytes();
+    source.format = {GL_FLOAT, T::length(), GL_FALSE, sizeof(T)};
+
+    auto it = prim.attributes.find(name); // absent for generated streams
+    int accessor = it != prim.attributes.end() ? it->second : -1;
+    PBRE::Core::AccessorInfo info;
+    size_t stride = 0;
+    // Tangent generation can append split vertices, the accessor's bytes then no longer cover the stream
+    if (accessor >= 0 && PBRE::Core::accessorInfo(gltfModel, accessor, info) && info.components == T::length() && info.count == decoded.size()) {
+        auto raw = PBRE::Core::stridedData(gltfModel, buffers, accessor, stride);
+        if (!raw.empty()) {
+            // glTF component type values are the GL type enums
+            source.format = {static_cast<GLenum>(info.componentType), info.components, info.normalized ? GLboolean(GL_TRUE) : GLboolean(GL_FALSE), static_cast<GLsizei>(stride)};
+            source.data = raw.data();
+            source.bytes = raw.size();
+            source.view = gltfModel.accessors[accessor].bufferView;
+        }
+    }
+    return source;
+}
+
+static bool uploadMesh(const tinygltf::Model& gltfModel, const PBRE::Core::BufferSpans& buffers, const tinygltf::Primitive& prim, const MeshStreams& streams, Mesh& mesh, const std::string& owner, ModelLoadStats& stats) {
+    auto& state = GlState::instance();
+    glGenVertexArrays(1, &mesh.vao);
+    state.bindVertexArray(mesh.vao);
+
+    // Attribute locations 0-3
+    StreamSource sources[] = {streamSource(gltfModel, buffers, prim, "POSITION", streams.positions), streamSource(gltfModel, buffers, prim, "NORMAL", streams.normals),
+                              streamSource(gltfModel, buffers, prim, "TANGENT", streams.tangents), streamSource(gltfModel, buffers, prim, "TEXCOORD_0", streams.uvs)};
+    GLuint* vbos[] = {&mesh.vboPos, &mesh.vboNorm, &mesh.vboTan, &mesh.vboUV};
+    VertexFormat* formats[] = {&mesh.positionFormat, &mesh.normalFormat, &mesh.tangentFormat, &mesh.uvFormat};
+    auto sameView = [&](int a, int b) { return a == b || (sources[a].view >= 0 && sources[a].view == sources[b].view); };
+    // A refused buffer leaves the mesh with no GL objects at all rather than some of its streams, never drawn
+    auto discard = [&] {
+        GLuint names[] = {mesh.vboPos, mesh.vboNorm, mesh.vboTan, mesh.vboUV, mesh.ebo};
+        for (size_t b = 0; b < std::size(names); ++b) {
+            if (!names[b] || std::find(names, names + b, names[b]) != names + b) continue; // shared by interleaved streams
+            GpuMemory::instance().release(GL_BUFFER, names[b]);
+            glDeleteBuffers(1, &names[b]);
+        }
+        for (GLuint* vao : {&mesh.vao, &mesh.depthVao}) {
+            state.forgetVertexArray(*vao);
+            if (*vao) glDeleteVertexArrays(1, vao);
+        }
+        mesh.vao = mesh.depthVao = 0;
+        mesh.vboPos = mesh.vboNorm = mesh.vboTan = mesh.vboUV = mesh.ebo = 0;
+        mesh.indexCount = 0;
+        return false;
+    };
+
+    // Streams interleaved in one buffer view go up once, as a buffer spanning all of them
+    size_t vertexBytes = 0, floatVertexBytes = 0; // added to the stats once every buffer is in
+    for (int s = 0; s < 4; ++s) {
+        if (!sources[s].data || *vbos[s]) continue; // absent, or uploaded with an earlier stream of its view
+        const uint8_t* begin = sources[s].data;
+        const uint8_t* end = begin + sources[s].bytes;
+        for (int o = s + 1; o < 4; ++o) {
+            if (!sources[o].data || !sameView(s, o)) continue;
+            begin = std::min(begin, sources[o].data);
+            end = std::max(end, sources[o].data + sources[o].bytes);
+        }
+        size_t bytes = static_cast<size_t>(end - begin);
+        // The visibility resolve reads the buffer as 32-bit words, so the last element of an 8 or 16-bit
+        // stream must not end mid word
+        size_t paddedBytes = (bytes + 3) & ~size_t(3);
+
+        GLuint vbo = 0;
+        glGenBuffers(1, &vbo);
+        if (!GpuMemory::instance().track({.objectType = GL_BUFFER, .name = vbo, .category = GpuCategory::VertexBuffer, .bytes = paddedBytes, .owner = owner, .site = std::source_location::current()})) {
+            glDeleteBuffers(1, &vbo);
+            return discard();
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, paddedBytes, nullptr, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, begin);
+        if (paddedBytes > bytes) {
+            const uint32_t zero = 0;
+            glBufferSubData(GL_ARRAY_BUFFER, bytes, paddedBytes - bytes, &zero);
+        }
+        vertexBytes += paddedBytes;
+        for (int o = s; o < 4; ++o) {
+            if (!sources[o].data || !sameView(s, o)) continue;
+            *vbos[o] = vbo;
+            *formats[o] = sources[o].format;
+            formats[o]->offset = static_cast<size_t>(sources[o].data - begin);
+            glEnableVertexAttribArray(o);
+            glVertexAttribPointer(o, formats[o]->components, formats[o]->type, formats[o]->normalized, formats[o]->stride, reinterpret_cast<const void*>(formats[o]->offset));
+            floatVertexBytes += sources[o].floatBytes;
+        }
+    }
+    if (!streams.indices.empty()) {
+        GLuint ebo = 0;
+        glGenBuffers(1, &ebo);
+        if (!GpuMemory::instance().track({.objectType = GL_BUFFER, .name = ebo, .category = GpuCategory::IndexBuffer, .bytes = streams.indices.size_bytes(), .owner = owner, .site = std::source_location::current()})) {
+            glDeleteBuffers(1, &ebo);
+            return discard();
+        }
+        mesh.ebo = ebo;
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, streams.indices.size_bytes(), streams.indices.data(), GL_STATIC_DRAW);
+        mesh.indexCount = static_cast<GLsizei>(streams.indices.size());
+    }
+
+    // Position only stream for depth passes, shares the position and index buffers
+    glGenVertexArrays(1, &mesh.depthVao);
+    state.bindVertexArray(mesh.depthVao);
+    if (mesh.vboPos) {
+        const auto& pf = mesh.positionFormat;
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vboPos);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, pf.components, pf.type, pf.normalized, pf.stride, reinterpret_cast<const void*>(pf.offset));
+    }
+    if (mesh.ebo) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    stats.vertexBytes += vertexBytes;
+    stats.floatVertexBytes += floatVertexBytes;
+    return true;
+}
+
+// Copies the streams the retention policy keeps out of the arena, returns their size
+static size_t retainStreams(const MeshStreams& streams, GeometryRetention retention, Mesh& mesh) {
+    auto keep = [](auto span, auto& vector) {
+        vector.assign(span.begin(), span.end());
+        vector.shrink_to_fit();
+        return span.size_bytes();
+    };
+    size_t bytes = 0;
+    if (retention == GeometryRetention::None) return bytes;
+    bytes += keep(streams.positions, mesh.positions);
+    bytes += keep(streams.indices, mesh.indices);
+    if (retention == GeometryRetention::Positions) return bytes;
+    bytes += keep(streams.normals, mesh.normals);
+    bytes += keep(streams.tangents, mesh.tangents);
+    bytes += keep(streams.uvs, mesh.uvs);
+    return bytes;
+}
+
+// Placeholders swapped in for buffers and images the engine reads from its own mappings, tinygltf decodes
+// them to a single byte instead of copying the real data
+static constexpr const char* kPlaceholderBuffer = "data:application/octet-stream;base64,AA==";
+static constexpr const char* kPlaceholderImage = "data:image/png;base64,AA==";
+
+static std::string decodeUri(const std::string& uri) {
+    std::string out;
+    out.reserve(uri.size());
+    for (size_t i = 0; i < uri.size(); ++i) {
+        if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1])) && std::isxdigit(static_cast<unsigned char>(uri[i + 2]))) {
+            out += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            out += uri[i];
+        }
+    }
+    return out;
+}
+
+static bool isDataUri(const std::string& uri) {
+    return uri.rfind("data:", 0) == 0;
+}
+
+// Everything a load reads from: the tinygltf model plus the bytes of its buffers and encoded images
+struct GltfSource {
+    tinygltf::Model model;
+    PBRE::Core::BufferSpans buffers;
+    std::vector<std::span<const uint8_t>> encodedImages; // per image, empty when tinygltf decoded it
+    std::vector<PBRE::Core::MappedFile> files;           // keep the spans above alive
+    std::vector<int> imageViews;                         // per image, the buffer view holding it or -1
+    std::vector<char> deferredImages;                    // read by the image loader callback
+};
+
+static bool loadImageCallback(tinygltf::Image* image, const int index, std::string* err, std::string* warn, int reqWidth, int reqHeight, const unsigned char* bytes, int size, void* user) {
+    const auto& deferred = *static_cast<const std::vector<char>*>(user);
+    if (index >= 0 && index < static_cast<int>(deferred.size()) && deferred[index]) return true;
+    return tinygltf::LoadImageData(image, index, err, warn, reqWidth, reqHeight, bytes, size, nullptr);
+}
+
+// The old path: tinygltf reads the JSON, then copies every buffer and decodes every image into vectors
+static bool loadCopied(const std::string& filename, GltfSource& source, std::string& err, std::string& warn) {
+    tinygltf::TinyGLTF loader;
+    bool binary = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".glb") == 0;
+    bool ok = binary ? loader.LoadBinaryFromFile(&source.model, &err, &warn, filename) : loader.LoadASCIIFromFile(&source.model, &err, &warn, filename);
+    if (!ok) return false;
+    source.buffers = PBRE::Core::ownedBufferSpans(source.model);
+    source.encodedImages.assign(source.model.images.size(), {});
+    return true;
+}
+
+// Maps the file (.gltf or .glb) and every external buffer and image. The JSON is rewritten so tinygltf only
+// parses it: buffers point at the mappings, and images are decoded later straight from the mapped bytes.
+static bool loadMapped(const std::string& filename, GltfSource& source, std::string& err, std::string& warn) {
+    auto& file = source.files.emplace_back();
+    if (!file.open(filename)) {
+        err = "Failed to map " + filename;
+        return false;
+    }
+    std::string_view json(reinterpret_cast<const char*>(file.bytes().data()), file.size());
+    std::span<const uint8_t> bin;
+    if (PBRE::Core::isGlb(file.bytes())) {
+        PBRE::Core::GlbChunks chunks;
+        if (!PBRE::Core::parseGlb(file.bytes(), chunks)) {
+            err = "Malformed GLB container";
+            return false;
+        }
+        json = chunks.json;
+        bin = chunks.bin;
+    }
+
+    nlohmann::json doc = nlohmann::json::parse(json.data(), json.data() + json.size(), nullptr, false);
+    if (doc.is_discarded() || !doc.is_object()) {
+        err = "Invalid glTF JSON";
+        return false;
+    }
+    std::filesystem::path baseDir = std::filesystem::path(filename).parent_path();
+    auto mapUri = [&](const std::string& uri, std::span<const uint8_t>& bytes) {
+        auto& mapped = source.files.emplace_back();
+        if (!mapped.open((baseDir / decodeUri(uri)).string())) {
+            err = "Failed to map " + uri;
+            return false;
+        }
+        bytes = mapped.bytes();
+        return true;
+    };
+
+    std::vector<std::span<const uint8_t>> mappedBuffers;
+    std::vector<char> overridden;
+    if (doc.contains("buffers")) {
+        auto& buffers = doc["buffers"];
+        mappedBuffers.resize(buffers.size());
+        overridden.resize(buffers.size());
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            auto& buffer = buffers[i];
+            if (!buffer.contains("uri")) {
+                // The GLB BIN chunk, or an EXT_meshopt_compression fallback the decoder fills in
+                if (i == 0) mappedBuffers[i] = bin;
+            } else {
+                std::string uri = buffer["uri"].get<std::string>();
+                if (isDataUri(uri)) continue;
+                if (!mapUri(uri, mappedBuffers[i])) return false;
+            }
+            overridden[i] = 1;
+            buffer["uri"] = kPlaceholderBuffer;
+            buffer["byteLength"] = 1;
+        }
+    }
+
+    size_t imageCount = doc.contains("images") ? doc["images"].size() : 0;
+    source.encodedImages.assign(imageCount, {});
+    source.imageViews.assign(imageCount, -1);
+    source.deferredImages.assign(imageCount, 0);
+    for (size_t i = 0; i < imageCount; ++i) {
+        auto& image = doc["images"][i];
+        if (image.contains("bufferView")) {
+            source.imageViews[i] = image["bufferView"].get<int>();
+            image.erase("bufferView");
+            image.erase("mimeType");
+        } else if (image.contains("uri")) {
+            std::string uri = image["uri"].get<std::string>();
+            if (isDataUri(uri)) continue;
+            if (!mapUri(uri, source.encodedImages[i])) return false;
+        } else {
+            continue;
+        }
+        source.deferredImages[i] = 1;
+        image["uri"] = kPlaceholderImage;
+    }
+
+    std::string text = doc.dump();
     tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(loadImageCallback, &source.deferredImages);
+    if (!loader.LoadASCIIFromString(&source.model, &err, &warn, text.c_str(), static_cast<unsigned int>(text.size()), baseDir.string())) return false;
+
+    source.buffers = PBRE::Core::ownedBufferSpans(source.model);
+    for (size_t i = 0; i < overridden.size() && i < source.buffers.size(); ++i) {
+        if (overridden[i]) {
+            source.buffers[i] = mappedBuffers[i];
+            source.model.buffers[i].data.clear(); // the placeholder byte
+        }
+    }
+    return true;
+}
+
+namespace PBRE::Wrapper {
+struct ModelUpload {
+    // Decoded RGBA8 pixels of an image a material uses, or the ones tinygltf decoded (copied loads). The
+    // packed ORM images follow the glTF ones.
+    struct Image {
+        std::shared_ptr<unsigned char> pixels;
+        int width = 0, height = 0;
+        int channels = 4;
+        bool decoded = false;
+    };
+    struct PendingTexture {
+        std::shared_ptr<Texture> texture;
+        int image = -1;
+    };
+
+    GltfSource source; // the vertex streams are uploaded from its buffers
+    LoadMode mode = LoadMode::Mapped;
+    std::vector<Image> images;
+    std::vector<PendingTexture> textures;
+    std::unique_ptr<PBRE::Core::LinearArena> arena; // decoded streams and tangents
+    std::vector<const tinygltf::Primitive*> primitives; // per Model::meshes entry
+    std::vector<MeshStreams> streams;                   // per Model::meshes entry
+};
+} // namespace PBRE::Wrapper
+
+// Every image a material reads, so they can all be decoded at once before the materials are built
+static std::vector<int> materialImages(const tinygltf::Model& gltfModel) {
+    std::vector<char> used(gltfModel.images.size(), 0);
+    auto mark = [&](int texIndex) {
+        if (texIndex < 0 || texIndex >= static_cast<int>(gltfModel.textures.size())) return;
+        int imgIndex = gltfModel.textures[texIndex].source;
+        if (imgIndex >= 0 && imgIndex < static_cast<int>(used.size())) used[imgIndex] = 1;
+    };
+    for (const auto& mat : gltfModel.materials) {
+        mark(mat.pbrMetallicRoughness.baseColorTexture.index);
+        mark(mat.pbrMetallicRoughness.metallicRoughnessTexture.index);
+        mark(mat.normalTexture.index);
+        mark(mat.occlusionTexture.index);
+        mark(mat.emissiveTexture.index);
+    }
+    std::vector<int> images;
+    for (size_t i = 0; i < used.size(); ++i) {
+        if (used[i]) images.push_back(static_cast<int>(i));
+    }
+    return images;
+}
+
+// 8-bit pixels of a decoded image, one of whose channels is read
+struct ChannelSource {
+    const unsigned char* pixels = nullptr;
+    int width = 0, height = 0, channels = 0;
+    int channel = 0;
+
+    unsigned char at(size_t texel) const { return pixels[texel * channels + channel]; }
+};
+
+// Occlusion, roughness and metallic of the materials sharing an occlusion and a metallic-roughness image,
+// in the order of the packed texture's channels
+enum OrmSlot { kOrmOcclusion, kOrmRoughness, kOrmMetallic, kOrmSlotCount };
+
+struct OrmPack {
+    ChannelSource sources[kOrmSlotCount]; // null pixels where the material has no texture for it
+    int channel[kOrmSlotCount] = {-1, -1, -1}; // in the packed image, -1 where the source is uniform or absent
+    float constant[kOrmSlotCount] = {};        // value of a uniform source
+    int width = 0, height = 0, channels = 0;
+    std::shared_ptr<unsigned char> pixels;
+};
+
+// Keeps only the channels that vary, uniform ones become constants. The result takes the size of the first
+// varying source, the others are point sampled if theirs differs.
+static void packOrm(OrmPack& pack) {
+    bool varies[kOrmSlotCount] = {};
+    for (int slot = 0; slot < kOrmSlotCount; ++slot) {
+        const auto& source = pack.sources[slot];
+        if (!source.pixels) continue;
+        size_t texels = static_cast<size_t>(source.width) * source.height;
+        unsigned char first = source.at(0);
+        bool uniform = true;
+        for (size_t t = 1; t < texels && uniform; ++t) uniform = source.at(t) == first;
+        if (uniform) {
+            pack.constant[slot] = first / 255.0f;
+        } else {
+            varies[slot] = true;
+            pack.channel[slot] = pack.channels++;
+        }
+    }
+    // Metallic-roughness is usually the larger image
+    for (int slot : {kOrmRoughness, kOrmMetallic, kOrmOcclusion}) {
+        if (varies[slot]) {
+            pack.width = pack.sources[slot].width;
+            pack.height = pack.sources[slot].height;
+            break;
+        }
+    }
+    if (pack.channels == 0) return;
+
+    size_t texels = static_cast<size_t>(pack.width) * pack.height;
+    pack.pixels.reset(new unsigned char[texels * pack.channels], std::default_delete<unsigned char[]>());
+    unsigned char* out = pack.pixels.get();
+    for (int slot = 0; slot < kOrmSlotCount; ++slot) {
+        if (pack.channel[slot] < 0) continue;
+        const auto& source = pack.sources[slot];
+        int c = pack.channel[slot];
+        bool sameSize = source.width == pack.width && source.height == pack.height;
+        for (int y = 0; y < pack.height; ++y) {
+            int sy = sameSize ? y : static_cast<int>(static_cast<int64_t>(y) * source.height / pack.height);
+            for (int x = 0; x < pack.width; ++x) {
+                int sx = sameSize ? x : static_cast<int>(static_cast<int64_t>(x) * source.width / pack.width);
+                out[(static_cast<size_t>(y) * pack.width + x) * pack.channels + c] = source.at(static_cast<size_t>(sy) * source.width + sx);
+            }
+        }
+    }
+}
+
+// Normal mapped primitives without a TANGENT attribute get generated ones
+static bool needsTangents(const std::vector<PBRE::Render::Material>& materials, const Mesh& mesh, const MeshStreams& streams) {
+    if (!streams.tangents.empty() || streams.normals.empty() || streams.uvs.empty()) return false;
+    return mesh.materialIndex < materials.size() && materials[mesh.materialIndex].normal;
+}
+
+// Adds generated tangents to the streams, with copies of the vertices the generator split and their corners
+// pointed at them. False, leaving the streams alone, if they don't fit the mesh (a stale cache entry).
+static bool applyTangents(const PBRE::Core::GeneratedTangents& generated, PBRE::Core::LinearArena& arena, MeshStreams& streams) {
+    size_t vertexCount = streams.positions.size();
+    size_t totalCount = vertexCount + generated.splitSources.size();
+    if (generated.tangents.size() != totalCount) return false;
+    for (uint32_t source : generated.splitSources) {
+        if (source >= vertexCount) return false;
+    }
+    for (const auto& split : generated.splitCorners) {
+        if (split.corner >= streams.indices.size() || split.vertex < vertexCount || split.vertex >= totalCount) return false;
+    }
+
+    if (totalCount > vertexCount) {
+        auto grow = [&](auto& stream) {
+            using T = typename std::remove_reference_t<decltype(stream)>::value_type;
+            auto grown = arena.allocateArray<T>(totalCount);
+            std::copy(stream.begin(), stream.end(), grown.begin());
+            for (size_t s = 0; s < generated.splitSources.size(); ++s) grown[vertexCount + s] = stream[generated.splitSources[s]];
+            stream = grown;
+        };
+        grow(streams.positions);
+        grow(streams.normals);
+        grow(streams.uvs);
+        for (const auto& split : generated.splitCorners) streams.indices[split.corner] = split.vertex;
+    }
+    streams.tangents = arena.copy<PBRE::vec4>(generated.tangents);
+    return true;
+}
+
+bool Model::loadFromFile(const std::string& filename, LoadMode mode) {
+    return decode(filename, mode) && upload();
+}
+
+bool Model::decode(const std::string& filename, LoadMode mode) {
+    auto decodeStart = std::chrono::steady_clock::now();
+    loadStats = {};
+    pendingUpload.reset();
+    auto pending = std::make_shared<ModelUpload>();
+    pending->mode = mode;
+    pending->arena = acquireArena();
+    auto& arena = *pending->arena;
+    auto& source = pending->source;
     std::string err, warn;
 
-    bool ret = loader.LoadASCIIFromFile(&gltfModel, &err, &warn, filename);
+    bool ret = mode == LoadMode::Mapped ? loadMapped(filename, source, err, warn) : loadCopied(filename, source, err, warn);
     if (!warn.empty()) {
         std::cout << "GLTF Warning: " << warn << std::endl;
     }
@@ -26,9 +578,86 @@ bool Model::loadFromFile(const std::string& filename) {
     }
 
     path = filename;
+    auto& gltfModel = source.model;
+    auto& buffers = source.buffers;
+
+    // EXT_meshopt_compression: decode the compressed views into their fallback buffers before anything reads them
+    if (!PBRE::Core::decodeMeshoptBufferViews(gltfModel, buffers, loadStats.meshopt)) {
+        std::cerr << "Failed to load GLTF: " << filename << std::endl;
+        return false;
+    }
+
+    // Images stored in buffer views are decoded from the view's bytes
+    for (size_t i = 0; i < source.imageViews.size(); ++i) {
+        int view = source.imageViews[i];
+        if (view < 0 || view >= static_cast<int>(gltfModel.bufferViews.size())) continue;
+        const auto& bufferView = gltfModel.bufferViews[view];
+        if (bufferView.buffer < 0 || bufferView.buffer >= static_cast<int>(buffers.size())) continue;
+        const auto& bytes = buffers[bufferView.buffer];
+        if (bufferView.byteOffset + bufferView.byteLength <= bytes.size()) source.encodedImages[i] = bytes.subspan(bufferView.byteOffset, bufferView.byteLength);
+    }
+
+    // Decode the images the materials use, one per task
+    pending->images.resize(gltfModel.images.size());
+    std::vector<int> usedImages = materialImages(gltfModel);
+    PBRE::Core::parallelFor(usedImages.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t u = begin; u < end; ++u) {
+            int imgIndex = usedImages[u];
+            auto& image = pending->images[imgIndex];
+            const auto& encoded = source.encodedImages[imgIndex];
+            if (!encoded.empty()) {
+                // Same RGBA expansion tinygltf's loader does
+                int channels = 0;
+                unsigned char* pixels = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &image.width, &image.height, &channels, 4);
+                if (!pixels) continue;
+                image.pixels.reset(pixels, stbi_image_free);
+                image.decoded = true;
+            } else {
+                const auto& img = gltfModel.images[imgIndex];
+                size_t bytes = static_cast<size_t>(img.width) * img.height * img.component;
+                bool channelsOk = img.component >= 1 && img.component <= 4;
+                image.decoded = img.width > 0 && img.height > 0 && channelsOk && img.image.size() >= bytes;
+            }
+        }
+    });
+
+    // Decoded image of a glTF texture, -1 if there is none
+    auto imageFor = [&](int texIndex) {
+        if (texIndex < 0 || texIndex >= static_cast<int>(gltfModel.textures.size())) return -1;
+        int imgIndex = gltfModel.textures[texIndex].source;
+        if (imgIndex < 0 || imgIndex >= static_cast<int>(gltfModel.images.size())) return -1;
+        return pending->images[imgIndex].decoded ? imgIndex : -1;
+    };
+    auto sourceOf = [&](int imgIndex, int channel) {
+        ChannelSource source;
+        const auto& image = pending->images[imgIndex];
+        if (image.pixels) {
+            source = {image.pixels.get(), image.width, image.height, image.channels};
+        } else {
+            const auto& img = gltfModel.images[imgIndex];
+            source = {img.image.data(), img.width, img.height, img.component};
+        }
+        source.channel = channel < source.channels ? channel : 0; // grey images repeat their one channel
+        return source;
+    };
+
+    // One texture per image, however many materials share it. Filled in by upload().
+    std::vector<std::shared_ptr<Texture>> textures(gltfModel.images.size());
+    auto textureFor = [&](int texIndex) -> std::shared_ptr<Texture> {
+        int imgIndex = imageFor(texIndex);
+        if (imgIndex < 0) return nullptr;
+        if (!textures[imgIndex]) {
+            textures[imgIndex] = std::make_shared<Texture>();
+            pending->textures.push_back({textures[imgIndex], imgIndex});
+        }
+        return textures[imgIndex];
+    };
 
     // Load materials
-    materials.resize(gltfModel.materials.size());
+    materials.assign(gltfModel.materials.size(), {}); // a reload must not inherit maps or factors
+    std::map<std::pair<int, int>, size_t> ormPackIndex; // (metallic-roughness, occlusion) image
+    std::vector<OrmPack> ormPacks;
+    std::vector<int> materialPacks(materials.size(), -1);
     for (size_t i = 0; i < gltfModel.materials.size(); ++i) {
         const auto& gltfMat = gltfModel.materials[i];
         auto& mat = materials[i];
@@ -39,70 +668,46 @@ bool Model::loadFromFile(const std::string& filename) {
             mat.albedo = vec3(factor[0], factor[1], factor[2]);
         }
         if (gltfMat.values.find("baseColorTexture") != gltfMat.values.end()) {
-            int texIndex = gltfMat.values.at("baseColorTexture").TextureIndex();
-            if (texIndex >= 0 && texIndex < gltfModel.textures.size()) {
-                int imgIndex = gltfModel.textures[texIndex].source;
-                if (imgIndex >= 0 && imgIndex < gltfModel.images.size()) {
-                    const auto& img = gltfModel.images[imgIndex];
-                    auto texture = std::make_shared<Texture>();
-                    if (texture->loadFromImageData(img.width, img.height, img.component, img.image)) {
-                        mat.albedo = texture;
-                    }
-                }
-            }
+            if (auto texture = textureFor(gltfMat.values.at("baseColorTexture").TextureIndex())) mat.albedo = texture;
         }
 
         // Metallic
         if (gltfMat.values.find("metallicFactor") != gltfMat.values.end()) {
-            mat.metallic = static_cast<float>(gltfMat.values.at("metallicFactor").Factor());
+            mat.metallicFactor = static_cast<float>(gltfMat.values.at("metallicFactor").Factor());
+            mat.metallic = mat.metallicFactor;
         }
         if (gltfMat.values.find("roughnessFactor") != gltfMat.values.end()) {
-            mat.roughness = static_cast<float>(gltfMat.values.at("roughnessFactor").Factor());
+            mat.roughnessFactor = static_cast<float>(gltfMat.values.at("roughnessFactor").Factor());
+            mat.roughness = mat.roughnessFactor;
         }
-        // glTF metallicRoughness is commonly a single texture (R=occlusion in extension, G=roughness, B=metallic in base spec)
+        // glTF metallicRoughness is G=roughness, B=metallic, occlusion is R of its own texture (often the same one).
+        // Both are repacked below, so the images themselves are only uploaded if something else samples them.
+        int metallicRoughnessImage = -1, occlusionImage = -1;
         if (gltfMat.values.find("metallicRoughnessTexture") != gltfMat.values.end()) {
-            int texIndex = gltfMat.values.at("metallicRoughnessTexture").TextureIndex();
-            if (texIndex >= 0 && texIndex < (int)gltfModel.textures.size()) {
-                int imgIndex = gltfModel.textures[texIndex].source;
-                if (imgIndex >= 0 && imgIndex < (int)gltfModel.images.size()) {
-                    const auto& img = gltfModel.images[imgIndex];
-                    auto texture = std::make_shared<Texture>();
-                    if (texture->loadFromImageData(img.width, img.height, img.component, img.image)) {
-                        // Bind the same texture to both metallic and roughness so shader can sample channels separately
-                        mat.metallic = texture;   // B channel
-                        mat.roughness = texture;  // G channel
-                    }
+            metallicRoughnessImage = imageFor(gltfMat.values.at("metallicRoughnessTexture").TextureIndex());
+        }
+        if (gltfMat.additionalValues.find("occlusionTexture") != gltfMat.additionalValues.end()) {
+            const auto& occlusion = gltfMat.additionalValues.at("occlusionTexture");
+            occlusionImage = imageFor(occlusion.TextureIndex());
+            mat.aoStrength = static_cast<float>(occlusion.TextureStrength());
+        }
+        if (metallicRoughnessImage >= 0 || occlusionImage >= 0) {
+            auto [it, inserted] = ormPackIndex.emplace(std::make_pair(metallicRoughnessImage, occlusionImage), ormPacks.size());
+            if (inserted) {
+                OrmPack pack;
+                if (metallicRoughnessImage >= 0) {
+                    pack.sources[kOrmRoughness] = sourceOf(metallicRoughnessImage, 1);
+                    pack.sources[kOrmMetallic] = sourceOf(metallicRoughnessImage, 2);
                 }
+                if (occlusionImage >= 0) pack.sources[kOrmOcclusion] = sourceOf(occlusionImage, 0);
+                ormPacks.push_back(pack);
             }
+            materialPacks[i] = static_cast<int>(it->second);
         }
 
         // Normal Map
         if (gltfMat.additionalValues.find("normalTexture") != gltfMat.additionalValues.end()) {
-            int texIndex = gltfMat.additionalValues.at("normalTexture").TextureIndex();
-            if (texIndex >= 0 && texIndex < gltfModel.textures.size()) {
-                int imgIndex = gltfModel.textures[texIndex].source;
-                if (imgIndex >= 0 && imgIndex < gltfModel.images.size()) {
-                    const auto& img = gltfModel.images[imgIndex];
-                    auto texture = std::make_shared<Texture>();
-                    if (texture->loadFromImageData(img.width, img.height, img.component, img.image)) {
-                        mat.normal = texture;
-                    }
-                }
-            }
-        }
-        // AO
-        if (gltfMat.additionalValues.find("occlusionTexture") != gltfMat.additionalValues.end()) {
-            int texIndex = gltfMat.additionalValues.at("occlusionTexture").TextureIndex();
-            if (texIndex >= 0 && texIndex < gltfModel.textures.size()) {
-                int imgIndex = gltfModel.textures[texIndex].source;
-                if (imgIndex >= 0 && imgIndex < gltfModel.images.size()) {
-                    const auto& img = gltfModel.images[imgIndex];
-                    auto texture = std::make_shared<Texture>();
-                    if (texture->loadFromImageData(img.width, img.height, img.component, img.image)) {
-                        mat.ao = texture;
-                    }
-                }
-            }
+            if (auto texture = textureFor(gltfMat.additionalValues.at("normalTexture").TextureIndex())) mat.normal = texture;
         }
         // Emissive
         if (gltfMat.additionalValues.find("emissiveFactor") != gltfMat.additionalValues.end()) {
@@ -110,197 +715,369 @@ bool Model::loadFromFile(const std::string& filename) {
             mat.emissive = vec3(factor[0], factor[1], factor[2]);
         }
         if (gltfMat.additionalValues.find("emissiveTexture") != gltfMat.additionalValues.end()) {
-            int texIndex = gltfMat.additionalValues.at("emissiveTexture").TextureIndex();
-            if (texIndex >= 0 && texIndex < gltfModel.textures.size()) {
-                int imgIndex = gltfModel.textures[texIndex].source;
-                if (imgIndex >= 0 && imgIndex < gltfModel.images.size()) {
-                    const auto& img = gltfModel.images[imgIndex];
-                    auto texture = std::make_shared<Texture>();
-                    if (texture->loadFromImageData(img.width, img.height, img.component, img.image)) {
-                        mat.emissive = texture;
-                    }
-                }
-            }
+            if (auto texture = textureFor(gltfMat.additionalValues.at("emissiveTexture").TextureIndex())) mat.emissive = texture;
         }
         mat.doubleSided = gltfMat.doubleSided;
         if (gltfMat.alphaMode == "MASK") {
+            mat.alphaMode = Render::AlphaMode::Mask;
             mat.alphaCutoff = static_cast<float>(gltfMat.alphaCutoff);
         } else {
+            mat.alphaMode = (gltfMat.alphaMode == "BLEND") ? Render::AlphaMode::Blend : Render::AlphaMode::Opaque;
             mat.alphaCutoff = 0.5f; // default
         }
     }
-    // Load meshes
-    meshes.resize(gltfModel.meshes.size());
-    for (size_t i = 0; i < gltfModel.meshes.size(); ++i) {
-        const auto& gltfMesh = gltfModel.meshes[i];
-        auto& mesh = meshes[i];
-
-        // For simplicity, we only load the first primitive of each mesh
-        if (gltfMesh.primitives.empty()) continue;
-        const auto& prim = gltfMesh.primitives[0];
-
-        // Positions
-        if (prim.attributes.find("POSITION") != prim.attributes.end()) {
-            int accessorIndex = prim.attributes.at("POSITION");
-            const auto& accessor = gltfModel.accessors[accessorIndex];
-            const auto& bufferView = gltfModel.bufferViews[accessor.bufferView];
-            const auto& buffer = gltfModel.buffers[bufferView.buffer];
-
-            size_t count = accessor.count;
-            mesh.positions.resize(count);
-            const float* dataPtr = reinterpret_cast<const float*>(
-                buffer.data.data() + bufferView.byteOffset + accessor.byteOffset);
-            for (size_t j = 0; j < count; ++j) {
-                mesh.positions[j] = vec3(dataPtr[j * 3 + 0], dataPtr[j * 3 + 1], dataPtr[j * 3 + 2]);
+    // One texture per pack of only the channels that vary: R8, RG8 or RGB8 instead of an RGBA8 per source image
+    PBRE::Core::parallelFor(ormPacks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) packOrm(ormPacks[p]);
+    });
+    std::vector<std::shared_ptr<Texture>> ormTextures(ormPacks.size());
+    for (size_t p = 0; p < ormPacks.size(); ++p) {
+        auto& pack = ormPacks[p];
+        if (pack.channels == 0) continue;
+        ModelUpload::Image image;
+        image.pixels = std::move(pack.pixels);
+        image.width = pack.width;
+        image.height = pack.height;
+        image.channels = pack.channels;
+        image.decoded = true;
+        pending->images.push_back(std::move(image));
+        ormTextures[p] = std::make_shared<Texture>();
+        pending->textures.push_back({ormTextures[p], static_cast<int>(pending->images.size()) - 1});
+        ++loadStats.ormTextures;
+    }
+    for (size_t i = 0; i < materials.size(); ++i) {
+        if (materialPacks[i] < 0) continue;
+        auto& mat = materials[i];
+        const auto& pack = ormPacks[materialPacks[i]];
+        // A texture channel keeps the factor in the material, a uniform source folds it into the constant
+        auto resolve = [&](auto& param, int& channel, int slot, auto applyFactor) {
+            if (!pack.sources[slot].pixels) return; // the factor stays
+            if (pack.channel[slot] >= 0) {
+                param = ormTextures[materialPacks[i]];
+                channel = pack.channel[slot];
+            } else {
+                param = applyFactor(pack.constant[slot]);
             }
-        }
-
-        // Normals
-        if (prim.attributes.find("NORMAL") != prim.attributes.end()) {
-            int accessorIndex = prim.attributes.at("NORMAL");
-            const auto& accessor = gltfModel.accessors[accessorIndex];
-            const auto& bufferView = gltfModel.bufferViews[accessor.bufferView];
-            const auto& buffer = gltfModel.buffers[bufferView.buffer];
+        };
+        resolve(mat.ao, mat.aoChannel, kOrmOcclusion, [&](float ao) { return 1.0f + mat.aoStrength * (ao - 1.0f); });
+        resolve(mat.roughness, mat.roughnessChannel, kOrmRoughness, [&](float roughness) { return roughness * mat.roughnessFactor; });
+        resolve(mat.metallic, mat.metallicChannel, kOrmMetallic, [&](float metallic) { return metallic * mat.metallicFactor; });
+    }
 
-            size_t count = accessor.count;
-            mesh.normals.resize(count);
-            const float* dataPtr = reinterpret_cast<const float*>(
-                buffer.data.data() + bufferView.byteOffset + accessor.byteOffset);
-            for (size_t j = 0; j < count; ++j) {
-                mesh.normals[j] = vec3(dataPtr[j * 3 + 0], dataPtr[j * 3 + 1], dataPtr[j * 3 + 2]);
+    // Texture memory the materials take, against uploading every image they use as it was decoded
+    auto imageBytes = [&](int imgIndex) {
+        auto source = sourceOf(imgIndex, 0);
+        return GpuMemory::imageBytes(Texture::pixelFormat(source.channels), source.width, source.height, 1,
+                                     GpuMemory::mipLevels(source.width, source.height));
+    };
+    for (int imgIndex : usedImages) {
+        if (pending->images[imgIndex].decoded) loadStats.unpackedTextureBytes += imageBytes(imgIndex);
+    }
+    for (const auto& pendingTexture : pending->textures) loadStats.textureBytes += imageBytes(pendingTexture.image);
+    // Source images nothing else samples are done with
+    for (int imgIndex : usedImages) {
+        if (textures[imgIndex]) continue;
+        pending->images[imgIndex].pixels.reset();
+        std::vector<unsigned char>().swap(gltfModel.images[imgIndex].image);
+    }
+    // The path tracer samples the materials on the CPU, so its textures keep their pixels past the upload
+    if (retainGeometry == GeometryRetention::All) {
+        for (const auto& [texture, imgIndex] : pending->textures) {
+            auto& image = pending->images[imgIndex];
+            if (!image.pixels) {
+                // tinygltf's copy, moved into shared storage that upload() reads from like a decoded image
+                auto& img = gltfModel.images[imgIndex];
+                auto owned = std::make_shared<std::vector<unsigned char>>(std::move(img.image));
+                image.pixels = std::shared_ptr<unsigned char>(owned, owned->data());
+                image.width = img.width;
+                image.height = img.height;
+                image.channels = img.component;
             }
+            texture->setCpuPixels({image.pixels, image.width, image.height, image.channels});
         }
+    }
+
+    // Tangents generated for primitives without them are cached next to the model
+    PBRE::Core::TangentCache tangentCache;
+    std::string tangentCachePath = filename + ".tangents";
+    tangentCache.load(tangentCachePath);
 
-        // Tangents
-        if (prim.attributes.find("TANGENT") != prim.attributes.end()) {
-            int accessorIndex = prim.attributes.at("TANGENT");
-            const auto& accessor = gltfModel.accessors[accessorIndex];
-            const auto& bufferView = gltfModel.bufferViews[accessor.bufferView];
-            const auto& buffer = gltfModel.buffers[bufferView.buffer];
-            size_t count = accessor.count;
-            mesh.tangents.resize(count);
-            const float* dataPtr = reinterpret_cast<const float*>(
-                buffer.data.data() + bufferView.byteOffset + accessor.byteOffset);
-            for (size_t j = 0; j < count; ++j) {
-                mesh.tangents[j] = vec4(dataPtr[j * 4 + 0], dataPtr[j * 4 + 1], dataPtr[j * 4 + 2], dataPtr[j * 4 + 3]);
+    // Load meshes, every triangle primitive becomes a Mesh
+    meshes.clear();
+    meshGroups.assign(gltfModel.meshes.size(), {});
+    for (size_t i = 0; i < gltfModel.meshes.size(); ++i) {
+        const auto& gltfMesh = gltfModel.meshes[i];
+        meshGroups[i].first = meshes.size();
+        for (const auto& prim : gltfMesh.primitives) {
+            if (prim.mode != -1 && prim.mode != TINYGLTF_MODE_TRIANGLES) {
+                std::cout << "GLTF Warning: skipping non-triangle primitive in mesh " << i << std::endl;
+                continue;
             }
-        }
-        // UVs
-        if (prim.attributes.find("TEXCOORD_0") != prim.attributes.end()) {
-            int accessorIndex = prim.attributes.at("TEXCOORD_0");
-            const auto& accessor = gltfModel.accessors[accessorIndex];
-            const auto& bufferView = gltfModel.bufferViews[accessor.bufferView];
-            const auto& buffer = gltfModel.buffers[bufferView.buffer];
-
-            size_t count = accessor.count;
-            mesh.uvs.resize(count);
-            const float* dataPtr = reinterpret_cast<const float*>(
-                buffer.data.data() + bufferView.byteOffset + accessor.byteOffset);
-            for (size_t j = 0; j < count; ++j) {
-                mesh.uvs[j] = vec2(dataPtr[j * 2 + 0], dataPtr[j * 2 + 1]);
+            Mesh mesh;
+            MeshStreams streams;
+            if (!loadPrimitive(gltfModel, buffers, prim, arena, streams, mesh)) {
+                std::cerr << "Failed to decode a primitive of mesh " << i << " in " << filename << std::endl;
+                continue;
             }
-        }
-        // Indices
-        if (prim.indices >= 0) {
-            int accessorIndex = prim.indices;
-            const auto& accessor = gltfModel.accessors[accessorIndex];
-            const auto& bufferView = gltfModel.bufferViews[accessor.bufferView];
-            const auto& buffer = gltfModel.buffers[bufferView.buffer];
-
-            size_t count = accessor.count;
-            mesh.indices.resize(count);
-            if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-                const uint16_t* dataPtr = reinterpret_cast<const uint16_t*>(
-                    buffer.data.data() + bufferView.byteOffset + accessor.byteOffset);
-                for (size_t j = 0; j < count; ++j) {
-                    mesh.indices[j] = static_cast<uint32_t>(dataPtr[j]);
-                }
-            } else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
-                const uint32_t* dataPtr = reinterpret_cast<const uint32_t*>(
-                    buffer.data.data() + bufferView.byteOffset + accessor.byteOffset);
-                for (size_t j = 0; j < count; ++j) {
-                    mesh.indices[j] = dataPtr[j];
+            if (needsTangents(materials, mesh, streams)) {
+                auto tangentStart = std::chrono::steady_clock::now();
+                uint64_t key = PBRE::Core::tangentKey(streams.positions, streams.normals, streams.uvs, streams.indices);
+                if (const auto* cached = tangentCache.find(key); cached && applyTangents(*cached, arena, streams)) {
+                    ++loadStats.tangentsCached;
+                } else {
+                    PBRE::Core::GeneratedTangents generated;
+                    PBRE::Core::generateTangents(streams.positions, streams.normals, streams.uvs, streams.indices, generated);
+                    applyTangents(generated, arena, streams);
+                    tangentCache.store(key, std::move(generated));
+                    ++loadStats.tangentsGenerated;
                 }
-            } else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
-                const uint8_t* dataPtr = reinterpret_cast<const uint8_t*>(
-                    buffer.data.data() + bufferView.byteOffset + accessor.byteOffset);
-                for (size_t j = 0; j < count; ++j) {
-                    mesh.indices[j] = static_cast<uint32_t>(dataPtr[j]);
+                loadStats.tangentMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tangentStart).count();
+            }
+            pending->primitives.push_back(&prim);
+            pending->streams.push_back(streams);
+            meshes.push_back(std::move(mesh));
+        }
+        meshGroups[i].count = meshes.size() - meshGroups[i].first;
+    }
+    if (tangentCache.modified() && !tangentCache.save(tangentCachePath)) {
+        std::cout << "GLTF Warning: couldn't write tangent cache " << tangentCachePath << std::endl;
+    }
+
+    // Node hierarchy of the default scene, breadth first so parents come before their children
+    nodes.clear();
+    int sceneIndex = gltfModel.defaultScene >= 0 ? gltfModel.defaultScene : 0;
+    if (sceneIndex < static_cast<int>(gltfModel.scenes.size())) {
+        std::vector<std::pair<int, int>> queue; // glTF node, parent in nodes
+        for (int root : gltfModel.scenes[sceneIndex].nodes) queue.push_back({root, -1});
+        for (size_t head = 0; head < queue.size(); ++head) {
+            auto [gltfIndex, parent] = queue[head];
+            if (gltfIndex < 0 || gltfIndex >= static_cast<int>(gltfModel.nodes.size())) continue;
+            const auto& gltfNode = gltfModel.nodes[gltfIndex];
+
+            ModelNode node;
+            node.parent = parent;
+            node.mesh = gltfNode.mesh;
+            if (gltfNode.matrix.size() == 16) {
+                mat4 m;
+                for (int c = 0; c < 4; ++c) {
+                    for (int r = 0; r < 4; ++r) m[c][r] = static_cast<float>(gltfNode.matrix[c * 4 + r]);
                 }
+                node.local = Transform::fromMat4(m);
             } else {
-                std::cerr << "Unsupported index component type in GLTF." << std::endl;
+                const auto& t = gltfNode.translation;
+                const auto& q = gltfNode.rotation;
+                const auto& s = gltfNode.scale;
+                if (t.size() == 3) node.local.position = vec3(t[0], t[1], t[2]);
+                if (q.size() == 4) node.local.rotation = quat(static_cast<float>(q[3]), static_cast<float>(q[0]), static_cast<float>(q[1]), static_cast<float>(q[2]));
+                if (s.size() == 3) node.local.scale = vec3(s[0], s[1], s[2]);
             }
+            int index = static_cast<int>(nodes.size());
+            nodes.push_back(node);
+            for (int child : gltfNode.children) queue.push_back({child, index});
         }
-        // Material index
-        mesh.materialIndex = prim.material;
-
-        // Create GPU buffers for this mesh
-        glGenVertexArrays(1, &mesh.vao);
-        glBindVertexArray(mesh.vao);
-
-        if (!mesh.positions.empty()) {
-            glGenBuffers(1, &mesh.vboPos);
-            glBindBuffer(GL_ARRAY_BUFFER, mesh.vboPos);
-            glBufferData(GL_ARRAY_BUFFER, mesh.positions.size() * sizeof(vec3), mesh.positions.data(), GL_STATIC_DRAW);
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
-        }
-        if (!mesh.normals.empty()) {
-            glGenBuffers(1, &mesh.vboNorm);
-            glBindBuffer(GL_ARRAY_BUFFER, mesh.vboNorm);
-            glBufferData(GL_ARRAY_BUFFER, mesh.normals.size() * sizeof(vec3), mesh.normals.data(), GL_STATIC_DRAW);
-            glEnableVertexAttribArray(1);
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
-        }
-        if (!mesh.tangents.empty()) {
-            glGenBuffers(1, &mesh.vboTan);
-            glBindBuffer(GL_ARRAY_BUFFER, mesh.vboTan);
-            glBufferData(GL_ARRAY_BUFFER, mesh.tangents.size() * sizeof(vec4), mesh.tangents.data(), GL_STATIC_DRAW);
-            glEnableVertexAttribArray(2);
-            glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), (void*)0);
-        }
-        if (!mesh.uvs.empty()) {
-            glGenBuffers(1, &mesh.vboUV);
-            glBindBuffer(GL_ARRAY_BUFFER, mesh.vboUV);
-            glBufferData(GL_ARRAY_BUFFER, mesh.uvs.size() * sizeof(vec2), mesh.uvs.data(), GL_STATIC_DRAW);
-            glEnableVertexAttribArray(3);
-            glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(vec2), (void*)0);
-        }
-        if (!mesh.indices.empty()) {
-            glGenBuffers(1, &mesh.ebo);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(), GL_STATIC_DRAW);
-            mesh.indexCount = static_cast<GLsizei>(mesh.indices.size());
-        }
-        glBindVertexArray(0);
     }
+    if (nodes.empty()) {
+        for (size_t i = 0; i < meshGroups.size(); ++i) {
+            ModelNode node;
+            node.mesh = static_cast<int>(i);
+            nodes.push_back(node);
+        }
+    }
+
+    pendingUpload = std::move(pending);
+    loadStats.decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decodeStart).count();
     return true;
 }
 
-void Model::draw(Shader& shader) {
-    for (const auto& mesh : meshes) {
-        // Bind material
-        if (mesh.materialIndex < materials.size()) {
-            const auto& mat = materials[mesh.materialIndex];
-            BIND_MATERIAL_PARAM(mat, albedo, Albedo, 1, shader, PBRE::vec3);
-            BIND_MATERIAL_PARAM(mat, metallic, Metallic, 2, shader, float);
-            BIND_MATERIAL_PARAM(mat, roughness, Roughness, 3, shader, float);
-            if (mat.normal) {
-                shader.set("u_HasNormalMap", 1);
-                shader.set("u_NormalMap", 4);
-                mat.normal->bind(4);
-            } else {
-                shader.set("u_HasNormalMap", 0);
-            }
-            BIND_MATERIAL_PARAM(mat, ao, AOMap, 5, shader, float);
-            BIND_MATERIAL_PARAM(mat, emissive, Emissive, 6, shader, PBRE::vec3);
-            shader.set("u_AlphaCutoff", mat.alphaCutoff);
-            shader.set("u_DoubleSided", mat.doubleSided);
+bool Model::upload() {
+    if (!pendingUpload) return false;
+    auto uploadStart = std::chrono::steady_clock::now();
+    auto& pending = *pendingUpload;
+    auto& gltfModel = pending.source.model;
+
+    // Decoded pixels are freed as soon as GL has its copy, instead of all staying alive until the end of the load
+    for (const auto& [texture, imgIndex] : pending.textures) {
+        auto& image = pending.images[imgIndex];
+        texture->setOwner(path);
+        bool ok = false;
+        if (image.pixels) {
+            ok = texture->loadFromPixels(image.width, image.height, image.channels, image.pixels.get());
+            image.pixels.reset();
+        } else {
+            // Packed images always have pixels, so this is a glTF one
+            auto& img = gltfModel.images[imgIndex];
+            ok = texture->loadFromImageData(img.width, img.height, img.component, img.image);
+            std::vector<unsigned char>().swap(img.image);
+        }
+        if (!ok) std::cerr << "Failed to upload image " << imgIndex << " of " << path << std::endl;
+    }
+    int refusedMeshes = 0;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        if (!uploadMesh(gltfModel, pending.source.buffers, *pending.primitives[i], pending.streams[i], meshes[i], path, loadStats)) ++refusedMeshes;
+        loadStats.retainedBytes += retainStreams(pending.streams[i], retainGeometry, meshes[i]);
+    }
+    if (refusedMeshes > 0) std::cerr << "GPU memory budget: " << refusedMeshes << " meshes of " << path << " won't be drawn" << std::endl;
+
+    LoadMode mode = pending.mode;
+    loadStats.scratchBytes = pending.arena->peakBytes();
+    releaseArena(std::move(pending.arena));
+    pendingUpload.reset();
+    loadStats.uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+    loadStats.loadMs = loadStats.decodeMs + loadStats.uploadMs;
+    std::cout << "Loaded " << path << (mode == LoadMode::Mapped ? " (mapped)" : " (copied)") << " in " << loadStats.loadMs << " ms (decode "
+              << loadStats.decodeMs << ", upload " << loadStats.uploadMs << "), vertex data " << loadStats.vertexBytes / 1024 << " KiB ("
+              << loadStats.floatVertexBytes / 1024 << " KiB as floats), scratch " << loadStats.scratchBytes / 1024 << " KiB, kept "
+              << loadStats.retainedBytes / 1024 << " KiB of CPU geometry";
+    if (loadStats.tangentsGenerated + loadStats.tangentsCached > 0) {
+        std::cout << ", tangents " << loadStats.tangentsGenerated << " generated " << loadStats.tangentsCached << " cached in " << loadStats.tangentMs << " ms";
+    }
+    if (loadStats.unpackedTextureBytes > 0) {
+        std::cout << ", textures " << loadStats.textureBytes / 1024 << " KiB (" << loadStats.unpackedTextureBytes / 1024 << " KiB unpacked, "
+                  << loadStats.ormTextures << " ORM packed)";
+    }
+    if (loadStats.meshopt.views > 0) {
+        const auto& m = loadStats.meshopt;
+        std::cout << ", meshopt " << m.views << " views " << m.compressedBytes / 1024 << " -> " << m.decodedBytes / 1024 << " KiB in "
+                  << m.decodeMs << " ms (" << m.megabytesPerSecond() << " MB/s)";
+    }
+    std::cout << std::endl;
+    return true;
+}
+
+bool Model::keepDecoded() {
+    if (!pendingUpload) return false;
+    auto& pending = *pendingUpload;
+    for (size_t i = 0; i < meshes.size(); ++i) loadStats.retainedBytes += retainStreams(pending.streams[i], retainGeometry, meshes[i]);
+    loadStats.loadMs = loadStats.decodeMs;
+    loadStats.scratchBytes = pending.arena->peakBytes();
+    releaseArena(std::move(pending.arena));
+    pendingUpload.reset(); // the textures keep their CPU pixels when retainGeometry is All
+    return true;
+}
+
+bool Model::create(const std::string& name, std::span<const vec3> positions, std::span<const vec3> normals, std::span<const uint32_t> indices,
+                   std::vector<Render::Material> variants) {
+    if (positions.empty() || indices.empty()) return false;
+    auto start = std::chrono::steady_clock::now();
+    path = name;
+    loadStats = {};
+    materials = std::move(variants);
+    if (materials.empty()) materials.emplace_back();
+
+    // uploadMesh() takes spans of mutable streams, and finds no glTF accessors to upload from instead
+    std::vector<vec3> positionCopy(positions.begin(), positions.end());
+    std::vector<vec3> normalCopy(normals.begin(), normals.end());
+    std::vector<uint32_t> indexCopy(indices.begin(), indices.end());
+    if (normalCopy.size() != positionCopy.size()) normalCopy.clear();
+    MeshStreams streams{positionCopy, normalCopy, {}, {}, indexCopy};
+    Mesh mesh;
+    mesh.boundsMin = mesh.boundsMax = positions[0];
+    for (const auto& p : positions) {
+        mesh.boundsMin = glm::min(mesh.boundsMin, p);
+        mesh.boundsMax = glm::max(mesh.boundsMax, p);
+    }
+    tinygltf::Model none;
+    tinygltf::Primitive prim;
+    bool ok = uploadMesh(none, {}, prim, streams, mesh, path, loadStats);
+    loadStats.retainedBytes = retainStreams(streams, retainGeometry, mesh);
+
+    meshes.assign(materials.size(), mesh);
+    meshGroups.resize(materials.size());
+    for (size_t i = 0; i < materials.size(); ++i) {
+        meshes[i].materialIndex = i;
+        meshGroups[i] = {i, 1};
+    }
+    nodes.assign(1, ModelNode{-1, 0, Transform()});
+    loadStats.uploadMs = loadStats.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return ok;
+}
+
+PBRE::Render::MaterialData Model::materialData(size_t materialIndex) const {
+    Render::MaterialData data;
+    if (materialIndex >= materials.size()) return data;
+    const auto& mat = materials[materialIndex];
+    // Each parameter is either a constant or a texture
+    auto resolve = [](const auto& param, auto& constant, int& hasMap) {
+        using T = std::remove_reference_t<decltype(constant)>;
+        if (auto value = std::get_if<T>(&param)) {
+            constant = *value;
+        } else {
+            hasMap = std::get<std::shared_ptr<Texture>>(param) ? 1 : 0;
+        }
+    };
+    resolve(mat.albedo, data.albedo, data.hasAlbedoMap);
+    resolve(mat.metallic, data.metallic, data.hasMetallicMap);
+    resolve(mat.roughness, data.roughness, data.hasRoughnessMap);
+    resolve(mat.ao, data.ao, data.hasAOMap);
+    resolve(mat.emissive, data.emissive, data.hasEmissiveMap);
+    // The shaders scale the packed channels by the factors
+    if (data.hasMetallicMap) data.metallic = mat.metallicFactor;
+    if (data.hasRoughnessMap) data.roughness = mat.roughnessFactor;
+    if (data.hasAOMap) data.ao = mat.aoStrength;
+    data.hasNormalMap = mat.normal ? 1 : 0;
+    data.metallicChannel = mat.metallicChannel;
+    data.roughnessChannel = mat.roughnessChannel;
+    data.aoChannel = mat.aoChannel;
+    data.alphaCutoff = mat.alphaCutoff;
+    data.doubleSided = mat.doubleSided ? 1 : 0;
+    return data;
+}
+
+int Model::bindMaterial(size_t materialIndex) const {
+    if (materialIndex >= materials.size()) return 0;
+    const auto& mat = materials[materialIndex];
+    int bound = 0;
+    auto bind = [&bound](const auto& param, unsigned int unit) {
+        if (auto tex = std::get_if<std::shared_ptr<Texture>>(&param); tex && *tex) {
+            (*tex)->bind(unit);
+            ++bound;
         }
+    };
+    bind(mat.albedo, 1);
+    // Metallic, roughness and AO read one packed texture
+    if (auto orm = mat.ormTexture()) {
+        orm->bind(2);
+        ++bound;
+    }
+    if (mat.normal) {
+        mat.normal->bind(4);
+        ++bound;
+    }
+    bind(mat.emissive, 6);
+    return bound;
+}
 
-        // Draw mesh using VAO
-        glBindVertexArray(mesh.vao);
-        glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+bool Model::isAlphaTested(const Mesh& mesh) const {
+    return mesh.materialIndex < materials.size() && materials[mesh.materialIndex].alphaMode == Render::AlphaMode::Mask;
+}
+
+static bool passesFilter(bool alphaTested, DrawFilter filter) {
+    return filter == DrawFilter::All || (filter == DrawFilter::AlphaTested) == alphaTested;
+}
+
+int Model::drawMeshDepth(const Mesh& mesh, DrawFilter filter) const {
+    bool alphaTested = isAlphaTested(mesh);
+    if (!passesFilter(alphaTested, filter)) return 0;
+    int bound = 0;
+    if (alphaTested) {
+        // Needs the UVs and the albedo alpha for the cutoff
+        bound = bindMaterial(mesh.materialIndex);
+        GlState::instance().bindVertexArray(mesh.vao);
+    } else {
+        GlState::instance().bindVertexArray(mesh.depthVao);
     }
-}
\ No newline at end of file
+    glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+    return bound;
+}
+
+int Model::drawMesh(const Mesh& mesh, DrawFilter filter) const {
+    if (!passesFilter(isAlphaTested(mesh), filter)) return 0;
+
+    // Bind material textures
+    int bound = bindMaterial(mesh.materialIndex);
+
+    // Draw mesh using VAO, left bound: every VAO setup binds its own first
+    GlState::instance().bindVertexArray(mesh.vao);
+    glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+    return bound;
+}
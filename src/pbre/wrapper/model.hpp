@@ -5,13 +5,27 @@
 #include "texture.hpp"
 #include "shader.hpp"
 #include "buffers.hpp"
+#include "pbre/core/meshopt.hpp"
 #include "pbre/render/material.hpp"
+#include "pbre/render/shader_data.hpp"
 
+#include <memory>
+#include <span>
 #include <vector>
 #include <glad/glad.h>
 
 namespace PBRE::Wrapper {
+// Layout of a vertex stream in its GL buffer, quantized streams keep their glTF component type
+struct VertexFormat {
+    GLenum type = GL_FLOAT;
+    GLint components = 3;
+    GLboolean normalized = GL_FALSE;
+    GLsizei stride = 0;
+    size_t offset = 0; // bytes from the start of the buffer to the first element
+};
+
 struct Mesh {
+    // CPU copies of the streams, what Model::retainGeometry keeps of them after the upload
     std::vector<vec3> positions;
     std::vector<vec3> normals;
     std::vector<vec4> tangents;
@@ -20,8 +34,18 @@ struct Mesh {
 
     size_t materialIndex = 0;
 
+    // Object space bounds of the positions
+    vec3 boundsMin = vec3(0.0f);
+    vec3 boundsMax = vec3(0.0f);
+
     // GPU objects
     GLuint vao = 0;
+    GLuint depthVao = 0; // positions only, for depth pre-passes
+    VertexFormat positionFormat;
+    VertexFormat normalFormat;
+    VertexFormat tangentFormat;
+    VertexFormat uvFormat;
+    // Streams interleaved in one glTF buffer view share a buffer, their formats' offsets tell them apart
     GLuint vboPos = 0;
     GLuint vboNorm = 0;
     GLuint vboTan = 0;
@@ -30,12 +54,93 @@ struct Mesh {
     GLsizei indexCount = 0;
 };
 
+// Selects meshes by whether their material needs the alpha test, so opaque and alpha tested
+// meshes can be drawn with separate shader variants
+enum class DrawFilter {
+    All,
+    Opaque,
+    AlphaTested,
+};
+
+// glTF node of the default scene
+struct ModelNode {
+    int parent = -1; // index into Model::nodes
+    int mesh = -1;   // index into Model::meshGroups
+    Transform local;
+};
+
+// The primitives of one glTF mesh, a range of Model::meshes
+struct MeshGroup {
+    size_t first = 0;
+    size_t count = 0;
+};
+
+enum class LoadMode {
+    Mapped, // map the files, geometry and images are read straight from the mapping
+    Copy,   // let tinygltf read everything into owned vectors, kept for comparison
+};
+
+// CPU side geometry a Model keeps once its vertex streams are on the GPU
+enum class GeometryRetention {
+    None,      // only the bounds
+    Positions, // positions and indices, for picking and CPU culling
+    All,       // every stream and the material textures' pixels, for the CPU path tracer
+};
+
+struct ModelLoadStats {
+    double loadMs = 0.0;   // decodeMs + uploadMs
+    double decodeMs = 0.0; // parsing and CPU decoding, may run on a worker thread
+    double uploadMs = 0.0; // GL objects, on the GL thread
+    Core::MeshoptStats meshopt;
+    size_t vertexBytes = 0;      // uploaded to vertex buffers
+    size_t floatVertexBytes = 0; // what the same streams take widened to floats
+    int tangentsGenerated = 0;    // primitives
+    int tangentsCached = 0;
+    double tangentMs = 0.0;
+    size_t scratchBytes = 0;  // peak of the load arena
+    size_t retainedBytes = 0; // CPU geometry kept after the upload
+    size_t textureBytes = 0;         // material textures as uploaded, with mips
+    size_t unpackedTextureBytes = 0; // every image the materials use as decoded, what the load took before ORM packing
+    int ormTextures = 0;             // packed occlusion-roughness-metallic textures
+};
+
+// What Model::decode() leaves for Model::upload()
+struct ModelUpload;
+
 struct Model {
-    std::vector<Mesh> meshes;
+    std::vector<Mesh> meshes; // one per triangle primitive
+    std::vector<MeshGroup> meshGroups;
     std::vector<PBRE::Render::Material> materials;
+    // Node hierarchy, parents before children. A file without nodes gets one root node per glTF mesh.
+    std::vector<ModelNode> nodes;
     std::string path;
+    ModelLoadStats loadStats;
+    GeometryRetention retainGeometry = GeometryRetention::Positions; // read by decode() and upload()
+    std::shared_ptr<ModelUpload> pendingUpload; // between decode() and upload()
 
-    bool loadFromFile(const std::string& filename);
-    void draw(Shader& shader);
+    // decode() followed by upload()
+    bool loadFromFile(const std::string& filename, LoadMode mode = LoadMode::Mapped);
+    // CPU half of a load: parses the file, decodes the images, vertex streams and tangents and builds the
+    // materials and nodes. Makes no GL calls, so several models can decode on worker threads at once.
+    bool decode(const std::string& filename, LoadMode mode = LoadMode::Mapped);
+    // GL half: fills the textures and creates the vertex buffers decode() prepared. GL thread only.
+    bool upload();
+    // Instead of upload(), for CPU only consumers such as the path tracer: keeps what retainGeometry asks for
+    // and drops the rest of the decode. Makes no GL calls; the meshes have no GL objects and can't be drawn.
+    bool keepDecoded();
+    // A model from CPU streams instead of a file, with one mesh per material all drawing the same buffers.
+    // Each mesh is its own mesh group; the single node shows the first. GL thread only.
+    bool create(const std::string& name, std::span<const vec3> positions, std::span<const vec3> normals, std::span<const uint32_t> indices,
+                std::vector<Render::Material> variants);
+    // The mesh's DrawData (transform and materialData()) must already be bound. Both draws return how many
+    // textures they bound.
+    int drawMesh(const Mesh& mesh, DrawFilter filter = DrawFilter::All) const;
+    // Depth only: opaque meshes use the position only stream, alpha tested ones bind their material
+    int drawMeshDepth(const Mesh& mesh, DrawFilter filter = DrawFilter::All) const;
+    bool isAlphaTested(const Mesh& mesh) const;
+    // Material constants and texture flags for the DrawData block
+    Render::MaterialData materialData(size_t materialIndex) const;
+    // Bind the material's textures to the units the shaders' samplers are fixed to (1-6), returns the count
+    int bindMaterial(size_t materialIndex) const;
 };
 } // namespace PBRE::Wrapper
\ No newline at end of file
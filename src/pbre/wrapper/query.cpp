@@ -0,0 +1,39 @@
+#include "query.hpp"
+
+using namespace PBRE::Wrapper;
+
+GpuTimer::GpuTimer() {
+    glGenQueries(kQueryCount, queries_);
+}
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(kQueryCount, queries_);
+}
+
+void GpuTimer::begin() {
+    collect(false);
+    // Every query is still in flight, so block on the oldest rather than overwrite it
+    if (pending_ == kQueryCount) collect(true);
+    glBeginQuery(GL_TIME_ELAPSED, queries_[head_]);
+}
+
+void GpuTimer::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+    head_ = (head_ + 1) % kQueryCount;
+    ++pending_;
+}
+
+void GpuTimer::collect(bool wait) {
+    while (pending_ > 0) {
+        GLuint query = queries_[(head_ - pending_ + kQueryCount) % kQueryCount];
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) return;
+        }
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        lastMs_ = static_cast<double>(ns) / 1.0e6;
+        --pending_;
+        wait = false;
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glad/glad.h>
+
+namespace PBRE::Wrapper {
+// GPU timer built on GL_TIME_ELAPSED queries. Results are read back a few frames late so
+// measuring never stalls the pipeline. Only one timer may be active (between begin/end) at a time.
+class GpuTimer {
+  public:
+    GpuTimer();
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void begin();
+    void end();
+
+    // Most recent completed measurement in milliseconds
+    double lastMs() const { return lastMs_; }
+
+  private:
+    void collect(bool wait);
+
+    static constexpr int kQueryCount = 4;
+    GLuint queries_[kQueryCount] = {};
+    int head_ = 0;    // next query to issue
+    int pending_ = 0; // issued but not yet read back
+    double lastMs_ = 0.0;
+};
+} // namespace PBRE::Wrapper
@@ -0,0 +1,119 @@
+#include "ring_buffer.hpp"
+
+#include "gpu_memory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+using namespace PBRE::Wrapper;
+
+RingBuffer::RingBuffer(size_t regionBytes) {
+    // Both are powers of two, the larger is a multiple of the smaller
+    GLint alignment = 0, storageAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    alignment = std::max(alignment, storageAlignment);
+    if (alignment > 0) alignment_ = static_cast<size_t>(alignment);
+    create(regionBytes);
+}
+RingBuffer::~RingBuffer() {
+    destroy();
+}
+
+void RingBuffer::create(size_t regionBytes) {
+    regionBytes_ = alignedSize(std::max(regionBytes, alignment_));
+    GLsizeiptr total = static_cast<GLsizeiptr>(regionBytes_ * kRegionCount);
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &buffer_);
+    if (!GpuMemory::instance().track({.objectType = GL_BUFFER, .name = buffer_, .category = GpuCategory::UniformBuffer, .bytes = static_cast<size_t>(total), .owner = "RingBuffer", .site = std::source_location::current()})) {
+        glDeleteBuffers(1, &buffer_);
+        buffer_ = 0;
+        throw std::runtime_error("GPU memory budget refused the ring buffer");
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferStorage(GL_UNIFORM_BUFFER, total, nullptr, flags);
+    mapped_ = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, total, flags));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    if (!mapped_) throw std::runtime_error("Failed to map the ring buffer");
+}
+
+void RingBuffer::destroy() {
+    for (int r = 0; r < kRegionCount; ++r) waitRegion(r);
+    if (buffer_) {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        GpuMemory::instance().release(GL_BUFFER, buffer_);
+        glDeleteBuffers(1, &buffer_);
+    }
+    buffer_ = 0;
+    mapped_ = nullptr;
+}
+
+bool RingBuffer::waitRegion(int region) {
+    GLsync& fence = fences_[region];
+    if (!fence) return false;
+    bool waited = false;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        waited = true;
+        // Flush so the fence is sure to be submitted, then block a second at a time
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        do {
+            status = glClientWaitSync(fence, flags, 1000000000);
+            flags = 0;
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+    return waited;
+}
+
+void RingBuffer::beginFrame(size_t minimumBytes) {
+    if (inFrame_) throw std::runtime_error("RingBuffer::beginFrame called twice without endFrame");
+    if (minimumBytes > regionBytes_) {
+        // Every region may still be read, destroy() waits for all of them
+        destroy();
+        create(std::max(minimumBytes, regionBytes_ * 2));
+        ++stats_.reallocations;
+    }
+    region_ = (region_ + 1) % kRegionCount;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (waitRegion(region_)) {
+        ++stats_.stalls;
+        stats_.stallMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    head_ = 0;
+    inFrame_ = true;
+}
+
+RingBuffer::Allocation RingBuffer::allocate(size_t bytes) {
+    if (!inFrame_) throw std::runtime_error("RingBuffer::allocate called outside a frame");
+    size_t size = alignedSize(bytes);
+    if (head_ + size > regionBytes_) {
+        throw std::runtime_error("Ring buffer region of " + std::to_string(regionBytes_) + " bytes is exhausted");
+    }
+    size_t offset = regionBytes_ * region_ + head_;
+    head_ += size;
+    return {mapped_ + offset, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes)};
+}
+
+void RingBuffer::bindUniform(GLuint binding, const Allocation& allocation) const {
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer_, allocation.offset, allocation.size);
+}
+
+void RingBuffer::bindStorage(GLuint binding, const Allocation& allocation) const {
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer_, allocation.offset, allocation.size);
+}
+
+void RingBuffer::endFrame() {
+    if (!inFrame_) return;
+    // Coherent mapping: the writes are visible to commands issued after them, the fence covers the reads
+    fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    inFrame_ = false;
+    stats_.frameBytes = head_;
+    stats_.peakFrameBytes = std::max(stats_.peakFrameBytes, head_);
+    ++stats_.frames;
+}
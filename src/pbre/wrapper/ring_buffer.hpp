@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstring>
+
+namespace PBRE::Wrapper {
+struct RingStats {
+    size_t frameBytes = 0;     // written during the last finished frame
+    size_t peakFrameBytes = 0;
+    int frames = 0;
+    int stalls = 0;            // frames that had to wait for the GPU to release their region
+    double stallMs = 0.0;      // summed over every stall
+    int reallocations = 0;     // region grown to fit a frame
+};
+
+// Streams dynamic GPU data (per frame constants, per draw transforms and materials) through one
+// persistently and coherently mapped buffer split into kRegionCount per frame regions. Each frame
+// writes linearly into its own region and binds the pieces by offset; the fence placed by endFrame()
+// stops the CPU from overwriting a region before the GPU has finished the frame that read it.
+class RingBuffer {
+  public:
+    static constexpr int kRegionCount = 3;
+
+    struct Allocation {
+        void* data = nullptr;
+        GLintptr offset = 0; // from the start of buffer()
+        GLsizeiptr size = 0;
+    };
+
+    explicit RingBuffer(size_t regionBytes = size_t(1) << 20);
+    ~RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Waits for the GPU to release the next region. A region smaller than minimumBytes is reallocated
+    // first, which waits for every region.
+    void beginFrame(size_t minimumBytes = 0);
+    // Aligned for uniform and shader storage binding, throws when the frame's region is exhausted
+    Allocation allocate(size_t bytes);
+    template <typename T>
+    Allocation write(const T& value) {
+        Allocation allocation = allocate(sizeof(T));
+        std::memcpy(allocation.data, &value, sizeof(T));
+        return allocation;
+    }
+    void bindUniform(GLuint binding, const Allocation& allocation) const;
+    void bindStorage(GLuint binding, const Allocation& allocation) const;
+    void endFrame();
+
+    // Bytes an allocation of the given size takes from the region
+    size_t alignedSize(size_t bytes) const { return (bytes + alignment_ - 1) / alignment_ * alignment_; }
+    size_t regionBytes() const { return regionBytes_; }
+    GLuint buffer() const { return buffer_; }
+    const RingStats& stats() const { return stats_; }
+
+  private:
+    void create(size_t regionBytes);
+    void destroy();
+    // Returns true if it had to wait
+    bool waitRegion(int region);
+
+    GLuint buffer_ = 0;
+    unsigned char* mapped_ = nullptr;
+    size_t regionBytes_ = 0;
+    size_t alignment_ = 256;
+    GLsync fences_[kRegionCount] = {};
+    int region_ = 0;
+    size_t head_ = 0; // bytes used in the current region
+    bool inFrame_ = false;
+    RingStats stats_;
+};
+} // namespace PBRE::Wrapper
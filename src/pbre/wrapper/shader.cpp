@@ -1,29 +1,73 @@
 #include "shader.hpp"
 
+#include "gl_state.hpp"
+
 #include <fstream>
+#include <sstream>
+#include <unordered_set>
 
 using namespace PBRE::Wrapper;
 
+// Reads a shader source file, expanding `#include "file"` directives relative to the including file.
+// Each file is only pasted once so shared headers can be included from several places.
+static std::string loadSource(const std::filesystem::path& path, std::unordered_set<std::string>& included) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open shader file: " + path.string());
+    }
+    included.insert(std::filesystem::weakly_canonical(path).string());
+
+    std::stringstream out;
+    std::string line;
+    while (std::getline(file, line)) {
+        auto first = line.find_first_not_of(" \t");
+        if (first != std::string::npos && line.compare(first, 8, "#include") == 0) {
+            auto open = line.find('"', first);
+            auto close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos) {
+                throw std::runtime_error("Malformed #include in " + path.string() + ": " + line);
+            }
+            auto includePath = path.parent_path() / line.substr(open + 1, close - open - 1);
+            if (!included.contains(std::filesystem::weakly_canonical(includePath).string())) {
+                out << loadSource(includePath, included);
+            }
+            continue;
+        }
+        out << line << '\n';
+    }
+    return out.str();
+}
+
+static void injectDefines(std::string& source, const std::vector<std::string>& defines) {
+    if (defines.empty()) return;
+    std::string block;
+    for (const auto& define : defines) {
+        block += "#define " + define + "\n";
+    }
+    // #version has to stay the first statement
+    size_t pos = 0;
+    if (source.compare(0, 8, "#version") == 0) {
+        pos = source.find('\n');
+        pos = (pos == std::string::npos) ? source.size() : pos + 1;
+    }
+    source.insert(pos, block);
+}
+
 Shader::Shader() {}
 Shader::~Shader() {
     if (program_ != 0) {
+        GlState::instance().forgetProgram(program_);
         glDeleteProgram(program_);
     }
 }
 
-void Shader::loadFromFiles(const std::filesystem::path& vertexPath, const std::filesystem::path& fragmentPath) {
-    std::ifstream vertexFile(vertexPath);
-    std::ifstream fragmentFile(fragmentPath);
-
-    if (!vertexFile.is_open()) {
-        throw std::runtime_error("Failed to open vertex shader file: " + vertexPath.string());
-    }
-    if (!fragmentFile.is_open()) {
-        throw std::runtime_error("Failed to open fragment shader file: " + fragmentPath.string());
-    }
-
-    std::string vertexCode((std::istreambuf_iterator<char>(vertexFile)), std::istreambuf_iterator<char>());
-    std::string fragmentCode((std::istreambuf_iterator<char>(fragmentFile)), std::istreambuf_iterator<char>());
+void Shader::loadFromFiles(const std::filesystem::path& vertexPath, const std::filesystem::path& fragmentPath,
+                           const std::vector<std::string>& defines) {
+    std::unordered_set<std::string> vertexIncluded, fragmentIncluded;
+    std::string vertexCode = loadSource(vertexPath, vertexIncluded);
+    std::string fragmentCode = loadSource(fragmentPath, fragmentIncluded);
+    injectDefines(vertexCode, defines);
+    injectDefines(fragmentCode, defines);
 
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -68,8 +112,37 @@ void Shader::loadFromFiles(const std::filesystem::path& vertexPath, const std::f
     glDeleteShader(fragment);
 }
 
+void Shader::loadComputeFromFile(const std::filesystem::path& computePath, const std::vector<std::string>& defines) {
+    std::unordered_set<std::string> included;
+    std::string computeCode = loadSource(computePath, included);
+    injectDefines(computeCode, defines);
+    const char* cShaderCode = computeCode.c_str();
+
+    GLint success;
+    GLchar infoLog[512];
+
+    GLuint compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &cShaderCode, nullptr);
+    glCompileShader(compute);
+    glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(compute, 512, nullptr, infoLog);
+        throw std::runtime_error("Compute shader compilation failed: " + std::string(infoLog));
+    }
+
+    program_ = glCreateProgram();
+    glAttachShader(program_, compute);
+    glLinkProgram(program_);
+    glGetProgramiv(program_, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program_, 512, nullptr, infoLog);
+        throw std::runtime_error("Compute program linking failed: " + std::string(infoLog));
+    }
+    glDeleteShader(compute);
+}
+
 void Shader::use() const {
-    glUseProgram(program_);
+    GlState::instance().useProgram(program_);
 }
 
 void Shader::set(std::string_view name, int value) const {
@@ -78,12 +151,24 @@ void Shader::set(std::string_view name, int value) const {
 void Shader::set(std::string_view name, float value) const {
     glUniform1f(glGetUniformLocation(program_, name.data()), value);
 }
+void Shader::set(std::string_view name, const vec2& value) const {
+    glUniform2fv(glGetUniformLocation(program_, name.data()), 1, &value[0]);
+}
+void Shader::set(std::string_view name, const ivec2& value) const {
+    glUniform2iv(glGetUniformLocation(program_, name.data()), 1, &value[0]);
+}
 void Shader::set(std::string_view name, const vec3& value) const {
     glUniform3fv(glGetUniformLocation(program_, name.data()), 1, &value[0]);
 }
 void Shader::set(std::string_view name, const vec4& value) const {
     glUniform4fv(glGetUniformLocation(program_, name.data()), 1, &value[0]);
 }
+void Shader::set(std::string_view name, const ivec4& value) const {
+    glUniform4iv(glGetUniformLocation(program_, name.data()), 1, &value[0]);
+}
+void Shader::set(std::string_view name, const mat3& value) const {
+    glUniformMatrix3fv(glGetUniformLocation(program_, name.data()), 1, GL_FALSE, &value[0][0]);
+}
 void Shader::set(std::string_view name, const mat4& value) const {
     glUniformMatrix4fv(glGetUniformLocation(program_, name.data()), 1, GL_FALSE, &value[0][0]);
 }
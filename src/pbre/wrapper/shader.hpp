@@ -6,6 +6,8 @@
 #include <glad/glad.h>
 
 #include <filesystem>
+#include <string>
+#include <vector>
 
 namespace PBRE::Wrapper {
 class Shader {
@@ -13,15 +15,22 @@ class Shader {
     Shader();
     ~Shader();
 
-    void loadFromFiles(const std::filesystem::path& vertexPath, const std::filesystem::path& fragmentPath);
+    // defines are injected as `#define NAME` lines right after the #version directive
+    void loadFromFiles(const std::filesystem::path& vertexPath, const std::filesystem::path& fragmentPath,
+                       const std::vector<std::string>& defines = {});
+    void loadComputeFromFile(const std::filesystem::path& computePath, const std::vector<std::string>& defines = {});
 
     void use() const;
     GLuint getProgram() const { return program_; }
 
     void set(std::string_view name, int value) const;
     void set(std::string_view name, float value) const;
+    void set(std::string_view name, const vec2& value) const;
+    void set(std::string_view name, const ivec2& value) const;
     void set(std::string_view name, const vec3& value) const;
     void set(std::string_view name, const vec4& value) const;
+    void set(std::string_view name, const ivec4& value) const;
+    void set(std::string_view name, const mat3& value) const;
     void set(std::string_view name, const mat4& value) const;
 
   private:
@@ -5,6 +5,14 @@
 #include <stb_image.h>
 #include <stb_image_write.h>
 
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
+#include "pbre/core/hdr_compress.hpp"
+#include "pbre/core/hdr_decode.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -13,37 +21,83 @@
 
 using namespace PBRE::Wrapper;
 
-Texture::Texture() {
-    glGenTextures(1, &id_);
-}
 Texture::~Texture() {
     if (id_ != 0) {
+        GpuMemory::instance().release(GL_TEXTURE, id_);
+        GlState::instance().forgetTexture(id_);
         glDeleteTextures(1, &id_);
     }
 }
 
-void Texture::loadFromFile(const char* path, bool equirectangular) {
+void Texture::create() {
+    if (id_ == 0) glGenTextures(1, &id_);
+}
+
+// Every load builds the full mip chain
+bool Texture::track(GLenum format, int width, int height, int layers, std::source_location site) {
+    int levels = GpuMemory::mipLevels(width, height);
+    return GpuMemory::instance().track({.objectType = GL_TEXTURE,
+                                        .name = id_,
+                                        .category = GpuCategory::Texture,
+                                        .format = format,
+                                        .width = width,
+                                        .height = height,
+                                        .layers = layers,
+                                        .levels = levels,
+                                        .bytes = GpuMemory::imageBytes(format, width, height, layers, levels),
+                                        .owner = owner_.empty() ? "Texture" : owner_,
+                                        .site = site});
+}
+
+void Texture::loadFromFile(const char* path, bool equirectangular, std::source_location site) {
+    auto& state = GlState::instance();
+    create();
+    if (owner_.empty()) owner_ = path;
     target_ = GL_TEXTURE_2D;
     stbi_set_flip_vertically_on_load(true);
 
     int width, height, channels;
-    if (equirectangular) {
+    PBRE::Core::HdrDecoder decoder;
+    if (equirectangular && decoder.open(path)) {
+        // Straight to half floats, bottom row first like the flipped stb load
+        width = decoder.width();
+        height = decoder.height();
+        std::vector<uint16_t> texels(static_cast<size_t>(width) * height * 3);
+        size_t rowValues = static_cast<size_t>(width) * 3;
+        decoder.decodeRows(0, height, texels.data());
+        decoder.close();
+        for (int row = 0; row < height / 2; ++row) {
+            auto top = texels.begin() + row * rowValues;
+            std::swap_ranges(top, top + rowValues, texels.begin() + (height - 1 - row) * rowValues);
+        }
+        if (!track(GL_RGB16F, width, height, 1, site)) {
+            throw std::runtime_error(std::string("GPU memory budget refused texture: ") + path);
+        }
+        state.bindTextureForUpdate(GL_TEXTURE_2D, id_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_HALF_FLOAT, texels.data());
+        width_ = width; height_ = height;
+        format_ = GL_RGB16F;
+    } else if (equirectangular) {
         float* data = stbi_loadf(path, &width, &height, &channels, 0);
         if (!data) {
             throw std::runtime_error(std::string("Failed to load texture: ") + stbi_failure_reason());
         }
-        glBindTexture(GL_TEXTURE_2D, id_);
         GLenum format = (channels == 3) ? GL_RGB : GL_RGBA;
         GLenum internalFormat = (channels == 3) ? GL_RGB16F : GL_RGBA16F;
+        if (!track(internalFormat, width, height, 1, site)) {
+            stbi_image_free(data);
+            throw std::runtime_error(std::string("GPU memory budget refused texture: ") + path);
+        }
+        state.bindTextureForUpdate(GL_TEXTURE_2D, id_);
         glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, data);
         stbi_image_free(data);
         width_ = width; height_ = height;
+        format_ = internalFormat;
     } else {
         unsigned char* data = stbi_load(path, &width, &height, &channels, 0);
         if (!data) {
             throw std::runtime_error(std::string("Failed to load texture: ") + stbi_failure_reason());
         }
-        glBindTexture(GL_TEXTURE_2D, id_);
         GLenum format = GL_RGB;
         if (channels == 1)
             format = GL_RED;
@@ -51,9 +105,15 @@ void Texture::loadFromFile(const char* path, bool equirectangular) {
             format = GL_RGB;
         else if (channels == 4)
             format = GL_RGBA;
+        if (!track(format, width, height, 1, site)) {
+            stbi_image_free(data);
+            throw std::runtime_error(std::string("GPU memory budget refused texture: ") + path);
+        }
+        state.bindTextureForUpdate(GL_TEXTURE_2D, id_);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         stbi_image_free(data);
         width_ = width; height_ = height;
+        format_ = format;
     }
 
     if (equirectangular) {
@@ -72,21 +132,35 @@ void Texture::loadFromFile(const char* path, bool equirectangular) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
-bool Texture::loadFromImageData(int width, int height, int channels, const std::vector<unsigned char>& data) {
-    if (data.empty() || width <= 0 || height <= 0 || (channels != 1 && channels != 3 && channels != 4)) {
+GLenum Texture::pixelFormat(int channels) {
+    switch (channels) {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+bool Texture::loadFromImageData(int width, int height, int channels, const std::vector<unsigned char>& data, std::source_location site) {
+    if (data.size() < static_cast<size_t>(width) * height * channels) return false;
+    return loadFromPixels(width, height, channels, data.data(), site);
+}
+
+bool Texture::loadFromPixels(int width, int height, int channels, const unsigned char* pixels, std::source_location site) {
+    if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4) {
         return false;
     }
+    create();
     target_ = GL_TEXTURE_2D;
-    glBindTexture(GL_TEXTURE_2D, id_);
-    GLenum format = GL_RGB;
-    if (channels == 1)
-        format = GL_RED;
-    else if (channels == 3)
-        format = GL_RGB;
-    else if (channels == 4)
-        format = GL_RGBA;
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data.data());
+    GLenum format = pixelFormat(channels);
+    if (!track(format, width, height, 1, site)) return false;
+    GlState::instance().bindTextureForUpdate(GL_TEXTURE_2D, id_);
+    // Rows of 1 to 3 channels needn't be 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     width_ = width; height_ = height;
+    format_ = format;
 
     glGenerateMipmap(GL_TEXTURE_2D);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -97,8 +171,7 @@ bool Texture::loadFromImageData(int width, int height, int channels, const std::
 }
 
 void Texture::bind(unsigned int unit) const {
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(target_, id_);
+    GlState::instance().bindTexture(unit, target_, id_);
 }
 
 GLuint Texture::getID() const {
@@ -118,100 +191,96 @@ float Texture::getMaxMips() const {
     return float(levels - 1);
 }
 
-// Helpers to convert direction vector to equirectangular UV
-static inline void dirToEquirectUV(const float dir[3], float& u, float& v) {
-    float phi = atan2f(dir[2], dir[0]); // z,x
-    float theta = asinf(fmaxf(-1.0f, fminf(1.0f, dir[1])));
-    u = phi / (2.0f * 3.14159265359f) + 0.5f;
-    // top-origin v: +Y (theta=+pi/2) -> v=0, -Y (theta=-pi/2) -> v=1
-    v = 0.5f - theta / 3.14159265359f;
-}
-
-static inline void faceDir(int face, float x, float y, float out[3]) {
-    // x,y in [-1,1], OpenGL cubemap face dirs
-    switch (face) {
-    case 0: out[0] =  1.0f; out[1] =     y; out[2] =    -x; break; // +X
-    case 1: out[0] = -1.0f; out[1] =     y; out[2] =     x; break; // -X
-    case 2: out[0] =     x; out[1] =  1.0f; out[2] =    -y; break; // +Y (z neg)
-    case 3: out[0] =     x; out[1] = -1.0f; out[2] =     y; break; // -Y (z pos)
-    case 4: out[0] =     x; out[1] =     y; out[2] =  1.0f; break; // +Z
-    case 5: out[0] =    -x; out[1] =     y; out[2] = -1.0f; break; // -Z
-    }
-    // normalize
-    float len = sqrtf(out[0]*out[0] + out[1]*out[1] + out[2]*out[2]);
-    out[0] /= len; out[1] /= len; out[2] /= len;
-}
+// Equirect HDR resampled to 6 faces of RGB floats. Radiance files stream through the mapped decoder a band of
+// rows at a time, anything else stb reads whole.
+static std::vector<float> equirectToFaces(const char* path, int faceSize) {
+    PBRE::Core::HdrDecoder decoder;
+    if (decoder.open(path)) return PBRE::Core::equirectToCubeFaces(decoder, faceSize);
 
-void Texture::loadHDRAsCubemap(const char* path, int faceSize) {
-    target_ = GL_TEXTURE_CUBE_MAP;
     // Do not flip when sampling into a cubemap
     stbi_set_flip_vertically_on_load(false);
     int w, h, ch;
-    float* data = stbi_loadf(path, &w, &h, &ch, 0);
+    float* data = stbi_loadf(path, &w, &h, &ch, 3);
     if (!data) {
         throw std::runtime_error(std::string("Failed to load HDR: ") + stbi_failure_reason());
     }
+    std::vector<float> faces = PBRE::Core::equirectToCubeFaces(data, w, h, faceSize);
+    stbi_image_free(data);
+    return faces;
+}
+
+// BPTC is core since 4.2, but the driver can still report it unsupported for cubemaps
+static bool bc6hSupported() {
+    GLint supported = GL_FALSE;
+    glGetInternalformativ(GL_TEXTURE_CUBE_MAP, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, GL_INTERNALFORMAT_SUPPORTED, 1, &supported);
+    return supported == GL_TRUE;
+}
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, id_);
+void Texture::loadHDRAsCubemap(const char* path, int faceSize, CubemapFormat format, CubemapLoadStats* stats, std::source_location site) {
+    auto start = std::chrono::steady_clock::now();
+    create();
+    if (owner_.empty()) owner_ = path;
+    target_ = GL_TEXTURE_CUBE_MAP;
+    if (format == CubemapFormat::BC6H && !bc6hSupported()) {
+        std::cerr << "BC6H isn't supported for cubemaps, " << path << " falls back to RGB9_E5" << std::endl;
+        format = CubemapFormat::RGB9E5;
+    }
+    GLenum internalFormat = format == CubemapFormat::BC6H     ? GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT
+                            : format == CubemapFormat::RGB9E5 ? GL_RGB9_E5
+                                                              : GL_RGB16F;
+    if (!track(internalFormat, faceSize, faceSize, 6, site)) {
+        throw std::runtime_error(std::string("GPU memory budget refused cubemap: ") + path);
+    }
+    GlState::instance().bindTextureForUpdate(GL_TEXTURE_CUBE_MAP, id_);
     width_ = faceSize; height_ = faceSize;
+    format_ = internalFormat;
 
-    std::vector<float> face(faceSize * faceSize * 3);
-    auto sampleHDR = [&](float u, float v) {
-        // wrap U, clamp V
-        u = u - floorf(u);
-        v = fmaxf(0.0f, fminf(1.0f, v));
-        float x = u * (w - 1);
-        float y = v * (h - 1);
-        int x0 = (int)floorf(x);
-        int y0 = (int)floorf(y);
-        int x1 = (x0 + 1) % w;
-        int y1 = (y0 + 1 < h) ? (y0 + 1) : (h - 1);
-        float tx = x - x0;
-        float ty = y - y0;
-        auto fetch = [&](int ix, int iy) {
-            int idx = (iy * w + ix) * ch;
-            float r = data[idx + 0];
-            float g = (ch > 1) ? data[idx + 1] : r;
-            float b = (ch > 2) ? data[idx + 2] : r;
-            return std::array<float,3>{r,g,b};
-        };
-        auto c00 = fetch(x0, y0);
-        auto c10 = fetch(x1, y0);
-        auto c01 = fetch(x0, y1);
-        auto c11 = fetch(x1, y1);
-        std::array<float,3> c{};
-        for (int k = 0; k < 3; ++k) {
-            float a = c00[k] * (1.0f - tx) + c10[k] * tx;
-            float b = c01[k] * (1.0f - tx) + c11[k] * tx;
-            c[k] = a * (1.0f - ty) + b * ty;
+    CubemapLoadStats result;
+    result.format = format;
+    result.rgb16fBytes = GpuMemory::imageBytes(GL_RGB16F, faceSize, faceSize, 6, GpuMemory::mipLevels(faceSize, faceSize));
+    if (format == CubemapFormat::RGB16F) {
+        std::vector<float> faces = equirectToFaces(path, faceSize);
+        size_t faceFloats = static_cast<size_t>(faceSize) * faceSize * 3;
+        for (int f = 0; f < 6; ++f) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, 0, GL_RGB16F,
+                         faceSize, faceSize, 0, GL_RGB, GL_FLOAT, faces.data() + faceFloats * f);
         }
-        return c;
-    };
-
-    for (int f = 0; f < 6; ++f) {
-        for (int y = 0; y < faceSize; ++y) {
-            for (int x = 0; x < faceSize; ++x) {
-                float sx = (2.0f * (x + 0.5f) / faceSize) - 1.0f;
-                // make +y upwards on the face
-                float sy = -((2.0f * (y + 0.5f) / faceSize) - 1.0f);
-                float dir[3]; faceDir(f, sx, sy, dir);
-                float u, v; dirToEquirectUV(dir, u, v);
-                auto c = sampleHDR(u, v);
-                int idx = (y * faceSize + x) * 3;
-                face[idx+0] = c[0];
-                face[idx+1] = c[1];
-                face[idx+2] = c[2];
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        result.bytes = result.rgb16fBytes;
+    } else {
+        // The encoded mip chain is cached next to the HDR, keyed by its size and modification time
+        auto hdrFormat = format == CubemapFormat::BC6H ? PBRE::Core::HdrFormat::BC6H : PBRE::Core::HdrFormat::RGB9E5;
+        std::string cachePath = std::string(path) + "." + std::to_string(faceSize) + (format == CubemapFormat::BC6H ? ".bc6h" : ".rgb9e5");
+        PBRE::Core::CompressedCubemap compressed;
+        result.cached = compressed.load(cachePath, path, hdrFormat, faceSize);
+        if (!result.cached) {
+            compressed = PBRE::Core::compressCubemap(equirectToFaces(path, faceSize), faceSize, hdrFormat);
+            if (!compressed.save(cachePath, path)) std::cerr << "Couldn't write the cubemap cache " << cachePath << std::endl;
+        }
+        for (int level = 0; level < compressed.levels; ++level) {
+            int size = std::max(1, faceSize >> level);
+            for (int f = 0; f < 6; ++f) {
+                const auto& image = compressed.images[static_cast<size_t>(level) * 6 + f];
+                if (format == CubemapFormat::BC6H) {
+                    glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, level, internalFormat, size, size, 0,
+                                           static_cast<GLsizei>(image.size()), image.data());
+                } else {
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, level, internalFormat, size, size, 0, GL_RGB,
+                                 GL_UNSIGNED_INT_5_9_9_9_REV, image.data());
+                }
             }
         }
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, 0, GL_RGB16F,
-                     faceSize, faceSize, 0, GL_RGB, GL_FLOAT, face.data());
+        result.bytes = compressed.bytes();
+        result.meanStops = compressed.meanStops;
+        result.maxStops = compressed.maxStops;
+        result.encodeMs = compressed.encodeMs;
     }
-    stbi_image_free(data);
 
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-}
\ No newline at end of file
+    result.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (stats) *stats = result;
+}
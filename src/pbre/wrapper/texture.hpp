@@ -2,29 +2,85 @@
 
 #include <glad/glad.h>
 
+#include <memory>
+#include <source_location>
+#include <string>
 #include <vector>
 
 namespace PBRE::Wrapper {
+// Storage of an HDR environment cubemap. The compressed ones are encoded on the CPU and cached next to the HDR.
+enum class CubemapFormat {
+    RGB16F,
+    BC6H,   // RGB9E5 where the driver doesn't support it
+    RGB9E5,
+};
+
+struct CubemapLoadStats {
+    CubemapFormat format = CubemapFormat::RGB16F; // as uploaded, after the fallback
+    bool cached = false;   // read from the cache instead of encoded
+    double loadMs = 0.0;
+    double encodeMs = 0.0; // of the encode that filled the cache when it was read from it
+    size_t bytes = 0;
+    size_t rgb16fBytes = 0; // the same mip chain as RGB16F
+    double meanStops = 0.0; // luminance error of the encoding, 0 for RGB16F
+    double maxStops = 0.0;
+};
+
+// 8-bit pixels with 1 to 4 channels, rows tightly packed
+struct TexturePixels {
+    std::shared_ptr<const unsigned char> data;
+    int width = 0, height = 0;
+    int channels = 4;
+};
+
+// The GL name is created by the first load, so a Texture can be constructed (e.g. while decoding a model on a
+// worker thread) before it is filled in on the GL thread.
 class Texture {
   public:
-    Texture();
+    Texture() = default;
     ~Texture();
 
-    void loadFromFile(const char* path, bool equirectangular = false);
-    void loadHDRAsCubemap(const char* path, int faceSize = 512);
-    bool loadFromImageData(int width, int height, int channels, const std::vector<unsigned char>& data);
+    // The loads record their storage in GpuMemory under owner() and the caller's site. Over a refusing
+    // budget the file loads throw and the pixel loads return false.
+    void loadFromFile(const char* path, bool equirectangular = false, std::source_location site = std::source_location::current());
+    void loadHDRAsCubemap(const char* path, int faceSize = 512, CubemapFormat format = CubemapFormat::RGB16F, CubemapLoadStats* stats = nullptr,
+                          std::source_location site = std::source_location::current());
+    bool loadFromImageData(int width, int height, int channels, const std::vector<unsigned char>& data,
+                           std::source_location site = std::source_location::current());
+    // 8-bit pixels with 1 to 4 channels, rows tightly packed
+    bool loadFromPixels(int width, int height, int channels, const unsigned char* pixels,
+                        std::source_location site = std::source_location::current());
+    // Unsized format the pixel loads use for a channel count
+    static GLenum pixelFormat(int channels);
+    // Level 0 as decoded, kept for CPU side consumers such as the path tracer by owners that ask for it.
+    // Empty otherwise; GL is never read back.
+    void setCpuPixels(TexturePixels pixels) { cpuPixels_ = std::move(pixels); }
+    const TexturePixels& cpuPixels() const { return cpuPixels_; }
 
     void bind(unsigned int unit = 0) const;
     GLuint getID() const;
+    GLenum getTarget() const { return target_; }
+    // As given to glTexImage2D, unsized for the 8-bit loads
+    GLenum getFormat() const { return format_; }
     int getWidth() const { return width_; }
     int getHeight() const { return height_; }
     // Returns approximate max mip level usable (mip count - 1)
     float getMaxMips() const;
 
+    // What the memory tracker files the texture under, the file loads default it to the path
+    void setOwner(std::string owner) { owner_ = std::move(owner); }
+    const std::string& owner() const { return owner_; }
+
   private:
+    void create();
+    bool track(GLenum format, int width, int height, int layers, std::source_location site);
+
     GLuint id_ = 0;
     GLenum target_ = GL_TEXTURE_2D;
+    GLenum format_ = 0;
     int width_ = 0;
     int height_ = 0;
+    std::string owner_;
+    TexturePixels cpuPixels_;
 };
 } // namespace PBRE::Wrapper
\ No newline at end of file
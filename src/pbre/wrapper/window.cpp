@@ -1,5 +1,7 @@
 #include "window.hpp"
 
+#include "gl_state.hpp"
+
 #include <glad/glad.h>
 
 #define IMGUI_DEFINE_MATH_OPERATORS
@@ -63,7 +65,7 @@ bool Window::shouldClose() const {
 void Window::beginFrame() const {
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     // Ensure depth writes enabled so glClear clears depth buffer as expected
-    glDepthMask(GL_TRUE);
+    GlState::instance().depthMask(true);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     ImGui_ImplOpenGL3_NewFrame();
@@ -71,12 +73,33 @@ void Window::beginFrame() const {
     ImGui::NewFrame();
 }
 void Window::endFrame() const {
+    renderUI();
+    present();
+}
+void Window::renderUI() const {
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
+    // The backend restores what it changes, but through raw GL calls the cache doesn't see
+    GlState::instance().invalidate();
+}
+void Window::present() const {
+    swapBuffers();
+    pollEvents();
+}
+void Window::swapBuffers() const {
     glfwSwapBuffers(window_);
+}
+void Window::pollEvents() const {
     glfwPollEvents();
 }
+void Window::setSwapInterval(int interval) const {
+    glfwSwapInterval(interval);
+}
+double Window::refreshRate() const {
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+    return mode && mode->refreshRate > 0 ? mode->refreshRate : 60.0;
+}
 int Window::getWidth() const {
     int width, height;
     glfwGetFramebufferSize(window_, &width, &height);
@@ -10,7 +10,18 @@ class Window {
 
     bool shouldClose() const;
     void beginFrame() const;
+    // renderUI() then present()
     void endFrame() const;
+    // Draw this frame's ImGui data into the bound framebuffer
+    void renderUI() const;
+    // swapBuffers() then pollEvents()
+    void present() const;
+    void swapBuffers() const;
+    void pollEvents() const;
+    // 0 presents immediately, 1 waits for vblank
+    void setSwapInterval(int interval) const;
+    // Of the primary monitor, 60 if unknown
+    double refreshRate() const;
 
     GLFWwindow* getGLFWwindow() const { return window_; }
 
@@ -0,0 +1,300 @@
+#include "test.hpp"
+
+#include "pbre/core/accessor.hpp"
+
+#include <tiny_gltf.h>
+
+#include <cstring>
+
+using namespace PBRE;
+
+namespace {
+// Synthetic glTF: one buffer that views and accessors are appended to
+struct GltfBuilder {
+    tinygltf::Model model;
+
+    GltfBuilder() { model.buffers.emplace_back(); }
+
+    std::vector<unsigned char>& bytes() { return model.buffers[0].data; }
+    Core::BufferSpans buffers() const { return Core::ownedBufferSpans(model); }
+
+    int view(const void* data, size_t size, size_t stride = 0) {
+        auto& out = bytes();
+        while (out.size() % 4) out.push_back(0); // views start aligned, like exporters write them
+        tinygltf::BufferView v;
+        v.buffer = 0;
+        v.byteOffset = out.size();
+        v.byteLength = size;
+        v.byteStride = stride;
+        auto src = static_cast<const unsigned char*>(data);
+        out.insert(out.end(), src, src + size);
+        model.bufferViews.push_back(v);
+        return static_cast<int>(model.bufferViews.size()) - 1;
+    }
+    template <class T> int view(const std::vector<T>& data, size_t stride = 0) { return view(data.data(), data.size() * sizeof(T), stride); }
+
+    int accessor(int view, size_t byteOffset, int componentType, int type, size_t count, bool normalized = false) {
+        tinygltf::Accessor a;
+        a.bufferView = view;
+        a.byteOffset = byteOffset;
+        a.componentType = componentType;
+        a.type = type;
+        a.count = count;
+        a.normalized = normalized;
+        model.accessors.push_back(a);
+        return static_cast<int>(model.accessors.size()) - 1;
+    }
+};
+
+// glTF 2.0 normalized integer decoding as the spec writes it
+float specNormalized(int value, int componentType) {
+    switch (componentType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: return value / 255.0f;
+    case TINYGLTF_COMPONENT_TYPE_BYTE: return std::max(value / 127.0f, -1.0f);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: return value / 65535.0f;
+    case TINYGLTF_COMPONENT_TYPE_SHORT: return std::max(value / 32767.0f, -1.0f);
+    default: return static_cast<float>(value);
+    }
+}
+} // namespace
+
+// Positions and UVs interleaved in one view, 20 bytes per vertex
+PBRE_TEST(accessorByteStride) {
+    GltfBuilder gltf;
+    constexpr size_t kCount = 5;
+    std::vector<float> interleaved;
+    for (size_t i = 0; i < kCount; ++i) {
+        float f = static_cast<float>(i);
+        interleaved.insert(interleaved.end(), {f, f + 0.25f, f + 0.5f, -f, f * 2.0f});
+    }
+    int view = gltf.view(interleaved, 20);
+    int positions = gltf.accessor(view, 0, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, kCount);
+    int uvs = gltf.accessor(view, 12, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2, kCount);
+
+    std::vector<float> p(kCount * 3), t(kCount * 2);
+    CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), positions, p.data(), 3));
+    CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), uvs, t.data(), 2));
+    for (size_t i = 0; i < kCount; ++i) {
+        float f = static_cast<float>(i);
+        CHECK(p[i * 3 + 0] == f && p[i * 3 + 1] == f + 0.25f && p[i * 3 + 2] == f + 0.5f);
+        CHECK(t[i * 2 + 0] == -f && t[i * 2 + 1] == f * 2.0f);
+    }
+
+    // Widening to vec4 zero fills, narrowing drops components
+    std::vector<float> wide(kCount * 4);
+    CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), uvs, wide.data(), 4));
+    CHECK(wide[4] == -1.0f && wide[5] == 2.0f && wide[6] == 0.0f && wide[7] == 0.0f);
+
+    size_t stride = 0;
+    auto raw = Core::stridedData(gltf.model, gltf.buffers(), uvs, stride);
+    CHECK(stride == 20);
+    CHECK(raw.size() == (kCount - 1) * 20 + 8);
+
+    // The last element would run past the view
+    int overrun = gltf.accessor(view, 16, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2, kCount);
+    CHECK(!Core::decodeFloats(gltf.model, gltf.buffers(), overrun, wide.data(), 2));
+}
+
+// Strided 16-bit indices and 8-bit ones of every count the SSE path splits into
+PBRE_TEST(accessorIndices) {
+    GltfBuilder gltf;
+    std::vector<uint16_t> strided;
+    for (uint16_t i = 0; i < 9; ++i) strided.insert(strided.end(), {static_cast<uint16_t>(i * 1000), 0xffff});
+    int view = gltf.view(strided, 4);
+    int accessor = gltf.accessor(view, 0, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, TINYGLTF_TYPE_SCALAR, 9);
+    std::vector<uint32_t> out(9);
+    CHECK(Core::decodeIndices(gltf.model, gltf.buffers(), accessor, out.data()));
+    for (uint32_t i = 0; i < 9; ++i) CHECK(out[i] == i * 1000);
+
+    std::vector<uint8_t> bytes(37);
+    for (size_t i = 0; i < bytes.size(); ++i) bytes[i] = static_cast<uint8_t>(255 - i);
+    int packed = gltf.accessor(gltf.view(bytes), 0, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, TINYGLTF_TYPE_SCALAR, bytes.size());
+    out.assign(bytes.size(), 0);
+    CHECK(Core::decodeIndices(gltf.model, gltf.buffers(), packed, out.data()));
+    for (size_t i = 0; i < bytes.size(); ++i) CHECK(out[i] == bytes[i]);
+}
+
+PBRE_TEST(accessorNormalizedBytes) {
+    GltfBuilder gltf;
+    std::vector<int8_t> signedBytes = {-128, -127, -64, -1, 0, 1, 64, 126, 127};
+    std::vector<uint8_t> unsignedBytes = {0, 1, 127, 128, 254, 255, 3, 7, 200};
+    int s = gltf.accessor(gltf.view(signedBytes), 0, TINYGLTF_COMPONENT_TYPE_BYTE, TINYGLTF_TYPE_VEC3, 3, true);
+    int u = gltf.accessor(gltf.view(unsignedBytes), 0, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, TINYGLTF_TYPE_VEC3, 3, true);
+    int raw = gltf.accessor(gltf.view(signedBytes), 0, TINYGLTF_COMPONENT_TYPE_BYTE, TINYGLTF_TYPE_VEC3, 3, false);
+
+    std::vector<float> out(9);
+    CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), s, out.data(), 3));
+    CHECK(out[0] == -1.0f && out[1] == -1.0f && out[8] == 1.0f);
+    for (size_t i = 0; i < out.size(); ++i) CHECK_NEAR(out[i], specNormalized(signedBytes[i], TINYGLTF_COMPONENT_TYPE_BYTE), 1e-6f);
+    CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), u, out.data(), 3));
+    CHECK(out[0] == 0.0f && out[5] == 1.0f);
+    for (size_t i = 0; i < out.size(); ++i) CHECK_NEAR(out[i], specNormalized(unsignedBytes[i], TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE), 1e-6f);
+    CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), raw, out.data(), 3));
+    for (size_t i = 0; i < out.size(); ++i) CHECK(out[i] == signedBytes[i]);
+}
+
+PBRE_TEST(accessorNormalizedShorts) {
+    GltfBuilder gltf;
+    std::vector<int16_t> signedShorts = {-32768, -32767, -16384, -1, 0, 1, 16384, 32766, 32767, 5};
+    std::vector<uint16_t> unsignedShorts = {0, 1, 32767, 32768, 65534, 65535, 3, 700, 40000, 9};
+    int s = gltf.accessor(gltf.view(signedShorts), 0, TINYGLTF_COMPONENT_TYPE_SHORT, TINYGLTF_TYPE_VEC2, 5, true);
+    int u = gltf.accessor(gltf.view(unsignedShorts), 0, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, TINYGLTF_TYPE_VEC2, 5, true);
+
+    std::vector<float> out(10);
+    CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), s, out.data(), 2));
+    CHECK(out[0] == -1.0f && out[1] == -1.0f && out[8] == 1.0f);
+    for (size_t i = 0; i < out.size(); ++i) CHECK_NEAR(out[i], specNormalized(signedShorts[i], TINYGLTF_COMPONENT_TYPE_SHORT), 1e-6f);
+    CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), u, out.data(), 2));
+    CHECK(out[0] == 0.0f && out[5] == 1.0f);
+    for (size_t i = 0; i < out.size(); ++i) CHECK_NEAR(out[i], specNormalized(unsignedShorts[i], TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT), 1e-6f);
+}
+
+// The tightly packed conversion takes the SSE path, the same values strided take the scalar one. Both must
+// give bit identical floats, for lengths that leave a scalar tail.
+PBRE_TEST(accessorSseMatchesScalar) {
+    const int types[] = {TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, TINYGLTF_COMPONENT_TYPE_BYTE, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT,
+                         TINYGLTF_COMPONENT_TYPE_SHORT, TINYGLTF_COMPONENT_TYPE_FLOAT};
+    uint32_t state = 12345;
+    auto next = [&] { return state = state * 1664525u + 1013904223u; };
+    for (int type : types) {
+        size_t size = Core::componentSize(type);
+        for (bool normalized : {false, true}) {
+            if (type == TINYGLTF_COMPONENT_TYPE_FLOAT && normalized) continue;
+            for (size_t count : {1u, 5u, 16u, 37u, 100u}) {
+                constexpr int kComponents = 4;
+                size_t elementSize = size * kComponents;
+                std::vector<unsigned char> packed(count * elementSize);
+                for (auto& b : packed) b = static_cast<unsigned char>(next() >> 24);
+                if (type == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+                    for (size_t i = 0; i < count * kComponents; ++i) {
+                        float f = static_cast<float>(static_cast<int32_t>(next())) / 65536.0f;
+                        std::memcpy(packed.data() + i * 4, &f, 4);
+                    }
+                }
+                size_t stride = elementSize + 4;
+                std::vector<unsigned char> strided(count * stride, 0xcd);
+                for (size_t e = 0; e < count; ++e) std::memcpy(strided.data() + e * stride, packed.data() + e * elementSize, elementSize);
+
+                std::vector<float> fast(count * kComponents), scalar(count * kComponents);
+                Core::convertToFloat(packed.data(), count, elementSize, type, kComponents, normalized, fast.data(), kComponents);
+                Core::convertToFloat(strided.data(), count, stride, type, kComponents, normalized, scalar.data(), kComponents);
+                CHECK(std::memcmp(fast.data(), scalar.data(), fast.size() * sizeof(float)) == 0);
+            }
+        }
+    }
+}
+
+PBRE_TEST(accessorSparse) {
+    GltfBuilder gltf;
+    std::vector<float> base(6 * 3);
+    for (size_t i = 0; i < base.size(); ++i) base[i] = static_cast<float>(i);
+    std::vector<uint16_t> indices = {1, 4};
+    std::vector<float> values = {-1.0f, -2.0f, -3.0f, -4.0f, -5.0f, -6.0f};
+    int baseView = gltf.view(base);
+    int indexView = gltf.view(indices);
+    int valueView = gltf.view(values);
+    auto makeSparse = [&](int accessor) {
+        auto& sparse = gltf.model.accessors[accessor].sparse;
+        sparse.isSparse = true;
+        sparse.count = 2;
+        sparse.indices.bufferView = indexView;
+        sparse.indices.byteOffset = 0;
+        sparse.indices.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+        sparse.values.bufferView = valueView;
+        sparse.values.byteOffset = 0;
+    };
+
+    int withBase = gltf.accessor(baseView, 0, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, 6);
+    makeSparse(withBase);
+    std::vector<float> out(6 * 3);
+    CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), withBase, out.data(), 3));
+    for (size_t e = 0; e < 6; ++e) {
+        for (size_t c = 0; c < 3; ++c) {
+            float expected = e == 1 ? values[c] : e == 4 ? values[3 + c] : base[e * 3 + c];
+            CHECK(out[e * 3 + c] == expected);
+        }
+    }
+    size_t stride = 0;
+    CHECK(Core::stridedData(gltf.model, gltf.buffers(), withBase, stride).empty()); // can't be uploaded as is
+
+    // Without a buffer view the base is zeros
+    int zeros = gltf.accessor(-1, 0, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, 6);
+    makeSparse(zeros);
+    CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), zeros, out.data(), 3));
+    for (size_t e = 0; e < 6; ++e) {
+        for (size_t c = 0; c < 3; ++c) {
+            float expected = e == 1 ? values[c] : e == 4 ? values[3 + c] : 0.0f;
+            CHECK(out[e * 3 + c] == expected);
+        }
+    }
+
+    // Substitutions past the end of the accessor are malformed
+    int shortAccessor = gltf.accessor(baseView, 0, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, 4);
+    makeSparse(shortAccessor);
+    CHECK(!Core::decodeFloats(gltf.model, gltf.buffers(), shortAccessor, out.data(), 3));
+}
+
+// Columns of 8 and 16-bit mat2 and mat3 elements start on 4-byte boundaries. The padding is filled with a
+// value that would show up if it were read.
+PBRE_TEST(accessorMatrixColumnPadding) {
+    struct Case {
+        int type;
+        int componentType;
+        int columns, rows;
+        size_t columnStride;
+    };
+    const Case cases[] = {
+        {TINYGLTF_TYPE_MAT2, TINYGLTF_COMPONENT_TYPE_BYTE, 2, 2, 4},
+        {TINYGLTF_TYPE_MAT3, TINYGLTF_COMPONENT_TYPE_BYTE, 3, 3, 4},
+        {TINYGLTF_TYPE_MAT3, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, 3, 3, 4},
+        {TINYGLTF_TYPE_MAT2, TINYGLTF_COMPONENT_TYPE_SHORT, 2, 2, 4},  // already aligned
+        {TINYGLTF_TYPE_MAT3, TINYGLTF_COMPONENT_TYPE_SHORT, 3, 3, 8},
+        {TINYGLTF_TYPE_MAT4, TINYGLTF_COMPONENT_TYPE_BYTE, 4, 4, 4},   // already aligned
+    };
+    for (const auto& c : cases) {
+        GltfBuilder gltf;
+        constexpr size_t kCount = 3;
+        size_t size = Core::componentSize(c.componentType);
+        size_t elementSize = c.columnStride * c.columns;
+        std::vector<unsigned char> bytes(kCount * elementSize, 0x55);
+        std::vector<int> expected;
+        for (size_t e = 0; e < kCount; ++e) {
+            for (int col = 0; col < c.columns; ++col) {
+                for (int row = 0; row < c.rows; ++row) {
+                    int value = static_cast<int>(e * 16 + col * 4 + row) - 10;
+                    if (c.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) value += 10;
+                    unsigned char* p = bytes.data() + e * elementSize + col * c.columnStride + row * size;
+                    if (size == 1) {
+                        *p = static_cast<unsigned char>(value);
+                    } else {
+                        int16_t v = static_cast<int16_t>(value);
+                        std::memcpy(p, &v, 2);
+                    }
+                    expected.push_back(value);
+                }
+            }
+        }
+        int accessor = gltf.accessor(gltf.view(bytes), 0, c.componentType, c.type, kCount, true);
+        int components = c.columns * c.rows;
+        std::vector<float> out(kCount * components);
+        CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), accessor, out.data(), components));
+        for (size_t i = 0; i < out.size(); ++i) CHECK_NEAR(out[i], specNormalized(expected[i], c.componentType), 1e-6f);
+
+        // A view exactly as long as the padded elements is in bounds
+        gltf.model.bufferViews.back().byteLength = bytes.size();
+        CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), accessor, out.data(), components));
+        // Sparse values are padded the same way
+        int indexView = gltf.view(std::vector<uint8_t>{2});
+        int valueView = gltf.view(bytes.data(), elementSize);
+        auto& sparse = gltf.model.accessors[accessor].sparse;
+        sparse.isSparse = true;
+        sparse.count = 1;
+        sparse.indices.bufferView = indexView;
+        sparse.indices.byteOffset = 0;
+        sparse.indices.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+        sparse.values.bufferView = valueView;
+        sparse.values.byteOffset = 0;
+        CHECK(Core::decodeFloats(gltf.model, gltf.buffers(), accessor, out.data(), components));
+        for (int i = 0; i < components; ++i) CHECK_NEAR(out[2 * components + i], specNormalized(expected[i], c.componentType), 1e-6f);
+    }
+}
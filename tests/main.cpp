@@ -0,0 +1,46 @@
+#include "test.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+int failures = 0;
+} // namespace
+
+std::vector<PBRE::Test::Case>& PBRE::Test::cases() {
+    static std::vector<Case> all;
+    return all;
+}
+
+bool PBRE::Test::add(const char* name, void (*run)()) {
+    cases().push_back({name, run});
+    return true;
+}
+
+bool PBRE::Test::check(bool ok, const char* expression, const char* file, int line) {
+    if (!ok) {
+        ++failures;
+        std::cerr << file << ":" << line << ": CHECK(" << expression << ") failed" << std::endl;
+    }
+    return ok;
+}
+
+// Runs every test, or the ones whose name contains the first argument
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    int failedCases = 0, run = 0;
+    for (const auto& test : PBRE::Test::cases()) {
+        if (filter && !std::strstr(test.name, filter)) continue;
+        int before = failures;
+        auto start = std::chrono::steady_clock::now();
+        test.run();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        bool passed = failures == before;
+        std::cout << (passed ? "[ OK ] " : "[FAIL] ") << test.name << " (" << ms << " ms)" << std::endl;
+        failedCases += passed ? 0 : 1;
+        ++run;
+    }
+    std::cout << run - failedCases << "/" << run << " tests passed" << std::endl;
+    return failedCases == 0 ? 0 : 1;
+}
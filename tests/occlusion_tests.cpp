@@ -0,0 +1,43 @@
+#include "test.hpp"
+
+#include "pbre/render/occlusion.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace PBRE;
+
+namespace {
+// Camera at the origin looking down -z, 90 degree square frustum, so NDC x and y are eye x / -z and y / -z
+mat4 nearPlaneProjection() {
+    return glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+}
+
+// Behind the occluder's projection, at NDC x 0.36 to 0.67 and y 0 to 0.22, depth about 0.98
+Render::OcclusionCuller::Result testBox(const Render::OcclusionCuller& culler) {
+    return culler.test(vec3(2.0f, 0.0f, -5.5f), vec3(3.0f, 1.0f, -4.5f), nearPlaneProjection());
+}
+} // namespace
+
+// Both triangles project to the same screen triangle around the box. The far one is all beyond the near
+// plane and hides the box.
+PBRE_TEST(occlusionCullsBehindOccluder) {
+    Render::OcclusionCuller culler;
+    const vec3 positions[] = {{-0.4f, -0.4f, -1.0f}, {0.4f, -0.4f, -1.0f}, {10.0f, 10.0f, -1.0f}};
+    const uint32_t indices[] = {0, 1, 2};
+    culler.clear();
+    culler.addOccluder(positions, indices, nearPlaneProjection());
+    culler.rasterize();
+    CHECK(testBox(culler) == Render::OcclusionCuller::Result::Occluded);
+}
+
+// The near one has two vertices between the eye and the near plane. The GPU clips everything of it that
+// would cover the box, what is left projects off screen, so the box must stay visible.
+PBRE_TEST(occlusionSkipsOccludersCrossingNearPlane) {
+    Render::OcclusionCuller culler;
+    const vec3 positions[] = {{-0.02f, -0.02f, -0.05f}, {0.02f, -0.02f, -0.05f}, {10.0f, 10.0f, -1.0f}};
+    const uint32_t indices[] = {0, 1, 2};
+    culler.clear();
+    culler.addOccluder(positions, indices, nearPlaneProjection());
+    culler.rasterize();
+    CHECK(testBox(culler) == Render::OcclusionCuller::Result::Visible);
+}
@@ -0,0 +1,107 @@
+#include "test.hpp"
+
+#include "pbre/render/path_tracer.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// texture.cpp holds the implementation in the engine, the tests don't link it
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <iostream>
+
+using namespace PBRE;
+
+namespace {
+constexpr int kImageSize = 64;
+
+// A box on a floor under the point light, no textures or environment, so nothing needs GL. The box and
+// floor light each other, which gives every pixel Monte Carlo noise from the bounces.
+struct BoxScene {
+    Wrapper::Model model;
+
+    BoxScene() {
+        model.materials.resize(2);
+        model.materials[0].albedo = vec3(0.8f);
+        model.materials[0].roughness = 0.9f;
+        model.materials[1].albedo = vec3(0.7f, 0.3f, 0.2f);
+        model.materials[1].metallic = 0.0f;
+        model.materials[1].roughness = 0.4f;
+
+        Wrapper::Mesh floor;
+        floor.positions = {{-4.0f, 0.0f, -4.0f}, {4.0f, 0.0f, -4.0f}, {4.0f, 0.0f, 4.0f}, {-4.0f, 0.0f, 4.0f}};
+        floor.normals.assign(4, vec3(0.0f, 1.0f, 0.0f));
+        floor.indices = {0, 2, 1, 0, 3, 2};
+        floor.materialIndex = 0;
+        model.meshes.push_back(floor);
+
+        // Unit cube resting on the floor, a quad per face so the normals stay flat
+        Wrapper::Mesh box;
+        const vec3 normals[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        for (const vec3& n : normals) {
+            vec3 u = std::abs(n.y) > 0.5f ? vec3(1, 0, 0) : vec3(0, 1, 0);
+            vec3 v = glm::cross(n, u);
+            uint32_t base = static_cast<uint32_t>(box.positions.size());
+            for (int k = 0; k < 4; ++k) {
+                float su = (k == 1 || k == 2) ? 0.5f : -0.5f, sv = k >= 2 ? 0.5f : -0.5f;
+                box.positions.push_back(vec3(0.0f, 0.5f, 0.0f) + n * 0.5f + u * su + v * sv);
+                box.normals.push_back(n);
+            }
+            for (uint32_t i : {0u, 1u, 2u, 0u, 2u, 3u}) box.indices.push_back(base + i);
+        }
+        box.materialIndex = 1;
+        model.meshes.push_back(box);
+    }
+
+    void submitTo(Render::PathTracer& tracer) const {
+        for (const auto& mesh : model.meshes) tracer.submit(model, mesh, mat4(1.0f));
+        tracer.build();
+        tracer.resize(kImageSize, kImageSize);
+        tracer.setCamera(glm::lookAt(vec3(3.0f, 2.5f, 3.0f), vec3(0.0f, 0.5f, 0.0f), vec3(0.0f, 1.0f, 0.0f)),
+                         glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 50.0f));
+    }
+};
+
+Render::PathTracerSettings boxSettings() {
+    Render::PathTracerSettings settings;
+    settings.lightPosition = vec3(1.5f, 4.0f, 1.0f);
+    settings.lightIntensity = 20.0f;
+    settings.enableIBL = false;
+    return settings;
+}
+} // namespace
+
+// The error of an unbiased estimator falls with 1/sqrt(samples), so every doubling of the samples per
+// pixel should take the noise estimate down by about 1/sqrt(2)
+PBRE_TEST(pathTracerNoiseFallsPerSampleDoubling) {
+    BoxScene scene;
+    Render::PathTracer tracer;
+    scene.submitTo(tracer);
+    auto settings = boxSettings();
+
+    tracer.render(settings, 8);
+    double previous = tracer.noiseEstimate();
+    CHECK(previous > 0.0);
+    for (int spp = 16; spp <= 64; spp *= 2) {
+        tracer.render(settings, spp - tracer.sampleCount());
+        double noise = tracer.noiseEstimate();
+        CHECK_NEAR(noise / previous, 1.0 / std::sqrt(2.0), 0.12);
+        previous = noise;
+    }
+}
+
+// Floor far below what any core does on this scene, catches traversal or shading slowing down by an order
+// of magnitude rather than measuring the machine
+PBRE_TEST(pathTracerRaysPerSecond) {
+    constexpr double kMinRaysPerSecond = 200000.0;
+    BoxScene scene;
+    Render::PathTracer tracer;
+    scene.submitTo(tracer);
+    auto settings = boxSettings();
+
+    tracer.render(settings, 2); // warms the job system's workers up
+    auto stats = tracer.render(settings, 16);
+    std::cout << "  " << stats.rays << " rays in " << stats.ms << " ms, " << stats.raysPerSecond() / 1e6 << " Mrays/s" << std::endl;
+    CHECK(stats.rays > 0);
+    CHECK(stats.raysPerSecond() > kMinRaysPerSecond);
+}
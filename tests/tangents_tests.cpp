@@ -0,0 +1,64 @@
+#include "test.hpp"
+
+#include "pbre/core/tangents.hpp"
+
+using namespace PBRE;
+
+namespace {
+// Two quads side by side in the xy plane facing +z, six vertices with the middle column shared. With
+// mirrored set the right quad's u runs back from 1 to 0, the way a symmetric model reuses half its texture.
+struct Strip {
+    std::vector<vec3> positions, normals;
+    std::vector<vec2> uvs;
+    std::vector<uint32_t> indices = {0, 1, 4, 0, 4, 3, 1, 2, 5, 1, 5, 4};
+
+    explicit Strip(bool mirrored) {
+        for (int y = 0; y < 2; ++y) {
+            for (int x = 0; x < 3; ++x) {
+                positions.push_back(vec3(x, y, 0.0f));
+                normals.push_back(vec3(0.0f, 0.0f, 1.0f));
+                float u = mirrored ? (x == 1 ? 1.0f : 0.0f) : x * 0.5f;
+                uvs.push_back(vec2(u, y));
+            }
+        }
+    }
+};
+
+// The tangent each corner ends up with once the split corners point at their copies
+vec4 cornerTangent(const Core::GeneratedTangents& generated, const std::vector<uint32_t>& indices, uint32_t corner) {
+    uint32_t vertex = indices[corner];
+    for (const auto& split : generated.splitCorners) {
+        if (split.corner == corner) vertex = split.vertex;
+    }
+    return generated.tangents[vertex];
+}
+} // namespace
+
+PBRE_TEST(tangentsKeepConsistentUVsShared) {
+    Strip strip(false);
+    Core::GeneratedTangents generated;
+    Core::generateTangents(strip.positions, strip.normals, strip.uvs, strip.indices, generated);
+    CHECK(generated.splitSources.empty());
+    CHECK(generated.splitCorners.empty());
+    CHECK(generated.tangents.size() == strip.positions.size());
+    for (const vec4& t : generated.tangents) {
+        CHECK_NEAR(t.x, 1.0, 1e-4);
+        CHECK(t.w == 1.0f);
+    }
+}
+
+// The middle column sees both handedness, its vertices must be split so each quad keeps its own tangent
+// instead of both sharing the heavier side's
+PBRE_TEST(tangentsSplitMirroredVertices) {
+    Strip strip(true);
+    Core::GeneratedTangents generated;
+    Core::generateTangents(strip.positions, strip.normals, strip.uvs, strip.indices, generated);
+    CHECK(generated.splitSources == std::vector<uint32_t>({1, 4}));
+    CHECK(generated.tangents.size() == strip.positions.size() + 2);
+    for (uint32_t corner = 0; corner < strip.indices.size(); ++corner) {
+        bool right = corner >= 6;
+        vec4 t = cornerTangent(generated, strip.indices, corner);
+        CHECK_NEAR(t.x, right ? -1.0 : 1.0, 1e-4);
+        CHECK(t.w == (right ? -1.0f : 1.0f));
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+// Minimal self-registering test runner, CPU only: tests must not need a GL context. Run with xmake test.
+namespace PBRE::Test {
+struct Case {
+    const char* name;
+    void (*run)();
+};
+
+std::vector<Case>& cases();
+bool add(const char* name, void (*run)());
+// Records a failure of the running test, returns ok
+bool check(bool ok, const char* expression, const char* file, int line);
+} // namespace PBRE::Test
+
+#define PBRE_TEST(name)                                                                                                                    \
+    static void name();                                                                                                                    \
+    static const bool name##Registered = ::PBRE::Test::add(#name, name);                                                                   \
+    static void name()
+
+#define CHECK(expression) ::PBRE::Test::check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) ::PBRE::Test::check(std::abs((a) - (b)) <= (tolerance), #a " ~ " #b, __FILE__, __LINE__)
@@ -1,6 +1,7 @@
 add_requires("glfw")
 add_requires("glad", {configs = {gl = "gl-4.6"}})
 add_requires("glm")
+add_requires("meshoptimizer")
 add_requires("imgui v1.92.1-docking", {configs = {glfw_opengl3 = true, freetype = true}})
 add_requires("spdlog")
 add_requires("stb")
@@ -14,4 +15,20 @@ target("PBREngine")
     set_kind("binary")
     add_files("src/**.cpp")
 	add_includedirs("src", {public = true})
-	add_packages("glfw", "glad", "glm", "imgui", "spdlog", "stb", "tinygltf")
\ No newline at end of file
+	add_packages("glfw", "glad", "glm", "imgui", "meshoptimizer", "spdlog", "stb", "tinygltf")
+	if is_plat("windows") then
+		add_syslinks("psapi")
+	end
+
+-- CPU only tests, run with `xmake test`
+target("tests")
+    set_kind("binary")
+    set_default(false)
+    add_files("tests/*.cpp", "src/pbre/core/accessor.cpp")
+    -- The path tracer and what it runs on, the GL wrappers are only included for their types
+    add_files("src/pbre/render/path_tracer.cpp", "src/pbre/render/bvh.cpp", "src/pbre/core/alias_table.cpp", "src/pbre/core/parallel.cpp",
+              "src/pbre/core/job_system.cpp", "src/pbre/core/hdr_decode.cpp", "src/pbre/core/hdr_compress.cpp", "src/pbre/core/mapped_file.cpp")
+    add_files("src/pbre/render/occlusion.cpp", "src/pbre/render/scene.cpp", "src/pbre/core/tangents.cpp")
+	add_includedirs("src", "tests")
+	add_packages("glfw", "glad", "glm", "meshoptimizer", "stb", "tinygltf")
+	add_tests("default")